@@ -1651,6 +1651,15 @@ static void print_final_stats(int64_t total_size)
 
         av_log(NULL, AV_LOG_VERBOSE, "  Total: %"PRIu64" packets (%"PRIu64" bytes) demuxed\n",
                total_packets, total_size);
+#if HAVE_THREADS
+        if (f->thread_queue_size > 0)
+            av_log(NULL, AV_LOG_VERBOSE, "  Queue: %d packets (%"PRId64" bytes) at most, "
+                   "%.1f packets on average; %"PRIu64" times empty, "
+                   "%"PRIu64" times throttled\n",
+                   f->queue_max, f->queue_max_bytes,
+                   f->nb_dequeued ? (double)f->queue_depth_sum / f->nb_dequeued : 0.0,
+                   f->nb_underruns, f->nb_throttled);
+#endif
     }
 
     for (i = 0; i < nb_output_files; i++) {
@@ -4079,43 +4088,130 @@ static int check_keyboard_interaction(int64_t cur_time)
 }
 
 #if HAVE_THREADS
-static void *input_thread(void *arg)
+/*
+ * The input files are read by a pool of threads shared by all of them,
+ * rather than by one thread per file. Each thread repeatedly picks a file
+ * that is not being read by another one and whose queue is not full, reads
+ * one packet from it and queues it for the main thread.
+ */
+typedef struct InputThreadPool {
+    pthread_t *threads;
+    int nb_threads;
+    int initialized;
+
+    /* protects the fields below and the shared fields of the input files */
+    pthread_mutex_t lock;
+    /* signaled when a file may have become readable or stopped being read */
+    pthread_cond_t cond;
+    int abort;
+    int next;                   /* first file to consider, for round robin */
+    int64_t queued_bytes;       /* total size of the packets in all queues */
+} InputThreadPool;
+
+static InputThreadPool input_pool;
+
+/* Choose the file with the fewest queued packets, in round robin order
+ * among equals, so that all the files are read at the same pace. Beyond
+ * the total size limit, only files with an empty queue are read. */
+static InputFile *pick_input_file(void)
 {
-    InputFile *f = arg;
-    unsigned flags = f->non_blocking ? AV_THREAD_MESSAGE_NONBLOCK : 0;
-    int ret = 0;
+    InputFile *best = NULL;
+    int i, best_idx = 0;
 
-    while (1) {
+    for (i = 0; i < nb_input_files; i++) {
+        int idx = (input_pool.next + i) % nb_input_files;
+        InputFile *f = input_files[idx];
+
+        if (f->read_done || f->reading || !f->in_thread_queue)
+            continue;
+        if (f->queued >= f->thread_queue_size) {
+            if (f->non_blocking && !f->queue_full_warned) {
+                av_log(f->ctx, AV_LOG_WARNING,
+                       "Thread message queue blocking; consider raising the "
+                       "thread_queue_size option (current value: %d)\n",
+                       f->thread_queue_size);
+                f->queue_full_warned = 1;
+            }
+            continue;
+        }
+        if (input_queue_max_bytes > 0 && f->queued &&
+            input_pool.queued_bytes >= input_queue_max_bytes) {
+            if (!f->throttled)
+                f->nb_throttled++;
+            f->throttled = 1;
+            continue;
+        }
+        if (!best || f->queued < best->queued) {
+            best     = f;
+            best_idx = idx;
+        }
+    }
+    if (best) {
+        best->throttled  = 0;
+        input_pool.next = (best_idx + 1) % nb_input_files;
+    }
+    return best;
+}
+
+static void input_queue_release(InputFile *f, const AVPacket *pkt)
+{
+    f->queued--;
+    f->queued_bytes         -= pkt->size;
+    input_pool.queued_bytes -= pkt->size;
+    pthread_cond_broadcast(&input_pool.cond);
+}
+
+static void *input_thread(void *arg)
+{
+    pthread_mutex_lock(&input_pool.lock);
+    while (!input_pool.abort) {
+        InputFile *f = pick_input_file();
         AVPacket pkt;
-        ret = av_read_frame(f->ctx, &pkt);
+        int ret;
 
-        if (ret == AVERROR(EAGAIN)) {
-            av_usleep(10000);
+        if (!f) {
+            pthread_cond_wait(&input_pool.cond, &input_pool.lock);
             continue;
         }
+        f->reading = 1;
+        pthread_mutex_unlock(&input_pool.lock);
+
+        ret = av_read_frame(f->ctx, &pkt);
+        if (ret == AVERROR(EAGAIN))
+            av_usleep(10000);
+
+        pthread_mutex_lock(&input_pool.lock);
+        f->reading = 0;
+        pthread_cond_broadcast(&input_pool.cond);
+
+        if (ret == AVERROR(EAGAIN))
+            continue;
         if (ret < 0) {
             av_thread_message_queue_set_err_recv(f->in_thread_queue, ret);
-            break;
-        }
-        ret = av_thread_message_queue_send(f->in_thread_queue, &pkt, flags);
-        if (flags && ret == AVERROR(EAGAIN)) {
-            flags = 0;
-            ret = av_thread_message_queue_send(f->in_thread_queue, &pkt, flags);
-            av_log(f->ctx, AV_LOG_WARNING,
-                   "Thread message queue blocking; consider raising the "
-                   "thread_queue_size option (current value: %d)\n",
-                   f->thread_queue_size);
+            f->read_done = 1;
+            continue;
         }
+
+        /* there is room, as only this thread queues packets for the file */
+        f->queued++;
+        f->queued_bytes         += pkt.size;
+        input_pool.queued_bytes += pkt.size;
+        f->queue_max       = FFMAX(f->queue_max,       f->queued);
+        f->queue_max_bytes = FFMAX(f->queue_max_bytes, f->queued_bytes);
+        ret = av_thread_message_queue_send(f->in_thread_queue, &pkt,
+                                           AV_THREAD_MESSAGE_NONBLOCK);
         if (ret < 0) {
             if (ret != AVERROR_EOF)
                 av_log(f->ctx, AV_LOG_ERROR,
                        "Unable to send packet to main thread: %s\n",
                        av_err2str(ret));
+            input_queue_release(f, &pkt);
             av_packet_unref(&pkt);
             av_thread_message_queue_set_err_recv(f->in_thread_queue, ret);
-            break;
+            f->read_done = 1;
         }
     }
+    pthread_mutex_unlock(&input_pool.lock);
 
     return NULL;
 }
@@ -4123,31 +4219,62 @@ static void *input_thread(void *arg)
 static void free_input_thread(int i)
 {
     InputFile *f = input_files[i];
+    AVThreadMessageQueue *queue;
     AVPacket pkt;
 
     if (!f || !f->in_thread_queue)
         return;
-    av_thread_message_queue_set_err_send(f->in_thread_queue, AVERROR_EOF);
-    while (av_thread_message_queue_recv(f->in_thread_queue, &pkt, 0) >= 0)
+
+    pthread_mutex_lock(&input_pool.lock);
+    f->read_done = 1;
+    while (f->reading)
+        pthread_cond_wait(&input_pool.cond, &input_pool.lock);
+    pthread_mutex_unlock(&input_pool.lock);
+
+    av_thread_message_queue_set_err_recv(f->in_thread_queue, AVERROR_EOF);
+    while (av_thread_message_queue_recv(f->in_thread_queue, &pkt, 0) >= 0) {
+        pthread_mutex_lock(&input_pool.lock);
+        input_queue_release(f, &pkt);
+        pthread_mutex_unlock(&input_pool.lock);
         av_packet_unref(&pkt);
+    }
 
-    pthread_join(f->thread, NULL);
-    f->joined = 1;
-    av_thread_message_queue_free(&f->in_thread_queue);
+    pthread_mutex_lock(&input_pool.lock);
+    queue = f->in_thread_queue;
+    f->in_thread_queue = NULL;
+    pthread_mutex_unlock(&input_pool.lock);
+    av_thread_message_queue_free(&queue);
 }
 
 static void free_input_threads(void)
 {
     int i;
 
+    if (!input_pool.initialized)
+        return;
+
+    pthread_mutex_lock(&input_pool.lock);
+    input_pool.abort = 1;
+    pthread_cond_broadcast(&input_pool.cond);
+    pthread_mutex_unlock(&input_pool.lock);
+    for (i = 0; i < input_pool.nb_threads; i++)
+        pthread_join(input_pool.threads[i], NULL);
+    av_freep(&input_pool.threads);
+    input_pool.nb_threads = 0;
+
     for (i = 0; i < nb_input_files; i++)
         free_input_thread(i);
+
+    pthread_cond_destroy(&input_pool.cond);
+    pthread_mutex_destroy(&input_pool.lock);
+    input_pool.initialized = 0;
 }
 
 static int init_input_thread(int i)
 {
     int ret;
     InputFile *f = input_files[i];
+    AVThreadMessageQueue *queue;
 
     if (f->thread_queue_size < 0)
         f->thread_queue_size = (nb_input_files > 1 ? 8 : 0);
@@ -4157,37 +4284,82 @@ static int init_input_thread(int i)
     if (f->ctx->pb ? !f->ctx->pb->seekable :
         strcmp(f->ctx->iformat->name, "lavfi"))
         f->non_blocking = 1;
-    ret = av_thread_message_queue_alloc(&f->in_thread_queue,
+    ret = av_thread_message_queue_alloc(&queue,
                                         f->thread_queue_size, sizeof(AVPacket));
     if (ret < 0)
         return ret;
 
-    if ((ret = pthread_create(&f->thread, NULL, input_thread, f))) {
-        av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
-        av_thread_message_queue_free(&f->in_thread_queue);
-        return AVERROR(ret);
-    }
+    pthread_mutex_lock(&input_pool.lock);
+    f->in_thread_queue = queue;
+    f->read_done       = 0;
+    pthread_cond_broadcast(&input_pool.cond);
+    pthread_mutex_unlock(&input_pool.lock);
 
     return 0;
 }
 
 static int init_input_threads(void)
 {
-    int i, ret;
+    int i, ret, nb_threads = 0;
+
+    pthread_mutex_init(&input_pool.lock, NULL);
+    pthread_cond_init(&input_pool.cond, NULL);
+    input_pool.initialized = 1;
 
     for (i = 0; i < nb_input_files; i++) {
         ret = init_input_thread(i);
         if (ret < 0)
             return ret;
+        if (input_files[i]->thread_queue_size)
+            nb_threads++;
+    }
+    if (!nb_threads)
+        return 0;
+
+    /* A thread blocked reading a live input leaves the others to the rest
+     * of the pool, so only share threads when asked to. */
+    if (input_nbthreads > 0)
+        nb_threads = FFMIN(nb_threads, input_nbthreads);
+
+    input_pool.threads = av_malloc_array(nb_threads, sizeof(*input_pool.threads));
+    if (!input_pool.threads)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < nb_threads; i++) {
+        if ((ret = pthread_create(&input_pool.threads[i], NULL, input_thread, NULL))) {
+            av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
+            return AVERROR(ret);
+        }
+        input_pool.nb_threads++;
     }
+    av_log(NULL, AV_LOG_VERBOSE, "Reading the input files with %d threads\n",
+           nb_threads);
+
     return 0;
 }
 
 static int get_input_packet_mt(InputFile *f, AVPacket *pkt)
 {
-    return av_thread_message_queue_recv(f->in_thread_queue, pkt,
-                                        f->non_blocking ?
-                                        AV_THREAD_MESSAGE_NONBLOCK : 0);
+    int ret;
+
+    pthread_mutex_lock(&input_pool.lock);
+    if (!f->queued && !f->read_done && !f->underrun) {
+        f->nb_underruns++;
+        f->underrun = 1;
+    }
+    pthread_mutex_unlock(&input_pool.lock);
+
+    ret = av_thread_message_queue_recv(f->in_thread_queue, pkt,
+                                       f->non_blocking ?
+                                       AV_THREAD_MESSAGE_NONBLOCK : 0);
+    if (ret >= 0) {
+        pthread_mutex_lock(&input_pool.lock);
+        f->queue_depth_sum += f->queued;
+        f->nb_dequeued++;
+        f->underrun = 0;
+        input_queue_release(f, pkt);
+        pthread_mutex_unlock(&input_pool.lock);
+    }
+    return ret;
 }
 #endif
 
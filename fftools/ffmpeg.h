@@ -420,10 +420,25 @@ typedef struct InputFile {
 
 #if HAVE_THREADS
     AVThreadMessageQueue *in_thread_queue;
-    pthread_t thread;           /* thread reading from this file */
     int non_blocking;           /* reading packets from the thread should not block */
-    int joined;                 /* the thread has been joined */
     int thread_queue_size;      /* maximum number of queued packets */
+
+    /* shared with the input threads, protected by their pool lock */
+    int reading;                /* a thread is reading from this file */
+    int read_done;              /* reading stopped on error or end of file */
+    int queued;                 /* number of packets in in_thread_queue */
+    int64_t queued_bytes;       /* size of the packets in in_thread_queue */
+    int queue_full_warned;
+    int throttled;              /* not read because of input_queue_max_bytes */
+    int underrun;               /* the queue was found empty */
+
+    /* queue statistics */
+    int queue_max;
+    int64_t queue_max_bytes;
+    uint64_t queue_depth_sum;   /* sum of the queue lengths at each dequeue */
+    uint64_t nb_dequeued;
+    uint64_t nb_underruns;
+    uint64_t nb_throttled;
 #endif
 } InputFile;
 
@@ -627,6 +642,8 @@ extern char *videotoolbox_pixfmt;
 
 extern int filter_nbthreads;
 extern int filter_complex_nbthreads;
+extern int input_nbthreads;
+extern int64_t input_queue_max_bytes;
 extern int vstats_version;
 extern int auto_conversion_filters;
 
@@ -172,6 +172,8 @@ int stdin_interaction = 1;
 int frame_bits_per_raw_sample = 0;
 float max_error_rate  = 2.0/3;
 int filter_nbthreads = 0;
+int input_nbthreads = 0;
+int64_t input_queue_max_bytes = 0;
 int filter_complex_nbthreads = 0;
 int vstats_version = 2;
 int auto_conversion_filters = 1;
@@ -3573,6 +3575,10 @@ const OptionDef options[] = {
         "create a complex filtergraph", "graph_description" },
     { "filter_complex_threads", HAS_ARG | OPT_INT,                   { &filter_complex_nbthreads },
         "number of threads for -filter_complex" },
+    { "input_threads",  HAS_ARG | OPT_INT | OPT_EXPERT,              { &input_nbthreads },
+        "number of threads reading the input files (0 for automatic)", "count" },
+    { "input_queue_max_bytes", HAS_ARG | OPT_INT64 | OPT_EXPERT,     { &input_queue_max_bytes },
+        "maximum total size of the packets queued by the input threads", "bytes" },
     { "lavfi",          HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_filter_complex },
         "create a complex filtergraph", "graph_description" },
     { "filter_complex_script", HAS_ARG | OPT_EXPERT,                 { .func_arg = opt_filter_complex_script },
@@ -28,8 +28,8 @@
 
 #include "avcodec.h"
 #include "internal.h"
-#include "get_bits.h"
 #include "libavutil/imgutils.h"
+#include "libavutil/intreadwrite.h"
 
 struct BitpackedContext {
     int (*decode)(AVCodecContext *avctx, AVFrame *frame,
@@ -60,7 +60,7 @@ static int bitpacked_decode_yuv422p10(AVCodecContext *avctx, AVFrame *frame,
 {
     uint64_t frame_size = (uint64_t)avctx->width * (uint64_t)avctx->height * 20;
     uint64_t packet_size = (uint64_t)avpkt->size * 8;
-    GetBitContext bc;
+    const uint8_t *src = avpkt->data;
     uint16_t *y, *u, *v;
     int ret, i, j;
 
@@ -74,20 +74,19 @@ static int bitpacked_decode_yuv422p10(AVCodecContext *avctx, AVFrame *frame,
     if (avctx->width % 2)
         return AVERROR_PATCHWELCOME;
 
-    ret = init_get_bits(&bc, avpkt->data, avctx->width * avctx->height * 20);
-    if (ret)
-        return ret;
-
     for (i = 0; i < avctx->height; i++) {
         y = (uint16_t*)(frame->data[0] + i * frame->linesize[0]);
         u = (uint16_t*)(frame->data[1] + i * frame->linesize[1]);
         v = (uint16_t*)(frame->data[2] + i * frame->linesize[2]);
 
+        /* each 5-byte pixel group holds Cb, Y0, Cr, Y1 */
         for (j = 0; j < avctx->width; j += 2) {
-            *u++ = get_bits(&bc, 10);
-            *y++ = get_bits(&bc, 10);
-            *v++ = get_bits(&bc, 10);
-            *y++ = get_bits(&bc, 10);
+            uint64_t pg = (uint64_t)AV_RB32(src) << 8 | src[4];
+            *u++ =  pg >> 30;
+            *y++ = (pg >> 20) & 0x3ff;
+            *v++ = (pg >> 10) & 0x3ff;
+            *y++ =  pg        & 0x3ff;
+            src += 5;
         }
     }
 
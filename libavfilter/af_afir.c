@@ -31,7 +31,6 @@
 #include "libavutil/intreadwrite.h"
 #include "libavutil/opt.h"
 #include "libavutil/xga_font_data.h"
-#include "libavcodec/avfft.h"
 
 #include "audio.h"
 #include "avfilter.h"
@@ -57,7 +56,7 @@ static void fcmul_add_c(float *sum, const float *t, const float *c, ptrdiff_t le
     sum[2 * n] += t[2 * n] * c[2 * n];
 }
 
-static void direct(const float *in, const FFTComplex *ir, int len, float *out)
+static void direct(const float *in, const AVComplexFloat *ir, int len, float *out)
 {
     for (int n = 0; n < len; n++)
         for (int m = 0; m <= n; m++)
@@ -78,7 +77,7 @@ static int fir_quantum(AVFilterContext *ctx, AVFrame *out, int ch, int offset)
 {
     AudioFIRContext *s = ctx->priv;
     const float *in = (const float *)s->in->extended_data[ch] + offset;
-    float *block, *buf, *ptr = (float *)out->extended_data[ch] + offset;
+    float *block, *buf, *tempin, *tempout, *ptr = (float *)out->extended_data[ch] + offset;
     const int nb_samples = FFMIN(s->min_part_size, out->nb_samples - offset);
     int n, i, j;
 
@@ -114,7 +113,7 @@ static int fir_quantum(AVFilterContext *ctx, AVFrame *out, int ch, int offset)
 
             for (i = 0; i < seg->nb_partitions; i++) {
                 const int coffset = j * seg->coeff_size;
-                const FFTComplex *coeff = (const FFTComplex *)seg->coeff->extended_data[ch * !s->one2many] + coffset;
+                const AVComplexFloat *coeff = (const AVComplexFloat *)seg->coeff->extended_data[ch * !s->one2many] + coffset;
 
                 direct(src, coeff, nb_samples, dst);
 
@@ -135,20 +134,20 @@ static int fir_quantum(AVFilterContext *ctx, AVFrame *out, int ch, int offset)
 
         memset(sum, 0, sizeof(*sum) * seg->fft_length);
         block = (float *)seg->block->extended_data[ch] + seg->part_index[ch] * seg->block_size;
-        memset(block + seg->part_size, 0, sizeof(*block) * (seg->fft_length - seg->part_size));
+        tempin = (float *)seg->tempin->extended_data[ch];
+        tempout = (float *)seg->tempout->extended_data[ch];
+        memset(tempin + seg->part_size, 0, sizeof(*tempin) * seg->part_size);
 
-        memcpy(block, src, sizeof(*src) * seg->part_size);
+        memcpy(tempin, src, sizeof(*src) * seg->part_size);
 
-        av_rdft_calc(seg->rdft[ch], block);
-        block[2 * seg->part_size] = block[1];
-        block[1] = 0;
+        seg->tx_fn(seg->tx[ch], block, tempin, sizeof(float));
 
         j = seg->part_index[ch];
 
         for (i = 0; i < seg->nb_partitions; i++) {
             const int coffset = j * seg->coeff_size;
             const float *block = (const float *)seg->block->extended_data[ch] + i * seg->block_size;
-            const FFTComplex *coeff = (const FFTComplex *)seg->coeff->extended_data[ch * !s->one2many] + coffset;
+            const AVComplexFloat *coeff = (const AVComplexFloat *)seg->coeff->extended_data[ch * !s->one2many] + coffset;
 
             s->afirdsp.fcmul_add(sum, block, (const float *)coeff, seg->part_size);
 
@@ -157,16 +156,15 @@ static int fir_quantum(AVFilterContext *ctx, AVFrame *out, int ch, int offset)
             j--;
         }
 
-        sum[1] = sum[2 * seg->part_size];
-        av_rdft_calc(seg->irdft[ch], sum);
+        seg->itx_fn(seg->itx[ch], tempout, sum, sizeof(float));
 
         buf = (float *)seg->buffer->extended_data[ch];
-        fir_fadd(s, buf, sum, seg->part_size);
+        fir_fadd(s, buf, tempout, seg->part_size);
 
         memcpy(dst, buf, seg->part_size * sizeof(*dst));
 
         buf = (float *)seg->buffer->extended_data[ch];
-        memcpy(buf, sum + seg->part_size, seg->part_size * sizeof(*buf));
+        memcpy(buf, tempout + seg->part_size, seg->part_size * sizeof(*buf));
 
         seg->part_index[ch] = (seg->part_index[ch] + 1) % seg->nb_partitions;
 
@@ -379,13 +377,15 @@ static int init_segment(AVFilterContext *ctx, AudioFIRSegment *seg,
                         int offset, int nb_partitions, int part_size)
 {
     AudioFIRContext *s = ctx->priv;
+    const float scale = 1.f, iscale = 0.5f;
+    int ret;
 
-    seg->rdft  = av_calloc(ctx->inputs[0]->channels, sizeof(*seg->rdft));
-    seg->irdft = av_calloc(ctx->inputs[0]->channels, sizeof(*seg->irdft));
-    if (!seg->rdft || !seg->irdft)
+    seg->tx  = av_calloc(ctx->inputs[0]->channels, sizeof(*seg->tx));
+    seg->itx = av_calloc(ctx->inputs[0]->channels, sizeof(*seg->itx));
+    if (!seg->tx || !seg->itx)
         return AVERROR(ENOMEM);
 
-    seg->fft_length    = part_size * 2 + 1;
+    seg->fft_length    = part_size * 2 + 2;
     seg->part_size     = part_size;
     seg->block_size    = FFALIGN(seg->fft_length, 32);
     seg->coeff_size    = FFALIGN(seg->part_size + 1, 32);
@@ -399,10 +399,14 @@ static int init_segment(AVFilterContext *ctx, AudioFIRSegment *seg,
         return AVERROR(ENOMEM);
 
     for (int ch = 0; ch < ctx->inputs[0]->channels && part_size >= 8; ch++) {
-        seg->rdft[ch]  = av_rdft_init(av_log2(2 * part_size), DFT_R2C);
-        seg->irdft[ch] = av_rdft_init(av_log2(2 * part_size), IDFT_C2R);
-        if (!seg->rdft[ch] || !seg->irdft[ch])
-            return AVERROR(ENOMEM);
+        ret = av_tx_init(&seg->tx[ch], &seg->tx_fn, AV_TX_FLOAT_RDFT,
+                         0, 2 * part_size, &scale, 0);
+        if (ret < 0)
+            return ret;
+        ret = av_tx_init(&seg->itx[ch], &seg->itx_fn, AV_TX_FLOAT_RDFT,
+                         1, 2 * part_size, &iscale, 0);
+        if (ret < 0)
+            return ret;
     }
 
     seg->sum    = ff_get_audio_buffer(ctx->inputs[0], seg->fft_length);
@@ -411,7 +415,10 @@ static int init_segment(AVFilterContext *ctx, AudioFIRSegment *seg,
     seg->coeff  = ff_get_audio_buffer(ctx->inputs[1 + s->selir], seg->nb_partitions * seg->coeff_size * 2);
     seg->input  = ff_get_audio_buffer(ctx->inputs[0], seg->input_size);
     seg->output = ff_get_audio_buffer(ctx->inputs[0], seg->part_size);
-    if (!seg->buffer || !seg->sum || !seg->block || !seg->coeff || !seg->input || !seg->output)
+    seg->tempin = ff_get_audio_buffer(ctx->inputs[0], seg->block_size);
+    seg->tempout = ff_get_audio_buffer(ctx->inputs[0], seg->block_size);
+    if (!seg->buffer || !seg->sum || !seg->block || !seg->coeff || !seg->input || !seg->output ||
+        !seg->tempin || !seg->tempout)
         return AVERROR(ENOMEM);
 
     return 0;
@@ -421,19 +428,19 @@ static void uninit_segment(AVFilterContext *ctx, AudioFIRSegment *seg)
 {
     AudioFIRContext *s = ctx->priv;
 
-    if (seg->rdft) {
+    if (seg->tx) {
         for (int ch = 0; ch < s->nb_channels; ch++) {
-            av_rdft_end(seg->rdft[ch]);
+            av_tx_uninit(&seg->tx[ch]);
         }
     }
-    av_freep(&seg->rdft);
+    av_freep(&seg->tx);
 
-    if (seg->irdft) {
+    if (seg->itx) {
         for (int ch = 0; ch < s->nb_channels; ch++) {
-            av_rdft_end(seg->irdft[ch]);
+            av_tx_uninit(&seg->itx[ch]);
         }
     }
-    av_freep(&seg->irdft);
+    av_freep(&seg->itx);
 
     av_freep(&seg->output_offset);
     av_freep(&seg->part_index);
@@ -444,6 +451,8 @@ static void uninit_segment(AVFilterContext *ctx, AudioFIRSegment *seg)
     av_frame_free(&seg->coeff);
     av_frame_free(&seg->input);
     av_frame_free(&seg->output);
+    av_frame_free(&seg->tempin);
+    av_frame_free(&seg->tempout);
     seg->input_size = 0;
 }
 
@@ -558,7 +567,8 @@ static int convert_coeffs(AVFilterContext *ctx)
         for (int segment = 0; segment < s->nb_segments; segment++) {
             AudioFIRSegment *seg = &s->seg[segment];
             float *block = (float *)seg->block->extended_data[ch];
-            FFTComplex *coeff = (FFTComplex *)seg->coeff->extended_data[ch];
+            float *tempin = (float *)seg->tempin->extended_data[ch];
+            AVComplexFloat *coeff = (AVComplexFloat *)seg->coeff->extended_data[ch];
 
             av_log(ctx, AV_LOG_DEBUG, "segment: %d\n", segment);
 
@@ -576,19 +586,15 @@ static int convert_coeffs(AVFilterContext *ctx)
                     continue;
                 }
 
-                memset(block, 0, sizeof(*block) * seg->fft_length);
-                memcpy(block, time + toffset, size * sizeof(*block));
+                memset(tempin + size, 0, sizeof(*tempin) * (2 * seg->part_size - size));
+                memcpy(tempin, time + toffset, size * sizeof(*tempin));
 
-                av_rdft_calc(seg->rdft[0], block);
+                seg->tx_fn(seg->tx[0], block, tempin, sizeof(float));
 
-                coeff[coffset].re = block[0] * scale;
-                coeff[coffset].im = 0;
-                for (n = 1; n < seg->part_size; n++) {
-                    coeff[coffset + n].re = block[2 * n] * scale;
+                for (n = 0; n <= seg->part_size; n++) {
+                    coeff[coffset + n].re = block[2 * n    ] * scale;
                     coeff[coffset + n].im = block[2 * n + 1] * scale;
                 }
-                coeff[coffset + seg->part_size].re = block[1] * scale;
-                coeff[coffset + seg->part_size].im = 0;
 
                 toffset += size;
             }
@@ -24,7 +24,7 @@
 #include "libavutil/common.h"
 #include "libavutil/float_dsp.h"
 #include "libavutil/opt.h"
-#include "libavcodec/avfft.h"
+#include "libavutil/tx.h"
 
 #include "audio.h"
 #include "avfilter.h"
@@ -49,8 +49,11 @@ typedef struct AudioFIRSegment {
     AVFrame *coeff;
     AVFrame *input;
     AVFrame *output;
+    AVFrame *tempin;
+    AVFrame *tempout;
 
-    RDFTContext **rdft, **irdft;
+    AVTXContext **tx, **itx;
+    av_tx_fn tx_fn, itx_fn;
 } AudioFIRSegment;
 
 typedef struct AudioFIRDSPContext {
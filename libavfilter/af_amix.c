@@ -170,6 +170,7 @@ typedef struct MixContext {
     int sample_rate;            /**< sample rate */
     int planar;
     AVAudioFifo **fifos;        /**< audio fifo for each input */
+    AVFrame **in_bufs;          /**< samples read from each input for mixing */
     uint8_t *input_state;       /**< current state of each input */
     float *input_scale;         /**< mixing scale factor for each input */
     float *weights;             /**< custom weights for every input */
@@ -268,6 +269,10 @@ static int config_output(AVFilterLink *outlink)
             return AVERROR(ENOMEM);
     }
 
+    s->in_bufs = av_mallocz_array(s->nb_inputs, sizeof(*s->in_bufs));
+    if (!s->in_bufs)
+        return AVERROR(ENOMEM);
+
     s->input_state = av_malloc(s->nb_inputs);
     if (!s->input_state)
         return AVERROR(ENOMEM);
@@ -291,6 +296,56 @@ static int config_output(AVFilterLink *outlink)
     return 0;
 }
 
+typedef struct ThreadData {
+    AVFrame *out;
+    int plane_size;
+} ThreadData;
+
+/**
+ * Mix one block range of every plane from all active inputs.
+ *
+ * Each job handles a contiguous range of 16-sample blocks so that the
+ * float_dsp length and alignment requirements hold for every slice.
+ */
+static int mix_inputs(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    MixContext *s = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *out_buf = td->out;
+    const int planes = s->planar ? s->nb_channels : 1;
+    const int nb_blocks = td->plane_size / 16;
+    const int start = 16 * ((nb_blocks * jobnr) / nb_jobs);
+    const int end   = 16 * ((nb_blocks * (jobnr + 1)) / nb_jobs);
+    int i, p;
+
+    if (start >= end)
+        return 0;
+
+    for (i = 0; i < s->nb_inputs; i++) {
+        AVFrame *in_buf = s->in_bufs[i];
+
+        if (!in_buf)
+            continue;
+
+        if (out_buf->format == AV_SAMPLE_FMT_FLT ||
+            out_buf->format == AV_SAMPLE_FMT_FLTP) {
+            for (p = 0; p < planes; p++) {
+                s->fdsp->vector_fmac_scalar((float *)out_buf->extended_data[p] + start,
+                                            (float *) in_buf->extended_data[p] + start,
+                                            s->input_scale[i], end - start);
+            }
+        } else {
+            for (p = 0; p < planes; p++) {
+                s->fdsp->vector_dmac_scalar((double *)out_buf->extended_data[p] + start,
+                                            (double *) in_buf->extended_data[p] + start,
+                                            s->input_scale[i], end - start);
+            }
+        }
+    }
+
+    return 0;
+}
+
 /**
  * Read samples from the input FIFOs, mix, and write to the output link.
  */
@@ -298,8 +353,9 @@ static int output_frame(AVFilterLink *outlink)
 {
     AVFilterContext *ctx = outlink->src;
     MixContext      *s = ctx->priv;
-    AVFrame *out_buf, *in_buf;
-    int nb_samples, ns, i;
+    AVFrame *out_buf;
+    ThreadData td;
+    int nb_samples, ns, i, ret = 0;
 
     if (s->input_state[0] & INPUT_ON) {
         /* first input live: use the corresponding frame size */
@@ -344,40 +400,32 @@ static int output_frame(AVFilterLink *outlink)
     if (!out_buf)
         return AVERROR(ENOMEM);
 
-    in_buf = ff_get_audio_buffer(outlink, nb_samples);
-    if (!in_buf) {
-        av_frame_free(&out_buf);
-        return AVERROR(ENOMEM);
-    }
-
     for (i = 0; i < s->nb_inputs; i++) {
         if (s->input_state[i] & INPUT_ON) {
-            int planes, plane_size, p;
+            s->in_bufs[i] = ff_get_audio_buffer(outlink, nb_samples);
+            if (!s->in_bufs[i]) {
+                ret = AVERROR(ENOMEM);
+                goto end;
+            }
 
-            av_audio_fifo_read(s->fifos[i], (void **)in_buf->extended_data,
+            av_audio_fifo_read(s->fifos[i], (void **)s->in_bufs[i]->extended_data,
                                nb_samples);
+        }
+    }
 
-            planes     = s->planar ? s->nb_channels : 1;
-            plane_size = nb_samples * (s->planar ? 1 : s->nb_channels);
-            plane_size = FFALIGN(plane_size, 16);
+    td.out        = out_buf;
+    td.plane_size = FFALIGN(nb_samples * (s->planar ? 1 : s->nb_channels), 16);
+    ctx->internal->execute(ctx, mix_inputs, &td, NULL,
+                           FFMIN(td.plane_size / 16, ff_filter_get_nb_threads(ctx)));
 
-            if (out_buf->format == AV_SAMPLE_FMT_FLT ||
-                out_buf->format == AV_SAMPLE_FMT_FLTP) {
-                for (p = 0; p < planes; p++) {
-                    s->fdsp->vector_fmac_scalar((float *)out_buf->extended_data[p],
-                                                (float *) in_buf->extended_data[p],
-                                                s->input_scale[i], plane_size);
-                }
-            } else {
-                for (p = 0; p < planes; p++) {
-                    s->fdsp->vector_dmac_scalar((double *)out_buf->extended_data[p],
-                                                (double *) in_buf->extended_data[p],
-                                                s->input_scale[i], plane_size);
-                }
-            }
-        }
+end:
+    for (i = 0; i < s->nb_inputs; i++)
+        av_frame_free(&s->in_bufs[i]);
+
+    if (ret < 0) {
+        av_frame_free(&out_buf);
+        return ret;
     }
-    av_frame_free(&in_buf);
 
     out_buf->pts = s->next_pts;
     if (s->next_pts != AV_NOPTS_VALUE)
@@ -584,6 +632,7 @@ static av_cold void uninit(AVFilterContext *ctx)
     }
     frame_list_clear(s->frame_list);
     av_freep(&s->frame_list);
+    av_freep(&s->in_bufs);
     av_freep(&s->input_state);
     av_freep(&s->input_scale);
     av_freep(&s->scale_norm);
@@ -649,5 +698,6 @@ AVFilter ff_af_amix = {
     .inputs         = NULL,
     .outputs        = avfilter_af_amix_outputs,
     .process_command = process_command,
-    .flags          = AVFILTER_FLAG_DYNAMIC_INPUTS,
+    .flags          = AVFILTER_FLAG_DYNAMIC_INPUTS |
+                      AVFILTER_FLAG_SLICE_THREADS,
 };
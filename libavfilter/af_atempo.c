@@ -39,13 +39,13 @@
  */
 
 #include <float.h>
-#include "libavcodec/avfft.h"
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
 #include "libavutil/channel_layout.h"
 #include "libavutil/eval.h"
 #include "libavutil/opt.h"
 #include "libavutil/samplefmt.h"
+#include "libavutil/tx.h"
 #include "avfilter.h"
 #include "audio.h"
 #include "internal.h"
@@ -65,9 +65,9 @@ typedef struct AudioFragment {
     // number of samples in this fragment:
     int nsamples;
 
-    // rDFT transform of the down-mixed mono fragment, used for
-    // fast waveform alignment via correlation in frequency domain:
-    FFTSample *xdat;
+    // real-input DFT of the zero-padded down-mixed mono fragment, used
+    // for fast waveform alignment via correlation in frequency domain:
+    AVComplexFloat *xdat;
 } AudioFragment;
 
 /**
@@ -140,9 +140,12 @@ typedef struct ATempoContext {
     FilterState state;
 
     // for fast correlation calculation in frequency domain:
-    RDFTContext *real_to_complex;
-    RDFTContext *complex_to_real;
-    FFTSample *correlation;
+    AVTXContext *real_to_complex;
+    AVTXContext *complex_to_real;
+    av_tx_fn r2c_fn, c2r_fn;
+    float *xdat_in;
+    AVComplexFloat *correlation_in;
+    float *correlation;
 
     // for managing AVFilterPad.request_frame and AVFilterPad.filter_frame
     AVFrame *dst_buffer;
@@ -233,13 +236,12 @@ static void yae_release_buffers(ATempoContext *atempo)
 
     av_freep(&atempo->buffer);
     av_freep(&atempo->hann);
+    av_freep(&atempo->xdat_in);
+    av_freep(&atempo->correlation_in);
     av_freep(&atempo->correlation);
 
-    av_rdft_end(atempo->real_to_complex);
-    atempo->real_to_complex = NULL;
-
-    av_rdft_end(atempo->complex_to_real);
-    atempo->complex_to_real = NULL;
+    av_tx_uninit(&atempo->real_to_complex);
+    av_tx_uninit(&atempo->complex_to_real);
 }
 
 /* av_realloc is not aligned enough; fortunately, the data does not need to
@@ -265,8 +267,9 @@ static int yae_reset(ATempoContext *atempo,
 {
     const int sample_size = av_get_bytes_per_sample(format);
     uint32_t nlevels  = 0;
+    float scale = 1.f, iscale = 0.5f;
     uint32_t pot;
-    int i;
+    int i, ret;
 
     atempo->format   = format;
     atempo->channels = channels;
@@ -288,29 +291,30 @@ static int yae_reset(ATempoContext *atempo,
     // initialize audio fragment buffers:
     RE_MALLOC_OR_FAIL(atempo->frag[0].data, atempo->window * atempo->stride);
     RE_MALLOC_OR_FAIL(atempo->frag[1].data, atempo->window * atempo->stride);
-    RE_MALLOC_OR_FAIL(atempo->frag[0].xdat, atempo->window * sizeof(FFTComplex));
-    RE_MALLOC_OR_FAIL(atempo->frag[1].xdat, atempo->window * sizeof(FFTComplex));
+    RE_MALLOC_OR_FAIL(atempo->frag[0].xdat, (atempo->window + 1) * sizeof(AVComplexFloat));
+    RE_MALLOC_OR_FAIL(atempo->frag[1].xdat, (atempo->window + 1) * sizeof(AVComplexFloat));
 
-    // initialize rDFT contexts:
-    av_rdft_end(atempo->real_to_complex);
-    atempo->real_to_complex = NULL;
+    // initialize DFT contexts:
+    av_tx_uninit(&atempo->real_to_complex);
+    av_tx_uninit(&atempo->complex_to_real);
 
-    av_rdft_end(atempo->complex_to_real);
-    atempo->complex_to_real = NULL;
-
-    atempo->real_to_complex = av_rdft_init(nlevels + 1, DFT_R2C);
-    if (!atempo->real_to_complex) {
+    ret = av_tx_init(&atempo->real_to_complex, &atempo->r2c_fn,
+                     AV_TX_FLOAT_RDFT, 0, 2 * atempo->window, &scale, 0);
+    if (ret < 0) {
         yae_release_buffers(atempo);
-        return AVERROR(ENOMEM);
+        return ret;
     }
 
-    atempo->complex_to_real = av_rdft_init(nlevels + 1, IDFT_C2R);
-    if (!atempo->complex_to_real) {
+    ret = av_tx_init(&atempo->complex_to_real, &atempo->c2r_fn,
+                     AV_TX_FLOAT_RDFT, 1, 2 * atempo->window, &iscale, 0);
+    if (ret < 0) {
         yae_release_buffers(atempo);
-        return AVERROR(ENOMEM);
+        return ret;
     }
 
-    RE_MALLOC_OR_FAIL(atempo->correlation, atempo->window * sizeof(FFTComplex));
+    RE_MALLOC_OR_FAIL(atempo->xdat_in, 2 * atempo->window * sizeof(float));
+    RE_MALLOC_OR_FAIL(atempo->correlation_in, (atempo->window + 1) * sizeof(AVComplexFloat));
+    RE_MALLOC_OR_FAIL(atempo->correlation, 2 * atempo->window * sizeof(float));
 
     atempo->ring = atempo->window * 3;
     RE_MALLOC_OR_FAIL(atempo->buffer, atempo->ring * atempo->stride);
@@ -348,7 +352,7 @@ static int yae_update(AVFilterContext *ctx)
         const uint8_t *src_end = src +                                  \
             frag->nsamples * atempo->channels * sizeof(scalar_type);    \
                                                                         \
-        FFTSample *xdat = frag->xdat;                                   \
+        float *xdat = atempo->xdat_in;                                  \
         scalar_type tmp;                                                \
                                                                         \
         if (atempo->channels == 1) {                                    \
@@ -356,27 +360,27 @@ static int yae_update(AVFilterContext *ctx)
                 tmp = *(const scalar_type *)src;                        \
                 src += sizeof(scalar_type);                             \
                                                                         \
-                *xdat = (FFTSample)tmp;                                 \
+                *xdat = (float)tmp;                                     \
             }                                                           \
         } else {                                                        \
-            FFTSample s, max, ti, si;                                   \
+            float s, max, ti, si;                                       \
             int i;                                                      \
                                                                         \
             for (; src < src_end; xdat++) {                             \
                 tmp = *(const scalar_type *)src;                        \
                 src += sizeof(scalar_type);                             \
                                                                         \
-                max = (FFTSample)tmp;                                   \
-                s = FFMIN((FFTSample)scalar_max,                        \
-                          (FFTSample)fabsf(max));                       \
+                max = (float)tmp;                                       \
+                s = FFMIN((float)scalar_max,                            \
+                          (float)fabsf(max));                           \
                                                                         \
                 for (i = 1; i < atempo->channels; i++) {                \
                     tmp = *(const scalar_type *)src;                    \
                     src += sizeof(scalar_type);                         \
                                                                         \
-                    ti = (FFTSample)tmp;                                \
-                    si = FFMIN((FFTSample)scalar_max,                   \
-                               (FFTSample)fabsf(ti));                   \
+                    ti = (float)tmp;                                    \
+                    si = FFMIN((float)scalar_max,                       \
+                               (float)fabsf(ti));                       \
                                                                         \
                     if (s < si) {                                       \
                         s   = si;                                       \
@@ -399,7 +403,7 @@ static void yae_downmix(ATempoContext *atempo, AudioFragment *frag)
     const uint8_t *src = frag->data;
 
     // init complex data buffer used for FFT and Correlation:
-    memset(frag->xdat, 0, sizeof(FFTComplex) * atempo->window);
+    memset(atempo->xdat_in, 0, sizeof(float) * 2 * atempo->window);
 
     if (atempo->format == AV_SAMPLE_FMT_U8) {
         yae_init_xdat(uint8_t, 127);
@@ -593,37 +597,26 @@ static void yae_advance_to_next_frag(ATempoContext *atempo)
 }
 
 /**
- * Calculate cross-correlation via rDFT.
+ * Calculate cross-correlation via real-input DFT.
  *
- * Multiply two vectors of complex numbers (result of real_to_complex rDFT)
- * and transform back via complex_to_real rDFT.
+ * Multiply two vectors of complex numbers (result of real_to_complex
+ * transform) and transform back via complex_to_real transform.
  */
-static void yae_xcorr_via_rdft(FFTSample *xcorr,
-                               RDFTContext *complex_to_real,
-                               const FFTComplex *xa,
-                               const FFTComplex *xb,
-                               const int window)
+static void yae_xcorr_via_rdft(ATempoContext *atempo,
+                               const AVComplexFloat *xa,
+                               const AVComplexFloat *xb)
 {
-    FFTComplex *xc = (FFTComplex *)xcorr;
-    int i;
-
-    // NOTE: first element requires special care -- Given Y = rDFT(X),
-    // Im(Y[0]) and Im(Y[N/2]) are always zero, therefore av_rdft_calc
-    // stores Re(Y[N/2]) in place of Im(Y[0]).
-
-    xc->re = xa->re * xb->re;
-    xc->im = xa->im * xb->im;
-    xa++;
-    xb++;
-    xc++;
+    AVComplexFloat *xc = atempo->correlation_in;
+    int k;
 
-    for (i = 1; i < window; i++, xa++, xb++, xc++) {
-        xc->re = (xa->re * xb->re + xa->im * xb->im);
-        xc->im = (xa->im * xb->re - xa->re * xb->im);
+    for (k = 0; k <= atempo->window; k++) {
+        xc[k].re = (xa[k].re * xb[k].re + xa[k].im * xb[k].im);
+        xc[k].im = (xa[k].im * xb[k].re - xa[k].re * xb[k].im);
     }
 
-    // apply inverse rDFT:
-    av_rdft_calc(complex_to_real, xcorr);
+    // apply inverse DFT:
+    atempo->c2r_fn(atempo->complex_to_real, atempo->correlation, xc,
+                   sizeof(float));
 }
 
 /**
@@ -632,27 +625,22 @@ static void yae_xcorr_via_rdft(FFTSample *xcorr,
  *
  * @return alignment offset of current fragment relative to previous.
  */
-static int yae_align(AudioFragment *frag,
+static int yae_align(ATempoContext *atempo,
+                     AudioFragment *frag,
                      const AudioFragment *prev,
                      const int window,
                      const int delta_max,
-                     const int drift,
-                     FFTSample *correlation,
-                     RDFTContext *complex_to_real)
+                     const int drift)
 {
-    int       best_offset = -drift;
-    FFTSample best_metric = -FLT_MAX;
-    FFTSample *xcorr;
+    int   best_offset = -drift;
+    float best_metric = -FLT_MAX;
+    float *xcorr;
 
     int i0;
     int i1;
     int i;
 
-    yae_xcorr_via_rdft(correlation,
-                       complex_to_real,
-                       (const FFTComplex *)prev->xdat,
-                       (const FFTComplex *)frag->xdat,
-                       window);
+    yae_xcorr_via_rdft(atempo, prev->xdat, frag->xdat);
 
     // identify search window boundaries:
     i0 = FFMAX(window / 2 - delta_max - drift, 0);
@@ -662,14 +650,14 @@ static int yae_align(AudioFragment *frag,
     i1 = FFMAX(i1, 0);
 
     // identify cross-correlation peaks within search window:
-    xcorr = correlation + i0;
+    xcorr = atempo->correlation + i0;
 
     for (i = i0; i < i1; i++, xcorr++) {
-        FFTSample metric = *xcorr;
+        float metric = *xcorr;
 
         // normalize:
-        FFTSample drifti = (FFTSample)(drift + i);
-        metric *= drifti * (FFTSample)(i - i0) * (FFTSample)(i1 - i);
+        float drifti = (float)(drift + i);
+        metric *= drifti * (float)(i - i0) * (float)(i1 - i);
 
         if (metric > best_metric) {
             best_metric = metric;
@@ -701,13 +689,12 @@ static int yae_adjust_position(ATempoContext *atempo)
     const int drift = (int)(prev_output_position - ideal_output_position);
 
     const int delta_max  = atempo->window / 2;
-    const int correction = yae_align(frag,
+    const int correction = yae_align(atempo,
+                                     frag,
                                      prev,
                                      atempo->window,
                                      delta_max,
-                                     drift,
-                                     atempo->correlation,
-                                     atempo->complex_to_real);
+                                     drift);
 
     if (correction) {
         // adjust fragment position:
@@ -731,25 +718,35 @@ static int yae_adjust_position(ATempoContext *atempo)
                                                                         \
         scalar_type *out     = (scalar_type *)dst;                      \
         scalar_type *out_end = (scalar_type *)dst_end;                  \
+        const int channels   = atempo->channels;                        \
+        const int64_t n = FFMIN(overlap, (out_end - out) / channels);   \
+        const int64_t z = av_clip64(-frag->position[0], 0, n);          \
         int64_t i;                                                      \
+        int j;                                                          \
                                                                         \
-        for (i = 0; i < overlap && out < out_end;                       \
-             i++, atempo->position[1]++, wa++, wb++) {                  \
-            float w0 = *wa;                                             \
-            float w1 = *wb;                                             \
-            int j;                                                      \
+        /* no blending where the current fragment is zero-padded */     \
+        memcpy(out, aaa, z * atempo->stride);                           \
+        aaa += z * channels;                                            \
+        bbb += z * channels;                                            \
+        out += z * channels;                                            \
                                                                         \
-            for (j = 0; j < atempo->channels;                           \
-                 j++, aaa++, bbb++, out++) {                            \
-                float t0 = (float)*aaa;                                 \
-                float t1 = (float)*bbb;                                 \
+        for (i = z; i < n; i++) {                                       \
+            const float w0 = wa[i];                                     \
+            const float w1 = wb[i];                                     \
                                                                         \
-                *out =                                                  \
-                    frag->position[0] + i < 0 ?                         \
-                    *aaa :                                              \
-                    (scalar_type)(t0 * w0 + t1 * w1);                   \
+            for (j = 0; j < channels; j++) {                            \
+                const float t0 = (float)aaa[j];                         \
+                const float t1 = (float)bbb[j];                         \
+                                                                        \
+                out[j] = (scalar_type)(t0 * w0 + t1 * w1);              \
             }                                                           \
+                                                                        \
+            aaa += channels;                                            \
+            bbb += channels;                                            \
+            out += channels;                                            \
         }                                                               \
+                                                                        \
+        atempo->position[1] += n;                                       \
         dst = (uint8_t *)out;                                           \
     } while (0)
 
@@ -833,7 +830,9 @@ yae_apply(ATempoContext *atempo,
             yae_downmix(atempo, yae_curr_frag(atempo));
 
             // apply rDFT:
-            av_rdft_calc(atempo->real_to_complex, yae_curr_frag(atempo)->xdat);
+            atempo->r2c_fn(atempo->real_to_complex,
+                           yae_curr_frag(atempo)->xdat, atempo->xdat_in,
+                           sizeof(float));
 
             // must load the second fragment before alignment can start:
             if (!atempo->nfrag) {
@@ -865,7 +864,9 @@ yae_apply(ATempoContext *atempo,
             yae_downmix(atempo, yae_curr_frag(atempo));
 
             // apply rDFT:
-            av_rdft_calc(atempo->real_to_complex, yae_curr_frag(atempo)->xdat);
+            atempo->r2c_fn(atempo->real_to_complex,
+                           yae_curr_frag(atempo)->xdat, atempo->xdat_in,
+                           sizeof(float));
 
             atempo->state = YAE_OUTPUT_OVERLAP_ADD;
         }
@@ -929,7 +930,8 @@ static int yae_flush(ATempoContext *atempo,
             yae_downmix(atempo, frag);
 
             // apply rDFT:
-            av_rdft_calc(atempo->real_to_complex, frag->xdat);
+            atempo->r2c_fn(atempo->real_to_complex, frag->xdat,
+                           atempo->xdat_in, sizeof(float));
 
             // align current fragment to previous fragment:
             if (yae_adjust_position(atempo)) {
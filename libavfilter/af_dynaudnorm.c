@@ -40,6 +40,12 @@
 #include "filters.h"
 #include "internal.h"
 
+typedef struct ThreadData {
+    AVFrame *frame;
+    int is_first_frame;
+    int enabled;
+} ThreadData;
+
 typedef struct local_gain {
     double max_gain;
     double threshold;
@@ -540,13 +546,17 @@ static inline double update_value(double new, double old, double aggressiveness)
     return aggressiveness * new + (1.0 - aggressiveness) * old;
 }
 
-static void perform_dc_correction(DynamicAudioNormalizerContext *s, AVFrame *frame)
+static int dc_correction_channels(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
+    DynamicAudioNormalizerContext *s = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *frame = td->frame;
     const double diff = 1.0 / frame->nb_samples;
-    int is_first_frame = cqueue_empty(s->gain_history_original[0]);
+    const int start = (s->channels * jobnr) / nb_jobs;
+    const int end = (s->channels * (jobnr+1)) / nb_jobs;
     int c, i;
 
-    for (c = 0; c < s->channels; c++) {
+    for (c = start; c < end; c++) {
         double *dst_ptr = (double *)frame->extended_data[c];
         double current_average_value = 0.0;
         double prev_value;
@@ -554,13 +564,26 @@ static void perform_dc_correction(DynamicAudioNormalizerContext *s, AVFrame *fra
         for (i = 0; i < frame->nb_samples; i++)
             current_average_value += dst_ptr[i] * diff;
 
-        prev_value = is_first_frame ? current_average_value : s->dc_correction_value[c];
-        s->dc_correction_value[c] = is_first_frame ? current_average_value : update_value(current_average_value, s->dc_correction_value[c], 0.1);
+        prev_value = td->is_first_frame ? current_average_value : s->dc_correction_value[c];
+        s->dc_correction_value[c] = td->is_first_frame ? current_average_value : update_value(current_average_value, s->dc_correction_value[c], 0.1);
 
         for (i = 0; i < frame->nb_samples; i++) {
             dst_ptr[i] -= fade(prev_value, s->dc_correction_value[c], i, frame->nb_samples);
         }
     }
+
+    return 0;
+}
+
+static void perform_dc_correction(AVFilterContext *ctx, AVFrame *frame)
+{
+    DynamicAudioNormalizerContext *s = ctx->priv;
+    ThreadData td;
+
+    td.frame = frame;
+    td.is_first_frame = cqueue_empty(s->gain_history_original[0]);
+    ctx->internal->execute(ctx, dc_correction_channels, &td, NULL,
+                           FFMIN(s->channels, ff_filter_get_nb_threads(ctx)));
 }
 
 static double setup_compress_thresh(double threshold)
@@ -657,10 +680,26 @@ static void perform_compression(DynamicAudioNormalizerContext *s, AVFrame *frame
     }
 }
 
-static void analyze_frame(DynamicAudioNormalizerContext *s, AVFrame *frame)
+static int analyze_channels(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    DynamicAudioNormalizerContext *s = ctx->priv;
+    ThreadData *td = arg;
+    const int start = (s->channels * jobnr) / nb_jobs;
+    const int end = (s->channels * (jobnr+1)) / nb_jobs;
+    int c;
+
+    for (c = start; c < end; c++)
+        update_gain_history(s, c, get_max_local_gain(s, td->frame, c));
+
+    return 0;
+}
+
+static void analyze_frame(AVFilterContext *ctx, AVFrame *frame)
 {
+    DynamicAudioNormalizerContext *s = ctx->priv;
+
     if (s->dc_correction) {
-        perform_dc_correction(s, frame);
+        perform_dc_correction(ctx, frame);
     }
 
     if (s->compress_factor > DBL_EPSILON) {
@@ -674,24 +713,30 @@ static void analyze_frame(DynamicAudioNormalizerContext *s, AVFrame *frame)
         for (c = 0; c < s->channels; c++)
             update_gain_history(s, c, gain);
     } else {
-        int c;
+        ThreadData td;
 
-        for (c = 0; c < s->channels; c++)
-            update_gain_history(s, c, get_max_local_gain(s, frame, c));
+        td.frame = frame;
+        ctx->internal->execute(ctx, analyze_channels, &td, NULL,
+                               FFMIN(s->channels, ff_filter_get_nb_threads(ctx)));
     }
 }
 
-static void amplify_frame(DynamicAudioNormalizerContext *s, AVFrame *frame, int enabled)
+static int amplify_channels(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
+    DynamicAudioNormalizerContext *s = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *frame = td->frame;
+    const int start = (s->channels * jobnr) / nb_jobs;
+    const int end = (s->channels * (jobnr+1)) / nb_jobs;
     int c, i;
 
-    for (c = 0; c < s->channels; c++) {
+    for (c = start; c < end; c++) {
         double *dst_ptr = (double *)frame->extended_data[c];
         double current_amplification_factor;
 
         cqueue_dequeue(s->gain_history_smoothed[c], &current_amplification_factor);
 
-        for (i = 0; i < frame->nb_samples && enabled; i++) {
+        for (i = 0; i < frame->nb_samples && td->enabled; i++) {
             const double amplification_factor = fade(s->prev_amplification_factor[c],
                                                      current_amplification_factor, i,
                                                      frame->nb_samples);
@@ -701,6 +746,19 @@ static void amplify_frame(DynamicAudioNormalizerContext *s, AVFrame *frame, int
 
         s->prev_amplification_factor[c] = current_amplification_factor;
     }
+
+    return 0;
+}
+
+static void amplify_frame(AVFilterContext *ctx, AVFrame *frame, int enabled)
+{
+    DynamicAudioNormalizerContext *s = ctx->priv;
+    ThreadData td;
+
+    td.frame = frame;
+    td.enabled = enabled;
+    ctx->internal->execute(ctx, amplify_channels, &td, NULL,
+                           FFMIN(s->channels, ff_filter_get_nb_threads(ctx)));
 }
 
 static int filter_frame(AVFilterLink *inlink, AVFrame *in)
@@ -718,12 +776,12 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
 
         cqueue_dequeue(s->is_enabled, &is_enabled);
 
-        amplify_frame(s, out, is_enabled > 0.);
+        amplify_frame(ctx, out, is_enabled > 0.);
         ret = ff_filter_frame(outlink, out);
     }
 
     av_frame_make_writable(in);
-    analyze_frame(s, in);
+    analyze_frame(ctx, in);
     if (!s->eof) {
         ff_bufqueue_add(ctx, &s->queue, in);
         cqueue_enqueue(s->is_enabled, !ctx->is_disabled);
@@ -878,6 +936,7 @@ AVFilter ff_af_dynaudnorm = {
     .inputs        = avfilter_af_dynaudnorm_inputs,
     .outputs       = avfilter_af_dynaudnorm_outputs,
     .priv_class    = &dynaudnorm_class,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL |
+                     AVFILTER_FLAG_SLICE_THREADS,
     .process_command = process_command,
 };
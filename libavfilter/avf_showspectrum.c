@@ -28,13 +28,13 @@
 
 #include <math.h>
 
-#include "libavcodec/avfft.h"
 #include "libavutil/audio_fifo.h"
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
 #include "libavutil/channel_layout.h"
 #include "libavutil/opt.h"
 #include "libavutil/parseutils.h"
+#include "libavutil/tx.h"
 #include "libavutil/xga_font_data.h"
 #include "audio.h"
 #include "video.h"
@@ -72,11 +72,14 @@ typedef struct ShowSpectrumContext {
     int start, stop;            ///< zoom mode
     int data;
     int xpos;                   ///< x position (current column)
-    FFTContext **fft;           ///< Fast Fourier Transform context
-    FFTContext **ifft;          ///< Inverse Fast Fourier Transform context
+    AVTXContext **fft;          ///< Fast Fourier Transform context
+    AVTXContext **ifft;         ///< Inverse Fast Fourier Transform context
+    av_tx_fn tx_fn;
+    av_tx_fn itx_fn;
     int fft_bits;               ///< number of bits (FFT window size = 1<<fft_bits)
-    FFTComplex **fft_data;      ///< bins holder for each (displayed) channels
-    FFTComplex **fft_scratch;   ///< scratch buffers
+    AVComplexFloat **fft_in;    ///< input FFT data
+    AVComplexFloat **fft_data;  ///< bins holder for each (displayed) channels
+    AVComplexFloat **fft_scratch; ///< scratch buffers
     float *window_func_lut;     ///< Window function LUT
     float **magnitudes;
     float **phases;
@@ -305,14 +308,19 @@ static av_cold void uninit(AVFilterContext *ctx)
     av_freep(&s->combine_buffer);
     if (s->fft) {
         for (i = 0; i < s->nb_display_channels; i++)
-            av_fft_end(s->fft[i]);
+            av_tx_uninit(&s->fft[i]);
     }
     av_freep(&s->fft);
     if (s->ifft) {
         for (i = 0; i < s->nb_display_channels; i++)
-            av_fft_end(s->ifft[i]);
+            av_tx_uninit(&s->ifft[i]);
     }
     av_freep(&s->ifft);
+    if (s->fft_in) {
+        for (i = 0; i < s->nb_display_channels; i++)
+            av_freep(&s->fft_in[i]);
+    }
+    av_freep(&s->fft_in);
     if (s->fft_data) {
         for (i = 0; i < s->nb_display_channels; i++)
             av_freep(&s->fft_data[i]);
@@ -387,14 +395,15 @@ static int run_channel_fft(AVFilterContext *ctx, void *arg, int jobnr, int nb_jo
     const float *p = (float *)fin->extended_data[ch];
 
     for (n = 0; n < s->win_size; n++) {
-        s->fft_data[ch][n].re = p[n] * window_func_lut[n];
-        s->fft_data[ch][n].im = 0;
+        s->fft_in[ch][n].re = p[n] * window_func_lut[n];
+        s->fft_in[ch][n].im = 0;
     }
 
     if (s->stop) {
         float theta, phi, psi, a, b, S, c;
-        FFTComplex *g = s->fft_data[ch];
-        FFTComplex *h = s->fft_scratch[ch];
+        AVComplexFloat *f = s->fft_in[ch];
+        AVComplexFloat *g = s->fft_data[ch];
+        AVComplexFloat *h = s->fft_scratch[ch];
         int L = s->buf_size;
         int N = s->win_size;
         int M = s->win_size / 2;
@@ -418,8 +427,8 @@ static int run_channel_fft(AVFilterContext *ctx, void *arg, int jobnr, int nb_jo
         }
 
         for (int n = 0; n < N; n++) {
-            g[n].re = s->fft_data[ch][n].re;
-            g[n].im = s->fft_data[ch][n].im;
+            g[n].re = s->fft_in[ch][n].re;
+            g[n].im = s->fft_in[ch][n].im;
         }
 
         for (int n = N; n < L; n++) {
@@ -437,38 +446,33 @@ static int run_channel_fft(AVFilterContext *ctx, void *arg, int jobnr, int nb_jo
             g[n].im = b;
         }
 
-        av_fft_permute(s->fft[ch], h);
-        av_fft_calc(s->fft[ch], h);
-
-        av_fft_permute(s->fft[ch], g);
-        av_fft_calc(s->fft[ch], g);
+        s->tx_fn(s->fft[ch], f, h, sizeof(float));
+        s->tx_fn(s->fft[ch], h, g, sizeof(float));
 
         for (int n = 0; n < L; n++) {
-            c = g[n].re;
-            S = g[n].im;
-            a = c * h[n].re - S * h[n].im;
-            b = S * h[n].re + c * h[n].im;
+            c = h[n].re;
+            S = h[n].im;
+            a = c * f[n].re - S * f[n].im;
+            b = S * f[n].re + c * f[n].im;
 
             g[n].re = a / L;
             g[n].im = b / L;
         }
 
-        av_fft_permute(s->ifft[ch], g);
-        av_fft_calc(s->ifft[ch], g);
+        s->itx_fn(s->ifft[ch], h, g, sizeof(float));
 
         for (int k = 0; k < M; k++) {
             psi = k * k / 2.f * phi;
             c =  cosf(psi);
             S = -sinf(psi);
-            a = c * g[k].re - S * g[k].im;
-            b = S * g[k].re + c * g[k].im;
+            a = c * h[k].re - S * h[k].im;
+            b = S * h[k].re + c * h[k].im;
             s->fft_data[ch][k].re = a;
             s->fft_data[ch][k].im = b;
         }
     } else {
         /* run FFT on each samples set */
-        av_fft_permute(s->fft[ch], s->fft_data[ch]);
-        av_fft_calc(s->fft[ch], s->fft_data[ch]);
+        s->tx_fn(s->fft[ch], s->fft_data[ch], s->fft_in[ch], sizeof(float));
     }
 
     return 0;
@@ -986,8 +990,8 @@ static int config_output(AVFilterLink *outlink)
     AVFilterContext *ctx = outlink->src;
     AVFilterLink *inlink = ctx->inputs[0];
     ShowSpectrumContext *s = ctx->priv;
-    int i, fft_bits, h, w;
-    float overlap;
+    int i, fft_bits, h, w, ret;
+    float overlap, scale = 1.f;
 
     switch (s->fscale) {
     case F_LINEAR: s->plot_channel = plot_channel_lin; break;
@@ -1056,30 +1060,32 @@ static int config_output(AVFilterLink *outlink)
          * make sure the buffer is aligned in memory for the FFT functions. */
         for (i = 0; i < s->nb_display_channels; i++) {
             if (s->stop) {
-                av_fft_end(s->ifft[i]);
+                av_tx_uninit(&s->ifft[i]);
                 av_freep(&s->fft_scratch[i]);
             }
-            av_fft_end(s->fft[i]);
+            av_tx_uninit(&s->fft[i]);
+            av_freep(&s->fft_in[i]);
             av_freep(&s->fft_data[i]);
         }
+        av_freep(&s->fft_in);
         av_freep(&s->fft_data);
 
         s->nb_display_channels = inlink->channels;
         for (i = 0; i < s->nb_display_channels; i++) {
-            s->fft[i] = av_fft_init(fft_bits + !!s->stop, 0);
+            ret = av_tx_init(&s->fft[i], &s->tx_fn, AV_TX_FLOAT_FFT, 0, s->buf_size, &scale, 0);
+            if (ret < 0) {
+                av_log(ctx, AV_LOG_ERROR, "Unable to create FFT context. "
+                       "The window size might be too high.\n");
+                return ret;
+            }
             if (s->stop) {
-                s->ifft[i] = av_fft_init(fft_bits + !!s->stop, 1);
-                if (!s->ifft[i]) {
+                ret = av_tx_init(&s->ifft[i], &s->itx_fn, AV_TX_FLOAT_FFT, 1, s->buf_size, &scale, 0);
+                if (ret < 0) {
                     av_log(ctx, AV_LOG_ERROR, "Unable to create Inverse FFT context. "
                            "The window size might be too high.\n");
-                    return AVERROR(EINVAL);
+                    return ret;
                 }
             }
-            if (!s->fft[i]) {
-                av_log(ctx, AV_LOG_ERROR, "Unable to create FFT context. "
-                       "The window size might be too high.\n");
-                return AVERROR(EINVAL);
-            }
         }
 
         s->magnitudes = av_calloc(s->nb_display_channels, sizeof(*s->magnitudes));
@@ -1110,6 +1116,9 @@ static int config_output(AVFilterLink *outlink)
                 return AVERROR(ENOMEM);
         }
 
+        s->fft_in = av_calloc(s->nb_display_channels, sizeof(*s->fft_in));
+        if (!s->fft_in)
+            return AVERROR(ENOMEM);
         s->fft_data = av_calloc(s->nb_display_channels, sizeof(*s->fft_data));
         if (!s->fft_data)
             return AVERROR(ENOMEM);
@@ -1117,6 +1126,10 @@ static int config_output(AVFilterLink *outlink)
         if (!s->fft_scratch)
             return AVERROR(ENOMEM);
         for (i = 0; i < s->nb_display_channels; i++) {
+            s->fft_in[i] = av_calloc(s->buf_size, sizeof(**s->fft_in));
+            if (!s->fft_in[i])
+                return AVERROR(ENOMEM);
+
             s->fft_data[i] = av_calloc(s->buf_size, sizeof(**s->fft_data));
             if (!s->fft_data[i])
                 return AVERROR(ENOMEM);
@@ -42,6 +42,7 @@ typedef struct CropDetectContext {
     int frame_nb;
     int max_pixsteps[4];
     int max_outliers;
+    int nb_threads;
 } CropDetectContext;
 
 static int query_formats(AVFilterContext *ctx)
@@ -152,6 +153,65 @@ static int config_input(AVFilterLink *inlink)
     s->x2 = 0;
     s->y2 = 0;
 
+    s->nb_threads = ff_filter_get_nb_threads(ctx);
+
+    return 0;
+}
+
+typedef struct ThreadData {
+    AVFrame *frame;
+    int limit;
+    int pass;
+} ThreadData;
+
+static int find_edge(AVFilterContext *ctx, const uint8_t *src, int dst,
+                     int from, int to, int inc, int step0, int step1, int len,
+                     int bpp, int limit)
+{
+    CropDetectContext *s = ctx->priv;
+    int outliers = 0, last_y, y;
+
+    for (last_y = y = from; inc > 0 ? y < to : y > to; y += inc) {
+        if (checkline(ctx, src + step0 * y, step1, len, bpp) > limit) {
+            if (++outliers > s->max_outliers)
+                return last_y;
+        } else
+            last_y = y + inc;
+    }
+
+    return dst;
+}
+
+static int find_edges(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    CropDetectContext *s = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *frame = td->frame;
+    const uint8_t *src = frame->data[0];
+    const int linesize = frame->linesize[0];
+    const int bpp = s->max_pixsteps[0];
+
+    for (int edge = jobnr; edge < 2; edge += nb_jobs) {
+        switch (td->pass * 2 + edge) {
+        case 0:
+            s->y1 = find_edge(ctx, src, s->y1, 0, s->y1, +1,
+                              linesize, bpp, frame->width, bpp, td->limit);
+            break;
+        case 1:
+            s->x1 = find_edge(ctx, src, s->x1, 0, s->x1, +1,
+                              bpp, linesize, frame->height, bpp, td->limit);
+            break;
+        case 2:
+            s->y2 = find_edge(ctx, src, s->y2, frame->height - 1, FFMAX(s->y2, s->y1), -1,
+                              linesize, bpp, frame->width, bpp, td->limit);
+            break;
+        case 3:
+            s->x2 = find_edge(ctx, src, s->x2, frame->width - 1, FFMAX(s->x2, s->x1), -1,
+                              bpp, linesize, frame->height, bpp, td->limit);
+            break;
+        }
+    }
+
     return 0;
 }
 
@@ -162,11 +222,10 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
 {
     AVFilterContext *ctx = inlink->dst;
     CropDetectContext *s = ctx->priv;
-    int bpp = s->max_pixsteps[0];
     int w, h, x, y, shrink_by;
     AVDictionary **metadata;
-    int outliers, last_y;
     int limit = lrint(s->limit);
+    ThreadData td;
 
     // ignore first s->skip frames
     if (++s->frame_nb > 0) {
@@ -181,23 +240,15 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
             s->frame_nb = 1;
         }
 
-#define FIND(DST, FROM, NOEND, INC, STEP0, STEP1, LEN) \
-        outliers = 0;\
-        for (last_y = y = FROM; NOEND; y = y INC) {\
-            if (checkline(ctx, frame->data[0] + STEP0 * y, STEP1, LEN, bpp) > limit) {\
-                if (++outliers > s->max_outliers) { \
-                    DST = last_y;\
-                    break;\
-                }\
-            } else\
-                last_y = y INC;\
-        }
-
-        FIND(s->y1,                 0,               y < s->y1, +1, frame->linesize[0], bpp, frame->width);
-        FIND(s->y2, frame->height - 1, y > FFMAX(s->y2, s->y1), -1, frame->linesize[0], bpp, frame->width);
-        FIND(s->x1,                 0,               y < s->x1, +1, bpp, frame->linesize[0], frame->height);
-        FIND(s->x2,  frame->width - 1, y > FFMAX(s->x2, s->x1), -1, bpp, frame->linesize[0], frame->height);
+        td.frame = frame;
+        td.limit = limit;
 
+        /* the top and left edges are independent of each other, as are the
+         * bottom and right edges once the former are known */
+        td.pass = 0;
+        ctx->internal->execute(ctx, find_edges, &td, NULL, FFMIN(2, s->nb_threads));
+        td.pass = 1;
+        ctx->internal->execute(ctx, find_edges, &td, NULL, FFMIN(2, s->nb_threads));
 
         // round x and y (up), important for yuv colorspaces
         // make sure they stay rounded!
@@ -283,5 +334,5 @@ AVFilter ff_vf_cropdetect = {
     .query_formats = query_formats,
     .inputs        = avfilter_vf_cropdetect_inputs,
     .outputs       = avfilter_vf_cropdetect_outputs,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -29,8 +29,8 @@
 #include "libavutil/imgutils.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
-#include "libavcodec/avfft.h"
 #include "libavutil/eval.h"
+#include "libavutil/tx.h"
 
 #define MAX_PLANES 4
 
@@ -49,16 +49,19 @@ typedef struct FFTFILTContext {
     int planewidth[MAX_PLANES];
     int planeheight[MAX_PLANES];
 
-    RDFTContext *hrdft[MAX_PLANES];
-    RDFTContext *vrdft[MAX_PLANES];
-    RDFTContext *ihrdft[MAX_PLANES];
-    RDFTContext *ivrdft[MAX_PLANES];
+    AVTXContext *hrdft[MAX_PLANES];
+    AVTXContext *vrdft[MAX_PLANES];
+    AVTXContext *ihrdft[MAX_PLANES];
+    AVTXContext *ivrdft[MAX_PLANES];
+    av_tx_fn htx_fn[MAX_PLANES], ihtx_fn[MAX_PLANES];
+    av_tx_fn vtx_fn[MAX_PLANES], ivtx_fn[MAX_PLANES];
     int rdft_hbits[MAX_PLANES];
     int rdft_vbits[MAX_PLANES];
     size_t rdft_hlen[MAX_PLANES];
     size_t rdft_vlen[MAX_PLANES];
-    FFTSample *rdft_hdata[MAX_PLANES];
-    FFTSample *rdft_vdata[MAX_PLANES];
+    float *rdft_hdata[MAX_PLANES];
+    float *rdft_vdata[MAX_PLANES];
+    float *rdft_tmp[MAX_PLANES];
 
     int dc[MAX_PLANES];
     char *weight_str[MAX_PLANES];
@@ -102,7 +105,7 @@ static double weight_Y(void *priv, double x, double y) { return lum(priv, x, y,
 static double weight_U(void *priv, double x, double y) { return lum(priv, x, y, U); }
 static double weight_V(void *priv, double x, double y) { return lum(priv, x, y, V); }
 
-static void copy_rev (FFTSample *dest, int w, int w2)
+static void copy_rev (float *dest, int w, int w2)
 {
     int i;
 
@@ -113,6 +116,27 @@ static void copy_rev (FFTSample *dest, int w, int w2)
         dest[i] = dest[w2 - i];
 }
 
+/* Forward and inverse real transform of len points, keeping the spectrum
+ * packed as re0, re(len/2), re1, im1, ... so that the weights apply to it
+ * unchanged */
+static void rdft_calc(AVTXContext *tx, av_tx_fn tx_fn, float *tmp, float *data, int len)
+{
+    tx_fn(tx, tmp, data, sizeof(float));
+    data[0] = tmp[0];
+    data[1] = tmp[len];
+    memcpy(data + 2, tmp + 2, (len - 2) * sizeof(*data));
+}
+
+static void irdft_calc(AVTXContext *tx, av_tx_fn tx_fn, float *tmp, float *data, int len)
+{
+    tmp[0] = data[0];
+    tmp[1] = 0;
+    memcpy(tmp + 2, data + 2, (len - 2) * sizeof(*data));
+    tmp[len] = data[1];
+    tmp[len + 1] = 0;
+    tx_fn(tx, data, tmp, sizeof(float));
+}
+
 /*Horizontal pass - RDFT*/
 static void rdft_horizontal8(FFTFILTContext *s, AVFrame *in, int w, int h, int plane)
 {
@@ -126,7 +150,8 @@ static void rdft_horizontal8(FFTFILTContext *s, AVFrame *in, int w, int h, int p
     }
 
     for (i = 0; i < h; i++)
-        av_rdft_calc(s->hrdft[plane], s->rdft_hdata[plane] + i * s->rdft_hlen[plane]);
+        rdft_calc(s->hrdft[plane], s->htx_fn[plane], s->rdft_tmp[plane],
+                  s->rdft_hdata[plane] + i * s->rdft_hlen[plane], s->rdft_hlen[plane]);
 }
 
 static void rdft_horizontal16(FFTFILTContext *s, AVFrame *in, int w, int h, int plane)
@@ -143,7 +168,8 @@ static void rdft_horizontal16(FFTFILTContext *s, AVFrame *in, int w, int h, int
     }
 
     for (i = 0; i < h; i++)
-        av_rdft_calc(s->hrdft[plane], s->rdft_hdata[plane] + i * s->rdft_hlen[plane]);
+        rdft_calc(s->hrdft[plane], s->htx_fn[plane], s->rdft_tmp[plane],
+                  s->rdft_hdata[plane] + i * s->rdft_hlen[plane], s->rdft_hlen[plane]);
 }
 
 /*Vertical pass - RDFT*/
@@ -159,7 +185,8 @@ static void rdft_vertical(FFTFILTContext *s, int h, int plane)
     }
 
     for (i = 0; i < s->rdft_hlen[plane]; i++)
-        av_rdft_calc(s->vrdft[plane], s->rdft_vdata[plane] + i * s->rdft_vlen[plane]);
+        rdft_calc(s->vrdft[plane], s->vtx_fn[plane], s->rdft_tmp[plane],
+                  s->rdft_vdata[plane] + i * s->rdft_vlen[plane], s->rdft_vlen[plane]);
 }
 /*Vertical pass - IRDFT*/
 static void irdft_vertical(FFTFILTContext *s, int h, int plane)
@@ -167,7 +194,8 @@ static void irdft_vertical(FFTFILTContext *s, int h, int plane)
     int i, j;
 
     for (i = 0; i < s->rdft_hlen[plane]; i++)
-        av_rdft_calc(s->ivrdft[plane], s->rdft_vdata[plane] + i * s->rdft_vlen[plane]);
+        irdft_calc(s->ivrdft[plane], s->ivtx_fn[plane], s->rdft_tmp[plane],
+                   s->rdft_vdata[plane] + i * s->rdft_vlen[plane], s->rdft_vlen[plane]);
 
     for (i = 0; i < s->rdft_hlen[plane]; i++)
         for (j = 0; j < h; j++)
@@ -181,7 +209,8 @@ static void irdft_horizontal8(FFTFILTContext *s, AVFrame *out, int w, int h, int
     int i, j;
 
     for (i = 0; i < h; i++)
-        av_rdft_calc(s->ihrdft[plane], s->rdft_hdata[plane] + i * s->rdft_hlen[plane]);
+        irdft_calc(s->ihrdft[plane], s->ihtx_fn[plane], s->rdft_tmp[plane],
+                   s->rdft_hdata[plane] + i * s->rdft_hlen[plane], s->rdft_hlen[plane]);
 
     for (i = 0; i < h; i++)
         for (j = 0; j < w; j++)
@@ -199,7 +228,8 @@ static void irdft_horizontal16(FFTFILTContext *s, AVFrame *out, int w, int h, in
     int i, j;
 
     for (i = 0; i < h; i++)
-        av_rdft_calc(s->ihrdft[plane], s->rdft_hdata[plane] + i * s->rdft_hlen[plane]);
+        irdft_calc(s->ihrdft[plane], s->ihtx_fn[plane], s->rdft_tmp[plane],
+                   s->rdft_hdata[plane] + i * s->rdft_hlen[plane], s->rdft_hlen[plane]);
 
     for (i = 0; i < h; i++)
         for (j = 0; j < w; j++)
@@ -266,7 +296,8 @@ static int config_props(AVFilterLink *inlink)
 {
     FFTFILTContext *s = inlink->dst->priv;
     const AVPixFmtDescriptor *desc;
-    int rdft_hbits, rdft_vbits, i, plane;
+    const float scale = 1.f, iscale = 0.5f;
+    int rdft_hbits, rdft_vbits, i, plane, ret;
 
     desc = av_pix_fmt_desc_get(inlink->format);
     s->depth = desc->comp[0].depth;
@@ -285,24 +316,31 @@ static int config_props(AVFilterLink *inlink)
         for (rdft_hbits = 1; 1 << rdft_hbits < w*10/9; rdft_hbits++);
         s->rdft_hbits[i] = rdft_hbits;
         s->rdft_hlen[i] = 1 << rdft_hbits;
-        if (!(s->rdft_hdata[i] = av_malloc_array(h, s->rdft_hlen[i] * sizeof(FFTSample))))
+        if (!(s->rdft_hdata[i] = av_malloc_array(h, s->rdft_hlen[i] * sizeof(float))))
             return AVERROR(ENOMEM);
 
-        if (!(s->hrdft[i] = av_rdft_init(s->rdft_hbits[i], DFT_R2C)))
-            return AVERROR(ENOMEM);
-        if (!(s->ihrdft[i] = av_rdft_init(s->rdft_hbits[i], IDFT_C2R)))
-            return AVERROR(ENOMEM);
+        if ((ret = av_tx_init(&s->hrdft[i], &s->htx_fn[i], AV_TX_FLOAT_RDFT,
+                              0, s->rdft_hlen[i], &scale, 0)) < 0)
+            return ret;
+        if ((ret = av_tx_init(&s->ihrdft[i], &s->ihtx_fn[i], AV_TX_FLOAT_RDFT,
+                              1, s->rdft_hlen[i], &iscale, 0)) < 0)
+            return ret;
 
         /* RDFT - Array initialization for Vertical pass*/
         for (rdft_vbits = 1; 1 << rdft_vbits < h*10/9; rdft_vbits++);
         s->rdft_vbits[i] = rdft_vbits;
         s->rdft_vlen[i] = 1 << rdft_vbits;
-        if (!(s->rdft_vdata[i] = av_malloc_array(s->rdft_hlen[i], s->rdft_vlen[i] * sizeof(FFTSample))))
+        if (!(s->rdft_vdata[i] = av_malloc_array(s->rdft_hlen[i], s->rdft_vlen[i] * sizeof(float))))
             return AVERROR(ENOMEM);
 
-        if (!(s->vrdft[i] = av_rdft_init(s->rdft_vbits[i], DFT_R2C)))
-            return AVERROR(ENOMEM);
-        if (!(s->ivrdft[i] = av_rdft_init(s->rdft_vbits[i], IDFT_C2R)))
+        if ((ret = av_tx_init(&s->vrdft[i], &s->vtx_fn[i], AV_TX_FLOAT_RDFT,
+                              0, s->rdft_vlen[i], &scale, 0)) < 0)
+            return ret;
+        if ((ret = av_tx_init(&s->ivrdft[i], &s->ivtx_fn[i], AV_TX_FLOAT_RDFT,
+                              1, s->rdft_vlen[i], &iscale, 0)) < 0)
+            return ret;
+
+        if (!(s->rdft_tmp[i] = av_malloc_array(FFMAX(s->rdft_hlen[i], s->rdft_vlen[i]) + 2, sizeof(float))))
             return AVERROR(ENOMEM);
     }
 
@@ -376,12 +414,13 @@ static av_cold void uninit(AVFilterContext *ctx)
     for (i = 0; i < MAX_PLANES; i++) {
         av_free(s->rdft_hdata[i]);
         av_free(s->rdft_vdata[i]);
+        av_free(s->rdft_tmp[i]);
         av_expr_free(s->weight_expr[i]);
         av_free(s->weight[i]);
-        av_rdft_end(s->hrdft[i]);
-        av_rdft_end(s->ihrdft[i]);
-        av_rdft_end(s->vrdft[i]);
-        av_rdft_end(s->ivrdft[i]);
+        av_tx_uninit(&s->hrdft[i]);
+        av_tx_uninit(&s->ihrdft[i]);
+        av_tx_uninit(&s->vrdft[i]);
+        av_tx_uninit(&s->ivrdft[i]);
     }
 }
 
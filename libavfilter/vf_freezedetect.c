@@ -29,6 +29,7 @@
 
 #include "avfilter.h"
 #include "filters.h"
+#include "internal.h"
 #include "scene_sad.h"
 
 typedef struct FreezeDetectContext {
@@ -38,6 +39,8 @@ typedef struct FreezeDetectContext {
     ptrdiff_t height[4];
     ff_scene_sad_fn sad;
     int bitdepth;
+    int nb_threads;
+    uint64_t *slice_sad;
     AVFrame *reference_frame;
     int64_t n;
     int64_t reference_n;
@@ -115,6 +118,12 @@ static int config_input(AVFilterLink *inlink)
     if (!s->sad)
         return AVERROR(EINVAL);
 
+    s->nb_threads = ff_filter_get_nb_threads(ctx);
+    av_freep(&s->slice_sad);
+    s->slice_sad = av_calloc(s->nb_threads, sizeof(*s->slice_sad));
+    if (!s->slice_sad)
+        return AVERROR(ENOMEM);
+
     return 0;
 }
 
@@ -122,24 +131,62 @@ static av_cold void uninit(AVFilterContext *ctx)
 {
     FreezeDetectContext *s = ctx->priv;
     av_frame_free(&s->reference_frame);
+    av_freep(&s->slice_sad);
 }
 
-static int is_frozen(FreezeDetectContext *s, AVFrame *reference, AVFrame *frame)
+typedef struct ThreadData {
+    AVFrame *reference;
+    AVFrame *frame;
+} ThreadData;
+
+static int sad_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
+    FreezeDetectContext *s = ctx->priv;
+    ThreadData *td = arg;
     uint64_t sad = 0;
-    uint64_t count = 0;
-    double mafd;
+
     for (int plane = 0; plane < 4; plane++) {
         if (s->width[plane]) {
+            const int start = (s->height[plane] * jobnr) / nb_jobs;
+            const int end = (s->height[plane] * (jobnr+1)) / nb_jobs;
+            const int frame_linesize = td->frame->linesize[plane];
+            const int ref_linesize = td->reference->linesize[plane];
             uint64_t plane_sad;
-            s->sad(frame->data[plane], frame->linesize[plane],
-                   reference->data[plane], reference->linesize[plane],
-                   s->width[plane], s->height[plane], &plane_sad);
+
+            if (start >= end)
+                continue;
+
+            s->sad(td->frame->data[plane] + start * frame_linesize, frame_linesize,
+                   td->reference->data[plane] + start * ref_linesize, ref_linesize,
+                   s->width[plane], end - start, &plane_sad);
             sad += plane_sad;
-            count += s->width[plane] * s->height[plane];
         }
     }
     emms_c();
+
+    s->slice_sad[jobnr] = sad;
+
+    return 0;
+}
+
+static int is_frozen(AVFilterContext *ctx, AVFrame *reference, AVFrame *frame)
+{
+    FreezeDetectContext *s = ctx->priv;
+    const int nb_jobs = FFMIN(s->height[0], s->nb_threads);
+    ThreadData td;
+    uint64_t sad = 0;
+    uint64_t count = 0;
+    double mafd;
+
+    td.reference = reference;
+    td.frame     = frame;
+    ctx->internal->execute(ctx, sad_slice, &td, NULL, nb_jobs);
+
+    for (int i = 0; i < nb_jobs; i++)
+        sad += s->slice_sad[i];
+    for (int plane = 0; plane < 4; plane++)
+        count += s->width[plane] * s->height[plane];
+
     mafd = (double)sad / count / (1ULL << s->bitdepth);
     return (mafd <= s->noise);
 }
@@ -175,7 +222,7 @@ static int activate(AVFilterContext *ctx)
             else
                 duration = av_rescale_q(frame->pts - s->reference_frame->pts, inlink->time_base, AV_TIME_BASE_Q);
 
-            frozen = is_frozen(s, s->reference_frame, frame);
+            frozen = is_frozen(ctx, s->reference_frame, frame);
             if (duration >= s->duration) {
                 if (!s->frozen)
                     set_meta(s, frame, "lavfi.freezedetect.freeze_start", av_ts2timestr(s->reference_frame->pts, &inlink->time_base));
@@ -232,4 +279,5 @@ AVFilter ff_vf_freezedetect = {
     .inputs        = freezedetect_inputs,
     .outputs       = freezedetect_outputs,
     .activate      = activate,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -110,38 +110,65 @@ int ff_idet_filter_line_c_16bit(const uint16_t *a, const uint16_t *b, const uint
     return ret;
 }
 
-static void filter(AVFilterContext *ctx)
+static int filter_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
     IDETContext *idet = ctx->priv;
+    IDETSliceStats *stats = &idet->slice_stats[jobnr];
     int y, i;
-    int64_t alpha[2]={0};
-    int64_t delta=0;
-    int64_t gamma[2]={0};
-    Type type, best_type;
-    RepeatedField repeat;
-    int match = 0;
-    AVDictionary **metadata = &idet->cur->metadata;
+
+    memset(stats, 0, sizeof(*stats));
 
     for (i = 0; i < idet->csp->nb_components; i++) {
         int w = idet->cur->width;
         int h = idet->cur->height;
         int refs = idet->cur->linesize[i];
+        int start, end;
 
         if (i && i<3) {
             w = AV_CEIL_RSHIFT(w, idet->csp->log2_chroma_w);
             h = AV_CEIL_RSHIFT(h, idet->csp->log2_chroma_h);
         }
 
-        for (y = 2; y < h - 2; y++) {
+        start = 2 + ((h - 4) * jobnr) / nb_jobs;
+        end   = 2 + ((h - 4) * (jobnr+1)) / nb_jobs;
+
+        for (y = start; y < end; y++) {
             uint8_t *prev = &idet->prev->data[i][y*refs];
             uint8_t *cur  = &idet->cur ->data[i][y*refs];
             uint8_t *next = &idet->next->data[i][y*refs];
-            alpha[ y   &1] += idet->filter_line(cur-refs, prev, cur+refs, w);
-            alpha[(y^1)&1] += idet->filter_line(cur-refs, next, cur+refs, w);
-            delta          += idet->filter_line(cur-refs,  cur, cur+refs, w);
-            gamma[(y^1)&1] += idet->filter_line(cur     , prev, cur     , w);
+            stats->alpha[ y   &1] += idet->filter_line(cur-refs, prev, cur+refs, w);
+            stats->alpha[(y^1)&1] += idet->filter_line(cur-refs, next, cur+refs, w);
+            stats->delta          += idet->filter_line(cur-refs,  cur, cur+refs, w);
+            stats->gamma[(y^1)&1] += idet->filter_line(cur     , prev, cur     , w);
         }
     }
+    emms_c();
+
+    return 0;
+}
+
+static void filter(AVFilterContext *ctx)
+{
+    IDETContext *idet = ctx->priv;
+    int i;
+    int64_t alpha[2]={0};
+    int64_t delta=0;
+    int64_t gamma[2]={0};
+    Type type, best_type;
+    RepeatedField repeat;
+    int match = 0;
+    AVDictionary **metadata = &idet->cur->metadata;
+    const int nb_jobs = FFMAX(1, FFMIN(idet->cur->height - 4, idet->nb_threads));
+
+    ctx->internal->execute(ctx, filter_slice, NULL, NULL, nb_jobs);
+
+    for (i = 0; i < nb_jobs; i++) {
+        alpha[0] += idet->slice_stats[i].alpha[0];
+        alpha[1] += idet->slice_stats[i].alpha[1];
+        delta    += idet->slice_stats[i].delta;
+        gamma[0] += idet->slice_stats[i].gamma[0];
+        gamma[1] += idet->slice_stats[i].gamma[1];
+    }
 
     if      (alpha[0] > idet->interlace_threshold * alpha[1]){
         type = TFF;
@@ -359,6 +386,7 @@ static av_cold void uninit(AVFilterContext *ctx)
     av_frame_free(&idet->prev);
     av_frame_free(&idet->cur );
     av_frame_free(&idet->next);
+    av_freep(&idet->slice_stats);
 }
 
 static int query_formats(AVFilterContext *ctx)
@@ -423,10 +451,25 @@ static av_cold int init(AVFilterContext *ctx)
     return 0;
 }
 
+static int config_input(AVFilterLink *inlink)
+{
+    AVFilterContext *ctx = inlink->dst;
+    IDETContext *idet = ctx->priv;
+
+    idet->nb_threads = ff_filter_get_nb_threads(ctx);
+    av_freep(&idet->slice_stats);
+    idet->slice_stats = av_calloc(idet->nb_threads, sizeof(*idet->slice_stats));
+    if (!idet->slice_stats)
+        return AVERROR(ENOMEM);
+
+    return 0;
+}
+
 static const AVFilterPad idet_inputs[] = {
     {
         .name         = "default",
         .type         = AVMEDIA_TYPE_VIDEO,
+        .config_props = config_input,
         .filter_frame = filter_frame,
     },
     { NULL }
@@ -451,4 +494,5 @@ AVFilter ff_vf_idet = {
     .inputs        = idet_inputs,
     .outputs       = idet_outputs,
     .priv_class    = &idet_class,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
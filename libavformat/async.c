@@ -30,11 +30,12 @@
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
 #include "libavutil/error.h"
-#include "libavutil/fifo.h"
 #include "libavutil/log.h"
 #include "libavutil/opt.h"
+#include "libavutil/spscring.h"
 #include "libavutil/thread.h"
 #include "url.h"
+#include <stdatomic.h>
 #include <stdint.h>
 
 #if HAVE_UNISTD_H
@@ -45,9 +46,13 @@
 #define READ_BACK_CAPACITY      (4 * 1024 * 1024)
 #define SHORT_SEEK_THRESHOLD    (256 * 1024)
 
+/* The background thread is the producer and the reading thread the
+ * consumer of the ring. Data already read is only drained once it exceeds
+ * read_back_capacity, read_pos being the offset of the logical position
+ * from the start of the retained data. */
 typedef struct RingBuffer
 {
-    AVFifoBuffer *fifo;
+    AVSPSCRing   *fifo;
     int           read_back_capacity;
 
     int           read_pos;
@@ -57,7 +62,7 @@ typedef struct Context {
     AVClass        *class;
     URLContext     *inner;
 
-    int             seek_request;
+    atomic_int      seek_request;
     int64_t         seek_pos;
     int             seek_whence;
     int             seek_completed;
@@ -65,7 +70,7 @@ typedef struct Context {
 
     int             inner_io_error;
     int             io_error;
-    int             io_eof_reached;
+    atomic_int      io_eof_reached;
 
     int64_t         logical_pos;
     int64_t         logical_size;
@@ -76,14 +81,14 @@ typedef struct Context {
     pthread_mutex_t mutex;
     pthread_t       async_buffer_thread;
 
-    int             abort_request;
+    atomic_int      abort_request;
     AVIOInterruptCB interrupt_callback;
 } Context;
 
 static int ring_init(RingBuffer *ring, unsigned int capacity, int read_back_capacity)
 {
     memset(ring, 0, sizeof(RingBuffer));
-    ring->fifo = av_fifo_alloc(capacity + read_back_capacity);
+    ring->fifo = av_spsc_ring_alloc(capacity + read_back_capacity);
     if (!ring->fifo)
         return AVERROR(ENOMEM);
 
@@ -93,45 +98,52 @@ static int ring_init(RingBuffer *ring, unsigned int capacity, int read_back_capa
 
 static void ring_destroy(RingBuffer *ring)
 {
-    av_fifo_freep(&ring->fifo);
+    av_spsc_ring_freep(&ring->fifo);
 }
 
 static void ring_reset(RingBuffer *ring)
 {
-    av_fifo_reset(ring->fifo);
+    av_spsc_ring_reset(ring->fifo);
     ring->read_pos = 0;
 }
 
 static int ring_size(RingBuffer *ring)
 {
-    return av_fifo_size(ring->fifo) - ring->read_pos;
+    return av_spsc_ring_size(ring->fifo) - ring->read_pos;
 }
 
 static int ring_space(RingBuffer *ring)
 {
-    return av_fifo_space(ring->fifo);
+    return av_spsc_ring_space(ring->fifo);
 }
 
-static int ring_generic_read(RingBuffer *ring, void *dest, int buf_size, void (*func)(void*, void*, int))
+static int ring_read(RingBuffer *ring, void *dest, int buf_size)
 {
-    int ret;
+    int ret = 0;
 
     av_assert2(buf_size <= ring_size(ring));
-    ret = av_fifo_generic_peek_at(ring->fifo, dest, ring->read_pos, buf_size, func);
+    if (dest)
+        ret = av_spsc_ring_peek(ring->fifo, dest, ring->read_pos, buf_size);
     ring->read_pos += buf_size;
 
     if (ring->read_pos > ring->read_back_capacity) {
-        av_fifo_drain(ring->fifo, ring->read_pos - ring->read_back_capacity);
+        av_spsc_ring_drain(ring->fifo, ring->read_pos - ring->read_back_capacity);
         ring->read_pos = ring->read_back_capacity;
     }
 
     return ret;
 }
 
-static int ring_generic_write(RingBuffer *ring, void *src, int size, int (*func)(void*, void*, int))
+static int ring_write(RingBuffer *ring, void *src, int size, int (*func)(void*, void*, int))
 {
-    av_assert2(size <= ring_space(ring));
-    return av_fifo_generic_write(ring->fifo, src, size, func);
+    size_t contiguous;
+    uint8_t *dst = av_spsc_ring_write_buffer(ring->fifo, &contiguous);
+    int ret;
+
+    ret = func(src, dst, FFMIN(size, contiguous));
+    if (ret > 0)
+        av_spsc_ring_write_commit(ring->fifo, ret);
+    return ret;
 }
 
 static int ring_size_of_read_back(RingBuffer *ring)
@@ -152,13 +164,13 @@ static int async_check_interrupt(void *arg)
     URLContext *h   = arg;
     Context    *c   = h->priv_data;
 
-    if (c->abort_request)
+    if (atomic_load(&c->abort_request))
         return 1;
 
     if (ff_check_interrupt(&c->interrupt_callback))
-        c->abort_request = 1;
+        atomic_store(&c->abort_request, 1);
 
-    return c->abort_request;
+    return atomic_load(&c->abort_request);
 }
 
 static int wrapped_url_read(void *src, void *dst, int size)
@@ -184,54 +196,61 @@ static void *async_buffer_task(void *arg)
     while (1) {
         int fifo_space, to_copy;
 
-        pthread_mutex_lock(&c->mutex);
+        /* The mutex is only taken for seek requests, errors and end of
+         * stream; the data itself goes through the lock-free ring. */
         if (async_check_interrupt(h)) {
-            c->io_eof_reached = 1;
-            c->io_error       = AVERROR_EXIT;
+            pthread_mutex_lock(&c->mutex);
+            c->io_error = AVERROR_EXIT;
+            atomic_store(&c->io_eof_reached, 1);
             pthread_cond_signal(&c->cond_wakeup_main);
             pthread_mutex_unlock(&c->mutex);
+            av_spsc_ring_wake(ring->fifo);
             break;
         }
 
-        if (c->seek_request) {
+        if (atomic_load(&c->seek_request)) {
+            pthread_mutex_lock(&c->mutex);
             seek_ret = ffurl_seek(c->inner, c->seek_pos, c->seek_whence);
             if (seek_ret >= 0) {
-                c->io_eof_reached = 0;
-                c->io_error       = 0;
+                c->io_error = 0;
+                atomic_store(&c->io_eof_reached, 0);
                 ring_reset(ring);
             }
 
             c->seek_completed = 1;
             c->seek_ret       = seek_ret;
-            c->seek_request   = 0;
-
+            atomic_store(&c->seek_request, 0);
 
             pthread_cond_signal(&c->cond_wakeup_main);
             pthread_mutex_unlock(&c->mutex);
             continue;
         }
 
-        fifo_space = ring_space(ring);
-        if (c->io_eof_reached || fifo_space <= 0) {
-            pthread_cond_signal(&c->cond_wakeup_main);
-            pthread_cond_wait(&c->cond_wakeup_background, &c->mutex);
+        if (atomic_load(&c->io_eof_reached)) {
+            pthread_mutex_lock(&c->mutex);
+            if (!atomic_load(&c->seek_request) && !atomic_load(&c->abort_request))
+                pthread_cond_wait(&c->cond_wakeup_background, &c->mutex);
             pthread_mutex_unlock(&c->mutex);
             continue;
         }
-        pthread_mutex_unlock(&c->mutex);
+
+        fifo_space = ring_space(ring);
+        if (fifo_space <= 0) {
+            av_spsc_ring_wait_space(ring->fifo, 1, -1);
+            continue;
+        }
 
         to_copy = FFMIN(4096, fifo_space);
-        ret = ring_generic_write(ring, (void *)h, to_copy, wrapped_url_read);
+        ret = ring_write(ring, (void *)h, to_copy, wrapped_url_read);
 
-        pthread_mutex_lock(&c->mutex);
         if (ret <= 0) {
-            c->io_eof_reached = 1;
+            pthread_mutex_lock(&c->mutex);
             if (c->inner_io_error < 0)
                 c->io_error = c->inner_io_error;
+            atomic_store(&c->io_eof_reached, 1);
+            pthread_mutex_unlock(&c->mutex);
+            av_spsc_ring_wake(ring->fifo);
         }
-
-        pthread_cond_signal(&c->cond_wakeup_main);
-        pthread_mutex_unlock(&c->mutex);
     }
 
     return NULL;
@@ -310,9 +329,10 @@ static int async_close(URLContext *h)
     int      ret;
 
     pthread_mutex_lock(&c->mutex);
-    c->abort_request = 1;
+    atomic_store(&c->abort_request, 1);
     pthread_cond_signal(&c->cond_wakeup_background);
     pthread_mutex_unlock(&c->mutex);
+    av_spsc_ring_wake(c->ring.fifo);
 
     ret = pthread_join(c->async_buffer_thread, NULL);
     if (ret != 0)
@@ -327,16 +347,13 @@ static int async_close(URLContext *h)
     return 0;
 }
 
-static int async_read_internal(URLContext *h, void *dest, int size, int read_complete,
-                               void (*func)(void*, void*, int))
+static int async_read_internal(URLContext *h, void *dest, int size, int read_complete)
 {
     Context      *c       = h->priv_data;
     RingBuffer   *ring    = &c->ring;
     int           to_read = size;
     int           ret     = 0;
 
-    pthread_mutex_lock(&c->mutex);
-
     while (to_read > 0) {
         int fifo_size, to_copy;
         if (async_check_interrupt(h)) {
@@ -346,8 +363,8 @@ static int async_read_internal(URLContext *h, void *dest, int size, int read_com
         fifo_size = ring_size(ring);
         to_copy   = FFMIN(to_read, fifo_size);
         if (to_copy > 0) {
-            ring_generic_read(ring, dest, to_copy, func);
-            if (!func)
+            ring_read(ring, dest, to_copy);
+            if (dest)
                 dest = (uint8_t *)dest + to_copy;
             c->logical_pos += to_copy;
             to_read        -= to_copy;
@@ -355,32 +372,30 @@ static int async_read_internal(URLContext *h, void *dest, int size, int read_com
 
             if (to_read <= 0 || !read_complete)
                 break;
-        } else if (c->io_eof_reached) {
+        } else if (atomic_load(&c->io_eof_reached)) {
+            /* Data may have been committed just before the end of stream */
+            if (ring_size(ring) > 0)
+                continue;
             if (ret <= 0) {
+                pthread_mutex_lock(&c->mutex);
                 if (c->io_error)
                     ret = c->io_error;
                 else
                     ret = AVERROR_EOF;
+                pthread_mutex_unlock(&c->mutex);
             }
             break;
+        } else {
+            av_spsc_ring_wait_size(ring->fifo, ring->read_pos + 1, -1);
         }
-        pthread_cond_signal(&c->cond_wakeup_background);
-        pthread_cond_wait(&c->cond_wakeup_main, &c->mutex);
     }
 
-    pthread_cond_signal(&c->cond_wakeup_background);
-    pthread_mutex_unlock(&c->mutex);
-
     return ret;
 }
 
 static int async_read(URLContext *h, unsigned char *buf, int size)
 {
-    return async_read_internal(h, buf, size, 0, NULL);
-}
-
-static void fifo_do_not_copy_func(void* dest, void* src, int size) {
-    // do not copy
+    return async_read_internal(h, buf, size, 0);
 }
 
 static int64_t async_seek(URLContext *h, int64_t pos, int whence)
@@ -422,7 +437,7 @@ static int64_t async_seek(URLContext *h, int64_t pos, int whence)
 
         if (pos_delta > 0) {
             // fast seek forwards
-            async_read_internal(h, NULL, pos_delta, 1, fifo_do_not_copy_func);
+            async_read_internal(h, NULL, pos_delta, 1);
         } else {
             // fast seek backwards
             ring_drain(ring, pos_delta);
@@ -440,11 +455,12 @@ static int64_t async_seek(URLContext *h, int64_t pos, int whence)
 
     pthread_mutex_lock(&c->mutex);
 
-    c->seek_request   = 1;
     c->seek_pos       = new_logical_pos;
     c->seek_whence    = SEEK_SET;
     c->seek_completed = 0;
     c->seek_ret       = 0;
+    atomic_store(&c->seek_request, 1);
+    av_spsc_ring_wake(ring->fifo);
 
     while (1) {
         if (async_check_interrupt(h)) {
@@ -655,6 +655,13 @@ int ffurl_shutdown(URLContext *h, int flags)
     return h->prot->url_shutdown(h, flags);
 }
 
+int ffurl_wait_writes(URLContext *h, int64_t pending)
+{
+    if (!h || !h->prot || !h->prot->url_wait_writes || !h->zerocopy_write)
+        return 0;
+    return h->prot->url_wait_writes(h, pending);
+}
+
 int ff_check_interrupt(AVIOInterruptCB *cb)
 {
     if (cb && cb->callback)
@@ -662,6 +669,12 @@ int ff_check_interrupt(AVIOInterruptCB *cb)
     return 0;
 }
 
+int ff_url_interrupt_cb(void *opaque)
+{
+    URLContext *h = opaque;
+    return ff_check_interrupt(&h->interrupt_callback);
+}
+
 int ff_rename(const char *url_src, const char *url_dst, void *logctx)
 {
     int ret = avpriv_io_move(url_src, url_dst);
@@ -349,6 +349,13 @@ typedef struct AVIOContext {
      * Try to buffer at least this amount of data before flushing it
      */
     int min_packet_size;
+
+    /**
+     * Internal, not meant to be used from outside of AVIOContext.
+     * Write buffers used in turn when the protocol sends them without
+     * copying, each being reused once the protocol has released it.
+     */
+    struct AVIOWriteRing *write_ring;
 } AVIOContext;
 
 /**
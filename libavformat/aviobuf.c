@@ -42,6 +42,21 @@
  */
 #define SHORT_SEEK_THRESHOLD 32768
 
+#define MAX_WRITE_BUFFERS 64
+
+/**
+ * Write buffers of a context whose protocol sends data without copying it.
+ * The buffer being filled is always buffers[cur].
+ */
+typedef struct AVIOWriteRing {
+    uint8_t *buffers[MAX_WRITE_BUFFERS];
+    /* number of bytes written when each buffer was last flushed */
+    int64_t  end[MAX_WRITE_BUFFERS];
+    int      nb_buffers;
+    int      cur;
+    int64_t  written;
+} AVIOWriteRing;
+
 static void *ff_avio_child_next(void *obj, void *prev)
 {
     AVIOContext *s = obj;
@@ -131,6 +146,7 @@ int ffio_init_context(AVIOContext *s,
     s->last_time             = AV_NOPTS_VALUE;
     s->short_seek_get        = NULL;
     s->written               = 0;
+    s->write_ring            = NULL;
 
     return 0;
 }
@@ -168,6 +184,12 @@ static void writeout(AVIOContext *s, const uint8_t *data, int len)
                                      s->last_time);
         else if (s->write_packet)
             ret = s->write_packet(s->opaque, (uint8_t *)data, len);
+        if (ret >= 0 && s->write_ring) {
+            s->write_ring->written += len;
+            /* data written directly from the caller buffer */
+            if (data != s->buffer)
+                ret = ffurl_wait_writes(s->opaque, 0);
+        }
         if (ret < 0) {
             s->error = ret;
         } else {
@@ -184,6 +206,23 @@ static void writeout(AVIOContext *s, const uint8_t *data, int len)
     s->pos += len;
 }
 
+/* Switch to the next write buffer once the protocol has released it. */
+static void next_write_buffer(AVIOContext *s)
+{
+    AVIOWriteRing *ring = s->write_ring;
+    int ret;
+
+    ring->end[ring->cur] = ring->written;
+    ring->cur = (ring->cur + 1) % ring->nb_buffers;
+    ret = ffurl_wait_writes(s->opaque, ring->written - ring->end[ring->cur]);
+    if (ret < 0 && !s->error)
+        s->error = ret;
+
+    s->buffer       = ring->buffers[ring->cur];
+    s->buf_end      = s->buffer + s->buffer_size;
+    s->checksum_ptr = s->buffer;
+}
+
 static void flush_buffer(AVIOContext *s)
 {
     s->buf_ptr_max = FFMAX(s->buf_ptr, s->buf_ptr_max);
@@ -194,6 +233,8 @@ static void flush_buffer(AVIOContext *s)
                                                  s->buf_ptr_max - s->checksum_ptr);
             s->checksum_ptr = s->buffer;
         }
+        if (s->write_ring)
+            next_write_buffer(s);
     }
     s->buf_ptr = s->buf_ptr_max = s->buffer;
     if (!s->write_flag)
@@ -922,6 +963,50 @@ uint64_t ffio_read_varlen(AVIOContext *bc){
     return val;
 }
 
+static int write_ring_alloc(AVIOContext *s, URLContext *h)
+{
+    AVIOWriteRing *ring;
+    int i;
+
+    ring = av_mallocz(sizeof(*ring));
+    if (!ring)
+        return AVERROR(ENOMEM);
+    ring->nb_buffers = av_clip(h->zerocopy_size / s->buffer_size + 1,
+                               2, MAX_WRITE_BUFFERS);
+    ring->buffers[0] = s->buffer;
+    for (i = 1; i < ring->nb_buffers; i++) {
+        ring->buffers[i] = av_malloc(s->buffer_size);
+        if (!ring->buffers[i]) {
+            while (--i)
+                av_free(ring->buffers[i]);
+            av_free(ring);
+            return AVERROR(ENOMEM);
+        }
+    }
+    s->write_ring     = ring;
+    h->zerocopy_write = 1;
+    return 0;
+}
+
+/* Go back to a single write buffer, the current one. The protocol has to
+ * release all of the data first; if it fails, the connection is broken and
+ * whatever it still has to send is lost anyway. */
+static void write_ring_free(AVIOContext *s)
+{
+    AVIOWriteRing *ring = s->write_ring;
+    URLContext *h = s->opaque;
+    int i;
+
+    if (!ring)
+        return;
+    ffurl_wait_writes(h, 0);
+    h->zerocopy_write = 0;
+    for (i = 0; i < ring->nb_buffers; i++)
+        if (ring->buffers[i] != s->buffer)
+            av_free(ring->buffers[i]);
+    av_freep(&s->write_ring);
+}
+
 int ffio_fdopen(AVIOContext **s, URLContext *h)
 {
     uint8_t *buffer = NULL;
@@ -974,6 +1059,16 @@ int ffio_fdopen(AVIOContext **s, URLContext *h)
     }
     (*s)->short_seek_get = (int (*)(void *))ffurl_get_short_seek;
     (*s)->av_class = &ff_avio_class;
+
+    if (h->zerocopy_size > 0 && (h->flags & AVIO_FLAG_WRITE)) {
+        int ret = write_ring_alloc(*s, h);
+        if (ret < 0) {
+            av_freep(&(*s)->buffer);
+            av_opt_free(*s);
+            avio_context_free(s);
+            return ret;
+        }
+    }
     return 0;
 fail:
     av_freep(&buffer);
@@ -1037,6 +1132,8 @@ int ffio_ensure_seekback(AVIOContext *s, int64_t buf_size)
 int ffio_set_buf_size(AVIOContext *s, int buf_size)
 {
     uint8_t *buffer;
+
+    write_ring_free(s);
     buffer = av_malloc(buf_size);
     if (!buffer)
         return AVERROR(ENOMEM);
@@ -1061,6 +1158,7 @@ int ffio_realloc_buf(AVIOContext *s, int buf_size)
     if (buf_size <= s->buffer_size)
         return 0;
 
+    write_ring_free(s);
     buffer = av_malloc(buf_size);
     if (!buffer)
         return AVERROR(ENOMEM);
@@ -1178,6 +1276,7 @@ int avio_close(AVIOContext *s)
         return 0;
 
     avio_flush(s);
+    write_ring_free(s);
     h         = s->opaque;
     s->opaque = NULL;
 
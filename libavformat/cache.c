@@ -24,13 +24,13 @@
 /**
  * @TODO
  *      support keeping files
- *      support filling with a background thread
  */
 
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
 #include "libavutil/internal.h"
 #include "libavutil/opt.h"
+#include "libavutil/thread.h"
 #include "libavutil/tree.h"
 #include "avformat.h"
 #include <fcntl.h>
@@ -41,14 +41,20 @@
 #include <unistd.h>
 #endif
 #include <sys/stat.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include "os_support.h"
 #include "url.h"
 
+/* Size of the reads done by the background thread, seek targets are
+ * aligned down to it */
+#define FILL_CHUNK_SIZE 32768
+
 typedef struct CacheEntry {
     int64_t logical_pos;
     int64_t physical_pos;
     int size;
+    uint8_t *data; /* in memory if set, in the temporary file otherwise */
 } CacheEntry;
 
 typedef struct Context {
@@ -63,7 +69,27 @@ typedef struct Context {
     int is_true_eof;
     URLContext *inner;
     int64_t cache_hit, cache_miss;
+    int64_t hit_bytes, miss_bytes;
     int read_ahead_limit;
+    int64_t mem_cache_size;
+    int64_t mem_used;
+    int background_fill;
+    int prefetch_size;
+
+    /* Background fill: the thread fetches the data missing from fill_start
+     * up to prefetch_size bytes after the logical position. The tree, the
+     * temporary file and the positions are protected by the mutex. */
+    int64_t fill_start;
+    int fill_error;
+    int64_t fill_error_pos;
+    int fill_idle;
+    atomic_int abort_request;
+    AVIOInterruptCB interrupt_callback;
+#if HAVE_THREADS
+    pthread_t fill_thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+#endif
 } Context;
 
 static int cmp(const void *key, const void *node)
@@ -71,32 +97,17 @@ static int cmp(const void *key, const void *node)
     return FFDIFFSIGN(*(const int64_t *)key, ((const CacheEntry *) node)->logical_pos);
 }
 
-static int cache_open(URLContext *h, const char *arg, int flags, AVDictionary **options)
+static int cache_check_interrupt(void *arg)
 {
-    int ret;
-    char *buffername;
-    Context *c= h->priv_data;
-
-    av_strstart(arg, "cache:", &arg);
-
-    c->fd = avpriv_tempfile("ffcache", &buffername, 0, h);
-    if (c->fd < 0){
-        av_log(h, AV_LOG_ERROR, "Failed to create tempfile\n");
-        return c->fd;
-    }
+    URLContext *h = arg;
+    Context *c = h->priv_data;
 
-    ret = unlink(buffername);
-
-    if (ret >= 0)
-        av_freep(&buffername);
-    else
-        c->filename = buffername;
-
-    return ffurl_open_whitelist(&c->inner, arg, flags, &h->interrupt_callback,
-                                options, h->protocol_whitelist, h->protocol_blacklist, h);
+    return atomic_load(&c->abort_request) ||
+           ff_check_interrupt(&c->interrupt_callback);
 }
 
-static int add_entry(URLContext *h, const unsigned char *buf, int size)
+static int add_entry(URLContext *h, int64_t logical_pos,
+                     const unsigned char *buf, int size)
 {
     Context *c= h->priv_data;
     int64_t pos = -1;
@@ -104,96 +115,361 @@ static int add_entry(URLContext *h, const unsigned char *buf, int size)
     CacheEntry *entry = NULL, *next[2] = {NULL, NULL};
     CacheEntry *entry_ret;
     struct AVTreeNode *node = NULL;
+    uint8_t *data = NULL;
 
-    //FIXME avoid lseek
-    pos = lseek(c->fd, 0, SEEK_END);
-    if (pos < 0) {
-        ret = AVERROR(errno);
-        av_log(h, AV_LOG_ERROR, "seek in cache failed\n");
-        goto fail;
-    }
-    c->cache_pos = pos;
-
-    ret = write(c->fd, buf, size);
-    if (ret < 0) {
-        ret = AVERROR(errno);
-        av_log(h, AV_LOG_ERROR, "write in cache failed\n");
-        goto fail;
-    }
-    c->cache_pos += ret;
-
-    entry = av_tree_find(c->root, &c->logical_pos, cmp, (void**)next);
-
-    if (!entry)
-        entry = next[0];
-
-    if (!entry ||
-        entry->logical_pos  + entry->size != c->logical_pos ||
-        entry->physical_pos + entry->size != pos
-    ) {
-        entry = av_malloc(sizeof(*entry));
-        node = av_tree_node_alloc();
-        if (!entry || !node) {
+    if (c->mem_used + size <= c->mem_cache_size) {
+        data = av_memdup(buf, size);
+        if (!data) {
             ret = AVERROR(ENOMEM);
             goto fail;
         }
-        entry->logical_pos = c->logical_pos;
-        entry->physical_pos = pos;
-        entry->size = ret;
-
-        entry_ret = av_tree_insert(&c->root, entry, cmp, &node);
-        if (entry_ret && entry_ret != entry) {
-            ret = -1;
-            av_log(h, AV_LOG_ERROR, "av_tree_insert failed\n");
+        ret = size;
+    } else {
+        //FIXME avoid lseek
+        pos = lseek(c->fd, 0, SEEK_END);
+        if (pos < 0) {
+            ret = AVERROR(errno);
+            av_log(h, AV_LOG_ERROR, "seek in cache failed\n");
             goto fail;
         }
-    } else
-        entry->size += ret;
+        c->cache_pos = pos;
+
+        ret = write(c->fd, buf, size);
+        if (ret < 0) {
+            ret = AVERROR(errno);
+            av_log(h, AV_LOG_ERROR, "write in cache failed\n");
+            goto fail;
+        }
+        c->cache_pos += ret;
+
+        entry = av_tree_find(c->root, &logical_pos, cmp, (void**)next);
+
+        if (!entry)
+            entry = next[0];
+
+        if (entry && !entry->data &&
+            entry->logical_pos  + entry->size == logical_pos &&
+            entry->physical_pos + entry->size == pos) {
+            entry->size += ret;
+            return 0;
+        }
+    }
+
+    entry = av_malloc(sizeof(*entry));
+    node = av_tree_node_alloc();
+    if (!entry || !node) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    entry->logical_pos = logical_pos;
+    entry->physical_pos = pos;
+    entry->size = ret;
+    entry->data = data;
+
+    entry_ret = av_tree_insert(&c->root, entry, cmp, &node);
+    if (entry_ret && entry_ret != entry) {
+        ret = -1;
+        av_log(h, AV_LOG_ERROR, "av_tree_insert failed\n");
+        goto fail;
+    }
+    if (data)
+        c->mem_used += size;
 
     return 0;
 fail:
     //we could truncate the file to pos here if pos >=0 but ftruncate isn't available in VS so
     //for simplicty we just leave the file a bit larger
+    av_free(data);
     av_free(entry);
     av_free(node);
     return ret;
 }
 
-static int cache_read(URLContext *h, unsigned char *buf, int size)
+/* Return the entry containing pos, if any. */
+static CacheEntry *find_entry(Context *c, int64_t pos)
 {
-    Context *c= h->priv_data;
     CacheEntry *entry, *next[2] = {NULL, NULL};
-    int64_t r;
 
-    entry = av_tree_find(c->root, &c->logical_pos, cmp, (void**)next);
+    entry = av_tree_find(c->root, &pos, cmp, (void**)next);
 
     if (!entry)
         entry = next[0];
 
-    if (entry) {
-        int64_t in_block_pos = c->logical_pos - entry->logical_pos;
-        av_assert0(entry->logical_pos <= c->logical_pos);
-        if (in_block_pos < entry->size) {
-            int64_t physical_target = entry->physical_pos + in_block_pos;
+    if (entry && pos - entry->logical_pos < entry->size)
+        return entry;
+    return NULL;
+}
+
+/* Read from the cache at the logical position, return 0 if the data is not
+ * cached or cannot be read back. */
+static int read_cached(URLContext *h, unsigned char *buf, int size)
+{
+    Context *c= h->priv_data;
+    CacheEntry *entry = find_entry(c, c->logical_pos);
+    int64_t in_block_pos, physical_target, r;
+
+    if (!entry)
+        return 0;
+
+    in_block_pos = c->logical_pos - entry->logical_pos;
+    av_assert0(entry->logical_pos <= c->logical_pos);
+    size = FFMIN(size, entry->size - in_block_pos);
 
-            if (c->cache_pos != physical_target) {
-                r = lseek(c->fd, physical_target, SEEK_SET);
-            } else
-                r = c->cache_pos;
+    if (entry->data) {
+        memcpy(buf, entry->data + in_block_pos, size);
+        c->logical_pos += size;
+        return size;
+    }
+
+    physical_target = entry->physical_pos + in_block_pos;
 
-            if (r >= 0) {
-                c->cache_pos = r;
-                r = read(c->fd, buf, FFMIN(size, entry->size - in_block_pos));
+    if (c->cache_pos != physical_target) {
+        r = lseek(c->fd, physical_target, SEEK_SET);
+    } else
+        r = c->cache_pos;
+
+    if (r >= 0) {
+        c->cache_pos = r;
+        r = read(c->fd, buf, size);
+    }
+
+    if (r > 0) {
+        c->cache_pos += r;
+        c->logical_pos += r;
+        return r;
+    }
+    return 0;
+}
+
+#if HAVE_THREADS
+/* Return the first position missing from the cache in the fill window,
+ * or -1 if there is none. */
+static int64_t next_fill_pos(Context *c)
+{
+    int64_t pos   = c->fill_start;
+    int64_t limit = c->logical_pos + c->prefetch_size;
+    CacheEntry *entry;
+
+    if (c->fill_error)
+        return -1;
+    while ((entry = find_entry(c, pos)))
+        pos = entry->logical_pos + entry->size;
+    if (pos >= limit || (c->is_true_eof && pos >= c->end))
+        return -1;
+    return pos;
+}
+
+static void *fill_task(void *arg)
+{
+    URLContext *h = arg;
+    Context *c = h->priv_data;
+    uint8_t buf[FILL_CHUNK_SIZE];
+
+    pthread_mutex_lock(&c->mutex);
+    while (!atomic_load(&c->abort_request)) {
+        int64_t pos = next_fill_pos(c);
+        CacheEntry *next[2] = {NULL, NULL};
+        int64_t r = 0;
+        int size = sizeof(buf);
+
+        if (pos < 0) {
+            c->fill_idle = 1;
+            pthread_cond_wait(&c->cond, &c->mutex);
+            c->fill_idle = 0;
+            continue;
+        }
+
+        /* do not overlap the next cached range */
+        av_tree_find(c->root, &pos, cmp, (void**)next);
+        if (next[1])
+            size = FFMIN(size, next[1]->logical_pos - pos);
+        if (c->is_true_eof)
+            size = FFMIN(size, c->end - pos);
+
+        pthread_mutex_unlock(&c->mutex);
+        if (pos != c->inner_pos) {
+            r = ffurl_seek(c->inner, pos, SEEK_SET);
+            if (r >= 0)
+                c->inner_pos = r;
+        }
+        if (r >= 0)
+            r = ffurl_read(c->inner, buf, size);
+        if (r > 0)
+            c->inner_pos += r;
+        pthread_mutex_lock(&c->mutex);
+
+        if (r == AVERROR_EOF) {
+            c->is_true_eof = 1;
+            c->end = FFMAX(c->end, pos);
+        } else if (r < 0) {
+            c->fill_error     = r;
+            c->fill_error_pos = pos;
+        } else if (r > 0) {
+            if (add_entry(h, pos, buf, r) < 0) {
+                c->fill_error     = AVERROR(EIO);
+                c->fill_error_pos = pos;
             }
+            c->end = FFMAX(c->end, pos + r);
+        }
+        pthread_cond_broadcast(&c->cond);
+    }
+    pthread_mutex_unlock(&c->mutex);
+
+    return NULL;
+}
 
-            if (r > 0) {
-                c->cache_pos += r;
-                c->logical_pos += r;
-                c->cache_hit ++;
-                return r;
+static void fill_wakeup(Context *c)
+{
+    if (c->fill_idle)
+        pthread_cond_broadcast(&c->cond);
+}
+
+static int cache_read_background(URLContext *h, unsigned char *buf, int size)
+{
+    Context *c= h->priv_data;
+    int miss = 0;
+    int r;
+
+    pthread_mutex_lock(&c->mutex);
+    if (c->logical_pos < c->fill_start ||
+        c->logical_pos - c->fill_start >= c->prefetch_size)
+        c->fill_start = c->logical_pos;
+    fill_wakeup(c);
+
+    while (!(r = read_cached(h, buf, size))) {
+        miss = 1;
+        if (c->is_true_eof && c->logical_pos >= c->end) {
+            r = AVERROR_EOF;
+            break;
+        }
+        if (c->fill_error) {
+            int err = c->fill_error;
+            c->fill_error = 0;
+            if (c->fill_error_pos == c->logical_pos) {
+                r = err;
+                break;
             }
+            /* failure further on in the window, retry from here */
+            c->fill_start = c->logical_pos;
+            fill_wakeup(c);
+        }
+        if (cache_check_interrupt(h)) {
+            r = AVERROR_EXIT;
+            break;
+        }
+        pthread_cond_wait(&c->cond, &c->mutex);
+    }
+
+    if (r > 0) {
+        if (miss) {
+            c->cache_miss ++;
+            c->miss_bytes += r;
+        } else {
+            c->cache_hit ++;
+            c->hit_bytes += r;
         }
     }
+    pthread_mutex_unlock(&c->mutex);
+
+    return r;
+}
+
+static int start_fill_thread(URLContext *h)
+{
+    Context *c= h->priv_data;
+    int64_t size;
+    int ret;
+
+    /* the inner protocol is only used by the thread from now on */
+    size = ffurl_seek(c->inner, 0, AVSEEK_SIZE);
+    if (size > 0) {
+        c->is_true_eof = 1;
+        c->end = size;
+    }
+
+    ret = pthread_mutex_init(&c->mutex, NULL);
+    if (ret)
+        return AVERROR(ret);
+    ret = pthread_cond_init(&c->cond, NULL);
+    if (ret) {
+        pthread_mutex_destroy(&c->mutex);
+        return AVERROR(ret);
+    }
+    ret = pthread_create(&c->fill_thread, NULL, fill_task, h);
+    if (ret) {
+        pthread_cond_destroy(&c->cond);
+        pthread_mutex_destroy(&c->mutex);
+        return AVERROR(ret);
+    }
+    return 0;
+}
+#endif
+
+static int cache_open(URLContext *h, const char *arg, int flags, AVDictionary **options)
+{
+    int ret;
+    char *buffername;
+    Context *c= h->priv_data;
+    AVIOInterruptCB interrupt_callback = { cache_check_interrupt, h };
+
+    av_strstart(arg, "cache:", &arg);
+
+    c->fd = avpriv_tempfile("ffcache", &buffername, 0, h);
+    if (c->fd < 0){
+        av_log(h, AV_LOG_ERROR, "Failed to create tempfile\n");
+        return c->fd;
+    }
+
+    ret = unlink(buffername);
+
+    if (ret >= 0)
+        av_freep(&buffername);
+    else
+        c->filename = buffername;
+
+    c->interrupt_callback = h->interrupt_callback;
+    ret = ffurl_open_whitelist(&c->inner, arg, flags, &interrupt_callback,
+                               options, h->protocol_whitelist, h->protocol_blacklist, h);
+    if (ret < 0 || !c->background_fill)
+        return ret;
+
+    if (c->inner->is_streamed) {
+        av_log(h, AV_LOG_WARNING,
+               "Background fill disabled, the input is not seekable\n");
+        c->background_fill = 0;
+        return 0;
+    }
+#if HAVE_THREADS
+    ret = start_fill_thread(h);
+    if (ret < 0) {
+        av_log(h, AV_LOG_ERROR, "Failed to start the fill thread: %s\n",
+               av_err2str(ret));
+        ffurl_closep(&c->inner);
+        return ret;
+    }
+#else
+    av_log(h, AV_LOG_WARNING, "Background fill requires threads, disabled\n");
+    c->background_fill = 0;
+#endif
+    return 0;
+}
+
+static int cache_read(URLContext *h, unsigned char *buf, int size)
+{
+    Context *c= h->priv_data;
+    int64_t r;
+
+#if HAVE_THREADS
+    if (c->background_fill)
+        return cache_read_background(h, buf, size);
+#endif
+
+    r = read_cached(h, buf, size);
+    if (r > 0) {
+        c->cache_hit ++;
+        c->hit_bytes += r;
+        return r;
+    }
 
     // Cache miss or some kind of fault with the cache
 
@@ -216,19 +492,69 @@ static int cache_read(URLContext *h, unsigned char *buf, int size)
     c->inner_pos += r;
 
     c->cache_miss ++;
+    c->miss_bytes += r;
 
-    add_entry(h, buf, r);
+    add_entry(h, c->logical_pos, buf, r);
     c->logical_pos += r;
     c->end = FFMAX(c->end, c->logical_pos);
 
     return r;
 }
 
+#if HAVE_THREADS
+/* The inner protocol belongs to the fill thread, so only seeks that can be
+ * resolved without it are done. The fill window is moved to the target,
+ * starting at the chunk containing it. */
+static int64_t cache_seek_background(URLContext *h, int64_t pos, int whence)
+{
+    Context *c= h->priv_data;
+    int64_t ret;
+
+    pthread_mutex_lock(&c->mutex);
+    if (whence == AVSEEK_SIZE) {
+        ret = c->is_true_eof ? c->end : AVERROR(ENOSYS);
+        goto end;
+    }
+    if (whence == SEEK_CUR) {
+        pos += c->logical_pos;
+    } else if (whence == SEEK_END) {
+        if (!c->is_true_eof) {
+            ret = AVERROR(ENOSYS);
+            goto end;
+        }
+        pos += c->end;
+    } else if (whence != SEEK_SET) {
+        ret = AVERROR(EINVAL);
+        goto end;
+    }
+    if (pos < 0) {
+        ret = AVERROR(EINVAL);
+        goto end;
+    }
+
+    c->logical_pos = pos;
+    if (!find_entry(c, pos)) {
+        c->fill_start = pos - pos % FILL_CHUNK_SIZE;
+        c->fill_error = 0;
+        fill_wakeup(c);
+    }
+    ret = pos;
+end:
+    pthread_mutex_unlock(&c->mutex);
+    return ret;
+}
+#endif
+
 static int64_t cache_seek(URLContext *h, int64_t pos, int whence)
 {
     Context *c= h->priv_data;
     int64_t ret;
 
+#if HAVE_THREADS
+    if (c->background_fill)
+        return cache_seek_background(h, pos, whence);
+#endif
+
     if (whence == AVSEEK_SIZE) {
         pos= ffurl_seek(c->inner, pos, whence);
         if(pos <= 0){
@@ -291,7 +617,10 @@ resolve_eof:
 
 static int enu_free(void *opaque, void *elem)
 {
-    av_free(elem);
+    CacheEntry *entry = elem;
+
+    av_free(entry->data);
+    av_free(entry);
     return 0;
 }
 
@@ -300,8 +629,24 @@ static int cache_close(URLContext *h)
     Context *c= h->priv_data;
     int ret;
 
-    av_log(h, AV_LOG_INFO, "Statistics, cache hits:%"PRId64" cache misses:%"PRId64"\n",
-           c->cache_hit, c->cache_miss);
+#if HAVE_THREADS
+    if (c->background_fill) {
+        pthread_mutex_lock(&c->mutex);
+        atomic_store(&c->abort_request, 1);
+        pthread_cond_broadcast(&c->cond);
+        pthread_mutex_unlock(&c->mutex);
+
+        ret = pthread_join(c->fill_thread, NULL);
+        if (ret != 0)
+            av_log(h, AV_LOG_ERROR, "pthread_join(): %s\n", av_err2str(AVERROR(ret)));
+        pthread_cond_destroy(&c->cond);
+        pthread_mutex_destroy(&c->mutex);
+    }
+#endif
+
+    av_log(h, AV_LOG_INFO, "Statistics, cache hits:%"PRId64" cache misses:%"PRId64
+           ", bytes hit:%"PRId64" bytes missed:%"PRId64"\n",
+           c->cache_hit, c->cache_miss, c->hit_bytes, c->miss_bytes);
 
     close(c->fd);
     if (c->filename) {
@@ -322,6 +667,11 @@ static int cache_close(URLContext *h)
 
 static const AVOption options[] = {
     { "read_ahead_limit", "Amount in bytes that may be read ahead when seeking isn't supported, -1 for unlimited", OFFSET(read_ahead_limit), AV_OPT_TYPE_INT, { .i64 = 65536 }, -1, INT_MAX, D },
+    { "mem_cache_size", "Amount in bytes of cached data kept in memory instead of the temporary file", OFFSET(mem_cache_size), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, D },
+    { "background_fill", "Fetch the data from a background thread", OFFSET(background_fill), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, D },
+    { "prefetch_size", "Amount in bytes fetched ahead of the read position in background fill mode", OFFSET(prefetch_size), AV_OPT_TYPE_INT, { .i64 = 1024 * 1024 }, FILL_CHUNK_SIZE, INT_MAX, D },
+    { "hit_bytes", "Amount in bytes read from the cache without waiting", OFFSET(hit_bytes), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, D | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
+    { "miss_bytes", "Amount in bytes read after waiting for the input", OFFSET(miss_bytes), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, D | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
     {NULL},
 };
 
@@ -27,6 +27,8 @@
 #include "internal.h"
 #include "avio_internal.h"
 #include "dash.h"
+#include "http.h"
+#include "segprefetch.h"
 
 #define INITIAL_BUFFER_SIZE 32768
 #define MAX_BPRINT_READ_SIZE (UINT_MAX - 1)
@@ -78,6 +80,8 @@ struct representation {
     char *url_template;
     AVIOContext pb;
     AVIOContext *input;
+    SegmentPrefetchQueue prefetch;
+    SegmentPrefetch *cur_prefetch; /* read instead of input if set */
     AVFormatContext *parent;
     AVFormatContext *ctx;
     int stream_index;
@@ -151,6 +155,9 @@ typedef struct DASHContext {
     char *allowed_extensions;
     AVDictionary *avio_opts;
     int max_url_size;
+    int http_connection_pool;
+    int prefetch_segments;
+    int64_t prefetch_max_size;
 
     /* Flags for init section*/
     int is_init_section_common_video;
@@ -354,6 +361,8 @@ static void free_representation(struct representation *pls)
     av_freep(&pls->init_sec_buf);
     av_freep(&pls->pb.buffer);
     ff_format_io_close(pls->parent, &pls->input);
+    ff_segment_prefetch_flush(&pls->prefetch);
+    ff_segment_prefetch_free(&pls->cur_prefetch);
     if (pls->ctx) {
         pls->ctx->pb = NULL;
         avformat_close_input(&pls->ctx);
@@ -440,6 +449,10 @@ static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
     av_freep(pb);
     av_dict_copy(&tmp, *opts, 0);
     av_dict_copy(&tmp, opts2, 0);
+    if (c->http_connection_pool && av_strstart(proto_name, "http", NULL)) {
+        av_dict_set(&tmp, "multiple_requests", "1", 0);
+        av_dict_set(&tmp, "connection_pool", "1", 0);
+    }
     ret = avio_open2(pb, url, AVIO_FLAG_READ, c->interrupt_callback, &tmp);
     if (ret >= 0) {
         // update cookies on http response with setcookies.
@@ -1208,6 +1221,10 @@ static int parse_manifest(AVFormatContext *s, const char *url, AVIOContext *in)
         close_in = 1;
 
         av_dict_copy(&opts, c->avio_opts, 0);
+        if (c->http_connection_pool && av_strstart(url, "http", NULL)) {
+            av_dict_set(&opts, "multiple_requests", "1", 0);
+            av_dict_set(&opts, "connection_pool", "1", 0);
+        }
         ret = avio_open2(&in, url, AVIO_FLAG_READ, c->interrupt_callback, &opts);
         av_dict_free(&opts);
         if (ret < 0)
@@ -1666,7 +1683,10 @@ static int read_from_url(struct representation *pls, struct fragment *seg,
     if (seg->size >= 0)
         buf_size = FFMIN(buf_size, pls->cur_seg_size - pls->cur_seg_offset);
 
-    ret = avio_read(pls->input, buf, buf_size);
+    if (pls->cur_prefetch)
+        ret = ff_segment_prefetch_read(pls->cur_prefetch, buf, buf_size);
+    else
+        ret = avio_read(pls->input, buf, buf_size);
     if (ret > 0)
         pls->cur_seg_offset += ret;
 
@@ -1754,13 +1774,74 @@ static int update_init_section(struct representation *pls)
 static int64_t seek_data(void *opaque, int64_t offset, int whence)
 {
     struct representation *v = opaque;
-    if (v->n_fragments && !v->init_sec_data_len) {
+    if (v->n_fragments && !v->init_sec_data_len && v->input) {
         return avio_seek(v->input, offset, whence);
     }
 
     return AVERROR(ENOSYS);
 }
 
+/* Start downloading the fragments following the ones already queued, up to
+ * prefetch_segments of them. This is only done for static manifests, and
+ * when the fragments are not seeked into, see seek_data(). Like for open_url(),
+ * only plain http(s) URLs are allowed, as they are opened directly. */
+static void prefetch_fragments(DASHContext *c, struct representation *pls)
+{
+    size_t max_size = c->prefetch_max_size / (c->prefetch_segments + 1);
+    int64_t cur_seq_no = pls->cur_seq_no;
+    int64_t seq_no = ff_segment_prefetch_next_id(&pls->prefetch, cur_seq_no);
+    char *url;
+
+    if (c->is_live || (pls->n_fragments && !pls->init_sec_data_len))
+        return;
+    url = av_mallocz(c->max_url_size);
+    if (!url)
+        return;
+
+    while (pls->prefetch.nb_segments < c->prefetch_segments &&
+           (pls->n_fragments ? seq_no < pls->n_fragments : seq_no <= pls->last_seq_no)) {
+        AVDictionary *opts = NULL;
+        const char *proto_name;
+        struct fragment *seg;
+        int ret;
+
+        pls->cur_seq_no = seq_no;
+        seg = get_current_fragment(pls);
+        pls->cur_seq_no = cur_seq_no;
+        if (!seg)
+            break;
+        ff_make_absolute_url(url, c->max_url_size, c->base_url, seg->url);
+        proto_name = avio_find_protocol_name(url);
+        if (!proto_name || !av_strstart(proto_name, "http", NULL) ||
+            strncmp(proto_name, url, strlen(proto_name)) || url[strlen(proto_name)] != ':') {
+            free_fragment(&seg);
+            break;
+        }
+
+        av_dict_copy(&opts, c->avio_opts, 0);
+        if (c->http_connection_pool) {
+            av_dict_set(&opts, "multiple_requests", "1", 0);
+            av_dict_set(&opts, "connection_pool", "1", 0);
+        }
+        if (seg->size >= 0) {
+            av_dict_set_int(&opts, "offset", seg->url_offset, 0);
+            av_dict_set_int(&opts, "end_offset", seg->url_offset + seg->size, 0);
+        }
+        ret = ff_segment_prefetch_start(&pls->prefetch, pls->parent, seq_no,
+                                        url, opts, seg->size, max_size);
+        av_dict_free(&opts);
+        free_fragment(&seg);
+        if (ret < 0) {
+            av_log(pls->parent, AV_LOG_WARNING,
+                   "Failed to prefetch fragment %"PRId64": %s\n",
+                   seq_no, av_err2str(ret));
+            break;
+        }
+        seq_no++;
+    }
+    av_free(url);
+}
+
 static int read_data(void *opaque, uint8_t *buf, int buf_size)
 {
     int ret = 0;
@@ -1768,7 +1849,7 @@ static int read_data(void *opaque, uint8_t *buf, int buf_size)
     DASHContext *c = v->parent->priv_data;
 
 restart:
-    if (!v->input) {
+    if (!v->input && !v->cur_prefetch) {
         free_fragment(&v->cur_seg);
         v->cur_seg = get_current_fragment(v);
         if (!v->cur_seg) {
@@ -1781,7 +1862,16 @@ restart:
         if (ret)
             goto end;
 
-        ret = open_input(c, v, v->cur_seg);
+        if (c->prefetch_segments &&
+            (v->cur_prefetch = ff_segment_prefetch_take(&v->prefetch, v->cur_seq_no))) {
+            ret = ff_segment_prefetch_wait(v->cur_prefetch);
+            if (ret < 0)
+                ff_segment_prefetch_free(&v->cur_prefetch);
+            v->cur_seg_offset = 0;
+            v->cur_seg_size = v->cur_seg->size;
+        }
+        if (!v->cur_prefetch)
+            ret = open_input(c, v, v->cur_seg);
         if (ret < 0) {
             if (ff_check_interrupt(c->interrupt_callback)) {
                 ret = AVERROR_EXIT;
@@ -1791,6 +1881,8 @@ restart:
             v->cur_seq_no++;
             goto restart;
         }
+        if (c->prefetch_segments)
+            prefetch_fragments(c, v);
     }
 
     if (v->init_sec_buf_read_offset < v->init_sec_data_len) {
@@ -2042,6 +2134,10 @@ static int dash_read_header(AVFormatContext *s)
 
     c->interrupt_callback = &s->interrupt_callback;
 
+    /* Keep pooled connections across fragments until dash_close(). */
+    if (CONFIG_HTTP_PROTOCOL && c->http_connection_pool)
+        ff_http_pool_ref();
+
     if ((ret = save_avio_options(s)) < 0)
         goto fail;
 
@@ -2183,6 +2279,8 @@ static void recheck_discard_flags(AVFormatContext *s, struct representation **p,
         } else if (!needed && pls->ctx) {
             close_demux_for_component(pls);
             ff_format_io_close(pls->parent, &pls->input);
+            ff_segment_prefetch_flush(&pls->prefetch);
+            ff_segment_prefetch_free(&pls->cur_prefetch);
             av_log(s, AV_LOG_INFO, "No longer receiving stream_index %d\n", pls->stream_index);
         }
     }
@@ -2244,6 +2342,7 @@ static int dash_read_packet(AVFormatContext *s, AVPacket *pkt)
             cur->cur_seg_offset = 0;
             cur->init_sec_buf_read_offset = 0;
             ff_format_io_close(cur->parent, &cur->input);
+            ff_segment_prefetch_free(&cur->cur_prefetch);
             ret = reopen_demux_for_component(s, cur);
             cur->is_restart_needed = 0;
         }
@@ -2259,6 +2358,8 @@ static int dash_close(AVFormatContext *s)
     free_subtitle_list(c);
     av_dict_free(&c->avio_opts);
     av_freep(&c->base_url);
+    if (CONFIG_HTTP_PROTOCOL && c->http_connection_pool)
+        ff_http_pool_unref();
     return 0;
 }
 
@@ -2283,6 +2384,8 @@ static int dash_seek(AVFormatContext *s, struct representation *pls, int64_t see
     }
 
     ff_format_io_close(pls->parent, &pls->input);
+    ff_segment_prefetch_flush(&pls->prefetch);
+    ff_segment_prefetch_free(&pls->cur_prefetch);
 
     // find the nearest fragment
     if (pls->n_timelines > 0 && pls->fragment_timescale > 0) {
@@ -2380,6 +2483,12 @@ static const AVOption dash_options[] = {
         OFFSET(allowed_extensions), AV_OPT_TYPE_STRING,
         {.str = "aac,m4a,m4s,m4v,mov,mp4,webm,ts"},
         INT_MIN, INT_MAX, FLAGS},
+    {"http_connection_pool", "Share persistent HTTP connections through the HTTP connection pool",
+        OFFSET(http_connection_pool), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, FLAGS },
+    {"prefetch_segments", "Number of fragments downloaded ahead in parallel, per representation",
+        OFFSET(prefetch_segments), AV_OPT_TYPE_INT, {.i64 = 0}, 0, SEGMENT_PREFETCH_MAX, FLAGS },
+    {"prefetch_max_size", "Maximum memory used for prefetched fragments, per representation",
+        OFFSET(prefetch_max_size), AV_OPT_TYPE_INT64, {.i64 = 32 * 1024 * 1024}, 0, INT_MAX, FLAGS },
     {NULL}
 };
 
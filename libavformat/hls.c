@@ -38,6 +38,7 @@
 #include "internal.h"
 #include "avio_internal.h"
 #include "id3v2.h"
+#include "segprefetch.h"
 
 #define INITIAL_BUFFER_SIZE 32768
 
@@ -98,6 +99,8 @@ struct playlist {
     int input_read_done;
     AVIOContext *input_next;
     int input_next_requested;
+    SegmentPrefetchQueue prefetch;
+    SegmentPrefetch *cur_prefetch; /* read instead of input if set */
     AVFormatContext *parent;
     int index;
     AVFormatContext *ctx;
@@ -211,7 +214,11 @@ typedef struct HLSContext {
     int max_reload;
     int http_persistent;
     int http_multiple;
+    int http_pipeline;
+    int http_connection_pool;
     int http_seekable;
+    int prefetch_segments;
+    int64_t prefetch_max_size;
     AVIOContext *playlist_pb;
 } HLSContext;
 
@@ -262,6 +269,8 @@ static void free_playlist_list(HLSContext *c)
         pls->input_read_done = 0;
         ff_format_io_close(c->ctx, &pls->input_next);
         pls->input_next_requested = 0;
+        ff_segment_prefetch_flush(&pls->prefetch);
+        ff_segment_prefetch_free(&pls->cur_prefetch);
         if (pls->ctx) {
             pls->ctx->pb = NULL;
             avformat_close_input(&pls->ctx);
@@ -616,6 +625,25 @@ static int open_url_keepalive(AVFormatContext *s, AVIOContext **pb,
 #endif
 }
 
+/* Send the request for seg on the connection of pb ahead of time, see
+ * ff_http_pipeline_request(). */
+static void pipeline_segment(AVFormatContext *s, AVIOContext *pb, struct segment *seg)
+{
+#if CONFIG_HTTP_PROTOCOL
+    URLContext *uc = ffio_geturlcontext(pb);
+    int ret;
+
+    if (!uc)
+        return;
+    ret = ff_http_pipeline_request(uc, seg->url,
+                                   seg->size >= 0 ? seg->url_offset : 0,
+                                   seg->size >= 0 ? seg->url_offset + seg->size : 0);
+    if (ret < 0)
+        av_log(s, AV_LOG_DEBUG, "Could not pipeline the request for '%s': %s\n",
+               seg->url, av_err2str(ret));
+#endif
+}
+
 static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
                     AVDictionary **opts, AVDictionary *opts2, int *is_http_out)
 {
@@ -742,8 +770,11 @@ static int parse_playlist(HLSContext *c, const char *url,
         AVDictionary *opts = NULL;
         av_dict_copy(&opts, c->avio_opts, 0);
 
-        if (c->http_persistent)
+        if (c->http_persistent) {
             av_dict_set(&opts, "multiple_requests", "1", 0);
+            if (c->http_connection_pool)
+                av_dict_set(&opts, "connection_pool", "1", 0);
+        }
 
         ret = c->ctx->io_open(c->ctx, &in, url, AVIO_FLAG_READ, &opts);
         av_dict_free(&opts);
@@ -1014,7 +1045,10 @@ static int read_from_url(struct playlist *pls, struct segment *seg,
     if (seg->size >= 0)
         buf_size = FFMIN(buf_size, seg->size - pls->cur_seg_offset);
 
-    ret = avio_read(pls->input, buf, buf_size);
+    if (pls->cur_prefetch)
+        ret = ff_segment_prefetch_read(pls->cur_prefetch, buf, buf_size);
+    else
+        ret = avio_read(pls->input, buf, buf_size);
     if (ret > 0)
         pls->cur_seg_offset += ret;
 
@@ -1225,8 +1259,11 @@ static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg,
     int ret;
     int is_http = 0;
 
-    if (c->http_persistent)
+    if (c->http_persistent) {
         av_dict_set(&opts, "multiple_requests", "1", 0);
+        if (c->http_connection_pool)
+            av_dict_set(&opts, "connection_pool", "1", 0);
+    }
 
     if (seg->size >= 0) {
         /* try to restrict the HTTP request to the part we want
@@ -1416,6 +1453,58 @@ static int playlist_needed(struct playlist *pls)
     return 0;
 }
 
+/* Only plain http(s) segments are prefetched: they are opened directly by
+ * the prefetching threads, with the checks of open_url() done here. */
+static int can_prefetch(struct segment *seg)
+{
+    const char *proto_name = avio_find_protocol_name(seg->url);
+
+    return seg->key_type == KEY_NONE && proto_name &&
+           av_strstart(proto_name, "http", NULL) &&
+           av_strstart(seg->url, proto_name, NULL) &&
+           seg->url[strlen(proto_name)] == ':';
+}
+
+/* Start downloading the segments following the ones already queued, up to
+ * prefetch_segments of them. The memory budget of the playlist is shared
+ * between the queued segments and the one being read. */
+static void prefetch_segments(HLSContext *c, struct playlist *pls)
+{
+    size_t max_size = c->prefetch_max_size / (c->prefetch_segments + 1);
+    int64_t seq_no = ff_segment_prefetch_next_id(&pls->prefetch, pls->cur_seq_no);
+
+    while (pls->prefetch.nb_segments < c->prefetch_segments &&
+           seq_no < pls->start_seq_no + pls->n_segments) {
+        struct segment *seg = pls->segments[seq_no - pls->start_seq_no];
+        AVDictionary *opts = NULL;
+        int ret;
+
+        if (!can_prefetch(seg))
+            break;
+
+        av_dict_copy(&opts, c->avio_opts, 0);
+        if (c->http_persistent) {
+            av_dict_set(&opts, "multiple_requests", "1", 0);
+            if (c->http_connection_pool)
+                av_dict_set(&opts, "connection_pool", "1", 0);
+        }
+        if (seg->size >= 0) {
+            av_dict_set_int(&opts, "offset", seg->url_offset, 0);
+            av_dict_set_int(&opts, "end_offset", seg->url_offset + seg->size, 0);
+        }
+        ret = ff_segment_prefetch_start(&pls->prefetch, pls->parent, seq_no,
+                                        seg->url, opts, seg->size, max_size);
+        av_dict_free(&opts);
+        if (ret < 0) {
+            av_log(pls->parent, AV_LOG_WARNING,
+                   "Failed to prefetch segment %"PRId64" of playlist %d: %s\n",
+                   seq_no, pls->index, av_err2str(ret));
+            break;
+        }
+        seq_no++;
+    }
+}
+
 static int read_data(void *opaque, uint8_t *buf, int buf_size)
 {
     struct playlist *v = opaque;
@@ -1429,7 +1518,8 @@ restart:
     if (!v->needed)
         return AVERROR_EOF;
 
-    if (!v->input || (c->http_persistent && v->input_read_done)) {
+    if ((!v->input && !v->cur_prefetch) ||
+        (c->http_persistent && v->input_read_done)) {
         int64_t reload_interval;
 
         /* Check that the playlist is still needed before opening a new
@@ -1500,7 +1590,18 @@ reload:
         if (ret)
             return ret;
 
-        if (c->http_multiple == 1 && v->input_next_requested) {
+        if (c->prefetch_segments &&
+            (v->cur_prefetch = ff_segment_prefetch_take(&v->prefetch, v->cur_seq_no))) {
+            ret = ff_segment_prefetch_wait(v->cur_prefetch);
+            if (ret < 0) {
+                ff_segment_prefetch_free(&v->cur_prefetch);
+                ret = open_input(c, v, seg, &v->input);
+            } else {
+                /* an idle persistent connection goes back to the pool */
+                ff_format_io_close(v->parent, &v->input);
+                v->cur_seg_offset = 0;
+            }
+        } else if (c->http_multiple == 1 && v->input_next_requested) {
             FFSWAP(AVIOContext *, v->input, v->input_next);
             v->cur_seg_offset = 0;
             v->input_next_requested = 0;
@@ -1520,7 +1621,7 @@ reload:
         just_opened = 1;
     }
 
-    if (c->http_multiple == -1) {
+    if (c->http_multiple == -1 && !c->prefetch_segments) {
         uint8_t *http_version_opt = NULL;
         int r = av_opt_get(v->input, "http_version", AV_OPT_SEARCH_CHILDREN, &http_version_opt);
         if (r >= 0) {
@@ -1530,7 +1631,14 @@ reload:
     }
 
     seg = next_segment(v);
-    if (c->http_multiple == 1 && !v->input_next_requested &&
+    if (c->prefetch_segments) {
+        if (just_opened)
+            prefetch_segments(c, v);
+    } else if (c->http_pipeline) {
+        if (just_opened && c->http_persistent && seg && seg->key_type == KEY_NONE &&
+            current_segment(v)->key_type == KEY_NONE && av_strstart(seg->url, "http", NULL))
+            pipeline_segment(v->parent, v->input, seg);
+    } else if (c->http_multiple == 1 && !v->input_next_requested &&
         seg && seg->key_type == KEY_NONE && av_strstart(seg->url, "http", NULL)) {
         ret = open_input(c, v, seg, &v->input_next);
         if (ret < 0) {
@@ -1563,7 +1671,9 @@ reload:
 
         return ret;
     }
-    if (c->http_persistent &&
+    if (v->cur_prefetch) {
+        ff_segment_prefetch_free(&v->cur_prefetch);
+    } else if (c->http_persistent &&
         seg->key_type == KEY_NONE && av_strstart(seg->url, "http", NULL)) {
         v->input_read_done = 1;
     } else {
@@ -1844,6 +1954,8 @@ static int hls_close(AVFormatContext *s)
 
     av_dict_free(&c->avio_opts);
     ff_format_io_close(c->ctx, &c->playlist_pb);
+    if (CONFIG_HTTP_PROTOCOL && c->http_connection_pool)
+        ff_http_pool_unref();
 
     return 0;
 }
@@ -1861,6 +1973,10 @@ static int hls_read_header(AVFormatContext *s)
     c->first_timestamp = AV_NOPTS_VALUE;
     c->cur_timestamp = AV_NOPTS_VALUE;
 
+    /* Keep pooled connections across segments until hls_close(). */
+    if (CONFIG_HTTP_PROTOCOL && c->http_connection_pool)
+        ff_http_pool_ref();
+
     if ((ret = save_avio_options(s)) < 0)
         goto fail;
 
@@ -2091,6 +2207,8 @@ static int recheck_discard_flags(AVFormatContext *s, int first)
             pls->input_read_done = 0;
             ff_format_io_close(pls->parent, &pls->input_next);
             pls->input_next_requested = 0;
+            ff_segment_prefetch_flush(&pls->prefetch);
+            ff_segment_prefetch_free(&pls->cur_prefetch);
             pls->needed = 0;
             changed = 1;
             av_log(s, AV_LOG_INFO, "No longer receiving playlist %d\n", i);
@@ -2331,6 +2449,8 @@ static int hls_read_seek(AVFormatContext *s, int stream_index,
         pls->input_read_done = 0;
         ff_format_io_close(pls->parent, &pls->input_next);
         pls->input_next_requested = 0;
+        ff_segment_prefetch_flush(&pls->prefetch);
+        ff_segment_prefetch_free(&pls->cur_prefetch);
         av_packet_unref(&pls->pkt);
         pls->pb.eof_reached = 0;
         /* Clear any buffered data */
@@ -2390,6 +2510,14 @@ static const AVOption hls_options[] = {
         OFFSET(http_persistent), AV_OPT_TYPE_BOOL, {.i64 = 1}, 0, 1, FLAGS },
     {"http_multiple", "Use multiple HTTP connections for fetching segments",
         OFFSET(http_multiple), AV_OPT_TYPE_BOOL, {.i64 = -1}, -1, 1, FLAGS},
+    {"http_pipeline", "Pipeline the request of the next segment on the persistent connection",
+        OFFSET(http_pipeline), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, FLAGS},
+    {"http_connection_pool", "Share persistent HTTP connections through the HTTP connection pool",
+        OFFSET(http_connection_pool), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, FLAGS},
+    {"prefetch_segments", "Number of segments downloaded ahead in parallel, per playlist",
+        OFFSET(prefetch_segments), AV_OPT_TYPE_INT, {.i64 = 0}, 0, SEGMENT_PREFETCH_MAX, FLAGS},
+    {"prefetch_max_size", "Maximum memory used for prefetched segments, per playlist",
+        OFFSET(prefetch_max_size), AV_OPT_TYPE_INT64, {.i64 = 32 * 1024 * 1024}, 0, INT_MAX, FLAGS},
     {"http_seekable", "Use HTTP partial requests, 0 = disable, 1 = enable, -1 = auto",
         OFFSET(http_seekable), AV_OPT_TYPE_BOOL, { .i64 = -1}, -1, 1, FLAGS},
     {NULL}
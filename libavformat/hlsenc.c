@@ -41,6 +41,8 @@
 #include "libavutil/random_seed.h"
 #include "libavutil/opt.h"
 #include "libavutil/log.h"
+#include "libavutil/thread.h"
+#include "libavutil/threadmessage.h"
 #include "libavutil/time.h"
 #include "libavutil/time_internal.h"
 
@@ -73,6 +75,11 @@ typedef enum {
 #define BUFSIZE (16 * 1024)
 #define POSTFIX_PATTERN "_%d"
 
+typedef struct HLSPart {
+    double duration; /* in seconds */
+    int independent; /* starts with a keyframe */
+} HLSPart;
+
 typedef struct HLSSegment {
     char filename[MAX_URL_SIZE];
     char sub_filename[MAX_URL_SIZE];
@@ -89,6 +96,9 @@ typedef struct HLSSegment {
 
     struct HLSSegment *next;
     double discont_program_date_time;
+
+    HLSPart *parts; /* partial segments, low latency mode only */
+    int nb_parts;
 } HLSSegment;
 
 typedef enum HLSFlags {
@@ -183,6 +193,14 @@ typedef struct VariantStream {
     const char *sgroup;   /* subtitle group name */
     const char *ccgroup;  /* closed caption group name */
     const char *varname;  /* variant name */
+
+    HLSPart *parts;       /* finished parts of the current segment */
+    int nb_parts;
+    int part_pos;         /* start of the current part in the segment buffer */
+    int64_t part_start_pts;
+    int part_new;         /* no reference packet written to the current part yet */
+    int part_independent;
+    AVIOContext *part_out;
 } VariantStream;
 
 typedef struct ClosedCaptionsStream {
@@ -198,6 +216,7 @@ typedef struct HLSContext {
 
     int64_t time;          // Set by a private option.
     int64_t init_time;     // Set by a private option.
+    int64_t part_time;     // Set by a private option.
     int max_nb_segments;   // Set by a private option.
     int hls_delete_threshold; // Set by a private option.
 #if FF_API_HLS_WRAP
@@ -258,6 +277,16 @@ typedef struct HLSContext {
     char *headers;
     int has_default_key; /* has DEFAULT field of var_stream_map */
     int has_video_m3u8; /* has video stream m3u8 list */
+
+    int async_io;
+    int async_io_queue_size;
+    AVThreadMessageQueue *io_queue; /* jobs for the I/O thread, NULL when writing synchronously */
+#if HAVE_THREADS
+    pthread_t io_thread;
+    pthread_mutex_t io_lock; /* serializes the io_open and io_close callbacks */
+#endif
+    AVIOContext *io_out; /* output of the I/O thread */
+    int io_ret; /* return code of the I/O thread, valid once it is joined */
 } HLSContext;
 
 static int strftime_expand(const char *fmt, char **dest)
@@ -283,6 +312,39 @@ static int strftime_expand(const char *fmt, char **dest)
     return r;
 }
 
+/* In async_io mode, the io_open and io_close callbacks are called from both
+ * the muxing and the I/O threads. They are not required to be thread-safe,
+ * so the calls are serialized. */
+static int hls_call_io_open(HLSContext *hls, AVFormatContext *s, AVIOContext **pb,
+                            const char *url, int flags, AVDictionary **options)
+{
+    int ret;
+
+#if HAVE_THREADS
+    if (hls->io_queue)
+        pthread_mutex_lock(&hls->io_lock);
+#endif
+    ret = s->io_open(s, pb, url, flags, options);
+#if HAVE_THREADS
+    if (hls->io_queue)
+        pthread_mutex_unlock(&hls->io_lock);
+#endif
+    return ret;
+}
+
+static void hls_call_io_close(HLSContext *hls, AVFormatContext *s, AVIOContext **pb)
+{
+#if HAVE_THREADS
+    if (hls->io_queue)
+        pthread_mutex_lock(&hls->io_lock);
+#endif
+    ff_format_io_close(s, pb);
+#if HAVE_THREADS
+    if (hls->io_queue)
+        pthread_mutex_unlock(&hls->io_lock);
+#endif
+}
+
 static int hlsenc_io_open(AVFormatContext *s, AVIOContext **pb, char *filename,
                           AVDictionary **options)
 {
@@ -290,14 +352,14 @@ static int hlsenc_io_open(AVFormatContext *s, AVIOContext **pb, char *filename,
     int http_base_proto = filename ? ff_is_http_proto(filename) : 0;
     int err = AVERROR_MUXER_NOT_FOUND;
     if (!*pb || !http_base_proto || !hls->http_persistent) {
-        err = s->io_open(s, pb, filename, AVIO_FLAG_WRITE, options);
+        err = hls_call_io_open(hls, s, pb, filename, AVIO_FLAG_WRITE, options);
 #if CONFIG_HTTP_PROTOCOL
     } else {
         URLContext *http_url_context = ffio_geturlcontext(*pb);
         av_assert0(http_url_context);
         err = ff_http_do_new_request(http_url_context, filename);
         if (err < 0)
-            ff_format_io_close(s, pb);
+            hls_call_io_close(hls, s, pb);
 
 #endif
     }
@@ -312,7 +374,7 @@ static int hlsenc_io_close(AVFormatContext *s, AVIOContext **pb, char *filename)
     if (!*pb)
         return ret;
     if (!http_base_proto || !hls->http_persistent || hls->key_info_file || hls->encrypt) {
-        ff_format_io_close(s, pb);
+        hls_call_io_close(hls, s, pb);
 #if CONFIG_HTTP_PROTOCOL
     } else {
         URLContext *http_url_context = ffio_geturlcontext(*pb);
@@ -574,11 +636,11 @@ static int hls_delete_file(HLSContext *hls, AVFormatContext *avf,
         AVIOContext  *out = NULL;
         int ret;
         av_dict_set(&opt, "method", "DELETE", 0);
-        ret = avf->io_open(avf, &out, path, AVIO_FLAG_WRITE, &opt);
+        ret = hls_call_io_open(hls, avf, &out, path, AVIO_FLAG_WRITE, &opt);
         av_dict_free(&opt);
         if (ret < 0)
             return hls->ignore_io_errors ? 1 : ret;
-        ff_format_io_close(avf, &out);
+        hls_call_io_close(hls, avf, &out);
     } else if (unlink(path) < 0) {
         av_log(hls, AV_LOG_ERROR, "failed to delete old segment %s: %s\n",
                path, strerror(errno));
@@ -586,6 +648,421 @@ static int hls_delete_file(HLSContext *hls, AVFormatContext *avf,
     return 0;
 }
 
+enum HLSIOJobType {
+    HLS_IO_WRITE,
+    HLS_IO_RENAME,
+    HLS_IO_DELETE,
+};
+
+typedef struct HLSIOJob {
+    enum HLSIOJobType type;
+    char *url;              /* file to write, rename or delete */
+    char *new_url;          /* new name of the file for renames */
+    const char *proto;      /* protocol to delete the file with */
+    AVDictionary *options;  /* options to open the file with for writes */
+    uint8_t *data;
+    int size;
+    int styp;               /* prepend a styp box to the data */
+} HLSIOJob;
+
+static void hls_io_job_free(void *msg)
+{
+    HLSIOJob *job = msg;
+
+    av_freep(&job->url);
+    av_freep(&job->new_url);
+    av_dict_free(&job->options);
+    av_freep(&job->data);
+}
+
+static int hls_io_upload(AVFormatContext *s, HLSIOJob *job)
+{
+    HLSContext *hls = s->priv_data;
+    AVDictionary *options = NULL;
+    int ret, err;
+
+    if ((ret = av_dict_copy(&options, job->options, 0)) < 0)
+        return ret;
+    ret = hlsenc_io_open(s, &hls->io_out, job->url, &options);
+    av_dict_free(&options);
+    if (ret < 0)
+        return ret;
+
+    if (job->styp)
+        write_styp(hls->io_out);
+    avio_write(hls->io_out, job->data, job->size);
+    avio_flush(hls->io_out);
+    err = hls->io_out->error;
+
+    ret = hlsenc_io_close(s, &hls->io_out, job->url);
+    return ret < 0 ? ret : err;
+}
+
+static int hls_io_run_job(AVFormatContext *s, HLSIOJob *job)
+{
+    HLSContext *hls = s->priv_data;
+    int ret = 0;
+
+    switch (job->type) {
+    case HLS_IO_WRITE:
+        if ((ret = hls_io_upload(s, job)) < 0) {
+            av_log(s, AV_LOG_WARNING, "upload of '%s' failed,"
+                   " will retry with a new http session.\n", job->url);
+            hls_call_io_close(hls, s, &hls->io_out);
+            ret = hls_io_upload(s, job);
+        }
+        if (ret < 0) {
+            av_log(s, hls->ignore_io_errors ? AV_LOG_WARNING : AV_LOG_ERROR,
+                   "Failed to write file '%s': %s\n", job->url, av_err2str(ret));
+            hls_call_io_close(hls, s, &hls->io_out);
+            ret = hls->ignore_io_errors ? 0 : ret;
+        }
+        break;
+    case HLS_IO_RENAME:
+        ff_rename(job->url, job->new_url, s);
+        break;
+    case HLS_IO_DELETE:
+        ret = hls_delete_file(hls, s, job->url, job->proto);
+        ret = FFMIN(ret, 0);
+        break;
+    }
+
+    return ret;
+}
+
+#if HAVE_THREADS
+static void *hls_io_thread(void *arg)
+{
+    AVFormatContext *s = arg;
+    HLSContext *hls = s->priv_data;
+    HLSIOJob job;
+    int ret;
+
+    while ((ret = av_thread_message_queue_recv(hls->io_queue, &job, 0)) >= 0) {
+        ret = hls_io_run_job(s, &job);
+        hls_io_job_free(&job);
+        if (ret < 0) {
+            /* fail the next job submission with this error */
+            av_thread_message_queue_set_err_send(hls->io_queue, ret);
+            break;
+        }
+    }
+
+    hls_call_io_close(hls, s, &hls->io_out);
+    hls->io_ret = ret == AVERROR_EOF ? 0 : ret;
+
+    return NULL;
+}
+#endif
+
+static int hls_io_start(AVFormatContext *s)
+{
+#if HAVE_THREADS
+    HLSContext *hls = s->priv_data;
+    int ret;
+
+    ret = av_thread_message_queue_alloc(&hls->io_queue, hls->async_io_queue_size,
+                                        sizeof(HLSIOJob));
+    if (ret < 0)
+        return ret;
+    av_thread_message_queue_set_free_func(hls->io_queue, hls_io_job_free);
+    pthread_mutex_init(&hls->io_lock, NULL);
+
+    ret = pthread_create(&hls->io_thread, NULL, hls_io_thread, s);
+    if (ret) {
+        av_log(s, AV_LOG_ERROR, "Failed to start I/O thread: %s\n",
+               av_err2str(AVERROR(ret)));
+        av_thread_message_queue_free(&hls->io_queue);
+        pthread_mutex_destroy(&hls->io_lock);
+        return AVERROR(ret);
+    }
+
+    return 0;
+#else
+    av_log(s, AV_LOG_ERROR, "async_io requires threading support\n");
+    return AVERROR(ENOSYS);
+#endif
+}
+
+/* Waits for the pending jobs to be done, or drops them if abort is set,
+ * then switches back to synchronous writes. */
+static int hls_io_stop(AVFormatContext *s, int abort)
+{
+#if HAVE_THREADS
+    HLSContext *hls = s->priv_data;
+    int ret;
+
+    if (!hls->io_queue)
+        return 0;
+
+    if (abort)
+        av_thread_message_flush(hls->io_queue);
+    av_thread_message_queue_set_err_recv(hls->io_queue, AVERROR_EOF);
+    ret = pthread_join(hls->io_thread, NULL);
+    av_thread_message_queue_free(&hls->io_queue);
+    pthread_mutex_destroy(&hls->io_lock);
+    if (ret) {
+        av_log(s, AV_LOG_ERROR, "pthread join error: %s\n",
+               av_err2str(AVERROR(ret)));
+        return AVERROR(ret);
+    }
+
+    return hls->io_ret;
+#else
+    return 0;
+#endif
+}
+
+/* Blocks while the queue is full. Takes ownership of the job. */
+static int hls_io_submit(HLSContext *hls, HLSIOJob *job)
+{
+    int ret = av_thread_message_queue_send(hls->io_queue, job, 0);
+    if (ret < 0)
+        hls_io_job_free(job);
+    return ret;
+}
+
+static int hls_rename(HLSContext *hls, const char *oldpath,
+                      const char *newpath, void *logctx)
+{
+    HLSIOJob job = { .type = HLS_IO_RENAME };
+
+    if (!hls->io_queue)
+        return ff_rename(oldpath, newpath, logctx);
+
+    job.url     = av_strdup(oldpath);
+    job.new_url = av_strdup(newpath);
+    if (!job.url || !job.new_url) {
+        hls_io_job_free(&job);
+        return AVERROR(ENOMEM);
+    }
+    return hls_io_submit(hls, &job);
+}
+
+static int hls_delete(HLSContext *hls, AVFormatContext *avf,
+                      const char *path, const char *proto)
+{
+    HLSIOJob job = { .type = HLS_IO_DELETE, .proto = proto };
+
+    if (!hls->io_queue)
+        return hls_delete_file(hls, avf, path, proto);
+
+    if (!(job.url = av_strdup(path)))
+        return AVERROR(ENOMEM);
+    return hls_io_submit(hls, &job);
+}
+
+/* In async_io mode playlists are written to memory, and handed over to
+ * the I/O thread once complete. */
+static int hls_playlist_open(AVFormatContext *s, AVIOContext **pb,
+                             char *filename, AVDictionary **options)
+{
+    HLSContext *hls = s->priv_data;
+
+    if (!hls->io_queue)
+        return hlsenc_io_open(s, pb, filename, options);
+
+    /* a persistent connection left over from a synchronous write */
+    hls_call_io_close(hls, s, pb);
+    return avio_open_dyn_buf(pb);
+}
+
+static int hls_playlist_close(AVFormatContext *s, AVIOContext **pb,
+                              char *filename)
+{
+    HLSContext *hls = s->priv_data;
+    HLSIOJob job = { .type = HLS_IO_WRITE };
+
+    if (!*pb)
+        return 0;
+    if (!hls->io_queue)
+        return hlsenc_io_close(s, pb, filename);
+
+    job.size = avio_close_dyn_buf(*pb, &job.data);
+    *pb = NULL;
+    if (!(job.url = av_strdup(filename))) {
+        hls_io_job_free(&job);
+        return AVERROR(ENOMEM);
+    }
+    set_http_options(s, &job.options, hls);
+
+    return hls_io_submit(hls, &job);
+}
+
+/* Hands the buffered segment over to the I/O thread */
+static int hls_io_write_segment(AVFormatContext *s, VariantStream *vs,
+                                const char *filename, AVDictionary *options)
+{
+    HLSContext *hls = s->priv_data;
+    AVFormatContext *oc = vs->avf;
+    HLSIOJob job = { .type = HLS_IO_WRITE };
+    int ret;
+
+    if (!oc->pb)
+        return AVERROR(EINVAL);
+
+    av_write_frame(oc, NULL);
+    job.size = avio_close_dyn_buf(oc->pb, &job.data);
+    job.styp = hls->segment_type == SEGMENT_TYPE_FMP4;
+    ret = avio_open_dyn_buf(&oc->pb);
+    if (ret >= 0 && !(job.url = av_strdup(filename)))
+        ret = AVERROR(ENOMEM);
+    if (ret >= 0)
+        ret = av_dict_copy(&job.options, options, 0);
+    if (ret < 0) {
+        hls_io_job_free(&job);
+        return ret;
+    }
+
+    return hls_io_submit(hls, &job);
+}
+
+/* Name of the idx-th part of a segment: "seg12.m4s" -> "seg12.part3.m4s" */
+static void hls_part_filename(char *buf, int size, const char *segment, int idx)
+{
+    const char *ext = strrchr(segment, '.');
+
+    if (!ext || strchr(ext, '/') || strchr(ext, SEPARATOR))
+        ext = segment + strlen(segment);
+    snprintf(buf, size, "%.*s.part%d%s", (int)(ext - segment), segment, idx, ext);
+}
+
+/* Final name of the segment being written, without the temp_file suffix.
+ * Parts are always written under their final name. */
+static void hls_current_segment_name(HLSContext *hls, VariantStream *vs,
+                                     char *buf, int size, int basename)
+{
+    const char *url = vs->avf->url;
+    size_t len;
+
+    av_strlcpy(buf, basename && !hls->use_localtime_mkdir ? av_basename(url) : url, size);
+    len = strlen(buf);
+    if ((hls->flags & HLS_TEMP_FILE) && len > 4 && !strcmp(buf + len - 4, ".tmp"))
+        buf[len - 4] = '\0';
+}
+
+/* Size of the init segment at the start of buf. The first fragment may
+ * already have been flushed after the moov, it belongs to the first segment. */
+static int hls_init_segment_size(const uint8_t *buf, int size)
+{
+    int pos = 0;
+
+    while (size - pos >= 8) {
+        uint32_t box_size = AV_RB32(buf + pos);
+        uint32_t type     = AV_RL32(buf + pos + 4);
+
+        if (box_size < 8 || box_size > size - pos)
+            break;
+        pos += box_size;
+        if (type == MKTAG('m','o','o','v'))
+            return pos;
+    }
+    return size;
+}
+
+static int hls_write_init_segment(AVFormatContext *s, VariantStream *vs)
+{
+    HLSContext *hls = s->priv_data;
+    AVFormatContext *oc = vs->avf;
+    int byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
+    int range_length, size, ret;
+
+    size = avio_close_dyn_buf(oc->pb, &vs->init_buffer);
+    oc->pb = NULL;
+    if (size <= 0)
+        return AVERROR(EINVAL);
+    range_length = hls_init_segment_size(vs->init_buffer, size);
+    avio_write(vs->out, vs->init_buffer, range_length);
+    vs->init_range_length = range_length;
+    if ((ret = avio_open_dyn_buf(&oc->pb)) < 0) {
+        av_freep(&vs->init_buffer);
+        return ret;
+    }
+    avio_write(oc->pb, vs->init_buffer + range_length, size - range_length);
+    if (!hls->resend_init_file)
+        av_freep(&vs->init_buffer);
+    vs->packets_written = 0;
+    vs->start_pos = range_length;
+    if (!byterange_mode) {
+        hlsenc_io_close(s, &vs->out, vs->base_output_dirname);
+    }
+    return 0;
+}
+
+static int hls_write_part_file(AVFormatContext *s, VariantStream *vs,
+                               char *filename, const uint8_t *data, int size)
+{
+    HLSContext *hls = s->priv_data;
+    HLSIOJob job = { .type = HLS_IO_WRITE };
+    AVDictionary *options = NULL;
+    int ret;
+
+    if (hls->io_queue) {
+        job.data = av_memdup(data, size);
+        job.size = size;
+        job.url  = av_strdup(filename);
+        if (!job.data || !job.url) {
+            hls_io_job_free(&job);
+            return AVERROR(ENOMEM);
+        }
+        set_http_options(s, &job.options, hls);
+        return hls_io_submit(hls, &job);
+    }
+
+    set_http_options(s, &options, hls);
+    ret = hlsenc_io_open(s, &vs->part_out, filename, &options);
+    av_dict_free(&options);
+    if (ret < 0) {
+        av_log(s, hls->ignore_io_errors ? AV_LOG_WARNING : AV_LOG_ERROR,
+               "Failed to open file '%s'\n", filename);
+        return hls->ignore_io_errors ? 0 : ret;
+    }
+    avio_write(vs->part_out, data, size);
+    ret = hlsenc_io_close(s, &vs->part_out, filename);
+    return hls->ignore_io_errors ? 0 : ret;
+}
+
+/* Flushes the fragment written since the last part and writes it out as
+ * the next part of the current segment. The segment itself is still
+ * written as a whole once complete. */
+static int hls_flush_part(AVFormatContext *s, VariantStream *vs, double duration)
+{
+    HLSContext *hls = s->priv_data;
+    AVFormatContext *oc = vs->avf;
+    char segment[MAX_URL_SIZE], filename[MAX_URL_SIZE];
+    HLSPart *part;
+    uint8_t *buf;
+    int size, ret;
+
+    av_write_frame(oc, NULL);
+    if (!vs->init_range_length) {
+        /* cut the init segment off the first part */
+        if ((ret = hls_write_init_segment(s, vs)) < 0)
+            return ret;
+        av_write_frame(oc, NULL);
+    }
+
+    size = avio_get_dyn_buf(oc->pb, &buf);
+    if (size <= vs->part_pos)
+        return 0;
+
+    hls_current_segment_name(hls, vs, segment, sizeof(segment), 0);
+    hls_part_filename(filename, sizeof(filename), segment, vs->nb_parts);
+    ret = hls_write_part_file(s, vs, filename, buf + vs->part_pos, size - vs->part_pos);
+    if (ret < 0)
+        return ret;
+
+    part = av_dynarray2_add((void **)&vs->parts, &vs->nb_parts, sizeof(*vs->parts), NULL);
+    if (!part)
+        return AVERROR(ENOMEM);
+    part->duration    = duration;
+    part->independent = vs->part_independent;
+    vs->part_pos = size;
+    vs->part_new = 1;
+
+    return 0;
+}
+
 static int hls_delete_old_segments(AVFormatContext *s, HLSContext *hls,
                                    VariantStream *vs)
 {
@@ -663,9 +1140,17 @@ static int hls_delete_old_segments(AVFormatContext *s, HLSContext *hls,
         }
 
         proto = avio_find_protocol_name(s->url);
-        if (ret = hls_delete_file(hls, vs->avf, path.str, proto))
+        if (ret = hls_delete(hls, vs->avf, path.str, proto))
             goto fail;
 
+        for (int i = 0; i < segment->nb_parts; i++) {
+            char part[MAX_URL_SIZE];
+
+            hls_part_filename(part, sizeof(part), path.str, i);
+            if (ret = hls_delete(hls, vs->avf, part, proto))
+                goto fail;
+        }
+
         if ((segment->sub_filename[0] != '\0')) {
             vtt_dirname_r = av_strdup(vs->vtt_avf->url);
             vtt_dirname = av_dirname(vtt_dirname_r);
@@ -680,12 +1165,13 @@ static int hls_delete_old_segments(AVFormatContext *s, HLSContext *hls,
                 goto fail;
             }
 
-            if (ret = hls_delete_file(hls, vs->vtt_avf, path.str, proto))
+            if (ret = hls_delete(hls, vs->vtt_avf, path.str, proto))
                 goto fail;
         }
         av_bprint_clear(&path);
         previous_segment = segment;
         segment = previous_segment->next;
+        av_freep(&previous_segment->parts);
         av_freep(&previous_segment);
     }
 
@@ -773,7 +1259,7 @@ static int do_encrypt(AVFormatContext *s, VariantStream *vs)
 
         ff_data_to_hex(hls->key_string, key, sizeof(key), 0);
         set_http_options(s, &options, hls);
-        ret = s->io_open(s, &pb, hls->key_file, AVIO_FLAG_WRITE, &options);
+        ret = hls_call_io_open(hls, s, &pb, hls->key_file, AVIO_FLAG_WRITE, &options);
         av_dict_free(&options);
         if (ret < 0)
             return ret;
@@ -794,7 +1280,7 @@ static int hls_encryption_start(AVFormatContext *s,  VariantStream *vs)
     AVDictionary *options = NULL;
 
     set_http_options(s, &options, hls);
-    ret = s->io_open(s, &pb, hls->key_info_file, AVIO_FLAG_READ, &options);
+    ret = hls_call_io_open(hls, s, &pb, hls->key_info_file, AVIO_FLAG_READ, &options);
     av_dict_free(&options);
     if (ret < 0) {
         av_log(hls, AV_LOG_ERROR,
@@ -811,7 +1297,7 @@ static int hls_encryption_start(AVFormatContext *s,  VariantStream *vs)
     ff_get_line(pb, vs->iv_string, sizeof(vs->iv_string));
     vs->iv_string[strcspn(vs->iv_string, "\r\n")] = '\0';
 
-    ff_format_io_close(s, &pb);
+    hls_call_io_close(hls, s, &pb);
 
     if (!*vs->key_uri) {
         av_log(hls, AV_LOG_ERROR, "no key URI specified in key info file\n");
@@ -824,7 +1310,7 @@ static int hls_encryption_start(AVFormatContext *s,  VariantStream *vs)
     }
 
     set_http_options(s, &options, hls);
-    ret = s->io_open(s, &pb, vs->key_file, AVIO_FLAG_READ, &options);
+    ret = hls_call_io_open(hls, s, &pb, vs->key_file, AVIO_FLAG_READ, &options);
     av_dict_free(&options);
     if (ret < 0) {
         av_log(hls, AV_LOG_ERROR, "error opening key file %s\n", vs->key_file);
@@ -832,7 +1318,7 @@ static int hls_encryption_start(AVFormatContext *s,  VariantStream *vs)
     }
 
     ret = avio_read(pb, key, sizeof(key));
-    ff_format_io_close(s, &pb);
+    hls_call_io_close(hls, s, &pb);
     if (ret != sizeof(key)) {
         av_log(hls, AV_LOG_ERROR, "error reading key file %s\n", vs->key_file);
         if (ret >= 0 || ret == AVERROR_EOF)
@@ -1054,7 +1540,7 @@ static int sls_flag_check_duration_size(HLSContext *hls, VariantStream *vs)
 static void sls_flag_file_rename(HLSContext *hls, VariantStream *vs, char *old_filename) {
     if ((hls->flags & (HLS_SECOND_LEVEL_SEGMENT_SIZE | HLS_SECOND_LEVEL_SEGMENT_DURATION)) &&
         strlen(vs->current_segment_final_filename_fmt)) {
-        ff_rename(old_filename, vs->avf->url, hls);
+        hls_rename(hls, old_filename, vs->avf->url, hls);
     }
 }
 
@@ -1149,6 +1635,10 @@ static int hls_append_segment(struct AVFormatContext *s, HLSContext *hls,
     en->next     = NULL;
     en->discont  = 0;
     en->discont_program_date_time = 0;
+    en->parts    = vs->parts;
+    en->nb_parts = vs->nb_parts;
+    vs->parts    = NULL;
+    vs->nb_parts = 0;
 
     if (vs->discontinuity) {
         en->discont = 1;
@@ -1186,8 +1676,10 @@ static int hls_append_segment(struct AVFormatContext *s, HLSContext *hls,
             vs->old_segments = en;
             if ((ret = hls_delete_old_segments(s, hls, vs)) < 0)
                 return ret;
-        } else
+        } else {
+            av_freep(&en->parts);
             av_freep(&en);
+        }
     } else
         vs->nb_entries++;
 
@@ -1317,12 +1809,14 @@ static void hls_free_segments(HLSSegment *p)
     while (p) {
         en = p;
         p = p->next;
+        av_freep(&en->parts);
         av_freep(&en);
     }
 }
 
 static int hls_rename_temp_file(AVFormatContext *s, AVFormatContext *oc)
 {
+    HLSContext *hls = s->priv_data;
     size_t len = strlen(oc->url);
     char *final_filename = av_strdup(oc->url);
     int ret;
@@ -1330,7 +1824,7 @@ static int hls_rename_temp_file(AVFormatContext *s, AVFormatContext *oc)
     if (!final_filename)
         return AVERROR(ENOMEM);
     final_filename[len-4] = '\0';
-    ret = ff_rename(oc->url, final_filename, s);
+    ret = hls_rename(hls, oc->url, final_filename, s);
     oc->url[len-4] = '\0';
     av_freep(&final_filename);
     return ret;
@@ -1406,7 +1900,7 @@ static int create_master_playlist(AVFormatContext *s,
 
     set_http_options(s, &options, hls);
     snprintf(temp_filename, sizeof(temp_filename), use_temp_file ? "%s.tmp" : "%s", hls->master_m3u8_url);
-    ret = hlsenc_io_open(s, &hls->m3u8_out, temp_filename, &options);
+    ret = hls_playlist_open(s, &hls->m3u8_out, temp_filename, &options);
     av_dict_free(&options);
     if (ret < 0) {
         av_log(s, AV_LOG_ERROR, "Failed to open master play list file '%s'\n",
@@ -1531,9 +2025,9 @@ static int create_master_playlist(AVFormatContext *s,
 fail:
     if (ret >=0)
         hls->master_m3u8_created = 1;
-    hlsenc_io_close(s, &hls->m3u8_out, temp_filename);
+    hls_playlist_close(s, &hls->m3u8_out, temp_filename);
     if (use_temp_file)
-        ff_rename(temp_filename, hls->master_m3u8_url, s);
+        hls_rename(hls, temp_filename, hls->master_m3u8_url, s);
 
     return ret;
 }
@@ -1557,6 +2051,9 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
     double prog_date_time = vs->initial_prog_date_time;
     double *prog_date_time_p = (hls->flags & HLS_PROGRAM_DATE_TIME) ? &prog_date_time : NULL;
     int byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
+    int part_mode = hls->part_time > 0 && !last;
+    double part_target = (double)hls->part_time / AV_TIME_BASE;
+    double parts_start = 0, seg_start = 0;
 
     hls->version = 3;
     if (byterange_mode) {
@@ -1581,7 +2078,7 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
 
     set_http_options(s, &options, hls);
     snprintf(temp_filename, sizeof(temp_filename), use_temp_file ? "%s.tmp" : "%s", vs->m3u8_name);
-    if ((ret = hlsenc_io_open(s, byterange_mode ? &hls->m3u8_out : &vs->out, temp_filename, &options)) < 0) {
+    if ((ret = hls_playlist_open(s, byterange_mode ? &hls->m3u8_out : &vs->out, temp_filename, &options)) < 0) {
         if (hls->ignore_io_errors)
             ret = 0;
         goto fail;
@@ -1590,11 +2087,19 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
     for (en = vs->segments; en; en = en->next) {
         if (target_duration <= en->duration)
             target_duration = lrint(en->duration);
+        parts_start += en->duration;
     }
+    /* before the first segment is complete, only its parts are listed */
+    if (part_mode && !vs->segments)
+        target_duration = lrint((double)(hls->init_time ? hls->init_time : hls->time) / AV_TIME_BASE);
+    /* parts are only listed for the last three target durations */
+    parts_start -= 3 * target_duration;
 
     vs->discontinuity_set = 0;
     ff_hls_write_playlist_header(byterange_mode ? hls->m3u8_out : vs->out, hls->version, hls->allowcache,
                                  target_duration, sequence, hls->pl_type, hls->flags & HLS_I_FRAMES_ONLY);
+    if (part_mode)
+        ff_hls_write_part_info(vs->out, part_target);
 
     if ((hls->flags & HLS_DISCONT_START) && sequence==hls->start_sequence && vs->discontinuity_set==0) {
         avio_printf(byterange_mode ? hls->m3u8_out : vs->out, "#EXT-X-DISCONTINUITY\n");
@@ -1619,6 +2124,17 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
                                    hls->flags & HLS_SINGLE_FILE, vs->init_range_length, 0);
         }
 
+        if (part_mode && seg_start + en->duration > parts_start) {
+            for (int i = 0; i < en->nb_parts; i++) {
+                char part[MAX_URL_SIZE];
+
+                hls_part_filename(part, sizeof(part), en->filename, i);
+                ff_hls_write_part(vs->out, en->parts[i].duration, hls->baseurl,
+                                  part, en->parts[i].independent);
+            }
+        }
+        seg_start += en->duration;
+
         ret = ff_hls_write_file_entry(byterange_mode ? hls->m3u8_out : vs->out, en->discont, byterange_mode,
                                       en->duration, hls->flags & HLS_ROUND_DURATIONS,
                                       en->size, en->pos, hls->baseurl,
@@ -1632,12 +2148,29 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
         }
     }
 
+    /* The parts of the segment being written. Right after a segment boundary
+     * the next segment is not opened yet, so there is no hint to give. */
+    if (part_mode && vs->nb_parts) {
+        char segment[MAX_URL_SIZE], part[MAX_URL_SIZE];
+
+        hls_current_segment_name(hls, vs, segment, sizeof(segment), 1);
+        if (!vs->segments)
+            ff_hls_write_init_file(vs->out, vs->fmp4_init_filename, 0, 0, 0);
+        for (int i = 0; i < vs->nb_parts; i++) {
+            hls_part_filename(part, sizeof(part), segment, i);
+            ff_hls_write_part(vs->out, vs->parts[i].duration, hls->baseurl,
+                              part, vs->parts[i].independent);
+        }
+        hls_part_filename(part, sizeof(part), segment, vs->nb_parts);
+        ff_hls_write_preload_hint(vs->out, hls->baseurl, part);
+    }
+
     if (last && (hls->flags & HLS_OMIT_ENDLIST)==0)
         ff_hls_write_end_list(byterange_mode ? hls->m3u8_out : vs->out);
 
     if (vs->vtt_m3u8_name) {
         snprintf(temp_vtt_filename, sizeof(temp_vtt_filename), use_temp_file ? "%s.tmp" : "%s", vs->vtt_m3u8_name);
-        if ((ret = hlsenc_io_open(s, &hls->sub_m3u8_out, temp_vtt_filename, &options)) < 0) {
+        if ((ret = hls_playlist_open(s, &hls->sub_m3u8_out, temp_vtt_filename, &options)) < 0) {
             if (hls->ignore_io_errors)
                 ret = 0;
             goto fail;
@@ -1660,15 +2193,16 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
 
 fail:
     av_dict_free(&options);
-    ret = hlsenc_io_close(s, byterange_mode ? &hls->m3u8_out : &vs->out, temp_filename);
+    ret = hls_playlist_close(s, byterange_mode ? &hls->m3u8_out : &vs->out, temp_filename);
     if (ret < 0) {
         return ret;
     }
-    hlsenc_io_close(s, &hls->sub_m3u8_out, vs->vtt_m3u8_name);
+    hls_playlist_close(s, &hls->sub_m3u8_out,
+                       hls->io_queue ? temp_vtt_filename : vs->vtt_m3u8_name);
     if (use_temp_file) {
-        ff_rename(temp_filename, vs->m3u8_name, s);
+        hls_rename(hls, temp_filename, vs->m3u8_name, s);
         if (vs->vtt_m3u8_name)
-            ff_rename(temp_vtt_filename, vs->vtt_m3u8_name, s);
+            hls_rename(hls, temp_vtt_filename, vs->vtt_m3u8_name, s);
     }
     if (ret >= 0 && hls->master_pl_name)
         if (create_master_playlist(s, vs) < 0)
@@ -2385,6 +2919,7 @@ static int hls_init_file_resend(AVFormatContext *s, VariantStream *vs)
 
 static int64_t append_single_file(AVFormatContext *s, VariantStream *vs)
 {
+    HLSContext *hls = s->priv_data;
     int ret = 0;
     int64_t read_byte = 0;
     int64_t total_size = 0;
@@ -2394,7 +2929,7 @@ static int64_t append_single_file(AVFormatContext *s, VariantStream *vs)
 
     hlsenc_io_close(s, &vs->out, vs->basename_tmp);
     filename = av_asprintf("%s.tmp", oc->url);
-    ret = s->io_open(s, &vs->out, filename, AVIO_FLAG_READ, NULL);
+    ret = hls_call_io_open(hls, s, &vs->out, filename, AVIO_FLAG_READ, NULL);
     if (ret < 0) {
         av_free(filename);
         return ret;
@@ -2506,25 +3041,23 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
         int64_t new_start_pos;
         int byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
 
+        if (hls->part_time > 0) {
+            /* the last part of the segment */
+            ret = hls_flush_part(s, vs, (double)(pkt->pts - vs->part_start_pts)
+                                        * st->time_base.num / st->time_base.den);
+            if (ret < 0)
+                return ret;
+            vs->part_start_pts = pkt->pts;
+        }
+
         av_write_frame(oc, NULL); /* Flush any buffered data */
         new_start_pos = avio_tell(oc->pb);
         vs->size = new_start_pos - vs->start_pos;
         avio_flush(oc->pb);
         if (hls->segment_type == SEGMENT_TYPE_FMP4) {
             if (!vs->init_range_length) {
-                range_length = avio_close_dyn_buf(oc->pb, &vs->init_buffer);
-                if (range_length <= 0)
-                    return AVERROR(EINVAL);
-                avio_write(vs->out, vs->init_buffer, range_length);
-                if (!hls->resend_init_file)
-                    av_freep(&vs->init_buffer);
-                vs->init_range_length = range_length;
-                avio_open_dyn_buf(&oc->pb);
-                vs->packets_written = 0;
-                vs->start_pos = range_length;
-                if (!byterange_mode) {
-                    hlsenc_io_close(s, &vs->out, vs->base_output_dirname);
-                }
+                if ((ret = hls_write_init_segment(s, vs)) < 0)
+                    return ret;
             }
         }
         if (!byterange_mode) {
@@ -2570,35 +3103,45 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
 
                 set_http_options(s, &options, hls);
 
-                ret = hlsenc_io_open(s, &vs->out, filename, &options);
-                if (ret < 0) {
-                    av_log(s, hls->ignore_io_errors ? AV_LOG_WARNING : AV_LOG_ERROR,
-                           "Failed to open file '%s'\n", filename);
-                    av_freep(&filename);
+                if (hls->io_queue) {
+                    ret = hls_io_write_segment(s, vs, filename, options);
                     av_dict_free(&options);
-                    return hls->ignore_io_errors ? 0 : ret;
-                }
-                if (hls->segment_type == SEGMENT_TYPE_FMP4) {
-                    write_styp(vs->out);
-                }
-                ret = flush_dynbuf(vs, &range_length);
-                if (ret < 0) {
                     av_freep(&filename);
-                    av_dict_free(&options);
-                    return ret;
-                }
-                ret = hlsenc_io_close(s, &vs->out, filename);
-                if (ret < 0) {
-                    av_log(s, AV_LOG_WARNING, "upload segment failed,"
-                           " will retry with a new http session.\n");
-                    ff_format_io_close(s, &vs->out);
+                    if (ret < 0)
+                        return ret;
+                } else {
                     ret = hlsenc_io_open(s, &vs->out, filename, &options);
-                    reflush_dynbuf(vs, &range_length);
+                    if (ret < 0) {
+                        av_log(s, hls->ignore_io_errors ? AV_LOG_WARNING : AV_LOG_ERROR,
+                               "Failed to open file '%s'\n", filename);
+                        av_freep(&filename);
+                        av_dict_free(&options);
+                        return hls->ignore_io_errors ? 0 : ret;
+                    }
+                    if (hls->segment_type == SEGMENT_TYPE_FMP4) {
+                        write_styp(vs->out);
+                    }
+                    ret = flush_dynbuf(vs, &range_length);
+                    if (ret < 0) {
+                        av_freep(&filename);
+                        av_dict_free(&options);
+                        return ret;
+                    }
                     ret = hlsenc_io_close(s, &vs->out, filename);
+                    if (ret < 0) {
+                        av_log(s, AV_LOG_WARNING, "upload segment failed,"
+                               " will retry with a new http session.\n");
+                        hls_call_io_close(hls, s, &vs->out);
+                        ret = hlsenc_io_open(s, &vs->out, filename, &options);
+                        reflush_dynbuf(vs, &range_length);
+                        ret = hlsenc_io_close(s, &vs->out, filename);
+                    }
+                    av_dict_free(&options);
+                    av_freep(&vs->temp_buffer);
+                    av_freep(&filename);
                 }
-                av_dict_free(&options);
-                av_freep(&vs->temp_buffer);
-                av_freep(&filename);
+                /* the segment buffer was reopened */
+                vs->part_pos = 0;
             }
 
             if (use_temp_file)
@@ -2625,7 +3168,7 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
         if (hls->pl_type != PLAYLIST_TYPE_VOD) {
             if ((ret = hls_window(s, 0, vs)) < 0) {
                 av_log(s, AV_LOG_WARNING, "upload playlist failed, will retry with a new http session.\n");
-                ff_format_io_close(s, &vs->out);
+                hls_call_io_close(hls, s, &vs->out);
                 if ((ret = hls_window(s, 0, vs)) < 0) {
                     av_freep(&old_filename);
                     return ret;
@@ -2670,6 +3213,28 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
 
     }
 
+    if (hls->part_time > 0 && is_ref_pkt) {
+        if (vs->part_start_pts == AV_NOPTS_VALUE)
+            vs->part_start_pts = pkt->pts;
+        /* cut before the part would exceed the part target duration */
+        if (vs->packets_written && !vs->part_new &&
+            av_compare_ts(pkt->pts + pkt->duration - vs->part_start_pts, st->time_base,
+                          hls->part_time, AV_TIME_BASE_Q) > 0) {
+            ret = hls_flush_part(s, vs, (double)(pkt->pts - vs->part_start_pts)
+                                        * st->time_base.num / st->time_base.den);
+            if (ret < 0)
+                return ret;
+            vs->part_start_pts = pkt->pts;
+            /* publish the new part */
+            if (hls->pl_type != PLAYLIST_TYPE_VOD && (ret = hls_window(s, 0, vs)) < 0)
+                return ret;
+        }
+        if (vs->part_new) {
+            vs->part_new = 0;
+            vs->part_independent = !vs->has_video || (pkt->flags & AV_PKT_FLAG_KEY);
+        }
+    }
+
     vs->packets_written++;
     if (oc->pb) {
         int64_t keyframe_pre_pos = avio_tell(oc->pb);
@@ -2693,6 +3258,8 @@ static void hls_deinit(AVFormatContext *s)
     int i = 0;
     VariantStream *vs = NULL;
 
+    hls_io_stop(s, 1);
+
     for (i = 0; i < hls->nb_varstreams; i++) {
         vs = &hls->var_streams[i];
 
@@ -2708,12 +3275,14 @@ static void hls_deinit(AVFormatContext *s)
             av_freep(&vs->init_buffer);
         hls_free_segments(vs->segments);
         hls_free_segments(vs->old_segments);
+        av_freep(&vs->parts);
+        hls_call_io_close(hls, s, &vs->part_out);
         av_freep(&vs->m3u8_name);
         av_freep(&vs->streams);
     }
 
-    ff_format_io_close(s, &hls->m3u8_out);
-    ff_format_io_close(s, &hls->sub_m3u8_out);
+    hls_call_io_close(hls, s, &hls->m3u8_out);
+    hls_call_io_close(hls, s, &hls->sub_m3u8_out);
     av_freep(&hls->key_basename);
     av_freep(&hls->var_streams);
     av_freep(&hls->cc_streams);
@@ -2733,6 +3302,8 @@ static int hls_write_trailer(struct AVFormatContext *s)
     VariantStream *vs = NULL;
     AVDictionary *options = NULL;
     int range_length, byterange_mode;
+    /* finish the pending writes first, the rest is written synchronously */
+    int io_ret = hls_io_stop(s, 0);
 
     for (i = 0; i < hls->nb_varstreams; i++) {
         char *filename = NULL;
@@ -2757,22 +3328,35 @@ static int hls_write_trailer(struct AVFormatContext *s)
             return AVERROR(ENOMEM);
         }
 
+        if (hls->part_time > 0 && vs->packets_written) {
+            /* the last part, the preload hint of the last playlist points to it */
+            double duration = vs->duration + vs->dpp;
+            for (int j = 0; j < vs->nb_parts; j++)
+                duration -= vs->parts[j].duration;
+            ret = hls_flush_part(s, vs, duration);
+            if (ret < 0)
+                av_log(s, AV_LOG_WARNING, "Failed to write the last part of '%s'\n", oc->url);
+        }
+
         if (hls->segment_type == SEGMENT_TYPE_FMP4) {
             int range_length = 0;
             if (!vs->init_range_length) {
                 uint8_t *buffer = NULL;
+                int size;
                 av_write_frame(oc, NULL); /* Flush any buffered data */
 
-                range_length = avio_close_dyn_buf(oc->pb, &buffer);
+                size = avio_close_dyn_buf(oc->pb, &buffer);
+                range_length = hls_init_segment_size(buffer, size);
                 avio_write(vs->out, buffer, range_length);
-                av_freep(&buffer);
                 vs->init_range_length = range_length;
                 avio_open_dyn_buf(&oc->pb);
+                avio_write(oc->pb, buffer + range_length, size - range_length);
+                av_freep(&buffer);
                 vs->packets_written = 0;
                 vs->start_pos = range_length;
                 byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
                 if (!byterange_mode) {
-                    ff_format_io_close(s, &vs->out);
+                    hls_call_io_close(hls, s, &vs->out);
                     hlsenc_io_close(s, &vs->out, vs->base_output_dirname);
                 }
             }
@@ -2795,7 +3379,7 @@ static int hls_write_trailer(struct AVFormatContext *s)
         ret = hlsenc_io_close(s, &vs->out, filename);
         if (ret < 0) {
             av_log(s, AV_LOG_WARNING, "upload segment failed, will retry with a new http session.\n");
-            ff_format_io_close(s, &vs->out);
+            hls_call_io_close(hls, s, &vs->out);
             ret = hlsenc_io_open(s, &vs->out, filename, &options);
             if (ret < 0) {
                 av_log(s, AV_LOG_ERROR, "Failed to open file '%s'\n", oc->url);
@@ -2842,12 +3426,12 @@ failed:
             if (vtt_oc->pb)
                 av_write_trailer(vtt_oc);
             vs->size = avio_tell(vs->vtt_avf->pb) - vs->start_pos;
-            ff_format_io_close(s, &vtt_oc->pb);
+            hls_call_io_close(hls, s, &vtt_oc->pb);
         }
         ret = hls_window(s, 1, vs);
         if (ret < 0) {
             av_log(s, AV_LOG_WARNING, "upload playlist failed, will retry with a new http session.\n");
-            ff_format_io_close(s, &vs->out);
+            hls_call_io_close(hls, s, &vs->out);
             hls_window(s, 1, vs);
         }
         ffio_free_dyn_buf(&oc->pb);
@@ -2855,7 +3439,7 @@ failed:
         av_free(old_filename);
     }
 
-    return 0;
+    return io_ret;
 }
 
 
@@ -2955,6 +3539,24 @@ static int hls_init(AVFormatContext *s)
                "enabled together. Disabling 'independent_segments' flag\n");
     }
 
+    if (hls->part_time > 0) {
+        if (hls->segment_type != SEGMENT_TYPE_FMP4 ||
+            (hls->flags & HLS_SINGLE_FILE) || hls->max_seg_size > 0) {
+            av_log(s, AV_LOG_ERROR, "hls_part_time requires fmp4 segments "
+                   "written to separate files\n");
+            return AVERROR(EINVAL);
+        }
+        if (hls->flags & (HLS_SECOND_LEVEL_SEGMENT_SIZE | HLS_SECOND_LEVEL_SEGMENT_DURATION)) {
+            av_log(s, AV_LOG_ERROR, "hls_part_time cannot be used with "
+                   "second_level_segment_size or second_level_segment_duration\n");
+            return AVERROR(EINVAL);
+        }
+        if (hls->part_time >= FFMIN(hls->time, hls->init_time ? hls->init_time : INT64_MAX)) {
+            av_log(s, AV_LOG_ERROR, "hls_part_time must be shorter than hls_time\n");
+            return AVERROR(EINVAL);
+        }
+    }
+
     for (i = 0; i < hls->nb_varstreams; i++) {
         vs = &hls->var_streams[i];
 
@@ -2965,6 +3567,8 @@ static int hls_init(AVFormatContext *s)
         vs->sequence  = hls->start_sequence;
         vs->start_pts = AV_NOPTS_VALUE;
         vs->end_pts   = AV_NOPTS_VALUE;
+        vs->part_start_pts = AV_NOPTS_VALUE;
+        vs->part_new  = 1;
         vs->current_segment_final_filename_fmt[0] = '\0';
         vs->initial_prog_date_time = initial_program_date_time;
 
@@ -3107,6 +3711,9 @@ static int hls_init(AVFormatContext *s)
         vs->number++;
     }
 
+    if (hls->async_io)
+        ret = hls_io_start(s);
+
     return ret;
 }
 
@@ -3116,6 +3723,7 @@ static const AVOption options[] = {
     {"start_number",  "set first number in the sequence",        OFFSET(start_sequence),AV_OPT_TYPE_INT64,  {.i64 = 0},     0, INT64_MAX, E},
     {"hls_time",      "set segment length",                      OFFSET(time),          AV_OPT_TYPE_DURATION, {.i64 = 2000000}, 0, INT64_MAX, E},
     {"hls_init_time", "set segment length at init list",         OFFSET(init_time),     AV_OPT_TYPE_DURATION, {.i64 = 0},       0, INT64_MAX, E},
+    {"hls_part_time", "set partial segment length for low latency HLS", OFFSET(part_time), AV_OPT_TYPE_DURATION, {.i64 = 0},   0, INT64_MAX, E},
     {"hls_list_size", "set maximum number of playlist entries",  OFFSET(max_nb_segments),    AV_OPT_TYPE_INT,    {.i64 = 5},     0, INT_MAX, E},
     {"hls_delete_threshold", "set number of unreferenced segments to keep before deleting",  OFFSET(hls_delete_threshold),    AV_OPT_TYPE_INT,    {.i64 = 1},     1, INT_MAX, E},
     {"hls_ts_options","set hls mpegts list of options for the container format used for hls", OFFSET(format_options), AV_OPT_TYPE_DICT, {.str = NULL},  0, 0,    E},
@@ -3180,6 +3788,8 @@ static const AVOption options[] = {
     {"timeout", "set timeout for socket I/O operations", OFFSET(timeout), AV_OPT_TYPE_DURATION, { .i64 = -1 }, -1, INT_MAX, .flags = E },
     {"ignore_io_errors", "Ignore IO errors for stable long-duration runs with network output", OFFSET(ignore_io_errors), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, E },
     {"headers", "set custom HTTP headers, can override built in default headers", OFFSET(headers), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, E },
+    {"async_io", "Write segments and playlists from a separate thread", OFFSET(async_io), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, E },
+    {"async_io_queue_size", "Set the maximum number of pending writes in async_io mode", OFFSET(async_io_queue_size), AV_OPT_TYPE_INT, { .i64 = 16 }, 1, INT_MAX, E },
     { NULL },
 };
 
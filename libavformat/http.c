@@ -29,6 +29,7 @@
 #include "libavutil/avstring.h"
 #include "libavutil/bprint.h"
 #include "libavutil/opt.h"
+#include "libavutil/thread.h"
 #include "libavutil/time.h"
 #include "libavutil/parseutils.h"
 
@@ -51,6 +52,8 @@
 #define HTTP_SINGLE   1
 #define HTTP_MUTLI    2
 #define MAX_EXPIRY    19
+#define POOL_MAX_IDLE     32
+#define POOL_IDLE_TIMEOUT (30 * 1000000)
 #define WHITESPACES " \n\t\r"
 typedef enum {
     LOWER_PROTO,
@@ -69,6 +72,8 @@ typedef struct HTTPContext {
     uint64_t chunksize;
     int chunkend;
     uint64_t off, end_off, filesize;
+    /* End of the range returned in Content-Range, 0 if none. */
+    uint64_t range_end;
     char *location;
     HTTPAuthState auth_state;
     HTTPAuthState proxy_auth_state;
@@ -93,6 +98,16 @@ typedef struct HTTPContext {
     int end_header;
     /* A flag which indicates if we use persistent connections. */
     int multiple_requests;
+    /* Share persistent connections through the process-wide pool. */
+    int connection_pool;
+    int pool_ref;
+    char *pool_key;
+    /* Request sent ahead on the connection by ff_http_pipeline_request(). */
+    char *pipeline_location;
+    uint64_t pipeline_off, pipeline_end_off;
+    int pipeline_sending;
+    /* Set if the next reply to read is the one of the pipelined request. */
+    int pipeline_reply;
     uint8_t *post_data;
     int post_datalen;
     int is_akamai;
@@ -127,6 +142,7 @@ typedef struct HTTPContext {
     char *resource;
     int reply_code;
     int is_multi_client;
+    int keep_alive;       /* the client connection may serve the next request */
     HandshakeState handshake_step;
     int is_connected_server;
 } HTTPContext;
@@ -148,6 +164,7 @@ static const AVOption options[] = {
     { "user-agent", "use the \"user_agent\" option instead", OFFSET(user_agent_deprecated), AV_OPT_TYPE_STRING, { .str = DEFAULT_USER_AGENT }, 0, 0, D|AV_OPT_FLAG_DEPRECATED },
 #endif
     { "multiple_requests", "use persistent connections", OFFSET(multiple_requests), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, D | E },
+    { "connection_pool", "share persistent connections with other http contexts", OFFSET(connection_pool), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, D },
     { "post_data", "set custom HTTP post data", OFFSET(post_data), AV_OPT_TYPE_BINARY, .flags = D | E },
     { "mime_type", "export the MIME type", OFFSET(mime_type), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
     { "http_version", "export the http response version", OFFSET(http_version), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
@@ -192,6 +209,207 @@ void ff_http_init_auth_state(URLContext *dest, const URLContext *src)
            sizeof(HTTPAuthState));
 }
 
+/* Idle persistent connections, shared by all contexts with connection_pool
+ * set. Connections are keyed by their lower protocol URL, so by host, port
+ * and TLS, along with the TLS options they were established with and the
+ * protocol white/blacklists of the context that opened them. The pool is
+ * emptied when its last user releases it. */
+typedef struct HTTPPoolEntry {
+    struct HTTPPoolEntry *next;
+    URLContext *hd;
+    char *key;
+    int64_t expiry;
+} HTTPPoolEntry;
+
+static AVMutex pool_mutex = AV_MUTEX_INITIALIZER;
+static HTTPPoolEntry *pool_entries;
+static int pool_nb_entries;
+static int pool_nb_users;
+
+static char *pool_make_key(URLContext *h, const char *lower_url, AVDictionary *options)
+{
+    static const char *const tls_options[] = {
+        "ca_file", "cafile", "tls_verify", "cert_file", "key_file", "verifyhost", NULL
+    };
+    const char *const *opt;
+    AVBPrint key;
+    char *str;
+
+    av_bprint_init(&key, 0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprintf(&key, "%s", lower_url);
+    if (av_strstart(lower_url, "tls:", NULL)) {
+        for (opt = tls_options; *opt; opt++) {
+            AVDictionaryEntry *e = av_dict_get(options, *opt, NULL, 0);
+            if (e)
+                av_bprintf(&key, "|%s=%s", e->key, e->value);
+        }
+    }
+    av_bprintf(&key, "|whitelist=%s|blacklist=%s",
+               h->protocol_whitelist ? h->protocol_whitelist : "",
+               h->protocol_blacklist ? h->protocol_blacklist : "");
+    if (!av_bprint_is_complete(&key)) {
+        av_bprint_finalize(&key, NULL);
+        return NULL;
+    }
+    av_bprint_finalize(&key, &str);
+    return str;
+}
+
+static void pool_free_entry(HTTPPoolEntry *entry)
+{
+    ffurl_closep(&entry->hd);
+    av_free(entry->key);
+    av_free(entry);
+}
+
+/* Check that an idle connection has not been closed by the server, in
+ * which case it would be readable. */
+static int pool_connection_alive(URLContext *hd)
+{
+    struct pollfd p = { .fd = ffurl_get_file_handle(hd), .events = POLLIN };
+
+    if (p.fd < 0)
+        return 1;
+    return !poll(&p, 1, 0);
+}
+
+static void pool_free_entries(HTTPPoolEntry *entry)
+{
+    while (entry) {
+        HTTPPoolEntry *next = entry->next;
+        pool_free_entry(entry);
+        entry = next;
+    }
+}
+
+/* Unlink the expired entries, and the first one matching key if found is
+ * set. Must be called with pool_mutex held. */
+static HTTPPoolEntry *pool_remove_expired(const char *key, HTTPPoolEntry **found)
+{
+    HTTPPoolEntry **p = &pool_entries, *expired = NULL;
+    int64_t now = av_gettime_relative();
+
+    while (*p) {
+        HTTPPoolEntry *entry = *p;
+        if (entry->expiry < now || (found && !*found && !strcmp(entry->key, key))) {
+            *p = entry->next;
+            pool_nb_entries--;
+            if (entry->expiry < now) {
+                entry->next = expired;
+                expired     = entry;
+            } else {
+                *found = entry;
+            }
+        } else {
+            p = &entry->next;
+        }
+    }
+    return expired;
+}
+
+static URLContext *pool_get(URLContext *h, const char *key)
+{
+    HTTPPoolEntry *expired, *found = NULL;
+
+    ff_mutex_lock(&pool_mutex);
+    expired = pool_remove_expired(key, &found);
+    ff_mutex_unlock(&pool_mutex);
+
+    pool_free_entries(expired);
+    if (found) {
+        URLContext *hd = found->hd;
+        found->hd = NULL;
+        pool_free_entry(found);
+        if (!pool_connection_alive(hd)) {
+            ffurl_close(hd);
+            return NULL;
+        }
+        hd->interrupt_callback = h->interrupt_callback;
+        av_log(h, AV_LOG_DEBUG, "Reusing pooled connection to %s\n", key);
+        return hd;
+    }
+    return NULL;
+}
+
+/* Takes ownership of hd. */
+static void pool_put(const char *key, URLContext *hd)
+{
+    HTTPPoolEntry *entry, *expired;
+
+    /* The callback may refer to a context that is about to be freed. */
+    hd->interrupt_callback = (AVIOInterruptCB){ NULL };
+
+    entry = av_mallocz(sizeof(*entry));
+    if (!entry || !(entry->key = av_strdup(key))) {
+        av_free(entry);
+        ffurl_close(hd);
+        return;
+    }
+    entry->hd     = hd;
+    entry->expiry = av_gettime_relative() + POOL_IDLE_TIMEOUT;
+
+    ff_mutex_lock(&pool_mutex);
+    expired = pool_remove_expired(NULL, NULL);
+    if (pool_nb_users && pool_nb_entries < POOL_MAX_IDLE) {
+        entry->next  = pool_entries;
+        pool_entries = entry;
+        pool_nb_entries++;
+        entry = NULL;
+    }
+    ff_mutex_unlock(&pool_mutex);
+
+    pool_free_entries(expired);
+    if (entry)
+        pool_free_entry(entry);
+}
+
+void ff_http_pool_ref(void)
+{
+    ff_mutex_lock(&pool_mutex);
+    pool_nb_users++;
+    ff_mutex_unlock(&pool_mutex);
+}
+
+void ff_http_pool_unref(void)
+{
+    HTTPPoolEntry *entries = NULL;
+
+    ff_mutex_lock(&pool_mutex);
+    av_assert0(pool_nb_users > 0);
+    if (!--pool_nb_users) {
+        entries         = pool_entries;
+        pool_entries    = NULL;
+        pool_nb_entries = 0;
+    }
+    ff_mutex_unlock(&pool_mutex);
+
+    pool_free_entries(entries);
+}
+
+/* Check whether the whole reply has been read, so that the connection can
+ * carry another request. */
+static int http_reply_complete(HTTPContext *s)
+{
+    if (!s->hd || s->willclose)
+        return 0;
+    if (s->chunksize != UINT64_MAX)
+        return s->chunkend;
+    if (s->filesize == UINT64_MAX)
+        return 0;
+    return s->off == (s->range_end ? s->range_end : s->filesize);
+}
+
+/* Whether the request of a server client has been read entirely, leaving
+ * nothing of the next one in the buffer. */
+static int http_request_consumed(HTTPContext *s)
+{
+    if (s->buf_ptr != s->buf_end)
+        return 0;
+    if (s->chunksize != UINT64_MAX)
+        return s->chunkend;
+    return s->filesize == UINT64_MAX || s->off >= s->filesize;
+}
+
 static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
 {
     const char *path, *proxy_path, *lower_proto = "tcp", *local_path;
@@ -200,8 +418,9 @@ static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
     char auth[1024], proxyauth[1024] = "";
     char path1[MAX_URL_SIZE], sanitized_path[MAX_URL_SIZE];
     char buf[1024], urlbuf[MAX_URL_SIZE];
-    int port, use_proxy, err, location_changed = 0;
+    int port, use_proxy, err, location_changed = 0, pooled = 0;
     HTTPContext *s = h->priv_data;
+    uint64_t off = s->off;
 
     av_url_split(proto, sizeof(proto), auth, sizeof(auth),
                  hostname, sizeof(hostname), &port,
@@ -247,15 +466,38 @@ static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
     ff_url_join(buf, sizeof(buf), lower_proto, NULL, hostname, port, NULL);
 
     if (!s->hd) {
+        av_freep(&s->pool_key);
+        if (s->connection_pool && s->multiple_requests && !s->listen) {
+            s->pool_key = pool_make_key(h, buf, *options);
+            if (s->pool_key && (s->hd = pool_get(h, s->pool_key))) {
+                pooled = 1;
+                s->line_count = 0;
+            }
+        }
+        if (!s->hd) {
+            err = ffurl_open_whitelist(&s->hd, buf, AVIO_FLAG_READ_WRITE,
+                                       &h->interrupt_callback, options,
+                                       h->protocol_whitelist, h->protocol_blacklist, h);
+            if (err < 0)
+                return err;
+        }
+    }
+
+    err = http_connect(h, path, local_path, hoststr,
+                       auth, proxyauth, &location_changed);
+    if (err < 0 && pooled && !s->line_count && err != AVERROR_EXIT) {
+        /* The server closed the idle connection before our request. */
+        av_log(h, AV_LOG_DEBUG, "Pooled connection failed, reconnecting\n");
+        ffurl_closep(&s->hd);
+        s->off = off;
         err = ffurl_open_whitelist(&s->hd, buf, AVIO_FLAG_READ_WRITE,
                                    &h->interrupt_callback, options,
                                    h->protocol_whitelist, h->protocol_blacklist, h);
         if (err < 0)
             return err;
+        err = http_connect(h, path, local_path, hoststr,
+                           auth, proxyauth, &location_changed);
     }
-
-    err = http_connect(h, path, local_path, hoststr,
-                       auth, proxyauth, &location_changed);
     if (err < 0)
         return err;
 
@@ -386,15 +628,9 @@ int ff_http_get_shutdown_status(URLContext *h)
     return ret;
 }
 
-int ff_http_do_new_request(URLContext *h, const char *uri) {
-    return ff_http_do_new_request2(h, uri, NULL);
-}
-
-int ff_http_do_new_request2(URLContext *h, const char *uri, AVDictionary **opts)
+static int http_check_reuse(URLContext *h, const char *uri)
 {
     HTTPContext *s = h->priv_data;
-    AVDictionary *options = NULL;
-    int ret;
     char hostname1[1024], hostname2[1024], proto1[10], proto2[10];
     int port1, port2;
 
@@ -416,6 +652,21 @@ int ff_http_do_new_request2(URLContext *h, const char *uri, AVDictionary **opts)
         );
         return AVERROR(EINVAL);
     }
+    return 0;
+}
+
+int ff_http_do_new_request(URLContext *h, const char *uri) {
+    return ff_http_do_new_request2(h, uri, NULL);
+}
+
+int ff_http_do_new_request2(URLContext *h, const char *uri, AVDictionary **opts)
+{
+    HTTPContext *s = h->priv_data;
+    AVDictionary *options = NULL;
+    int ret, complete;
+
+    if ((ret = http_check_reuse(h, uri)) < 0)
+        return ret;
 
     if (!s->end_chunked_post) {
         ret = http_shutdown(h, h->flags);
@@ -426,6 +677,8 @@ int ff_http_do_new_request2(URLContext *h, const char *uri, AVDictionary **opts)
     if (s->willclose)
         return AVERROR_EOF;
 
+    complete = http_reply_complete(s);
+
     s->end_chunked_post = 0;
     s->chunkend      = 0;
     s->off           = 0;
@@ -438,12 +691,71 @@ int ff_http_do_new_request2(URLContext *h, const char *uri, AVDictionary **opts)
     if ((ret = av_opt_set_dict(s, opts)) < 0)
         return ret;
 
+    if (s->pipeline_location) {
+        s->pipeline_reply = complete &&
+                            !strcmp(s->pipeline_location, s->location) &&
+                            s->pipeline_off     == s->off &&
+                            s->pipeline_end_off == s->end_off;
+        av_freep(&s->pipeline_location);
+        /* The pending reply cannot be skipped, use a new connection. */
+        if (!s->pipeline_reply)
+            ffurl_closep(&s->hd);
+    }
+
     av_log(s, AV_LOG_INFO, "Opening \'%s\' for %s\n", uri, h->flags & AVIO_FLAG_WRITE ? "writing" : "reading");
     ret = http_open_cnx(h, &options);
     av_dict_free(&options);
     return ret;
 }
 
+int ff_http_pipeline_request(URLContext *h, const char *uri,
+                             uint64_t off, uint64_t end_off)
+{
+    HTTPContext *s = h->priv_data;
+    AVDictionary *options = NULL;
+    char *location;
+    uint64_t cur_off, cur_end_off;
+    int ret;
+
+    if ((ret = http_check_reuse(h, uri)) < 0)
+        return ret;
+    if (!s->hd || !s->multiple_requests || s->willclose || s->listen ||
+        s->pipeline_location || s->post_data || (h->flags & AVIO_FLAG_WRITE))
+        return AVERROR(EINVAL);
+
+    s->pipeline_location = av_strdup(uri);
+    if (!s->pipeline_location)
+        return AVERROR(ENOMEM);
+    s->pipeline_off     = off;
+    s->pipeline_end_off = end_off;
+
+    /* Send the request built from the new location and range, without
+     * waiting for its reply. */
+    location    = s->location;
+    cur_off     = s->off;
+    cur_end_off = s->end_off;
+    s->location = s->pipeline_location;
+    s->off      = off;
+    s->end_off  = end_off;
+    s->pipeline_sending = 1;
+    av_dict_copy(&options, s->chained_options, 0);
+    ret = http_open_cnx_internal(h, &options);
+    av_dict_free(&options);
+    s->pipeline_sending = 0;
+    s->location = location;
+    s->off      = cur_off;
+    s->end_off  = cur_end_off;
+
+    if (ret < 0) {
+        av_freep(&s->pipeline_location);
+        /* A partial request may have been sent. */
+        s->willclose = 1;
+        return ret;
+    }
+    av_log(h, AV_LOG_DEBUG, "Pipelined request for %s\n", uri);
+    return 0;
+}
+
 int ff_http_averror(int status_code, int default_averror)
 {
     switch (status_code) {
@@ -500,6 +812,13 @@ static int http_write_reply(URLContext* h, int status_code)
     default:
         return AVERROR(EINVAL);
     }
+    if (s->is_multi_client) {
+        /* Without a body, the request must have been read entirely by now.
+         * With one, whether the client reads it all is checked on close. */
+        s->keep_alive = !body && !s->willclose &&
+                        (s->chunksize != UINT64_MAX || s->filesize ||
+                         http_request_consumed(s));
+    }
     if (body) {
         s->chunked_post = 0;
         message_len = snprintf(message, sizeof(message),
@@ -507,12 +826,14 @@ static int http_write_reply(URLContext* h, int status_code)
                  "Content-Type: %s\r\n"
                  "Content-Length: %"SIZE_SPECIFIER"\r\n"
                  "%s"
+                 "%s"
                  "\r\n"
                  "%03d %s\r\n",
                  reply_code,
                  reply_text,
                  content_type,
                  strlen(reply_text) + 6, // 3 digit status code + space + \r\n
+                 s->is_multi_client ? "Connection: close\r\n" : "",
                  s->headers ? s->headers : "",
                  reply_code,
                  reply_text);
@@ -523,10 +844,12 @@ static int http_write_reply(URLContext* h, int status_code)
                  "Content-Type: %s\r\n"
                  "Transfer-Encoding: chunked\r\n"
                  "%s"
+                 "%s"
                  "\r\n",
                  reply_code,
                  reply_text,
                  content_type,
+                 s->is_multi_client && !s->keep_alive ? "Connection: close\r\n" : "",
                  s->headers ? s->headers : "");
     }
     av_log(h, AV_LOG_TRACE, "HTTP reply header: \n%s----\n", message);
@@ -644,6 +967,10 @@ static int http_open(URLContext *h, const char *uri, int flags,
         return http_listen(h, uri, flags, options);
     }
     ret = http_open_cnx(h, options);
+    if (ret >= 0 && s->connection_pool && s->multiple_requests) {
+        ff_http_pool_ref();
+        s->pool_ref = 1;
+    }
 bail_out:
     if (ret < 0)
         av_dict_free(&s->chained_options);
@@ -750,8 +1077,11 @@ static void parse_content_range(URLContext *h, const char *p)
     const char *slash;
 
     if (!strncmp(p, "bytes ", 6)) {
+        const char *dash;
         p     += 6;
         s->off = strtoull(p, NULL, 10);
+        if ((dash = strchr(p, '-')))
+            s->range_end = strtoull(dash + 1, NULL, 10) + 1;
         if ((slash = strchr(p, '/')) && strlen(slash) > 0)
             s->filesize = strtoull(slash + 1, NULL, 10);
     }
@@ -1026,6 +1356,8 @@ static int process_line(URLContext *h, char *line, int line_count,
                 return ff_http_averror(400, AVERROR(EIO));
             }
             av_log(h, AV_LOG_TRACE, "HTTP version string: %s\n", version);
+            if (!av_strcasecmp(version, "HTTP/1.0"))
+                s->willclose = 1;
         } else {
             if (av_strncasecmp(p, "HTTP/1.0", 8) == 0)
                 s->willclose = 1;
@@ -1062,7 +1394,7 @@ static int process_line(URLContext *h, char *line, int line_count,
                 return ret;
             *new_location = 1;
         } else if (!av_strcasecmp(tag, "Content-Length") &&
-                   s->filesize == UINT64_MAX) {
+                   (s->filesize == UINT64_MAX || s->is_connected_server)) {
             s->filesize = strtoull(p, NULL, 10);
         } else if (!av_strcasecmp(tag, "Content-Range")) {
             parse_content_range(h, p);
@@ -1288,6 +1620,13 @@ static int http_connect(URLContext *h, const char *path, const char *local_path,
     /* send http header */
     post = h->flags & AVIO_FLAG_WRITE;
 
+    if (s->pipeline_reply) {
+        /* The request was sent by ff_http_pipeline_request(), and the start
+         * of its reply may already be buffered. */
+        s->pipeline_reply = 0;
+        goto read_reply;
+    }
+
     if (s->post_data) {
         /* force POST method and disable chunked encoding when
          * custom HTTP post data is set */
@@ -1400,11 +1739,16 @@ static int http_connect(URLContext *h, const char *path, const char *local_path,
         if ((err = ffurl_write(s->hd, s->post_data, s->post_datalen)) < 0)
             goto done;
 
+    if (s->pipeline_sending)
+        goto done;
+
     /* init input buffer */
     s->buf_ptr          = s->buffer;
     s->buf_end          = s->buffer;
+read_reply:
     s->line_count       = 0;
     s->off              = 0;
+    s->range_end        = 0;
     s->icy_data_read    = 0;
     s->filesize         = UINT64_MAX;
     s->willclose        = 0;
@@ -1478,6 +1822,11 @@ static int http_buf_read(URLContext *h, uint8_t *buf, int size)
             }
         }
         size = FFMIN(size, s->chunksize);
+    } else if (s->pipeline_location) {
+        /* Do not read into the reply to the pipelined request. */
+        uint64_t reply_end = s->range_end ? s->range_end : s->filesize;
+        if (reply_end > s->off && reply_end - s->off < size)
+            size = reply_end - s->off;
     }
 
     /* read bytes from input buffer first */
@@ -1734,8 +2083,9 @@ static int http_shutdown(URLContext *h, int flags)
         ((flags & AVIO_FLAG_READ) && s->chunked_post && s->listen)) {
         ret = ffurl_write(s->hd, footer, sizeof(footer) - 1);
         ret = ret > 0 ? 0 : ret;
-        /* flush the receive buffer when it is write only mode */
-        if (!(flags & AVIO_FLAG_READ)) {
+        /* flush the receive buffer when it is write only mode, unless it
+         * holds the next request of a server client */
+        if (!(flags & AVIO_FLAG_READ) && !s->is_multi_client) {
             char buf[1024];
             int read_ret;
             s->hd->flags |= AVIO_FLAG_NONBLOCK;
@@ -1762,12 +2112,31 @@ static int http_close(URLContext *h)
     av_freep(&s->inflate_buffer);
 #endif /* CONFIG_ZLIB */
 
-    if (s->hd && !s->end_chunked_post)
+    /* The multi-client server only listens, its clients write the replies. */
+    if (s->hd && !s->end_chunked_post && s->listen <= HTTP_SINGLE)
         /* Close the write direction by sending the end of chunked encoding. */
         ret = http_shutdown(h, h->flags);
 
+    /* Only a client connection that completed its exchange may be kept by
+     * the lower protocol for the next request, shut down the others. */
+    if (s->hd && s->is_multi_client &&
+        (!s->keep_alive || ret < 0 || s->handshake_step != FINISH ||
+         !http_request_consumed(s)))
+        ffurl_shutdown(s->hd, AVIO_FLAG_READ_WRITE);
+
+    if (s->hd && s->pool_key && !s->pipeline_location &&
+        !(h->flags & AVIO_FLAG_WRITE) && !s->post_data &&
+        s->buf_ptr == s->buf_end && http_reply_complete(s)) {
+        pool_put(s->pool_key, s->hd);
+        s->hd = NULL;
+    }
     if (s->hd)
         ffurl_closep(&s->hd);
+    if (s->pool_ref)
+        ff_http_pool_unref();
+    s->pool_ref = 0;
+    av_freep(&s->pool_key);
+    av_freep(&s->pipeline_location);
     av_dict_free(&s->chained_options);
     return ret;
 }
@@ -1810,6 +2179,12 @@ static int64_t http_seek_internal(URLContext *h, int64_t off, int whence, int fo
             return s->off;
     }
 
+    /* the reply to a pipelined request is lost with the old connection */
+    if (s->pipeline_location) {
+        av_freep(&s->pipeline_location);
+        s->willclose = 1;
+    }
+
     /* we save the old context in case the seek fails */
     old_buf_size = s->buf_end - s->buf_ptr;
     memcpy(old_buf, s->buf_ptr, old_buf_size);
@@ -1916,6 +2291,7 @@ static int http_proxy_open(URLContext *h, const char *uri, int flags)
     HTTPAuthType cur_auth_type;
     char *authstr;
     int new_loc;
+    AVIOInterruptCB int_cb = { ff_url_interrupt_cb, h };
 
     if( s->seekable == 1 )
         h->is_streamed = 0;
@@ -1933,7 +2309,7 @@ static int http_proxy_open(URLContext *h, const char *uri, int flags)
                 NULL);
 redo:
     ret = ffurl_open_whitelist(&s->hd, lower_url, AVIO_FLAG_READ_WRITE,
-                               &h->interrupt_callback, NULL,
+                               &int_cb, NULL,
                                h->protocol_whitelist, h->protocol_blacklist, h);
     if (ret < 0)
         return ret;
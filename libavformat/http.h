@@ -69,6 +69,34 @@ int ff_http_do_new_request(URLContext *h, const char *uri);
  */
 int ff_http_do_new_request2(URLContext *h, const char *uri, AVDictionary **options);
 
+/**
+ * Send the request for the next resource on the connection of h without
+ * waiting for the current reply to be read (HTTP pipelining). The reply is
+ * used by the next ff_http_do_new_request2() call if it requests the same
+ * uri and range, otherwise that call opens a new connection.
+ *
+ * @param h pointer to the resource
+ * @param uri uri of the next request, on the same host
+ * @param off start of the requested range
+ * @param end_off end of the requested range, 0 for the end of the resource
+ * @return a negative value if an error condition occurred, 0
+ * otherwise
+ */
+int ff_http_pipeline_request(URLContext *h, const char *uri,
+                             uint64_t off, uint64_t end_off);
+
+/**
+ * Take a reference to the HTTP connection pool, see the connection_pool
+ * option. Idle pooled connections are kept only while the pool is
+ * referenced, and are closed when the last reference is released with
+ * ff_http_pool_unref(). Contexts using the pool hold a reference while
+ * open; a caller opening several of them in sequence should hold one for
+ * the whole sequence.
+ */
+void ff_http_pool_ref(void);
+
+void ff_http_pool_unref(void);
+
 int ff_http_averror(int status_code, int default_averror);
 
 #endif /* AVFORMAT_HTTP_H */
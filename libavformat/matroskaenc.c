@@ -129,6 +129,7 @@ typedef struct MatroskaMuxContext {
     int64_t             segment_offset;
     AVIOContext        *cluster_bc;
     int64_t             cluster_pos;    ///< file offset of the current Cluster
+    int64_t             cluster_data_pos; ///< offset of the current Cluster's data in its output
     int64_t             cluster_pts;
     int64_t             duration_offset;
     int64_t             duration;
@@ -136,6 +137,7 @@ typedef struct MatroskaMuxContext {
     mkv_seekhead        seekhead;
     mkv_cues            cues;
     int64_t             cues_pos;
+    int                 wrote_cues;
 
     AVPacket            cur_audio_pkt;
 
@@ -146,6 +148,8 @@ typedef struct MatroskaMuxContext {
     int                 wrote_tags;
 
     int                 reserve_cues_space;
+    int                 update_cues;
+    int                 direct_clusters;
     int                 cluster_size_limit;
     int64_t             cluster_time_limit;
     int                 write_crc;
@@ -2173,6 +2177,137 @@ static int mkv_write_vtt_blocks(AVFormatContext *s, AVIOContext *pb, const AVPac
     return pkt->duration;
 }
 
+/**
+ * Write the Cues at the current position or, if space has been reserved
+ * for them, into that space; the current position is kept in that case.
+ *
+ * @return 0 on success, 1 if the Cues do not fit into the reserved space,
+ *         < 0 on error.
+ */
+static int mkv_write_cues(AVFormatContext *s)
+{
+    MatroskaMuxContext *mkv = s->priv_data;
+    AVIOContext *pb = s->pb, *cues = NULL;
+    int64_t curpos = avio_tell(pb), ret64;
+    uint64_t size;
+    int length_size = 0, ret;
+
+    ret = start_ebml_master_crc32(&cues, mkv);
+    if (ret < 0)
+        return ret;
+
+    ret = mkv_assemble_cues(s->streams, cues, &mkv->cues,
+                            mkv->tracks, s->nb_streams);
+    if (ret < 0) {
+        ffio_free_dyn_buf(&cues);
+        return ret;
+    }
+
+    if (mkv->reserve_cues_space) {
+        size  = avio_tell(cues);
+        length_size = ebml_length_size(size);
+        size += 4 + length_size;
+        if (mkv->reserve_cues_space < size) {
+            av_log(s, AV_LOG_WARNING,
+                   "Insufficient space reserved for Cues: "
+                   "%d < %"PRIu64". %s\n", mkv->reserve_cues_space, size,
+                   mkv->wrote_cues ? "The Cues written before are kept."
+                                   : "No Cues will be output.");
+            ffio_free_dyn_buf(&cues);
+            return 1;
+        }
+        if ((ret64 = avio_seek(pb, mkv->cues_pos, SEEK_SET)) < 0) {
+            ffio_free_dyn_buf(&cues);
+            return ret64;
+        }
+        if (mkv->reserve_cues_space == size + 1) {
+            /* There is no way to reserve a single byte because
+             * the minimal size of an EBML Void element is 2
+             * (1 byte ID, 1 byte length field). This problem
+             * is solved by writing the Cues' length field on
+             * one byte more than necessary. */
+            length_size++;
+            size++;
+        }
+    }
+    ret = end_ebml_master_crc32(pb, &cues, mkv, MATROSKA_ID_CUES,
+                                length_size, 0, !mkv->wrote_cues);
+    if (ret < 0)
+        return ret;
+    mkv->wrote_cues = 1;
+
+    if (mkv->reserve_cues_space) {
+        if (size < mkv->reserve_cues_space)
+            put_ebml_void(pb, mkv->reserve_cues_space - size);
+        if ((ret64 = avio_seek(pb, curpos, SEEK_SET)) < 0)
+            return ret64;
+    }
+
+    return 0;
+}
+
+static int mkv_start_cluster(AVFormatContext *s, int64_t ts)
+{
+    MatroskaMuxContext *mkv = s->priv_data;
+    AVIOContext *pb;
+    int ret;
+
+    mkv->cluster_pos = avio_tell(s->pb);
+    if (mkv->direct_clusters) {
+        pb = s->pb;
+        put_ebml_id(pb, MATROSKA_ID_CLUSTER);
+        if (IS_SEEKABLE(pb, mkv)) {
+            /* The size and the CRC32 are filled in by mkv_end_cluster(). */
+            put_ebml_size_unknown(pb, 8);
+            mkv->cluster_data_pos = avio_tell(pb);
+            if (mkv->write_crc) {
+                put_ebml_void(pb, 6);
+                ffio_init_checksum(pb, ff_crcEDB88320_update, UINT32_MAX);
+            }
+        } else {
+            /* A CRC32 element would have to precede the data it covers. */
+            put_ebml_size_unknown(pb, 1);
+            mkv->cluster_data_pos = avio_tell(pb);
+        }
+    } else {
+        ret = start_ebml_master_crc32(&mkv->cluster_bc, mkv);
+        if (ret < 0)
+            return ret;
+        pb = mkv->cluster_bc;
+        mkv->cluster_data_pos = 0;
+    }
+    put_ebml_uint(pb, MATROSKA_ID_CLUSTERTIMECODE, FFMAX(0, ts));
+    mkv->cluster_pts = FFMAX(0, ts);
+    av_log(s, AV_LOG_DEBUG,
+           "Starting new cluster with timestamp "
+           "%" PRId64 " at offset %" PRId64 " bytes\n",
+           mkv->cluster_pts, mkv->cluster_pos);
+    return 0;
+}
+
+static int mkv_end_direct_cluster(AVFormatContext *s)
+{
+    MatroskaMuxContext *mkv = s->priv_data;
+    AVIOContext *pb = s->pb;
+    int64_t endpos = avio_tell(pb), ret64;
+    uint8_t crc[4];
+
+    if (!IS_SEEKABLE(pb, mkv))
+        return pb->error;
+
+    if (mkv->write_crc)
+        AV_WL32(crc, ffio_get_checksum(pb) ^ UINT32_MAX);
+    if ((ret64 = avio_seek(pb, mkv->cluster_data_pos - 8, SEEK_SET)) < 0)
+        return ret64;
+    put_ebml_length(pb, endpos - mkv->cluster_data_pos, 8);
+    if (mkv->write_crc)
+        put_ebml_binary(pb, EBML_ID_CRC32, crc, sizeof(crc));
+    if ((ret64 = avio_seek(pb, endpos, SEEK_SET)) < 0)
+        return ret64;
+
+    return pb->error;
+}
+
 static int mkv_end_cluster(AVFormatContext *s)
 {
     MatroskaMuxContext *mkv = s->priv_data;
@@ -2183,11 +2318,29 @@ static int mkv_end_cluster(AVFormatContext *s)
             mkv->tracks[i].has_cue = 0;
     }
     mkv->cluster_pos = -1;
-    ret = end_ebml_master_crc32(s->pb, &mkv->cluster_bc, mkv,
-                                MATROSKA_ID_CLUSTER, 0, 1, 0);
+    if (mkv->direct_clusters)
+        ret = mkv_end_direct_cluster(s);
+    else
+        ret = end_ebml_master_crc32(s->pb, &mkv->cluster_bc, mkv,
+                                    MATROSKA_ID_CLUSTER, 0, 1, 0);
     if (ret < 0)
         return ret;
 
+    /* Keep the index in the reserved space up to date, so that the file
+     * is seekable even if it is never finalized. */
+    if (mkv->update_cues && mkv->reserve_cues_space > 0 && mkv->cues.num_entries) {
+        ret = mkv_write_cues(s);
+        if (ret < 0)
+            return ret;
+        if (ret > 0) {
+            mkv->update_cues = 0;
+        } else {
+            ret = mkv_write_seekhead(s->pb, mkv, 1, avio_tell(s->pb));
+            if (ret < 0)
+                return ret;
+        }
+    }
+
     avio_write_marker(s->pb, AV_NOPTS_VALUE, AVIO_DATA_MARKER_FLUSH_POINT);
     return 0;
 }
@@ -2311,20 +2464,13 @@ static int mkv_write_packet_internal(AVFormatContext *s, const AVPacket *pkt)
     }
 
     if (mkv->cluster_pos == -1) {
-        ret = start_ebml_master_crc32(&mkv->cluster_bc, mkv);
+        ret = mkv_start_cluster(s, ts);
         if (ret < 0)
             return ret;
-        mkv->cluster_pos = avio_tell(s->pb);
-        put_ebml_uint(mkv->cluster_bc, MATROSKA_ID_CLUSTERTIMECODE, FFMAX(0, ts));
-        mkv->cluster_pts = FFMAX(0, ts);
-        av_log(s, AV_LOG_DEBUG,
-               "Starting new cluster with timestamp "
-               "%" PRId64 " at offset %" PRId64 " bytes\n",
-               mkv->cluster_pts, mkv->cluster_pos);
     }
-    pb = mkv->cluster_bc;
+    pb = mkv->direct_clusters ? s->pb : mkv->cluster_bc;
 
-    relative_packet_pos = avio_tell(pb);
+    relative_packet_pos = avio_tell(pb) - mkv->cluster_data_pos;
 
     if (par->codec_type != AVMEDIA_TYPE_SUBTITLE) {
         ret = mkv_write_block(s, pb, MATROSKA_ID_SIMPLEBLOCK, pkt, keyframe);
@@ -2379,7 +2525,7 @@ static int mkv_write_packet(AVFormatContext *s, const AVPacket *pkt)
     MatroskaMuxContext *mkv = s->priv_data;
     int codec_type          = s->streams[pkt->stream_index]->codecpar->codec_type;
     int keyframe            = !!(pkt->flags & AV_PKT_FLAG_KEY);
-    int cluster_size;
+    int64_t cluster_size;
     int64_t cluster_time;
     int ret;
     int start_new_cluster;
@@ -2395,7 +2541,8 @@ static int mkv_write_packet(AVFormatContext *s, const AVPacket *pkt)
             cluster_time = pkt->pts - mkv->cluster_pts;
         cluster_time += mkv->tracks[pkt->stream_index].ts_offset;
 
-        cluster_size  = avio_tell(mkv->cluster_bc);
+        cluster_size  = avio_tell(mkv->direct_clusters ? s->pb : mkv->cluster_bc) -
+                        mkv->cluster_data_pos;
 
         if (mkv->is_dash && codec_type == AVMEDIA_TYPE_VIDEO) {
             // WebM DASH specification states that the first block of
@@ -2484,8 +2631,7 @@ static int mkv_write_trailer(AVFormatContext *s)
     }
 
     if (mkv->cluster_pos != -1) {
-        ret = end_ebml_master_crc32(pb, &mkv->cluster_bc, mkv,
-                                    MATROSKA_ID_CLUSTER, 0, 0, 0);
+        ret = mkv_end_cluster(s);
         if (ret < 0)
             return ret;
     }
@@ -2500,60 +2646,15 @@ static int mkv_write_trailer(AVFormatContext *s)
     endpos = avio_tell(pb);
 
     if (mkv->cues.num_entries && mkv->reserve_cues_space >= 0) {
-        AVIOContext *cues = NULL;
-        uint64_t size;
-        int length_size = 0;
-
-        ret = start_ebml_master_crc32(&cues, mkv);
-        if (ret < 0)
-            return ret;
-
-        ret = mkv_assemble_cues(s->streams, cues, &mkv->cues,
-                                mkv->tracks, s->nb_streams);
-        if (ret < 0) {
-            ffio_free_dyn_buf(&cues);
-            return ret;
-        }
-
-        if (mkv->reserve_cues_space) {
-            size  = avio_tell(cues);
-            length_size = ebml_length_size(size);
-            size += 4 + length_size;
-            if (mkv->reserve_cues_space < size) {
-                av_log(s, AV_LOG_WARNING,
-                       "Insufficient space reserved for Cues: "
-                       "%d < %"PRIu64". No Cues will be output.\n",
-                       mkv->reserve_cues_space, size);
-                ret2 = AVERROR(EINVAL);
-                goto after_cues;
-            } else {
-                if ((ret64 = avio_seek(pb, mkv->cues_pos, SEEK_SET)) < 0) {
-                    ffio_free_dyn_buf(&cues);
-                    return ret64;
-                }
-                if (mkv->reserve_cues_space == size + 1) {
-                    /* There is no way to reserve a single byte because
-                     * the minimal size of an EBML Void element is 2
-                     * (1 byte ID, 1 byte length field). This problem
-                     * is solved by writing the Cues' length field on
-                     * one byte more than necessary. */
-                    length_size++;
-                    size++;
-                }
-            }
-        }
-        ret = end_ebml_master_crc32(pb, &cues, mkv, MATROSKA_ID_CUES,
-                                    length_size, 0, 1);
+        ret = mkv_write_cues(s);
         if (ret < 0)
             return ret;
-        if (mkv->reserve_cues_space) {
-            if (size < mkv->reserve_cues_space)
-                put_ebml_void(pb, mkv->reserve_cues_space - size);
-        } else
+        if (ret > 0)
+            ret2 = AVERROR(EINVAL);
+        else if (!mkv->reserve_cues_space)
             endpos = avio_tell(pb);
     }
 
-after_cues:
     /* Lengths greater than (1ULL << 56) - 1 can't be represented
      * via an EBML number, so leave the unknown length field. */
     if (endpos - mkv->segment_offset < (1ULL << 56) - 1) {
@@ -2797,6 +2898,8 @@ static const AVCodecTag additional_subtitle_tags[] = {
 #define FLAGS AV_OPT_FLAG_ENCODING_PARAM
 static const AVOption options[] = {
     { "reserve_index_space", "Reserve a given amount of space (in bytes) at the beginning of the file for the index (cues).", OFFSET(reserve_cues_space), AV_OPT_TYPE_INT,   { .i64 = 0 },   0, INT_MAX,   FLAGS },
+    { "update_index",        "Synchronously rewrite the index (cues) in the reserved space after every cluster.",             OFFSET(update_cues), AV_OPT_TYPE_BOOL, { .i64 = 0 },    0, 1,         FLAGS },
+    { "direct_clusters",     "Write clusters directly to the output instead of buffering them.",                             OFFSET(direct_clusters), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1,         FLAGS },
     { "cluster_size_limit",  "Store at most the provided amount of bytes in a cluster. ",                                     OFFSET(cluster_size_limit), AV_OPT_TYPE_INT  , { .i64 = -1 }, -1, INT_MAX,   FLAGS },
     { "cluster_time_limit",  "Store at most the provided number of milliseconds in a cluster.",                               OFFSET(cluster_time_limit), AV_OPT_TYPE_INT64, { .i64 = -1 }, -1, INT64_MAX, FLAGS },
     { "dash", "Create a WebM file conforming to WebM DASH specification", OFFSET(is_dash), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, FLAGS },
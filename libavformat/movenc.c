@@ -5257,6 +5257,78 @@ static void mov_parse_truehd_frame(AVPacket *pkt, MOVTrack *trk)
     return;
 }
 
+static int64_t mov_frag_data_size(MOVTrack *track)
+{
+    return track->frag_chunks_size +
+           (track->mdat_buf ? avio_tell(track->mdat_buf) : 0);
+}
+
+/* Appends a chunk to the fragment payload, takes ownership of buf */
+static int mov_frag_add_chunk(MOVTrack *track, AVBufferRef *buf,
+                              const uint8_t *data, int size)
+{
+    MOVFragChunk *chunk;
+
+    if (track->nb_frag_chunks >= track->frag_chunks_capacity) {
+        unsigned new_capacity = track->nb_frag_chunks + MOV_INDEX_CLUSTER_SIZE;
+        if (av_reallocp_array(&track->frag_chunks, new_capacity,
+                              sizeof(*track->frag_chunks))) {
+            av_buffer_unref(&buf);
+            track->nb_frag_chunks = track->frag_chunks_capacity = 0;
+            return AVERROR(ENOMEM);
+        }
+        track->frag_chunks_capacity = new_capacity;
+    }
+
+    chunk = &track->frag_chunks[track->nb_frag_chunks++];
+    chunk->buf  = buf;
+    chunk->data = data;
+    chunk->size = size;
+    track->frag_chunks_size += size;
+    return 0;
+}
+
+/* Moves the data written to the dynamic buffer so far into a chunk, so that
+ * referenced packets can be appended after it */
+static int mov_frag_seal_dyn_buf(MOVTrack *track)
+{
+    AVBufferRef *ref;
+    uint8_t *buf;
+    int size;
+
+    if (!track->mdat_buf || !avio_tell(track->mdat_buf))
+        return 0;
+
+    size = avio_close_dyn_buf(track->mdat_buf, &buf);
+    track->mdat_buf = NULL;
+    ref = av_buffer_create(buf, size, av_buffer_default_free, NULL, 0);
+    if (!ref) {
+        av_free(buf);
+        return AVERROR(ENOMEM);
+    }
+    return mov_frag_add_chunk(track, ref, buf, size);
+}
+
+static int mov_frag_ref_packet(MOVTrack *track, const AVPacket *pkt, int size)
+{
+    AVBufferRef *ref;
+    int ret;
+
+    if ((ret = mov_frag_seal_dyn_buf(track)) < 0)
+        return ret;
+    if (!(ref = av_buffer_ref(pkt->buf)))
+        return AVERROR(ENOMEM);
+    return mov_frag_add_chunk(track, ref, pkt->data, size);
+}
+
+static void mov_frag_free_chunks(MOVTrack *track)
+{
+    for (int i = 0; i < track->nb_frag_chunks; i++)
+        av_buffer_unref(&track->frag_chunks[i].buf);
+    track->nb_frag_chunks   = 0;
+    track->frag_chunks_size = 0;
+}
+
 static int mov_flush_fragment_interleaving(AVFormatContext *s, MOVTrack *track)
 {
     MOVMuxContext *mov = s->priv_data;
@@ -5427,8 +5499,7 @@ static int mov_flush_fragment(AVFormatContext *s, int force)
         }
         if (!track->entry)
             continue;
-        if (track->mdat_buf)
-            mdat_size += avio_tell(track->mdat_buf);
+        mdat_size += mov_frag_data_size(track);
         if (first_track < 0)
             first_track = i;
     }
@@ -5450,9 +5521,9 @@ static int mov_flush_fragment(AVFormatContext *s, int force)
             duration = track->start_dts + track->track_duration -
                        track->cluster[0].dts;
         if (mov->flags & FF_MOV_FLAG_SEPARATE_MOOF) {
-            if (!track->mdat_buf)
+            if (!track->mdat_buf && !track->nb_frag_chunks)
                 continue;
-            mdat_size = avio_tell(track->mdat_buf);
+            mdat_size = mov_frag_data_size(track);
             moof_tracks = i;
         } else {
             write_moof = i == first_track;
@@ -5474,6 +5545,11 @@ static int mov_flush_fragment(AVFormatContext *s, int force)
         track->entries_flushed = 0;
         track->end_reliable = 0;
         if (!mov->frag_interleave) {
+            /* referenced packet data goes straight to the output */
+            for (int j = 0; j < track->nb_frag_chunks; j++)
+                avio_write(s->pb, track->frag_chunks[j].data,
+                           track->frag_chunks[j].size);
+            mov_frag_free_chunks(track);
             if (!track->mdat_buf)
                 continue;
             buf_size = avio_close_dyn_buf(track->mdat_buf, &buf);
@@ -5558,6 +5634,7 @@ int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt)
     int size = pkt->size, ret = 0, offset = 0;
     int prft_size;
     uint8_t *reformatted_data = NULL;
+    int frag_buf = 0;
 
     ret = check_pkt(s, pkt);
     if (ret < 0)
@@ -5578,6 +5655,7 @@ int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt)
                     return ret;
             }
             pb = trk->mdat_buf;
+            frag_buf = !mov->frag_interleave;
         } else {
             if (!mov->mdat_buf) {
                 if ((ret = avio_open_dyn_buf(&mov->mdat_buf)) < 0)
@@ -5734,6 +5812,11 @@ int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt)
             if (ret) {
                 goto err;
             }
+        } else if (frag_buf && pkt->buf) {
+            /* pb may be closed by this, it is not used afterwards */
+            ret = mov_frag_ref_packet(trk, pkt, size);
+            if (ret < 0)
+                goto err;
         } else {
             avio_write(pb, pkt->data, size);
         }
@@ -5749,7 +5832,7 @@ int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt)
         trk->cluster_capacity = new_capacity;
     }
 
-    trk->cluster[trk->entry].pos              = avio_tell(pb) - size;
+    trk->cluster[trk->entry].pos              = (frag_buf ? mov_frag_data_size(trk) : avio_tell(pb)) - size;
     trk->cluster[trk->entry].samples_in_chunk = samples_in_chunk;
     trk->cluster[trk->entry].chunkNum         = 0;
     trk->cluster[trk->entry].size             = size;
@@ -6312,6 +6395,8 @@ static void mov_free(AVFormatContext *s)
 
         ff_mov_cenc_free(&mov->tracks[i].cenc);
         ffio_free_dyn_buf(&mov->tracks[i].mdat_buf);
+        mov_frag_free_chunks(&mov->tracks[i]);
+        av_freep(&mov->tracks[i].frag_chunks);
     }
 
     av_freep(&mov->tracks);
@@ -6437,7 +6522,9 @@ static int mov_init(AVFormatContext *s)
         mov->flags &= ~FF_MOV_FLAG_SKIP_SIDX;
     }
 
-    if (mov->flags & FF_MOV_FLAG_FASTSTART) {
+    /* With faststart, an explicit moov_size reserves space for the moov so
+     * the second pass can be skipped if it fits. */
+    if (mov->flags & FF_MOV_FLAG_FASTSTART && !mov->reserved_moov_size) {
         mov->reserved_moov_size = -1;
     }
 
@@ -6801,7 +6888,7 @@ static int mov_write_header(AVFormatContext *s)
             !mov->max_fragment_duration && !mov->max_fragment_size)
             mov->flags |= FF_MOV_FLAG_FRAG_KEYFRAME;
     } else {
-        if (mov->flags & FF_MOV_FLAG_FASTSTART)
+        if (mov->flags & FF_MOV_FLAG_FASTSTART && !mov->reserved_moov_size)
             mov->reserved_header_pos = avio_tell(pb);
         mov_write_mdat_tag(pb, mov);
     }
@@ -6935,9 +7022,11 @@ static int compute_sidx_size(AVFormatContext *s)
     return sidx_size;
 }
 
+#define SHIFT_BLOCK_SIZE (1 << 20)
+
 static int shift_data(AVFormatContext *s)
 {
-    int ret = 0, moov_size;
+    int ret = 0, moov_size, block_size;
     MOVMuxContext *mov = s->priv_data;
     int64_t pos, pos_end;
     uint8_t *buf, *read_buf[2];
@@ -6952,11 +7041,15 @@ static int shift_data(AVFormatContext *s)
     if (moov_size < 0)
         return moov_size;
 
-    buf = av_malloc(moov_size * 2);
+    /* Each block is read before the previous one is written, so any block
+     * size of at least moov_size works; small moovs would otherwise make the
+     * second pass issue a large number of tiny reads and writes. */
+    block_size = FFMAX(moov_size, SHIFT_BLOCK_SIZE);
+    buf = av_malloc(block_size * 2LL);
     if (!buf)
         return AVERROR(ENOMEM);
     read_buf[0] = buf;
-    read_buf[1] = buf + moov_size;
+    read_buf[1] = buf + block_size;
 
     /* Shift the data: the AVIO context of the output can only be used for
      * writing, so we re-open the same output, but for reading. It also avoids
@@ -6979,11 +7072,11 @@ static int shift_data(AVFormatContext *s)
     pos = avio_tell(read_pb);
 
 #define READ_BLOCK do {                                                             \
-    read_size[read_buf_id] = avio_read(read_pb, read_buf[read_buf_id], moov_size);  \
+    read_size[read_buf_id] = avio_read(read_pb, read_buf[read_buf_id], block_size); \
     read_buf_id ^= 1;                                                               \
 } while (0)
 
-    /* shift data by chunk of at most moov_size */
+    /* shift data by chunk of at most block_size */
     READ_BLOCK;
     do {
         int n;
@@ -7001,6 +7094,23 @@ end:
     return ret;
 }
 
+/* Fills the rest of the space reserved with moov_size with a free atom */
+static int mov_write_reserved_free_tag(AVFormatContext *s)
+{
+    MOVMuxContext *mov = s->priv_data;
+    AVIOContext *pb = s->pb;
+    int64_t size = mov->reserved_moov_size - (avio_tell(pb) - mov->reserved_header_pos);
+
+    if (size < 8) {
+        av_log(s, AV_LOG_ERROR, "reserved_moov_size is too small, needed %"PRId64" additional\n", 8-size);
+        return AVERROR(EINVAL);
+    }
+    avio_wb32(pb, size);
+    ffio_wfourcc(pb, "free");
+    ffio_fill(pb, 0, size - 8);
+    return 0;
+}
+
 static int mov_write_trailer(AVFormatContext *s)
 {
     MOVMuxContext *mov = s->priv_data;
@@ -7008,6 +7118,7 @@ static int mov_write_trailer(AVFormatContext *s)
     int res = 0;
     int i;
     int64_t moov_pos;
+    int moov_fits = 0;
 
     if (mov->need_rewrite_extradata) {
         for (i = 0; i < s->nb_streams; i++) {
@@ -7067,7 +7178,22 @@ static int mov_write_trailer(AVFormatContext *s)
         }
         avio_seek(pb, mov->reserved_moov_size > 0 ? mov->reserved_header_pos : moov_pos, SEEK_SET);
 
-        if (mov->flags & FF_MOV_FLAG_FASTSTART) {
+        if (mov->flags & FF_MOV_FLAG_FASTSTART && mov->reserved_moov_size > 0) {
+            if ((res = get_moov_size(s)) < 0)
+                return res;
+            moov_fits = res + 8 <= mov->reserved_moov_size;
+        }
+        if (moov_fits) {
+            /* the moov fits into the reserved space, no second pass needed */
+            if ((res = mov_write_moov_tag(pb, mov, s)) < 0)
+                return res;
+            res = mov_write_reserved_free_tag(s);
+            if (res < 0)
+                return res;
+            avio_seek(pb, moov_pos, SEEK_SET);
+        } else if (mov->flags & FF_MOV_FLAG_FASTSTART) {
+            if (mov->reserved_moov_size > 0)
+                av_log(s, AV_LOG_WARNING, "moov_size is too small, moving the data instead\n");
             av_log(s, AV_LOG_INFO, "Starting second pass: moving the moov atom to the beginning of the file\n");
             res = shift_data(s);
             if (res < 0)
@@ -7075,18 +7201,18 @@ static int mov_write_trailer(AVFormatContext *s)
             avio_seek(pb, mov->reserved_header_pos, SEEK_SET);
             if ((res = mov_write_moov_tag(pb, mov, s)) < 0)
                 return res;
+            if (mov->reserved_moov_size > 0) {
+                /* the reserved space was moved along and now follows the moov */
+                mov->reserved_header_pos = avio_tell(pb);
+                if ((res = mov_write_reserved_free_tag(s)) < 0)
+                    return res;
+            }
         } else if (mov->reserved_moov_size > 0) {
-            int64_t size;
             if ((res = mov_write_moov_tag(pb, mov, s)) < 0)
                 return res;
-            size = mov->reserved_moov_size - (avio_tell(pb) - mov->reserved_header_pos);
-            if (size < 8){
-                av_log(s, AV_LOG_ERROR, "reserved_moov_size is too small, needed %"PRId64" additional\n", 8-size);
-                return AVERROR(EINVAL);
-            }
-            avio_wb32(pb, size);
-            ffio_wfourcc(pb, "free");
-            ffio_fill(pb, 0, size - 8);
+            res = mov_write_reserved_free_tag(s);
+            if (res < 0)
+                return res;
             avio_seek(pb, moov_pos, SEEK_SET);
         } else {
             if ((res = mov_write_moov_tag(pb, mov, s)) < 0)
@@ -59,6 +59,17 @@ typedef struct MOVIentry {
     AVProducerReferenceTime prft;
 } MOVIentry;
 
+/**
+ * A piece of fragment payload. Packet data is referenced instead of being
+ * copied into the track's dynamic buffer, data written through the dynamic
+ * buffer (reformatted or encrypted samples) is stored as chunks of its own.
+ */
+typedef struct MOVFragChunk {
+    AVBufferRef   *buf;
+    const uint8_t *data;
+    int            size;
+} MOVFragChunk;
+
 typedef struct HintSample {
     uint8_t *data;
     int size;
@@ -137,6 +148,10 @@ typedef struct MOVTrack {
     AVPacket cover_image;
 
     AVIOContext *mdat_buf;
+    MOVFragChunk *frag_chunks;    ///< payload of the current fragment, preceding mdat_buf
+    int         nb_frag_chunks;
+    unsigned    frag_chunks_capacity;
+    int64_t     frag_chunks_size;
     int64_t     data_offset;
     int64_t     frag_start;
     int         frag_discont;
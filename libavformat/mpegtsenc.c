@@ -72,6 +72,9 @@ enum {
     MPEGTS_SERVICE_TYPE_ADVANCED_CODEC_DIGITAL_HDTV  = 0x19,
     MPEGTS_SERVICE_TYPE_HEVC_DIGITAL_HDTV            = 0x1F,
 };
+/* number of TS packets written to the output at once */
+#define TS_BATCH_PACKETS 32
+
 typedef struct MpegTSWrite {
     const AVClass *av_class;
     MpegTSSection pat; /* MPEG-2 PAT table */
@@ -115,6 +118,10 @@ typedef struct MpegTSWrite {
     int64_t last_sdt_ts;
 
     int omit_video_pes_length;
+
+    /* TS packets are assembled here and written to the output together */
+    uint8_t batch[TS_BATCH_PACKETS * (TS_PACKET_SIZE + 4)];
+    int batch_nb;
 } MpegTSWrite;
 
 /* a PES packet header is generated every DEFAULT_PES_HEADER_FREQ packets */
@@ -838,18 +845,41 @@ static int64_t get_pcr(const MpegTSWrite *ts)
            ts->first_pcr;
 }
 
+/**
+ * Return the place in the batch buffer where the next TS packet goes.
+ * Packets built there directly are not copied by write_packet().
+ */
+static uint8_t *get_packet_buf(MpegTSWrite *ts)
+{
+    int header_size = ts->m2ts_mode ? 4 : 0;
+    return ts->batch + ts->batch_nb * (TS_PACKET_SIZE + header_size) + header_size;
+}
+
+static void flush_packets(AVFormatContext *s)
+{
+    MpegTSWrite *ts = s->priv_data;
+    int header_size = ts->m2ts_mode ? 4 : 0;
+
+    if (!ts->batch_nb)
+        return;
+    avio_write(s->pb, ts->batch, ts->batch_nb * (TS_PACKET_SIZE + header_size));
+    ts->batch_nb = 0;
+}
+
 static void write_packet(AVFormatContext *s, const uint8_t *packet)
 {
     MpegTSWrite *ts = s->priv_data;
+    uint8_t *buf = get_packet_buf(ts);
+
     if (ts->m2ts_mode) {
         int64_t pcr = get_pcr(s->priv_data);
-        uint32_t tp_extra_header = pcr % 0x3fffffff;
-        tp_extra_header = AV_RB32(&tp_extra_header);
-        avio_write(s->pb, (unsigned char *) &tp_extra_header,
-                   sizeof(tp_extra_header));
+        AV_WB32(buf - 4, pcr % 0x3fffffff);
     }
-    avio_write(s->pb, packet, TS_PACKET_SIZE);
+    if (packet != buf)
+        memcpy(buf, packet, TS_PACKET_SIZE);
     ts->total_size += TS_PACKET_SIZE;
+    if (++ts->batch_nb == TS_BATCH_PACKETS)
+        flush_packets(s);
 }
 
 static void section_write_packet(MpegTSSection *s, const uint8_t *packet)
@@ -1294,7 +1324,7 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
 {
     MpegTSWriteStream *ts_st = st->priv_data;
     MpegTSWrite *ts = s->priv_data;
-    uint8_t buf[TS_PACKET_SIZE];
+    uint8_t *buf;
     uint8_t *q;
     int val, is_start, len, header_len, write_pcr, is_dvb_subtitle, is_dvb_teletext, flags;
     int afc_len, stuffing_len;
@@ -1302,7 +1332,6 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
     int force_pat = st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && key && !ts_st->prev_payload_key;
     int force_sdt = 0;
 
-    av_assert0(ts_st->payload != buf || st->codecpar->codec_type != AVMEDIA_TYPE_VIDEO);
     if (ts->flags & MPEGTS_FLAG_PAT_PMT_AT_FRAMES && st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
         force_pat = 1;
     }
@@ -1368,7 +1397,8 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
             }
         }
 
-        /* prepare packet header */
+        /* prepare packet header, directly in the batch buffer */
+        buf  = get_packet_buf(ts);
         q    = buf;
         *q++ = 0x47;
         val  = ts_st->pid >> 8;
@@ -1990,7 +2020,9 @@ static void mpegts_write_flush(AVFormatContext *s)
     }
 
     if (ts->m2ts_mode) {
-        int packets = (avio_tell(s->pb) / (TS_PACKET_SIZE + 4)) % 32;
+        int packets;
+        flush_packets(s);
+        packets = (avio_tell(s->pb) / (TS_PACKET_SIZE + 4)) % 32;
         while (packets++ < 32)
             mpegts_insert_null_packet(s);
     }
@@ -1998,18 +2030,25 @@ static void mpegts_write_flush(AVFormatContext *s)
 
 static int mpegts_write_packet(AVFormatContext *s, AVPacket *pkt)
 {
+    int ret;
+
     if (!pkt) {
         mpegts_write_flush(s);
-        return 1;
+        ret = 1;
     } else {
-        return mpegts_write_packet_internal(s, pkt);
+        ret = mpegts_write_packet_internal(s, pkt);
     }
+    /* callers may switch or inspect the output between packets */
+    flush_packets(s);
+    return ret;
 }
 
 static int mpegts_write_end(AVFormatContext *s)
 {
-    if (s->pb)
+    if (s->pb) {
         mpegts_write_flush(s);
+        flush_packets(s);
+    }
 
     return 0;
 }
@@ -18,6 +18,8 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#define _GNU_SOURCE /* recvmmsg(), sendmmsg() */
+
 #include <fcntl.h>
 #include "network.h"
 #include "tls.h"
@@ -28,6 +30,21 @@
 #include "libavutil/mem.h"
 #include "libavutil/time.h"
 
+#if HAVE_NETINET_UDP_H
+#include <netinet/udp.h>
+#endif
+
+#ifdef __linux__
+/* Older C libraries lack these even when the kernel supports them;
+ * unsupported options are rejected at run time. */
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO     104
+#endif
+#endif
+
 int ff_tls_init(void)
 {
 #if CONFIG_TLS_PROTOCOL
@@ -584,3 +601,139 @@ void ff_log_net_error(void *ctx, int level, const char* prefix)
     av_strerror(ff_neterrno(), errbuf, sizeof(errbuf));
     av_log(ctx, level, "%s: %s\n", prefix, errbuf);
 }
+
+int ff_recv_datagrams(int fd, FFDatagram *dg, int nb, int flags)
+{
+#if HAVE_RECVMMSG
+    struct mmsghdr msg[FF_DATAGRAM_BATCH_MAX];
+    struct iovec iov[FF_DATAGRAM_BATCH_MAX];
+#ifdef UDP_GRO
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control[FF_DATAGRAM_BATCH_MAX];
+#endif
+    int i, ret;
+
+    nb = FFMIN(nb, FF_DATAGRAM_BATCH_MAX);
+    memset(msg, 0, nb * sizeof(*msg));
+    for (i = 0; i < nb; i++) {
+        iov[i].iov_base = dg[i].buf;
+        iov[i].iov_len  = dg[i].size;
+        msg[i].msg_hdr.msg_name       = &dg[i].addr;
+        msg[i].msg_hdr.msg_namelen    = sizeof(dg[i].addr);
+        msg[i].msg_hdr.msg_iov        = &iov[i];
+        msg[i].msg_hdr.msg_iovlen     = 1;
+#ifdef UDP_GRO
+        msg[i].msg_hdr.msg_control    = &control[i];
+        msg[i].msg_hdr.msg_controllen = sizeof(control[i]);
+#endif
+    }
+
+    ret = recvmmsg(fd, msg, nb, flags | MSG_WAITFORONE, NULL);
+    if (ret < 0)
+        return ff_neterrno();
+
+    for (i = 0; i < ret; i++) {
+        dg[i].len      = msg[i].msg_len;
+        dg[i].addr_len = msg[i].msg_hdr.msg_namelen;
+        dg[i].seg_size = 0;
+#ifdef UDP_GRO
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg[i].msg_hdr); cmsg;
+             cmsg = CMSG_NXTHDR(&msg[i].msg_hdr, cmsg)) {
+            if (cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_GRO)
+                memcpy(&dg[i].seg_size, CMSG_DATA(cmsg), sizeof(int));
+        }
+#endif
+    }
+    return ret;
+#else
+    socklen_t addr_len = sizeof(dg->addr);
+    int ret = recvfrom(fd, dg->buf, dg->size, flags,
+                       (struct sockaddr *)&dg->addr, &addr_len);
+    if (ret < 0)
+        return ff_neterrno();
+    dg->len      = ret;
+    dg->addr_len = addr_len;
+    dg->seg_size = 0;
+    return 1;
+#endif
+}
+
+int ff_send_datagrams(int fd, const FFDatagram *dg, int nb,
+                      const struct sockaddr *dest, socklen_t dest_len)
+{
+#if HAVE_SENDMMSG
+    struct mmsghdr msg[FF_DATAGRAM_BATCH_MAX];
+    struct iovec iov[FF_DATAGRAM_BATCH_MAX];
+    int i, ret;
+
+    nb = FFMIN(nb, FF_DATAGRAM_BATCH_MAX);
+    memset(msg, 0, nb * sizeof(*msg));
+    for (i = 0; i < nb; i++) {
+        iov[i].iov_base = dg[i].buf;
+        iov[i].iov_len  = dg[i].len;
+        msg[i].msg_hdr.msg_name    = (struct sockaddr *)dest;
+        msg[i].msg_hdr.msg_namelen = dest ? dest_len : 0;
+        msg[i].msg_hdr.msg_iov     = &iov[i];
+        msg[i].msg_hdr.msg_iovlen  = 1;
+    }
+
+    ret = sendmmsg(fd, msg, nb, 0);
+    return ret < 0 ? ff_neterrno() : ret;
+#else
+    int ret;
+
+    if (dest)
+        ret = sendto(fd, dg->buf, dg->len, 0, dest, dest_len);
+    else
+        ret = send(fd, dg->buf, dg->len, 0);
+    return ret < 0 ? ff_neterrno() : 1;
+#endif
+}
+
+int ff_send_segments(int fd, const uint8_t *buf, int len, int seg_size,
+                     const struct sockaddr *dest, socklen_t dest_len)
+{
+#if defined(UDP_SEGMENT) && HAVE_STRUCT_MSGHDR_MSG_FLAGS
+    struct iovec iov = { (void *)buf, len };
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof(uint16_t))];
+    } control;
+    struct msghdr msg = { 0 };
+    struct cmsghdr *cmsg;
+    uint16_t gso_size = seg_size;
+    int ret;
+
+    memset(&control, 0, sizeof(control));
+    msg.msg_name       = (struct sockaddr *)dest;
+    msg.msg_namelen    = dest ? dest_len : 0;
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = &control;
+    msg.msg_controllen = sizeof(control);
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = IPPROTO_UDP;
+    cmsg->cmsg_type  = UDP_SEGMENT;
+    cmsg->cmsg_len   = CMSG_LEN(sizeof(gso_size));
+    memcpy(CMSG_DATA(cmsg), &gso_size, sizeof(gso_size));
+
+    ret = sendmsg(fd, &msg, 0);
+    return ret < 0 ? ff_neterrno() : ret;
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
+int ff_socket_enable_gro(int fd)
+{
+#ifdef UDP_GRO
+    if (setsockopt(fd, IPPROTO_UDP, UDP_GRO, &(int){1}, sizeof(int)))
+        return ff_neterrno();
+    return 0;
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
@@ -337,4 +337,69 @@ int ff_connect_parallel(struct addrinfo *addrs, int timeout_ms_per_address,
                         int parallel, URLContext *h, int *fd,
                         void (*customize_fd)(void *, int), void *customize_ctx);
 
+#define FF_DATAGRAM_BATCH_MAX 64
+
+typedef struct FFDatagram {
+    uint8_t *buf;
+    int size;           ///< size of buf
+    int len;            ///< length of the datagram in buf
+    /**
+     * Segment size of a datagram coalesced by UDP generic receive offload,
+     * 0 if it contains a single datagram.
+     */
+    int seg_size;
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+} FFDatagram;
+
+/**
+ * Receive up to nb datagrams with a single recvmmsg() call, or a single
+ * datagram with recvfrom() if recvmmsg() is unavailable. Only the first
+ * datagram is waited for on a blocking socket.
+ *
+ * @param fd    The socket file descriptor.
+ * @param dg    Array of nb datagrams with buf and size set; len, seg_size,
+ *              addr and addr_len are set for the received ones.
+ * @param nb    Number of entries in dg, at most FF_DATAGRAM_BATCH_MAX.
+ * @param flags Flags passed to the receive call.
+ * @return      The number of datagrams received or an AVERROR on failure.
+ */
+int ff_recv_datagrams(int fd, FFDatagram *dg, int nb, int flags);
+
+/**
+ * Send up to nb datagrams with a single sendmmsg() call, or a single
+ * datagram with sendto() if sendmmsg() is unavailable.
+ *
+ * @param fd       The socket file descriptor.
+ * @param dg       Array of nb datagrams with buf and len set.
+ * @param nb       Number of entries in dg, at most FF_DATAGRAM_BATCH_MAX.
+ * @param dest     Destination address, NULL for a connected socket.
+ * @param dest_len Length of dest.
+ * @return         The number of datagrams sent or an AVERROR on failure.
+ */
+int ff_send_datagrams(int fd, const FFDatagram *dg, int nb,
+                      const struct sockaddr *dest, socklen_t dest_len);
+
+/**
+ * Send a buffer as consecutive datagrams of seg_size bytes (the last one
+ * may be shorter) with a single call, using UDP generic segmentation
+ * offload.
+ *
+ * @return The number of bytes sent, AVERROR(ENOSYS) if segmentation
+ *         offload is not supported on this platform or another AVERROR
+ *         on failure.
+ */
+int ff_send_segments(int fd, const uint8_t *buf, int len, int seg_size,
+                     const struct sockaddr *dest, socklen_t dest_len);
+
+/**
+ * Enable UDP generic receive offload on a socket, after which
+ * ff_recv_datagrams() may return several coalesced datagrams in a single
+ * entry, as indicated by FFDatagram.seg_size.
+ *
+ * @return 0 on success, AVERROR(ENOSYS) if not supported on this platform
+ *         or another AVERROR on failure.
+ */
+int ff_socket_enable_gro(int fd);
+
 #endif /* AVFORMAT_NETWORK_H */
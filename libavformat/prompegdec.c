@@ -0,0 +1,362 @@
+/*
+ * Pro-MPEG Code of Practice #3 Release 2 FEC decoder
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Each FEC packet protects the media packets SNBase + i * offset, i < NA,
+ * with the XOR of their headers and payloads (see prompeg.c for the layout).
+ * A lost packet is rebuilt as soon as a FEC packet covering it is received
+ * while all the other packets it covers are. Rebuilt packets can complete
+ * other FEC packets, so the pending ones are retried until no more packets
+ * can be recovered: this lets the row and column FEC together repair
+ * bursts that neither of them could alone.
+ */
+
+#include <string.h>
+
+#include "config.h"
+#include "libavutil/common.h"
+#include "libavutil/error.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "prompegdec.h"
+
+#define RTP_HEADER_SIZE 12
+#define FEC_HEADER_SIZE 28
+
+/* Must cover the packets protected by two FEC matrices, as column FEC
+ * packets are sent once the following matrix has started. */
+#define HISTORY_SIZE    1024
+#define MAX_FEC         128
+#define MAX_RECOVERED   64
+
+typedef struct MediaPacket {
+    uint8_t *buf;
+    unsigned int alloc;
+    int size;
+    uint16_t seq;
+} MediaPacket;
+
+typedef struct FecPacket {
+    uint8_t *buf;
+    unsigned int alloc;
+    int size;
+    int pending;
+} FecPacket;
+
+struct PrompegDecoder {
+    void *logctx;
+
+    MediaPacket history[HISTORY_SIZE];
+    int started;
+    uint16_t max_seq;
+    uint32_t ssrc;
+
+    FecPacket fec[MAX_FEC];
+    int fec_next;
+    int nb_pending;
+
+    uint16_t recovered[MAX_RECOVERED];
+    int recovered_first, nb_recovered_queued;
+
+    uint8_t *tmp;
+    unsigned int tmp_alloc;
+
+    int64_t nb_fec;
+    int64_t nb_recovered;
+};
+
+PrompegDecoder *ff_prompeg_dec_alloc(void *logctx)
+{
+    PrompegDecoder *d = av_mallocz(sizeof(*d));
+
+    if (d)
+        d->logctx = logctx;
+    return d;
+}
+
+void ff_prompeg_dec_free(PrompegDecoder **pd)
+{
+    PrompegDecoder *d = *pd;
+    int i;
+
+    if (!d)
+        return;
+    for (i = 0; i < HISTORY_SIZE; i++)
+        av_freep(&d->history[i].buf);
+    for (i = 0; i < MAX_FEC; i++)
+        av_freep(&d->fec[i].buf);
+    av_freep(&d->tmp);
+    av_freep(pd);
+}
+
+static void xor_add(uint8_t *dst, const uint8_t *src, int size)
+{
+    int i = 0;
+
+#if HAVE_FAST_64BIT
+    for (; i + 8 <= size; i += 8)
+        AV_WN64(dst + i, AV_RN64(dst + i) ^ AV_RN64(src + i));
+#else
+    for (; i + 4 <= size; i += 4)
+        AV_WN32(dst + i, AV_RN32(dst + i) ^ AV_RN32(src + i));
+#endif
+    for (; i < size; i++)
+        dst[i] ^= src[i];
+}
+
+/* Packets too old to still be in the history are considered lost for good. */
+static int seq_expired(PrompegDecoder *d, uint16_t seq)
+{
+    return (int16_t)(d->max_seq - seq) >= HISTORY_SIZE;
+}
+
+static MediaPacket *get_media(PrompegDecoder *d, uint16_t seq)
+{
+    MediaPacket *pkt = &d->history[seq & (HISTORY_SIZE - 1)];
+
+    if (!pkt->size || pkt->seq != seq || seq_expired(d, seq))
+        return NULL;
+    return pkt;
+}
+
+static int store_media(PrompegDecoder *d, const uint8_t *buf, int size)
+{
+    uint16_t seq = AV_RB16(buf + 2);
+    MediaPacket *pkt = &d->history[seq & (HISTORY_SIZE - 1)];
+
+    if (!d->started || AV_RB32(buf + 8) != d->ssrc) {
+        int i;
+        for (i = 0; i < HISTORY_SIZE; i++)
+            d->history[i].size = 0;
+        for (i = 0; i < MAX_FEC; i++)
+            d->fec[i].pending = 0;
+        d->nb_pending = 0;
+        d->nb_recovered_queued = 0;
+        d->ssrc    = AV_RB32(buf + 8);
+        d->max_seq = seq;
+        d->started = 1;
+    } else if (seq_expired(d, seq)) {
+        return 0;
+    }
+
+    av_fast_malloc(&pkt->buf, &pkt->alloc, size);
+    if (!pkt->buf) {
+        pkt->size = 0;
+        return AVERROR(ENOMEM);
+    }
+    memcpy(pkt->buf, buf, size);
+    pkt->size = size;
+    pkt->seq  = seq;
+    if ((int16_t)(seq - d->max_seq) > 0)
+        d->max_seq = seq;
+    return 0;
+}
+
+/**
+ * Try to recover the packet missing from those covered by a FEC packet.
+ *
+ * @return 1 if a packet was recovered, 0 if none could be, in which case
+ *         fec->pending is cleared if none ever will be
+ */
+static int recover_fec(PrompegDecoder *d, FecPacket *fec)
+{
+    const uint8_t *f = fec->buf;
+    int payload_size = fec->size - FEC_HEADER_SIZE;
+    uint16_t sn_base = AV_RB16(f + 12);
+    int offset = f[25], na = f[26];
+    uint16_t last = sn_base + (na - 1) * offset;
+    uint16_t missing = 0;
+    int i, nb_missing = 0;
+    uint8_t b0, m_pt, *out;
+    uint32_t ts;
+    unsigned length;
+    int ret;
+
+    if (!d->started)
+        return 0;
+    if ((int16_t)(last - d->max_seq) > 0) {
+        /* wait until the last covered packet is due, so that the following
+         * ones are not taken as lost */
+        if ((int16_t)(last - d->max_seq) >= HISTORY_SIZE / 2)
+            goto done;
+        return 0;
+    }
+
+    for (i = 0; i < na; i++) {
+        uint16_t seq = sn_base + i * offset;
+        if (seq_expired(d, seq))
+            goto done;
+        if (!get_media(d, seq)) {
+            missing = seq;
+            if (++nb_missing > 1)
+                return 0;
+        }
+    }
+    if (!nb_missing)
+        goto done;
+
+    b0     = f[0] & 0x3f;
+    m_pt   = (f[1] & 0x80) | (f[16] & 0x7f);
+    ts     = AV_RB32(f + 20);
+    length = AV_RB16(f + 14);
+
+    av_fast_malloc(&d->tmp, &d->tmp_alloc, RTP_HEADER_SIZE + payload_size);
+    if (!d->tmp)
+        return AVERROR(ENOMEM);
+    out = d->tmp + RTP_HEADER_SIZE;
+    memcpy(out, f + FEC_HEADER_SIZE, payload_size);
+
+    for (i = 0; i < na; i++) {
+        uint16_t seq = sn_base + i * offset;
+        const MediaPacket *pkt;
+
+        if (seq == missing)
+            continue;
+        pkt = get_media(d, seq);
+        if (pkt->size - RTP_HEADER_SIZE > payload_size) {
+            av_log(d->logctx, AV_LOG_WARNING,
+                   "FEC packet smaller than the media packets, ignored\n");
+            goto done;
+        }
+        b0     ^= pkt->buf[0] & 0x3f;
+        m_pt   ^= pkt->buf[1];
+        ts     ^= AV_RB32(pkt->buf + 4);
+        length ^= pkt->size - RTP_HEADER_SIZE;
+        xor_add(out, pkt->buf + RTP_HEADER_SIZE, pkt->size - RTP_HEADER_SIZE);
+    }
+    if (length > payload_size) {
+        av_log(d->logctx, AV_LOG_WARNING,
+               "Invalid length recovered for packet %d\n", missing);
+        goto done;
+    }
+
+    d->tmp[0] = 0x80 | b0;
+    d->tmp[1] = m_pt;
+    AV_WB16(d->tmp + 2, missing);
+    AV_WB32(d->tmp + 4, ts);
+    AV_WB32(d->tmp + 8, d->ssrc);
+    if ((ret = store_media(d, d->tmp, RTP_HEADER_SIZE + length)) < 0)
+        return ret;
+
+    if (d->nb_recovered_queued < MAX_RECOVERED) {
+        int idx = (d->recovered_first + d->nb_recovered_queued++) % MAX_RECOVERED;
+        d->recovered[idx] = missing;
+    }
+    d->nb_recovered++;
+    av_log(d->logctx, AV_LOG_DEBUG, "Recovered packet %d\n", missing);
+    fec->pending = 0;
+    d->nb_pending--;
+    return 1;
+
+done:
+    fec->pending = 0;
+    d->nb_pending--;
+    return 0;
+}
+
+static int process_pending(PrompegDecoder *d)
+{
+    int i, ret, progress;
+
+    do {
+        progress = 0;
+        for (i = 0; i < MAX_FEC && d->nb_pending; i++) {
+            if (!d->fec[i].pending)
+                continue;
+            if ((ret = recover_fec(d, &d->fec[i])) < 0)
+                return ret;
+            progress |= ret;
+        }
+    } while (progress);
+    return 0;
+}
+
+int ff_prompeg_dec_add_media(PrompegDecoder *d, const uint8_t *buf, int size)
+{
+    int ret;
+
+    if (size < RTP_HEADER_SIZE || (buf[0] & 0xc0) != 0x80)
+        return AVERROR_INVALIDDATA;
+    if ((ret = store_media(d, buf, size)) < 0)
+        return ret;
+    return d->nb_pending ? process_pending(d) : 0;
+}
+
+int ff_prompeg_dec_add_fec(PrompegDecoder *d, const uint8_t *buf, int size)
+{
+    FecPacket *fec;
+    int offset, na;
+
+    if (size <= FEC_HEADER_SIZE || (buf[0] & 0xc0) != 0x80)
+        return AVERROR_INVALIDDATA;
+    offset = buf[25];
+    na     = buf[26];
+    if (!offset || !na || (buf[24] & 0x80) || (na - 1) * offset >= HISTORY_SIZE / 2) {
+        av_log(d->logctx, AV_LOG_WARNING, "Unsupported FEC packet\n");
+        return AVERROR_PATCHWELCOME;
+    }
+    d->nb_fec++;
+
+    fec = &d->fec[d->fec_next];
+    d->fec_next = (d->fec_next + 1) % MAX_FEC;
+    if (fec->pending)
+        d->nb_pending--;
+    av_fast_malloc(&fec->buf, &fec->alloc, size);
+    if (!fec->buf) {
+        fec->pending = 0;
+        return AVERROR(ENOMEM);
+    }
+    memcpy(fec->buf, buf, size);
+    fec->size    = size;
+    fec->pending = 1;
+    d->nb_pending++;
+
+    return process_pending(d);
+}
+
+int ff_prompeg_dec_get_recovered(PrompegDecoder *d, uint8_t *buf, int size)
+{
+    while (d->nb_recovered_queued) {
+        uint16_t seq = d->recovered[d->recovered_first];
+        const MediaPacket *pkt = get_media(d, seq);
+
+        d->recovered_first = (d->recovered_first + 1) % MAX_RECOVERED;
+        d->nb_recovered_queued--;
+        if (!pkt)
+            continue;
+        size = FFMIN(size, pkt->size);
+        memcpy(buf, pkt->buf, size);
+        return size;
+    }
+    return AVERROR(EAGAIN);
+}
+
+int ff_prompeg_dec_has_recovered(PrompegDecoder *d)
+{
+    return d->nb_recovered_queued > 0;
+}
+
+void ff_prompeg_dec_log_stats(PrompegDecoder *d)
+{
+    av_log(d->logctx, AV_LOG_VERBOSE,
+           "FEC: %"PRId64" FEC packets received, %"PRId64" packets recovered\n",
+           d->nb_fec, d->nb_recovered);
+}
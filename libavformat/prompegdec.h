@@ -0,0 +1,71 @@
+/*
+ * Pro-MPEG Code of Practice #3 Release 2 FEC decoder
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_PROMPEGDEC_H
+#define AVFORMAT_PROMPEGDEC_H
+
+#include <stdint.h>
+
+/**
+ * Recovery of lost RTP packets from the column and row FEC packets of
+ * SMPTE 2022-1 / Pro-MPEG CoP #3, as sent by the prompeg protocol.
+ *
+ * The media packets are passed through unchanged by the caller, which also
+ * gives them to the decoder. Recovered packets are returned later, out of
+ * order, and are to be put back in order by the RTP reordering queue.
+ */
+typedef struct PrompegDecoder PrompegDecoder;
+
+PrompegDecoder *ff_prompeg_dec_alloc(void *logctx);
+
+void ff_prompeg_dec_free(PrompegDecoder **d);
+
+/**
+ * Add a received media RTP packet.
+ *
+ * @return 0 on success, a negative error code on failure
+ */
+int ff_prompeg_dec_add_media(PrompegDecoder *d, const uint8_t *buf, int size);
+
+/**
+ * Add a received FEC RTP packet, and recover the packets it allows to.
+ *
+ * @return 0 on success, a negative error code on failure
+ */
+int ff_prompeg_dec_add_fec(PrompegDecoder *d, const uint8_t *buf, int size);
+
+/**
+ * Get the next recovered media packet.
+ *
+ * @return the size of the packet, AVERROR(EAGAIN) if there is none
+ */
+int ff_prompeg_dec_get_recovered(PrompegDecoder *d, uint8_t *buf, int size);
+
+/**
+ * @return whether a recovered packet can be got
+ */
+int ff_prompeg_dec_has_recovered(PrompegDecoder *d);
+
+/**
+ * Log the number of recovered packets.
+ */
+void ff_prompeg_dec_log_stats(PrompegDecoder *d);
+
+#endif /* AVFORMAT_PROMPEGDEC_H */
@@ -426,28 +426,32 @@ void ff_rtp_send_punch_packets(URLContext *rtp_handle)
     ffurl_write(rtp_handle, buf, ptr - buf);
 }
 
+static RTPPacket *queue_slot(RTPDemuxContext *s, uint16_t seq)
+{
+    return &s->queue[seq & (s->queue_alloc - 1)];
+}
+
+static int is_queued(RTPDemuxContext *s, uint16_t seq)
+{
+    RTPPacket *pkt = queue_slot(s, seq);
+    return pkt->buf && pkt->seq == seq;
+}
+
 static int find_missing_packets(RTPDemuxContext *s, uint16_t *first_missing,
                                 uint16_t *missing_mask)
 {
     int i;
     uint16_t next_seq = s->seq + 1;
-    RTPPacket *pkt = s->queue;
 
-    if (!pkt || pkt->seq == next_seq)
+    if (!s->queue_len || s->queue_first == next_seq)
         return 0;
 
     *missing_mask = 0;
     for (i = 1; i <= 16; i++) {
         uint16_t missing_seq = next_seq + i;
-        while (pkt) {
-            int16_t diff = pkt->seq - missing_seq;
-            if (diff >= 0)
-                break;
-            pkt = pkt->next;
-        }
-        if (!pkt)
+        if ((int16_t)(missing_seq - s->queue_last) > 0)
             break;
-        if (pkt->seq == missing_seq)
+        if (is_queued(s, missing_seq))
             continue;
         *missing_mask |= 1 << (i - 1);
     }
@@ -746,39 +750,65 @@ static int rtp_parse_packet_internal(RTPDemuxContext *s, AVPacket *pkt,
 
 void ff_rtp_reset_packet_queue(RTPDemuxContext *s)
 {
-    while (s->queue) {
-        RTPPacket *next = s->queue->next;
-        av_freep(&s->queue->buf);
-        av_freep(&s->queue);
-        s->queue = next;
+    int i;
+
+    for (i = 0; i < s->queue_alloc && s->queue_len; i++) {
+        if (s->queue[i].buf) {
+            av_freep(&s->queue[i].buf);
+            s->queue_len--;
+        }
     }
     s->seq       = 0;
     s->queue_len = 0;
     s->prev_ret  = 0;
 }
 
+/* Make room for packets up to span sequence numbers after the last returned
+ * one. All the queued packets are within this span, so they keep distinct
+ * slots when moved. */
+static int grow_queue(RTPDemuxContext *s, int span)
+{
+    RTPPacket *queue;
+    int i, alloc = FFMAX(s->queue_alloc, 16);
+
+    while (alloc < span || alloc < 2 * s->queue_size)
+        alloc <<= 1;
+    queue = av_calloc(alloc, sizeof(*queue));
+    if (!queue)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < s->queue_alloc; i++)
+        if (s->queue[i].buf)
+            queue[s->queue[i].seq & (alloc - 1)] = s->queue[i];
+    av_free(s->queue);
+    s->queue       = queue;
+    s->queue_alloc = alloc;
+    return 0;
+}
+
 static int enqueue_packet(RTPDemuxContext *s, uint8_t *buf, int len)
 {
-    uint16_t seq   = AV_RB16(buf + 2);
-    RTPPacket **cur = &s->queue, *packet;
+    uint16_t seq = AV_RB16(buf + 2);
+    uint16_t span = seq - s->seq;
+    RTPPacket *packet;
+    int ret;
 
-    /* Find the correct place in the queue to insert the packet */
-    while (*cur) {
-        int16_t diff = seq - (*cur)->seq;
-        if (diff < 0)
-            break;
-        cur = &(*cur)->next;
-    }
+    if (span > s->queue_alloc && (ret = grow_queue(s, span)) < 0)
+        return ret;
 
-    packet = av_mallocz(sizeof(*packet));
-    if (!packet)
-        return AVERROR(ENOMEM);
+    packet = queue_slot(s, seq);
+    if (packet->buf) {
+        av_log(s->ic, AV_LOG_DEBUG, "RTP: dropping duplicate packet %d\n", seq);
+        return AVERROR_INVALIDDATA;
+    }
     packet->recvtime = av_gettime_relative();
     packet->seq      = seq;
     packet->len      = len;
     packet->buf      = buf;
-    packet->next     = *cur;
-    *cur = packet;
+
+    if (!s->queue_len || (int16_t)(seq - s->queue_first) < 0)
+        s->queue_first = seq;
+    if (!s->queue_len || (int16_t)(seq - s->queue_last) > 0)
+        s->queue_last = seq;
     s->queue_len++;
 
     return 0;
@@ -786,33 +816,52 @@ static int enqueue_packet(RTPDemuxContext *s, uint8_t *buf, int len)
 
 static int has_next_packet(RTPDemuxContext *s)
 {
-    return s->queue && s->queue->seq == (uint16_t) (s->seq + 1);
+    return s->queue_len && s->queue_first == (uint16_t) (s->seq + 1);
 }
 
 int64_t ff_rtp_queued_packet_time(RTPDemuxContext *s)
 {
-    return s->queue ? s->queue->recvtime : 0;
+    return s->queue_len ? queue_slot(s, s->queue_first)->recvtime : 0;
+}
+
+/* Track the delay of packets that arrive after later ones: increase it
+ * immediately, decrease it slowly. */
+static void update_late_delay(RTPDemuxContext *s, int64_t delay)
+{
+    if (delay > s->late_delay)
+        s->late_delay = delay;
+    else
+        s->late_delay -= (s->late_delay - delay) >> 4;
+}
+
+int64_t ff_rtp_reorder_delay(RTPDemuxContext *s, int64_t max_delay)
+{
+    AVRational time_base = s->st ? s->st->time_base : (AVRational){ 1, 90000 };
+    int64_t jitter = av_rescale_q(s->statistics.jitter >> 4, time_base, AV_TIME_BASE_Q);
+
+    return FFMIN(FFMAX(2 * s->late_delay, 4 * jitter), max_delay);
 }
 
 static int rtp_parse_queued_packet(RTPDemuxContext *s, AVPacket *pkt)
 {
     int rv;
-    RTPPacket *next;
+    RTPPacket *packet;
 
     if (s->queue_len <= 0)
         return -1;
 
-    if (!has_next_packet(s))
+    packet = queue_slot(s, s->queue_first);
+    if (!has_next_packet(s)) {
         av_log(s->ic, AV_LOG_WARNING,
-               "RTP: missed %d packets\n", s->queue->seq - s->seq - 1);
+               "RTP: missed %d packets\n", (uint16_t)(s->queue_first - s->seq - 1));
+        s->skip_time = av_gettime_relative();
+    }
 
     /* Parse the first packet in the queue, and dequeue it */
-    rv   = rtp_parse_packet_internal(s, pkt, s->queue->buf, s->queue->len);
-    next = s->queue->next;
-    av_freep(&s->queue->buf);
-    av_freep(&s->queue);
-    s->queue = next;
-    s->queue_len--;
+    rv = rtp_parse_packet_internal(s, pkt, packet->buf, packet->len);
+    av_freep(&packet->buf);
+    if (--s->queue_len)
+        while (!is_queued(s, ++s->queue_first));
     return rv;
 }
 
@@ -852,17 +901,18 @@ static int rtp_parse_one_packet(RTPDemuxContext *s, AVPacket *pkt,
         return rtcp_parse_packet(s, buf, len);
     }
 
-    if (s->st) {
+    {
         int64_t received = av_gettime_relative();
-        uint32_t arrival_ts = av_rescale_q(received, AV_TIME_BASE_Q,
-                                           s->st->time_base);
+        /* MPEG-TS streams have no AVStream, but use a 90 kHz clock */
+        AVRational time_base = s->st ? s->st->time_base : (AVRational){ 1, 90000 };
+        uint32_t arrival_ts = av_rescale_q(received, AV_TIME_BASE_Q, time_base);
         timestamp = AV_RB32(buf + 4);
         // Calculate the jitter immediately, before queueing the packet
         // into the reordering queue.
         rtcp_update_jitter(&s->statistics, timestamp, arrival_ts);
     }
 
-    if ((s->seq == 0 && !s->queue) || s->queue_size <= 1) {
+    if ((s->seq == 0 && !s->queue_len) || s->queue_size <= 1) {
         /* First packet, or no reordering */
         return rtp_parse_packet_internal(s, pkt, buf, len);
     } else {
@@ -872,9 +922,22 @@ static int rtp_parse_one_packet(RTPDemuxContext *s, AVPacket *pkt,
             /* Packet older than the previously emitted one, drop */
             av_log(s->ic, AV_LOG_WARNING,
                    "RTP: dropping old packet received too late\n");
+            /* it would have been needed at least this late */
+            if (s->skip_time) {
+                update_late_delay(s, av_gettime_relative() - s->skip_time +
+                                     s->late_delay);
+                s->skip_time = 0;
+            }
             return -1;
-        } else if (diff <= 1) {
+        } else if (diff == 0) {
+            /* e.g. a lost packet recovered by FEC and then received */
+            av_log(s->ic, AV_LOG_DEBUG, "RTP: dropping duplicate packet %d\n", seq);
+            return -1;
+        } else if (diff == 1) {
             /* Correct packet */
+            if (s->queue_len)
+                update_late_delay(s, av_gettime_relative() -
+                                     ff_rtp_queued_packet_time(s));
             rv = rtp_parse_packet_internal(s, pkt, buf, len);
             return rv;
         } else {
@@ -919,6 +982,7 @@ int ff_rtp_parse_packet(RTPDemuxContext *s, AVPacket *pkt,
 void ff_rtp_parse_close(RTPDemuxContext *s)
 {
     ff_rtp_reset_packet_queue(s);
+    av_freep(&s->queue);
     ff_srtp_free(&s->srtp);
     av_free(s);
 }
@@ -50,6 +50,14 @@ int ff_rtp_parse_packet(RTPDemuxContext *s, AVPacket *pkt,
                         uint8_t **buf, int len);
 void ff_rtp_parse_close(RTPDemuxContext *s);
 int64_t ff_rtp_queued_packet_time(RTPDemuxContext *s);
+/**
+ * Get the time to wait for missing packets before returning the queued ones,
+ * adapted to the delays observed for late packets and to the jitter.
+ *
+ * @param max_delay maximum delay in microseconds
+ * @return the delay in microseconds
+ */
+int64_t ff_rtp_reorder_delay(RTPDemuxContext *s, int64_t max_delay);
 void ff_rtp_reset_packet_queue(RTPDemuxContext *s);
 
 /**
@@ -138,10 +146,9 @@ struct RTPDynamicProtocolHandler {
 
 typedef struct RTPPacket {
     uint16_t seq;
-    uint8_t *buf;
+    uint8_t *buf;       ///< NULL if the queue slot is free
     int len;
     int64_t recvtime;
-    struct RTPPacket *next;
 } RTPPacket;
 
 struct RTPDemuxContext {
@@ -166,9 +173,14 @@ struct RTPDemuxContext {
 
     /** Fields for packet reordering @{ */
     int prev_ret;     ///< The return value of the actual parsing of the previous packet
-    RTPPacket* queue; ///< A sorted queue of buffered packets not yet returned
+    RTPPacket* queue; ///< Buffered packets not yet returned, indexed by sequence number modulo queue_alloc
+    int queue_alloc;  ///< The number of slots in queue, a power of two
     int queue_len;    ///< The number of packets in queue
     int queue_size;   ///< The size of queue, or 0 if reordering is disabled
+    uint16_t queue_first; ///< Sequence number of the first packet in queue
+    uint16_t queue_last;  ///< Sequence number of the last packet in queue
+    int64_t late_delay;   ///< Estimated delay of late packets, in microseconds
+    int64_t skip_time;    ///< Time of the last forced return of a queued packet
     /*@}*/
 
     /* rtcp sender statistics receive */
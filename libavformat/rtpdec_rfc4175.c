@@ -24,6 +24,8 @@
 #include "avio_internal.h"
 #include "rtpdec_formats.h"
 #include "libavutil/avstring.h"
+#include "libavutil/buffer.h"
+#include "libavutil/intreadwrite.h"
 #include "libavutil/pixdesc.h"
 
 struct PayloadContext {
@@ -32,12 +34,25 @@ struct PayloadContext {
     int width;
     int height;
 
-    uint8_t *frame;
+    /* The lines of each packet are copied straight to their place in a
+     * frame sized buffer, taken from a pool to avoid allocating and
+     * faulting in several megabytes per frame. */
+    AVBufferPool *pool;
+    AVBufferRef *frame;
     unsigned int frame_size;
+    unsigned int frame_received; /* bytes of the current frame received */
     unsigned int pgroup; /* size of the pixel group in bytes */
     unsigned int xinc;
 
     uint32_t timestamp;
+
+    /* loss accounting, using the extended sequence numbers */
+    void *logctx;
+    int have_seq;
+    uint32_t ext_seq;
+    int64_t nb_frames;
+    int64_t nb_incomplete_frames;
+    int64_t nb_lost_packets;
 };
 
 static int rfc4175_parse_format(AVStream *stream, PayloadContext *data)
@@ -70,6 +85,12 @@ static int rfc4175_parse_format(AVStream *stream, PayloadContext *data)
     stream->codecpar->bits_per_coded_sample = bits_per_sample;
     data->frame_size = data->width * data->height * data->pgroup / data->xinc;
 
+    av_buffer_pool_uninit(&data->pool);
+    data->pool = av_buffer_pool_init(data->frame_size + AV_INPUT_BUFFER_PADDING_SIZE,
+                                     av_buffer_allocz);
+    if (!data->pool)
+        return AVERROR(ENOMEM);
+
     return 0;
 }
 
@@ -123,17 +144,39 @@ static int rfc4175_parse_sdp_line(AVFormatContext *s, int st_index,
 static int rfc4175_finalize_packet(PayloadContext *data, AVPacket *pkt,
                                    int stream_index)
 {
-   int ret;
+    /* The parts of the frame not received keep the content of the pool
+     * buffer: an arbitrary earlier frame, not necessarily the previous one,
+     * or zeroes if the buffer has not been used yet. */
+    if (data->frame_received < data->frame_size) {
+        av_log(data->logctx, AV_LOG_WARNING,
+               "Incomplete frame: %u of %u bytes received\n",
+               data->frame_received, data->frame_size);
+        pkt->flags |= AV_PKT_FLAG_CORRUPT;
+        data->nb_incomplete_frames++;
+    }
+    data->nb_frames++;
 
-   pkt->stream_index = stream_index;
-   ret = av_packet_from_data(pkt, data->frame, data->frame_size);
-   if (ret < 0) {
-       av_freep(&data->frame);
-   }
+    pkt->stream_index = stream_index;
+    pkt->buf  = data->frame;
+    pkt->data = data->frame->data;
+    pkt->size = data->frame_size;
+    data->frame = NULL;
 
-   data->frame = NULL;
+    return 0;
+}
 
-   return ret;
+static void rfc4175_update_seq(PayloadContext *data, const uint8_t *buf,
+                               uint16_t seq)
+{
+    uint32_t ext_seq = AV_RB16(buf) << 16 | seq;
+    uint32_t diff = ext_seq - data->ext_seq;
+
+    /* the packets have been reordered already, so gaps are losses */
+    if (data->have_seq && diff > 1 && diff < 1U << 31)
+        data->nb_lost_packets += diff - 1;
+    if (!data->have_seq || diff < 1U << 31)
+        data->ext_seq = ext_seq;
+    data->have_seq = 1;
 }
 
 static int rfc4175_handle_packet(AVFormatContext *ctx, PayloadContext *data,
@@ -149,7 +192,15 @@ static int rfc4175_handle_packet(AVFormatContext *ctx, PayloadContext *data,
 
     uint8_t *dest;
 
-    if (*timestamp != data->timestamp) {
+    if (!data->pool)
+        return AVERROR_INVALIDDATA;
+    if (len < 2)
+        return AVERROR_INVALIDDATA;
+
+    data->logctx = ctx;
+    rfc4175_update_seq(data, buf, seq);
+
+    if (*timestamp != data->timestamp || !data->frame) {
         if (data->frame) {
             /*
              * if we're here, it means that two RTP packets didn't have the
@@ -163,7 +214,7 @@ static int rfc4175_handle_packet(AVFormatContext *ctx, PayloadContext *data,
             rfc4175_finalize_packet(data, pkt, st->index);
         }
 
-        data->frame = av_malloc(data->frame_size);
+        data->frame = av_buffer_pool_get(data->pool);
 
         data->timestamp = *timestamp;
 
@@ -171,6 +222,9 @@ static int rfc4175_handle_packet(AVFormatContext *ctx, PayloadContext *data,
             av_log(ctx, AV_LOG_ERROR, "Out of memory.\n");
             return AVERROR(ENOMEM);
         }
+        memset(data->frame->data + data->frame_size, 0,
+               AV_INPUT_BUFFER_PADDING_SIZE);
+        data->frame_received = 0;
     }
 
     /*
@@ -210,8 +264,9 @@ static int rfc4175_handle_packet(AVFormatContext *ctx, PayloadContext *data,
         if (copy_offset + length > data->frame_size)
             return AVERROR_INVALIDDATA;
 
-        dest = data->frame + copy_offset;
+        dest = data->frame->data + copy_offset;
         memcpy(dest, payload, length);
+        data->frame_received += length;
 
         payload += length;
         payload_len -= length;
@@ -226,11 +281,25 @@ static int rfc4175_handle_packet(AVFormatContext *ctx, PayloadContext *data,
     return AVERROR(EAGAIN);
 }
 
+static void rfc4175_close(PayloadContext *data)
+{
+    if (data->nb_frames)
+        av_log(data->logctx, AV_LOG_VERBOSE,
+               "%"PRId64" frames received, %"PRId64" incomplete, "
+               "%"PRId64" packets lost\n",
+               data->nb_frames, data->nb_incomplete_frames,
+               data->nb_lost_packets);
+    av_buffer_unref(&data->frame);
+    av_buffer_pool_uninit(&data->pool);
+    av_freep(&data->sampling);
+}
+
 const RTPDynamicProtocolHandler ff_rfc4175_rtp_handler = {
     .enc_name           = "raw",
     .codec_type         = AVMEDIA_TYPE_VIDEO,
     .codec_id           = AV_CODEC_ID_BITPACKED,
     .priv_data_size     = sizeof(PayloadContext),
     .parse_sdp_a_line   = rfc4175_parse_sdp_line,
+    .close              = rfc4175_close,
     .parse_packet       = rfc4175_handle_packet,
 };
@@ -38,6 +38,7 @@
 #include "internal.h"
 #include "network.h"
 #include "os_support.h"
+#include "prompegdec.h"
 #include <fcntl.h>
 #if HAVE_POLL_H
 #include <poll.h>
@@ -46,7 +47,10 @@
 typedef struct RTPContext {
     const AVClass *class;
     URLContext *rtp_hd, *rtcp_hd, *fec_hd;
+    URLContext *fec_col_hd, *fec_row_hd;
     int rtp_fd, rtcp_fd;
+    PrompegDecoder *fec_dec;
+    uint8_t *fec_buf;
     IPSourceFilters filters;
     int write_to_source;
     struct sockaddr_storage last_rtp_source, last_rtcp_source;
@@ -61,6 +65,10 @@ typedef struct RTPContext {
     char *block;
     char *fec_options_str;
     int64_t rw_timeout;
+    int batch_size;
+    uint8_t *batch_buf;
+    FFDatagram batch[FF_DATAGRAM_BATCH_MAX];
+    int batch_pos, batch_count;
 } RTPContext;
 
 #define OFFSET(x) offsetof(RTPContext, x)
@@ -79,7 +87,8 @@ static const AVOption options[] = {
     { "timeout",            "set timeout (in microseconds) of socket I/O operations",           OFFSET(rw_timeout),      AV_OPT_TYPE_INT64,  { .i64 = -1 },    -1, INT64_MAX, .flags = D|E },
     { "sources",            "Source list",                                                      OFFSET(sources),         AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
     { "block",              "Block list",                                                       OFFSET(block),           AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
-    { "fec",                "FEC",                                                              OFFSET(fec_options_str), AV_OPT_TYPE_STRING, { .str = NULL },               .flags = E },
+    { "batch_size",         "Maximum number of RTP packets received per system call",          OFFSET(batch_size),      AV_OPT_TYPE_INT,    { .i64 =  1 },     1, FF_DATAGRAM_BATCH_MAX, .flags = D },
+    { "fec",                "FEC",                                                              OFFSET(fec_options_str), AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
     { NULL }
 };
 
@@ -209,6 +218,7 @@ static void build_udp_url(RTPContext *s,
  *         'block=ip[,ip]'    : list disallowed source IP addresses
  *         'write_to_source=0/1' : send packets to the source address of the latest received packet
  *         'dscp=n'           : set DSCP value to n (QoS)
+ *         'batch_size=n'     : receive up to n RTP packets per system call
  * deprecated option:
  *         'localport=n'      : set the local port to n
  *
@@ -270,6 +280,9 @@ static int rtp_open(URLContext *h, const char *uri, int flags)
         if (av_find_info_tag(buf, sizeof(buf), "timeout", p)) {
             s->rw_timeout = strtol(buf, NULL, 10);
         }
+        if (av_find_info_tag(buf, sizeof(buf), "batch_size", p)) {
+            s->batch_size = av_clip(strtol(buf, NULL, 10), 1, FF_DATAGRAM_BATCH_MAX);
+        }
         if (av_find_info_tag(buf, sizeof(buf), "sources", p)) {
             av_strlcpy(include_sources, buf, sizeof(include_sources));
             ff_ip_parse_sources(h, buf, &s->filters);
@@ -348,7 +361,24 @@ static int rtp_open(URLContext *h, const char *uri, int flags)
     }
 
     s->fec_hd = NULL;
-    if (fec_protocol) {
+    if (fec_protocol && (flags & AVIO_FLAG_READ)) {
+        /* receive the column and row FEC packets sent by the prompeg
+         * protocol to the ports following the RTCP one */
+        build_udp_url(s, buf, sizeof(buf), hostname, rtp_port + 2,
+                      s->local_rtpport + 2, sources, block);
+        if (ffurl_open_whitelist(&s->fec_col_hd, buf, AVIO_FLAG_READ, &h->interrupt_callback,
+                                 NULL, h->protocol_whitelist, h->protocol_blacklist, h) < 0)
+            goto fail;
+        build_udp_url(s, buf, sizeof(buf), hostname, rtp_port + 4,
+                      s->local_rtpport + 4, sources, block);
+        if (ffurl_open_whitelist(&s->fec_row_hd, buf, AVIO_FLAG_READ, &h->interrupt_callback,
+                                 NULL, h->protocol_whitelist, h->protocol_blacklist, h) < 0)
+            goto fail;
+        s->fec_dec = ff_prompeg_dec_alloc(h);
+        s->fec_buf = av_malloc(s->fec_col_hd->max_packet_size);
+        if (!s->fec_dec || !s->fec_buf)
+            goto fail;
+    } else if (fec_protocol) {
         ff_url_join(buf, sizeof(buf), fec_protocol, NULL, hostname, rtp_port, NULL);
         if (ffurl_open_whitelist(&s->fec_hd, buf, flags, &h->interrupt_callback,
                              &fec_opts, h->protocol_whitelist, h->protocol_blacklist, h) < 0)
@@ -363,6 +393,16 @@ static int rtp_open(URLContext *h, const char *uri, int flags)
     h->max_packet_size = s->rtp_hd->max_packet_size;
     h->is_streamed = 1;
 
+    if ((flags & AVIO_FLAG_READ) && s->batch_size > 1) {
+        s->batch_buf = av_malloc_array(s->batch_size, h->max_packet_size);
+        if (!s->batch_buf)
+            goto fail;
+        for (i = 0; i < s->batch_size; i++) {
+            s->batch[i].buf  = s->batch_buf + i * h->max_packet_size;
+            s->batch[i].size = h->max_packet_size;
+        }
+    }
+
     av_free(fec_protocol);
     av_dict_free(&fec_opts);
 
@@ -372,30 +412,121 @@ static int rtp_open(URLContext *h, const char *uri, int flags)
     ffurl_closep(&s->rtp_hd);
     ffurl_closep(&s->rtcp_hd);
     ffurl_closep(&s->fec_hd);
+    ffurl_closep(&s->fec_col_hd);
+    ffurl_closep(&s->fec_row_hd);
+    ff_prompeg_dec_free(&s->fec_dec);
+    av_freep(&s->fec_buf);
+    av_freep(&s->batch_buf);
     av_free(fec_protocol);
     av_dict_free(&fec_opts);
     return AVERROR(EIO);
 }
 
+/* Give a received RTP packet to the FEC decoder, if any. */
+static int rtp_fec_add_media(RTPContext *s, const uint8_t *buf, int len)
+{
+    int ret;
+
+    if (!s->fec_dec || len < 12 || RTP_PT_IS_RTCP(buf[1]))
+        return len;
+    ret = ff_prompeg_dec_add_media(s->fec_dec, buf, len);
+    return ret == AVERROR(ENOMEM) ? ret : len;
+}
+
+/* Read the pending packets of a FEC socket and return the first packet
+ * they allowed to recover, if any. */
+static int rtp_read_fec(RTPContext *s, int fd, uint8_t *buf, int size)
+{
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    int len, ret;
+
+    for (;;) {
+        addr_len = sizeof(addr);
+        len = recvfrom(fd, s->fec_buf, s->fec_col_hd->max_packet_size, 0,
+                       (struct sockaddr *)&addr, &addr_len);
+        if (len < 0)
+            break;
+        if (ff_ip_check_source_lists(&addr, &s->filters))
+            continue;
+        ret = ff_prompeg_dec_add_fec(s->fec_dec, s->fec_buf, len);
+        if (ret == AVERROR(ENOMEM))
+            return ret;
+    }
+    return ff_prompeg_dec_get_recovered(s->fec_dec, buf, size);
+}
+
+/* Return the next RTP packet left from the last batch, if any. */
+static int rtp_read_batch(RTPContext *s, uint8_t *buf, int size)
+{
+    while (s->batch_pos < s->batch_count) {
+        FFDatagram *dg = &s->batch[s->batch_pos++];
+        int len = FFMIN(dg->len, size);
+
+        if (ff_ip_check_source_lists(&dg->addr, &s->filters))
+            continue;
+        s->last_rtp_source     = dg->addr;
+        s->last_rtp_source_len = dg->addr_len;
+        memcpy(buf, dg->buf, len);
+        return len;
+    }
+    return AVERROR(EAGAIN);
+}
+
 static int rtp_read(URLContext *h, uint8_t *buf, int size)
 {
     RTPContext *s = h->priv_data;
     int len, n, i;
-    struct pollfd p[2] = {{s->rtp_fd, POLLIN, 0}, {s->rtcp_fd, POLLIN, 0}};
+    struct pollfd p[4] = {{s->rtp_fd, POLLIN, 0}, {s->rtcp_fd, POLLIN, 0}};
+    int nb_fds = 2;
     int poll_delay = h->flags & AVIO_FLAG_NONBLOCK ? 0 : POLLING_TIME;
     struct sockaddr_storage *addrs[2] = { &s->last_rtp_source, &s->last_rtcp_source };
     socklen_t *addr_lens[2] = { &s->last_rtp_source_len, &s->last_rtcp_source_len };
     int runs = h->rw_timeout / 1000 / POLLING_TIME;
 
+    if (s->fec_dec) {
+        p[2] = (struct pollfd){ ffurl_get_file_handle(s->fec_col_hd), POLLIN, 0 };
+        p[3] = (struct pollfd){ ffurl_get_file_handle(s->fec_row_hd), POLLIN, 0 };
+        nb_fds = 4;
+    }
+
     for(;;) {
         if (ff_check_interrupt(&h->interrupt_callback))
             return AVERROR_EXIT;
-        n = poll(p, 2, poll_delay);
+        if (s->fec_dec) {
+            len = ff_prompeg_dec_get_recovered(s->fec_dec, buf, size);
+            if (len >= 0)
+                return len;
+        }
+        len = rtp_read_batch(s, buf, size);
+        if (len >= 0)
+            return rtp_fec_add_media(s, buf, len);
+        n = poll(p, nb_fds, poll_delay);
         if (n > 0) {
-            /* first try RTCP, then RTP */
-            for (i = 1; i >= 0; i--) {
+            /* first try FEC, then RTCP, then RTP */
+            for (i = nb_fds - 1; i >= 0; i--) {
                 if (!(p[i].revents & POLLIN))
                     continue;
+                if (i >= 2) {
+                    len = rtp_read_fec(s, p[i].fd, buf, size);
+                    if (len >= 0 || len == AVERROR(ENOMEM))
+                        return len;
+                    continue;
+                }
+                if (i == 0 && s->batch_buf) {
+                    len = ff_recv_datagrams(p[i].fd, s->batch, s->batch_size, 0);
+                    if (len < 0) {
+                        if (len == AVERROR(EAGAIN) || len == AVERROR(EINTR))
+                            continue;
+                        return AVERROR(EIO);
+                    }
+                    s->batch_count = len;
+                    s->batch_pos   = 0;
+                    len = rtp_read_batch(s, buf, size);
+                    if (len < 0)
+                        continue;
+                    return rtp_fec_add_media(s, buf, len);
+                }
                 *addr_lens[i] = sizeof(*addrs[i]);
                 len = recvfrom(p[i].fd, buf, size, 0,
                                 (struct sockaddr *)addrs[i], addr_lens[i]);
@@ -407,7 +538,7 @@ static int rtp_read(URLContext *h, uint8_t *buf, int size)
                 }
                 if (ff_ip_check_source_lists(addrs[i], &s->filters))
                     continue;
-                return len;
+                return i ? len : rtp_fec_add_media(s, buf, len);
             }
         } else if (n == 0 && h->rw_timeout > 0 && --runs <= 0) {
             return AVERROR(ETIMEDOUT);
@@ -516,9 +647,24 @@ static int rtp_close(URLContext *h)
     ffurl_closep(&s->rtp_hd);
     ffurl_closep(&s->rtcp_hd);
     ffurl_closep(&s->fec_hd);
+    ffurl_closep(&s->fec_col_hd);
+    ffurl_closep(&s->fec_row_hd);
+    if (s->fec_dec)
+        ff_prompeg_dec_log_stats(s->fec_dec);
+    ff_prompeg_dec_free(&s->fec_dec);
+    av_freep(&s->fec_buf);
+    av_freep(&s->batch_buf);
     return 0;
 }
 
+int ff_rtp_has_buffered_packets(URLContext *h)
+{
+    RTPContext *s = h->priv_data;
+
+    return s->batch_pos < s->batch_count ||
+           (s->fec_dec && ff_prompeg_dec_has_recovered(s->fec_dec));
+}
+
 /**
  * Return the local rtp port used by the RTP connection
  * @param h media file context
@@ -547,12 +693,17 @@ static int rtp_get_multi_file_handle(URLContext *h, int **handles,
                                      int *numhandles)
 {
     RTPContext *s = h->priv_data;
-    int *hs       = *handles = av_malloc(sizeof(**handles) * 2);
+    int *hs       = *handles = av_malloc(sizeof(**handles) * 4);
     if (!hs)
         return AVERROR(ENOMEM);
     hs[0] = s->rtp_fd;
     hs[1] = s->rtcp_fd;
     *numhandles = 2;
+    if (s->fec_dec) {
+        hs[2] = ffurl_get_file_handle(s->fec_col_hd);
+        hs[3] = ffurl_get_file_handle(s->fec_row_hd);
+        *numhandles = 4;
+    }
     return 0;
 }
 
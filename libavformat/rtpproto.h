@@ -27,4 +27,10 @@ int ff_rtp_set_remote_url(URLContext *h, const char *uri);
 
 int ff_rtp_get_local_rtp_port(URLContext *h);
 
+/**
+ * Check whether packets already received from the sockets are waiting to
+ * be read, in which case polling the sockets does not report them.
+ */
+int ff_rtp_has_buffered_packets(URLContext *h);
+
 #endif /* AVFORMAT_RTPPROTO_H */
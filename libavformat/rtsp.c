@@ -73,6 +73,7 @@
 
 #define COMMON_OPTS() \
     { "reorder_queue_size", "set number of packets to buffer for handling of reordered packets", OFFSET(reordering_queue_size), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, INT_MAX, DEC }, \
+    { "adaptive_reorder_delay", "adapt the time to wait for reordered packets to the observed delays, up to max_delay", OFFSET(adaptive_reorder_delay), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, DEC }, \
     { "buffer_size",        "Underlying protocol send/receive buffer size",                  OFFSET(buffer_size),           AV_OPT_TYPE_INT, { .i64 = -1 }, -1, INT_MAX, DEC|ENC }, \
     { "pkt_size",           "Underlying protocol send packet size",                          OFFSET(pkt_size),              AV_OPT_TYPE_INT, { .i64 = -1 }, -1, INT_MAX, ENC } \
 
@@ -114,6 +115,8 @@ static const AVOption sdp_options[] = {
     { "rtcp_to_source", "send RTCP packets to the source address of received packets", 0, AV_OPT_TYPE_CONST, {.i64 = RTSP_FLAG_RTCP_TO_SOURCE}, 0, 0, DEC, "rtsp_flags" },
     { "listen_timeout", "set maximum timeout (in seconds) to wait for incoming connections", OFFSET(initial_timeout), AV_OPT_TYPE_INT, {.i64 = READ_PACKET_TIMEOUT_S}, INT_MIN, INT_MAX, DEC },
     RTSP_MEDIATYPE_OPTS("allowed_media_types", "set media types to accept from the server"),
+    { "fec", "set the FEC scheme used to recover lost packets", OFFSET(fec), AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, DEC },
+    { "batch_size", "set the maximum number of RTP packets received per system call", OFFSET(batch_size), AV_OPT_TYPE_INT, {.i64 = 1}, 1, FF_DATAGRAM_BATCH_MAX, DEC },
     COMMON_OPTS(),
     { NULL },
 };
@@ -122,6 +125,8 @@ static const AVOption rtp_options[] = {
     RTSP_FLAG_OPTS("rtp_flags", "set RTP flags"),
     { "listen_timeout", "set maximum timeout (in seconds) to wait for incoming connections", OFFSET(initial_timeout), AV_OPT_TYPE_INT, {.i64 = READ_PACKET_TIMEOUT_S}, INT_MIN, INT_MAX, DEC },
     RTSP_MEDIATYPE_OPTS("allowed_media_types", "set media types to accept from the server"),
+    { "fec", "set the FEC scheme used to recover lost packets", OFFSET(fec), AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, DEC },
+    { "batch_size", "set the maximum number of RTP packets received per system call", OFFSET(batch_size), AV_OPT_TYPE_INT, {.i64 = 1}, 1, FF_DATAGRAM_BATCH_MAX, DEC },
     COMMON_OPTS(),
     { NULL },
 };
@@ -136,6 +141,10 @@ static AVDictionary *map_to_opts(RTSPState *rt)
     av_dict_set(&opts, "buffer_size", buf, 0);
     snprintf(buf, sizeof(buf), "%d", rt->pkt_size);
     av_dict_set(&opts, "pkt_size", buf, 0);
+    if (rt->batch_size > 1)
+        av_dict_set_int(&opts, "batch_size", rt->batch_size, 0);
+    if (rt->fec)
+        av_dict_set(&opts, "fec", rt->fec, 0);
 
     return opts;
 }
@@ -2038,7 +2047,7 @@ static int udp_read_packet(AVFormatContext *s, RTSPStream **prtsp_st,
     int runs = rt->initial_timeout * 1000LL / POLLING_TIME;
 
     if (!p) {
-        p = rt->p = av_malloc_array(2 * rt->nb_rtsp_streams + 1, sizeof(*p));
+        p = rt->p = av_malloc_array(4 * rt->nb_rtsp_streams + 1, sizeof(*p));
         if (!p)
             return AVERROR(ENOMEM);
 
@@ -2054,7 +2063,7 @@ static int udp_read_packet(AVFormatContext *s, RTSPStream **prtsp_st,
                     av_log(s, AV_LOG_ERROR, "Unable to recover rtp ports\n");
                     return ret;
                 }
-                if (fdsnum != 2) {
+                if (fdsnum != 2 && fdsnum != 4) {
                     av_log(s, AV_LOG_ERROR,
                            "Number of fds %d not supported\n", fdsnum);
                     return AVERROR_INVALIDDATA;
@@ -2063,30 +2072,51 @@ static int udp_read_packet(AVFormatContext *s, RTSPStream **prtsp_st,
                     p[rt->max_p].fd       = fds[fdsidx];
                     p[rt->max_p++].events = POLLIN;
                 }
+                rtsp_st->nb_poll_fds = fdsnum;
                 av_freep(&fds);
             }
         }
     }
 
     for (;;) {
+        int timeout = POLLING_TIME;
         if (ff_check_interrupt(&s->interrupt_callback))
             return AVERROR_EXIT;
-        if (wait_end && wait_end - av_gettime_relative() < 0)
-            return AVERROR(EAGAIN);
-        n = poll(p, rt->max_p, POLLING_TIME);
+        if (wait_end) {
+            int64_t left = wait_end - av_gettime_relative();
+            if (left < 0)
+                return AVERROR(EAGAIN);
+            /* do not hold reordered packets longer than needed */
+            timeout = FFMIN(timeout, left / 1000 + 1);
+        }
+        for (i = 0; i < rt->nb_rtsp_streams; i++) {
+            rtsp_st = rt->rtsp_streams[i];
+            if (rtsp_st->rtp_handle &&
+                ff_rtp_has_buffered_packets(rtsp_st->rtp_handle)) {
+                ret = ffurl_read(rtsp_st->rtp_handle, buf, buf_size);
+                if (ret > 0) {
+                    *prtsp_st = rtsp_st;
+                    return ret;
+                }
+            }
+        }
+        n = poll(p, rt->max_p, timeout);
         if (n > 0) {
             int j = rt->rtsp_hd ? 1 : 0;
             for (i = 0; i < rt->nb_rtsp_streams; i++) {
                 rtsp_st = rt->rtsp_streams[i];
                 if (rtsp_st->rtp_handle) {
-                    if (p[j].revents & POLLIN || p[j+1].revents & POLLIN) {
+                    for (fdsidx = 0; fdsidx < rtsp_st->nb_poll_fds; fdsidx++)
+                        if (p[j + fdsidx].revents & POLLIN)
+                            break;
+                    if (fdsidx < rtsp_st->nb_poll_fds) {
                         ret = ffurl_read(rtsp_st->rtp_handle, buf, buf_size);
                         if (ret > 0) {
                             *prtsp_st = rtsp_st;
                             return ret;
                         }
                     }
-                    j+=2;
+                    j += rtsp_st->nb_poll_fds;
                 }
             }
 #if CONFIG_RTSP_DEMUXER
@@ -2221,25 +2251,24 @@ int ff_rtsp_fetch_packet(AVFormatContext *s, AVPacket *pkt)
 redo:
     if (rt->transport == RTSP_TRANSPORT_RTP) {
         int i;
-        int64_t first_queue_time = 0;
+        wait_end       = 0;
+        first_queue_st = NULL;
         for (i = 0; i < rt->nb_rtsp_streams; i++) {
             RTPDemuxContext *rtpctx = rt->rtsp_streams[i]->transport_priv;
-            int64_t queue_time;
+            int64_t queue_time, queue_end;
             if (!rtpctx)
                 continue;
             queue_time = ff_rtp_queued_packet_time(rtpctx);
-            if (queue_time && (queue_time - first_queue_time < 0 ||
-                               !first_queue_time)) {
-                first_queue_time = queue_time;
-                first_queue_st   = rt->rtsp_streams[i];
+            if (!queue_time)
+                continue;
+            queue_end = queue_time + (rt->adaptive_reorder_delay ?
+                                      ff_rtp_reorder_delay(rtpctx, s->max_delay) :
+                                      s->max_delay);
+            if (!first_queue_st || queue_end - wait_end < 0) {
+                wait_end       = queue_end;
+                first_queue_st = rt->rtsp_streams[i];
             }
         }
-        if (first_queue_time) {
-            wait_end = first_queue_time + s->max_delay;
-        } else {
-            wait_end = 0;
-            first_queue_st = NULL;
-        }
     }
 
     /* read next RTP packet */
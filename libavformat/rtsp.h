@@ -411,6 +411,21 @@ typedef struct RTSPState {
      */
     int reordering_queue_size;
 
+    /**
+     * Adapt the time to wait for reordered packets to the observed delays.
+     */
+    int adaptive_reorder_delay;
+
+    /**
+     * FEC scheme and options of the RTP streams (SDP and RTP only)
+     */
+    char *fec;
+
+    /**
+     * Maximum number of RTP packets received per system call (SDP and RTP only)
+     */
+    int batch_size;
+
     /**
      * User-Agent string
      */
@@ -443,6 +458,7 @@ typedef struct RTSPSource {
  */
 typedef struct RTSPStream {
     URLContext *rtp_handle;   /**< RTP stream handle (if UDP) */
+    int nb_poll_fds;          /**< number of RTSPState.p entries of rtp_handle */
     void *transport_priv; /**< RTP/RDT parse context if input, RTP AVFormatContext if output */
 
     /** corresponding stream index, if any. -1 if none (MPEG2TS case) */
@@ -38,6 +38,8 @@
 #include "libavutil/avstring.h"
 #include "libavutil/parseutils.h"
 #include "libavutil/mathematics.h"
+#include "libavutil/thread.h"
+#include "libavutil/threadmessage.h"
 #include "libavutil/time.h"
 #include "libavutil/timecode.h"
 #include "libavutil/time_internal.h"
@@ -66,6 +68,20 @@ typedef enum {
 #define SEGMENT_LIST_FLAG_CACHE 1
 #define SEGMENT_LIST_FLAG_LIVE  2
 
+#define FINALIZE_QUEUE_SIZE 4
+
+/**
+ * A finished segment handed over to the finalization thread.
+ */
+typedef struct SegmentFinalizeJob {
+    AVFormatContext *parent;
+    AVFormatContext *avf;  ///< segment muxer to write the trailer of and free, or NULL
+    AVIOContext *pb;       ///< segment output to close, when avf is NULL
+    SegmentListEntry entry;
+    int segment_count;
+    int is_last;
+} SegmentFinalizeJob;
+
 typedef struct SegmentContext {
     const AVClass *class;  /**< Class for private options. */
     int segment_idx;       ///< index of the segment file to write, starting from 0
@@ -123,8 +139,49 @@ typedef struct SegmentContext {
     SegmentListEntry cur_entry;
     SegmentListEntry *segment_list_entries;
     SegmentListEntry *segment_list_entries_end;
+
+    int async_finalize;
+    AVThreadMessageQueue *finalize_queue; ///< jobs for the finalization thread, NULL if disabled
+#if HAVE_THREADS
+    pthread_t finalize_thread;
+    pthread_mutex_t io_lock; ///< serializes the io_open and io_close callbacks
+#endif
+    int finalize_ret;
 } SegmentContext;
 
+/* With async_finalize, the io_open and io_close callbacks are called from
+ * both the muxing and the finalization threads. They are not required to be
+ * thread-safe, so the calls are serialized. */
+static int segment_io_open(SegmentContext *seg, AVFormatContext *s, AVIOContext **pb,
+                           const char *url, int flags, AVDictionary **options)
+{
+    int ret;
+
+#if HAVE_THREADS
+    if (seg->finalize_queue)
+        pthread_mutex_lock(&seg->io_lock);
+#endif
+    ret = s->io_open(s, pb, url, flags, options);
+#if HAVE_THREADS
+    if (seg->finalize_queue)
+        pthread_mutex_unlock(&seg->io_lock);
+#endif
+    return ret;
+}
+
+static void segment_io_close(SegmentContext *seg, AVFormatContext *s, AVIOContext **pb)
+{
+#if HAVE_THREADS
+    if (seg->finalize_queue)
+        pthread_mutex_lock(&seg->io_lock);
+#endif
+    ff_format_io_close(s, pb);
+#if HAVE_THREADS
+    if (seg->finalize_queue)
+        pthread_mutex_unlock(&seg->io_lock);
+#endif
+}
+
 static void print_csv_escaped_str(AVIOContext *ctx, const char *str)
 {
     int needs_quoting = !!str[strcspn(str, "\",\n\r")];
@@ -257,7 +314,7 @@ static int segment_start(AVFormatContext *s, int write_header)
     if ((err = set_segment_filename(s)) < 0)
         return err;
 
-    if ((err = s->io_open(s, &oc->pb, oc->url, AVIO_FLAG_WRITE, NULL)) < 0) {
+    if ((err = segment_io_open(seg, s, &oc->pb, oc->url, AVIO_FLAG_WRITE, NULL)) < 0) {
         av_log(s, AV_LOG_ERROR, "Failed to open segment '%s'\n", oc->url);
         return err;
     }
@@ -287,7 +344,7 @@ static int segment_list_open(AVFormatContext *s)
     int ret;
 
     snprintf(seg->temp_list_filename, sizeof(seg->temp_list_filename), seg->use_rename ? "%s.tmp" : "%s", seg->list);
-    ret = s->io_open(s, &seg->list_pb, seg->temp_list_filename, AVIO_FLAG_WRITE, NULL);
+    ret = segment_io_open(seg, s, &seg->list_pb, seg->temp_list_filename, AVIO_FLAG_WRITE, NULL);
     if (ret < 0) {
         av_log(s, AV_LOG_ERROR, "Failed to open segment list '%s'\n", seg->list);
         return ret;
@@ -351,6 +408,200 @@ static void segment_list_print_entry(AVIOContext      *list_ioctx,
     }
 }
 
+/* Adds a finished segment to the segment list and rewrites the list file
+ * if needed */
+static int segment_list_update(AVFormatContext *s, const SegmentListEntry *cur_entry,
+                               int segment_count, int is_last)
+{
+    SegmentContext *seg = s->priv_data;
+    int ret;
+
+    if (!seg->list)
+        return 0;
+
+    if (seg->list_size || seg->list_type == LIST_TYPE_M3U8) {
+        SegmentListEntry *entry = av_mallocz(sizeof(*entry));
+        if (!entry)
+            return AVERROR(ENOMEM);
+
+        /* append new element */
+        memcpy(entry, cur_entry, sizeof(*entry));
+        entry->filename = av_strdup(entry->filename);
+        entry->next = NULL;
+        if (!seg->segment_list_entries)
+            seg->segment_list_entries = seg->segment_list_entries_end = entry;
+        else
+            seg->segment_list_entries_end->next = entry;
+        seg->segment_list_entries_end = entry;
+
+        /* drop first item */
+        if (seg->list_size && segment_count >= seg->list_size) {
+            entry = seg->segment_list_entries;
+            seg->segment_list_entries = seg->segment_list_entries->next;
+            av_freep(&entry->filename);
+            av_freep(&entry);
+        }
+
+        if ((ret = segment_list_open(s)) < 0)
+            return ret;
+        for (entry = seg->segment_list_entries; entry; entry = entry->next)
+            segment_list_print_entry(seg->list_pb, seg->list_type, entry, s);
+        if (seg->list_type == LIST_TYPE_M3U8 && is_last)
+            avio_printf(seg->list_pb, "#EXT-X-ENDLIST\n");
+        segment_io_close(seg, s, &seg->list_pb);
+        if (seg->use_rename)
+            ff_rename(seg->temp_list_filename, seg->list, s);
+    } else {
+        segment_list_print_entry(seg->list_pb, seg->list_type, cur_entry, s);
+        avio_flush(seg->list_pb);
+    }
+    return 0;
+}
+
+static void segment_finalize_job_free(void *msg)
+{
+    SegmentFinalizeJob *job = msg;
+    SegmentContext *seg = job->parent->priv_data;
+
+    if (job->avf) {
+        segment_io_close(seg, job->avf, &job->avf->pb);
+        avformat_free_context(job->avf);
+        job->avf = NULL;
+    }
+    segment_io_close(seg, job->parent, &job->pb);
+    av_freep(&job->entry.filename);
+}
+
+#if HAVE_THREADS
+/* Writes the trailer of a segment, closes it and only then lists it, so
+ * that the list never references an incomplete segment */
+static int segment_finalize(AVFormatContext *s, SegmentFinalizeJob *job)
+{
+    SegmentContext *seg = s->priv_data;
+    AVFormatContext *oc = job->avf;
+    int ret = 0, err;
+
+    if (oc) {
+        av_write_frame(oc, NULL); /* Flush any buffered data (fragmented mp4) */
+        ret = av_write_trailer(oc);
+        if (ret < 0)
+            av_log(s, AV_LOG_ERROR, "Failure occurred when ending segment '%s'\n",
+                   oc->url);
+        segment_io_close(seg, oc, &oc->pb);
+        avformat_free_context(oc);
+        job->avf = NULL;
+    } else {
+        segment_io_close(seg, job->parent, &job->pb);
+    }
+
+    err = segment_list_update(s, &job->entry, job->segment_count, job->is_last);
+    av_freep(&job->entry.filename);
+    return ret < 0 ? ret : err;
+}
+
+static void *segment_finalize_thread(void *arg)
+{
+    AVFormatContext *s = arg;
+    SegmentContext *seg = s->priv_data;
+    SegmentFinalizeJob job;
+    int ret;
+
+    while (av_thread_message_queue_recv(seg->finalize_queue, &job, 0) >= 0) {
+        ret = segment_finalize(s, &job);
+        if (ret < 0) {
+            /* fail the next segment, pending ones are freed by the queue */
+            seg->finalize_ret = ret;
+            av_thread_message_queue_set_err_send(seg->finalize_queue, ret);
+            break;
+        }
+    }
+
+    return NULL;
+}
+#endif
+
+static int segment_finalize_start(AVFormatContext *s)
+{
+#if HAVE_THREADS
+    SegmentContext *seg = s->priv_data;
+    int ret;
+
+    ret = av_thread_message_queue_alloc(&seg->finalize_queue, FINALIZE_QUEUE_SIZE,
+                                        sizeof(SegmentFinalizeJob));
+    if (ret < 0)
+        return ret;
+    av_thread_message_queue_set_free_func(seg->finalize_queue, segment_finalize_job_free);
+    pthread_mutex_init(&seg->io_lock, NULL);
+
+    ret = pthread_create(&seg->finalize_thread, NULL, segment_finalize_thread, s);
+    if (ret) {
+        av_log(s, AV_LOG_ERROR, "Failed to start the finalization thread: %s\n",
+               av_err2str(AVERROR(ret)));
+        av_thread_message_queue_free(&seg->finalize_queue);
+        pthread_mutex_destroy(&seg->io_lock);
+        return AVERROR(ret);
+    }
+    return 0;
+#else
+    av_log(s, AV_LOG_ERROR, "async_finalize requires threading support\n");
+    return AVERROR(ENOSYS);
+#endif
+}
+
+/* Waits until all queued segments are finalized */
+static int segment_finalize_stop(AVFormatContext *s)
+{
+    SegmentContext *seg = s->priv_data;
+
+    if (!seg->finalize_queue)
+        return 0;
+
+    av_thread_message_queue_set_err_recv(seg->finalize_queue, AVERROR_EOF);
+#if HAVE_THREADS
+    pthread_join(seg->finalize_thread, NULL);
+#endif
+    av_thread_message_queue_free(&seg->finalize_queue);
+#if HAVE_THREADS
+    pthread_mutex_destroy(&seg->io_lock);
+#endif
+    return seg->finalize_ret;
+}
+
+/* Hands the current segment over to the finalization thread. With
+ * write_trailer, the whole segment muxer is handed over and a new one is
+ * created by segment_start(), otherwise only the output is. */
+static int segment_queue_finalize(AVFormatContext *s, int write_trailer, int is_last)
+{
+    SegmentContext *seg = s->priv_data;
+    AVFormatContext *oc = seg->avf;
+    SegmentFinalizeJob job = {
+        .parent        = s,
+        .entry         = seg->cur_entry,
+        .segment_count = seg->segment_count,
+        .is_last       = is_last,
+    };
+    int ret;
+
+    job.entry.next     = NULL;
+    job.entry.filename = av_strdup(seg->cur_entry.filename);
+    if (!job.entry.filename)
+        return AVERROR(ENOMEM);
+
+    if (write_trailer) {
+        job.avf  = oc;
+        seg->avf = NULL;
+    } else {
+        av_write_frame(oc, NULL); /* Flush any buffered data (fragmented mp4) */
+        job.pb  = oc->pb;
+        oc->pb  = NULL;
+    }
+
+    ret = av_thread_message_queue_send(seg->finalize_queue, &job, 0);
+    if (ret < 0)
+        segment_finalize_job_free(&job);
+    return ret;
+}
+
 static int segment_end(AVFormatContext *s, int write_trailer, int is_last)
 {
     SegmentContext *seg = s->priv_data;
@@ -366,56 +617,28 @@ static int segment_end(AVFormatContext *s, int write_trailer, int is_last)
     if (!oc || !oc->pb)
         return AVERROR(EINVAL);
 
-    av_write_frame(oc, NULL); /* Flush any buffered data (fragmented mp4) */
-    if (write_trailer)
-        ret = av_write_trailer(oc);
-
-    if (ret < 0)
-        av_log(s, AV_LOG_ERROR, "Failure occurred when ending segment '%s'\n",
-               oc->url);
+    av_log(s, AV_LOG_VERBOSE, "segment:'%s' count:%d ended\n",
+           oc->url, seg->segment_count);
 
-    if (seg->list) {
-        if (seg->list_size || seg->list_type == LIST_TYPE_M3U8) {
-            SegmentListEntry *entry = av_mallocz(sizeof(*entry));
-            if (!entry) {
-                ret = AVERROR(ENOMEM);
-                goto end;
-            }
+    if (seg->finalize_queue) {
+        /* the list is updated by the finalization thread */
+        if ((ret = segment_queue_finalize(s, write_trailer, is_last)) < 0)
+            goto end;
+    } else {
+        av_write_frame(oc, NULL); /* Flush any buffered data (fragmented mp4) */
+        if (write_trailer)
+            ret = av_write_trailer(oc);
 
-            /* append new element */
-            memcpy(entry, &seg->cur_entry, sizeof(*entry));
-            entry->filename = av_strdup(entry->filename);
-            if (!seg->segment_list_entries)
-                seg->segment_list_entries = seg->segment_list_entries_end = entry;
-            else
-                seg->segment_list_entries_end->next = entry;
-            seg->segment_list_entries_end = entry;
-
-            /* drop first item */
-            if (seg->list_size && seg->segment_count >= seg->list_size) {
-                entry = seg->segment_list_entries;
-                seg->segment_list_entries = seg->segment_list_entries->next;
-                av_freep(&entry->filename);
-                av_freep(&entry);
-            }
+        if (ret < 0)
+            av_log(s, AV_LOG_ERROR, "Failure occurred when ending segment '%s'\n",
+                   oc->url);
 
-            if ((ret = segment_list_open(s)) < 0)
-                goto end;
-            for (entry = seg->segment_list_entries; entry; entry = entry->next)
-                segment_list_print_entry(seg->list_pb, seg->list_type, entry, s);
-            if (seg->list_type == LIST_TYPE_M3U8 && is_last)
-                avio_printf(seg->list_pb, "#EXT-X-ENDLIST\n");
-            ff_format_io_close(s, &seg->list_pb);
-            if (seg->use_rename)
-                ff_rename(seg->temp_list_filename, seg->list, s);
-        } else {
-            segment_list_print_entry(seg->list_pb, seg->list_type, &seg->cur_entry, s);
-            avio_flush(seg->list_pb);
+        if ((err = segment_list_update(s, &seg->cur_entry, seg->segment_count, is_last)) < 0) {
+            ret = err;
+            goto end;
         }
     }
 
-    av_log(s, AV_LOG_VERBOSE, "segment:'%s' count:%d ended\n",
-           seg->avf->url, seg->segment_count);
     seg->segment_count++;
 
     if (seg->increment_tc) {
@@ -458,7 +681,8 @@ static int segment_end(AVFormatContext *s, int write_trailer, int is_last)
     }
 
 end:
-    ff_format_io_close(oc, &oc->pb);
+    if (seg->avf)
+        segment_io_close(seg, seg->avf, &seg->avf->pb);
 
     return ret;
 }
@@ -654,6 +878,7 @@ static void seg_free(AVFormatContext *s)
     SegmentContext *seg = s->priv_data;
     SegmentListEntry *cur;
 
+    segment_finalize_stop(s);
     ff_format_io_close(s, &seg->list_pb);
     if (seg->avf) {
         if (seg->is_nullctx)
@@ -812,6 +1037,12 @@ static int seg_init(AVFormatContext *s)
     if (oc->avoid_negative_ts > 0 && s->avoid_negative_ts < 0)
         s->avoid_negative_ts = 1;
 
+    if (seg->async_finalize) {
+        int err = segment_finalize_start(s);
+        if (err < 0)
+            return err;
+    }
+
     return ret;
 }
 
@@ -830,12 +1061,12 @@ static int seg_write_header(AVFormatContext *s)
     if (!seg->write_header_trailer || seg->header_filename) {
         if (seg->header_filename) {
             av_write_frame(oc, NULL);
-            ff_format_io_close(oc, &oc->pb);
+            segment_io_close(seg, oc, &oc->pb);
         } else {
             close_null_ctxp(&oc->pb);
             seg->is_nullctx = 0;
         }
-        if ((ret = oc->io_open(oc, &oc->pb, oc->url, AVIO_FLAG_WRITE, NULL)) < 0)
+        if ((ret = segment_io_open(seg, oc, &oc->pb, oc->url, AVIO_FLAG_WRITE, NULL)) < 0)
             return ret;
         if (!seg->individual_header_trailer)
             oc->pb->seekable = 0;
@@ -973,7 +1204,7 @@ static int seg_write_trailer(struct AVFormatContext *s)
 {
     SegmentContext *seg = s->priv_data;
     AVFormatContext *oc = seg->avf;
-    int ret;
+    int ret, err;
 
     if (!oc)
         return 0;
@@ -988,7 +1219,8 @@ static int seg_write_trailer(struct AVFormatContext *s)
     } else {
         ret = segment_end(s, 1, 1);
     }
-    return ret;
+    err = segment_finalize_stop(s);
+    return ret < 0 ? ret : err;
 }
 
 static int seg_check_bitstream(struct AVFormatContext *s, const AVPacket *pkt)
@@ -1051,6 +1283,7 @@ static const AVOption options[] = {
     { "reset_timestamps", "reset timestamps at the beginning of each segment", OFFSET(reset_timestamps), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, E },
     { "initial_offset", "set initial timestamp offset", OFFSET(initial_offset), AV_OPT_TYPE_DURATION, {.i64 = 0}, -INT64_MAX, INT64_MAX, E },
     { "write_empty_segments", "allow writing empty 'filler' segments", OFFSET(write_empty), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, E },
+    { "async_finalize", "finalize segments and update the list in a separate thread", OFFSET(async_finalize), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, E },
     { NULL },
 };
 
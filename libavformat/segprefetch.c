@@ -0,0 +1,265 @@
+/*
+ * Background prefetching of playlist segments
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdatomic.h>
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/error.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+
+#include "avio_internal.h"
+#include "segprefetch.h"
+#include "url.h"
+
+#define READ_CHUNK_SIZE (64 * 1024)
+
+struct SegmentPrefetch {
+    int64_t id;
+    AVFormatContext *s;
+    char *url;
+    AVDictionary *opts;
+    int64_t size;
+    size_t max_size;
+
+    AVIOInterruptCB interrupt_callback;
+    atomic_int abort_request;
+
+    AVIOContext *pb;
+    uint8_t *buf;
+    unsigned int buf_alloc;
+    size_t buf_size;
+    size_t buf_pos;
+    int64_t pos;
+    /* Error met while opening or buffering, returned once the buffered data
+     * has been read. */
+    int error;
+
+#if HAVE_THREADS
+    pthread_t thread;
+    int thread_running;
+#endif
+};
+
+static int prefetch_interrupt_cb(void *opaque)
+{
+    SegmentPrefetch *p = opaque;
+
+    return atomic_load(&p->abort_request) ||
+           ff_check_interrupt(&p->s->interrupt_callback);
+}
+
+#if HAVE_THREADS
+static void *prefetch_task(void *arg)
+{
+    SegmentPrefetch *p = arg;
+    int ret;
+
+    ret = ffio_open_whitelist(&p->pb, p->url, AVIO_FLAG_READ,
+                              &p->interrupt_callback, &p->opts,
+                              p->s->protocol_whitelist, p->s->protocol_blacklist);
+    av_dict_free(&p->opts);
+    if (ret < 0) {
+        p->error = ret;
+        return NULL;
+    }
+
+    while (p->buf_size < p->max_size) {
+        size_t to_read = FFMIN(p->max_size - p->buf_size, READ_CHUNK_SIZE);
+        uint8_t *buf;
+
+        if (p->size >= 0)
+            to_read = FFMIN(to_read, p->size - p->pos);
+        if (!to_read)
+            break;
+
+        buf = av_fast_realloc(p->buf, &p->buf_alloc, p->buf_size + to_read);
+        if (!buf) {
+            p->error = AVERROR(ENOMEM);
+            break;
+        }
+        p->buf = buf;
+
+        ret = avio_read(p->pb, p->buf + p->buf_size, to_read);
+        if (ret <= 0) {
+            if (ret < 0 && ret != AVERROR_EOF)
+                p->error = ret;
+            avio_closep(&p->pb);
+            break;
+        }
+        p->buf_size += ret;
+        p->pos      += ret;
+    }
+    if (p->size >= 0 && p->pos >= p->size)
+        avio_closep(&p->pb);
+
+    return NULL;
+}
+#endif
+
+int ff_segment_prefetch_start(SegmentPrefetchQueue *q, AVFormatContext *s,
+                              int64_t id, const char *url, AVDictionary *opts,
+                              int64_t size, size_t max_size)
+{
+#if HAVE_THREADS
+    SegmentPrefetch *p;
+    int ret;
+
+    if (q->nb_segments >= SEGMENT_PREFETCH_MAX)
+        return AVERROR(ENOSPC);
+
+    p = av_mallocz(sizeof(*p));
+    if (!p)
+        return AVERROR(ENOMEM);
+    p->id       = id;
+    p->s        = s;
+    p->size     = size;
+    p->max_size = max_size;
+    p->interrupt_callback.callback = prefetch_interrupt_cb;
+    p->interrupt_callback.opaque   = p;
+    atomic_init(&p->abort_request, 0);
+
+    p->url = av_strdup(url);
+    if (!p->url || av_dict_copy(&p->opts, opts, 0) < 0) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    ret = pthread_create(&p->thread, NULL, prefetch_task, p);
+    if (ret) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    p->thread_running = 1;
+
+    av_log(s, AV_LOG_DEBUG, "Prefetching segment %"PRId64": %s\n", id, url);
+    q->segments[q->nb_segments++] = p;
+    return 0;
+
+fail:
+    ff_segment_prefetch_free(&p);
+    return ret;
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
+int64_t ff_segment_prefetch_next_id(const SegmentPrefetchQueue *q, int64_t cur)
+{
+    if (!q->nb_segments)
+        return cur + 1;
+    return FFMAX(q->segments[q->nb_segments - 1]->id + 1, cur + 1);
+}
+
+SegmentPrefetch *ff_segment_prefetch_take(SegmentPrefetchQueue *q, int64_t id)
+{
+    SegmentPrefetch *p = NULL;
+    int i, n = 0;
+
+    while (n < q->nb_segments && q->segments[n]->id < id)
+        n++;
+    if (n < q->nb_segments && q->segments[n]->id == id) {
+        p = q->segments[n];
+        q->segments[n] = NULL;
+        n++;
+    } else {
+        n = q->nb_segments;
+    }
+
+    /* cancel all the skipped segments before waiting for them */
+    for (i = 0; i < n; i++)
+        if (q->segments[i])
+            atomic_store(&q->segments[i]->abort_request, 1);
+    for (i = 0; i < n; i++)
+        ff_segment_prefetch_free(&q->segments[i]);
+
+    q->nb_segments -= n;
+    memmove(q->segments, q->segments + n, q->nb_segments * sizeof(*q->segments));
+    return p;
+}
+
+int ff_segment_prefetch_wait(SegmentPrefetch *p)
+{
+#if HAVE_THREADS
+    if (p->thread_running) {
+        pthread_join(p->thread, NULL);
+        p->thread_running = 0;
+    }
+#endif
+    return p->buf_size ? 0 : p->error;
+}
+
+int ff_segment_prefetch_read(SegmentPrefetch *p, uint8_t *buf, int size)
+{
+    int ret;
+
+    ff_segment_prefetch_wait(p);
+
+    if (p->buf_pos < p->buf_size) {
+        size = FFMIN(size, p->buf_size - p->buf_pos);
+        memcpy(buf, p->buf + p->buf_pos, size);
+        p->buf_pos += size;
+        if (p->buf_pos == p->buf_size)
+            av_freep(&p->buf);
+        return size;
+    }
+    if (p->error < 0)
+        return p->error;
+    if (!p->pb)
+        return AVERROR_EOF;
+
+    if (p->size >= 0)
+        size = FFMIN(size, p->size - p->pos);
+    ret = avio_read(p->pb, buf, size);
+    if (ret > 0)
+        p->pos += ret;
+    return ret;
+}
+
+void ff_segment_prefetch_free(SegmentPrefetch **pp)
+{
+    SegmentPrefetch *p = *pp;
+
+    if (!p)
+        return;
+#if HAVE_THREADS
+    if (p->thread_running) {
+        atomic_store(&p->abort_request, 1);
+        pthread_join(p->thread, NULL);
+    }
+#endif
+    avio_closep(&p->pb);
+    av_dict_free(&p->opts);
+    av_freep(&p->buf);
+    av_freep(&p->url);
+    av_freep(pp);
+}
+
+void ff_segment_prefetch_flush(SegmentPrefetchQueue *q)
+{
+    int i;
+
+    for (i = 0; i < q->nb_segments; i++)
+        atomic_store(&q->segments[i]->abort_request, 1);
+    for (i = 0; i < q->nb_segments; i++)
+        ff_segment_prefetch_free(&q->segments[i]);
+    q->nb_segments = 0;
+}
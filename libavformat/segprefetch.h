@@ -0,0 +1,101 @@
+/*
+ * Background prefetching of playlist segments
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_SEGPREFETCH_H
+#define AVFORMAT_SEGPREFETCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libavutil/dict.h"
+#include "avformat.h"
+
+#define SEGMENT_PREFETCH_MAX 16
+
+/**
+ * A segment downloaded by a background thread. The start of the segment,
+ * up to a maximum size, is read into memory; the rest, if any, is read from
+ * the still open connection once the buffered data has been consumed.
+ */
+typedef struct SegmentPrefetch SegmentPrefetch;
+
+/**
+ * Segments being prefetched for a playlist, in increasing id order.
+ */
+typedef struct SegmentPrefetchQueue {
+    SegmentPrefetch *segments[SEGMENT_PREFETCH_MAX];
+    int nb_segments;
+} SegmentPrefetchQueue;
+
+/**
+ * Start prefetching a segment and append it to the queue.
+ *
+ * The segment is opened with the interrupt callback and protocol lists of
+ * s, but not through its io_open callback.
+ *
+ * @param id       identifier of the segment, greater than the ones queued
+ * @param opts     protocol options, not modified
+ * @param size     size of the segment, or -1 if unknown
+ * @param max_size maximum number of bytes buffered in memory
+ * @return 0 on success, a negative error code on failure
+ */
+int ff_segment_prefetch_start(SegmentPrefetchQueue *q, AVFormatContext *s,
+                              int64_t id, const char *url, AVDictionary *opts,
+                              int64_t size, size_t max_size);
+
+/**
+ * @return the id following the last queued segment, or cur + 1 if the queue
+ *         is empty
+ */
+int64_t ff_segment_prefetch_next_id(const SegmentPrefetchQueue *q, int64_t cur);
+
+/**
+ * Remove the segment with the given id from the queue. Queued segments
+ * preceding it are cancelled, and all of them if it is not queued.
+ *
+ * @return the segment, to be freed by the caller, or NULL
+ */
+SegmentPrefetch *ff_segment_prefetch_take(SegmentPrefetchQueue *q, int64_t id);
+
+/**
+ * Wait until the segment has been opened and its start buffered.
+ *
+ * @return 0 on success, a negative error code if it could not be opened
+ */
+int ff_segment_prefetch_wait(SegmentPrefetch *p);
+
+/**
+ * Read data from a segment returned by ff_segment_prefetch_take().
+ *
+ * @return the number of bytes read, or a negative error code
+ */
+int ff_segment_prefetch_read(SegmentPrefetch *p, uint8_t *buf, int size);
+
+/**
+ * Cancel the download of a segment if still running, and free it.
+ */
+void ff_segment_prefetch_free(SegmentPrefetch **p);
+
+/**
+ * Cancel and free all the queued segments.
+ */
+void ff_segment_prefetch_flush(SegmentPrefetchQueue *q);
+
+#endif /* AVFORMAT_SEGPREFETCH_H */
@@ -18,10 +18,15 @@
  * License along with FFmpeg; if not, write to the Free Software
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
+
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE     /* Needed for SO_ZEROCOPY with glibc */
+
 #include "avformat.h"
 #include "libavutil/avassert.h"
 #include "libavutil/parseutils.h"
 #include "libavutil/opt.h"
+#include "libavutil/thread.h"
 #include "libavutil/time.h"
 
 #include "internal.h"
@@ -31,11 +36,56 @@
 #if HAVE_POLL_H
 #include <poll.h>
 #endif
+#if HAVE_EPOLL_CREATE1
+#include <sys/epoll.h>
+#endif
+#if HAVE_LINUX_ERRQUEUE_H && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#include <linux/errqueue.h>
+#define USE_ZEROCOPY 1
+#else
+#define USE_ZEROCOPY 0
+#endif
+
+/* Smaller writes are copied, pinning the pages and handling the completion
+ * notification costs more than the copy. */
+#define ZEROCOPY_MIN_SIZE 16384
+
+/* Zero-copy sends whose data may still be referenced by the kernel. Each
+ * successful send with MSG_ZEROCOPY gets the next 32-bit id, completions are
+ * reported for ranges of ids through the socket error queue. */
+typedef struct TCPZeroCopy {
+    int64_t *start;         /* number of bytes sent before each send */
+    uint8_t *done;
+    unsigned size;          /* allocated entries, a power of two */
+    unsigned head, count;
+    uint32_t head_id;       /* id of the send at head */
+    int64_t nb_sends;
+    int64_t nb_copied;      /* sends the kernel had to copy anyway */
+} TCPZeroCopy;
+
+/* Multiplexed listen mode: the listening socket and the client connections
+ * waiting for data are in one epoll set. Accepting returns the next client
+ * with data to read, and clients closed while their connection is still
+ * usable go back to the set. This lets one thread serve many keep-alive
+ * connections. The set is shared by the listening context and the clients
+ * it returned, which may be closed from other threads. */
+typedef struct TCPMux {
+    int epfd;
+    int listen_fd;
+    AVMutex lock;
+    int refcount;
+    int closed;
+    uint8_t *idle;  /* idle[fd] is set if the client fd is in the set */
+    int idle_size;
+} TCPMux;
 
 typedef struct TCPContext {
     const AVClass *class;
     int fd;
     int listen;
+    int multiplex;
+    TCPMux *mux;
+    int reusable;
     int open_timeout;
     int rw_timeout;
     int listen_timeout;
@@ -45,6 +95,12 @@ typedef struct TCPContext {
 #if !HAVE_WINSOCK2_H
     int tcp_mss;
 #endif /* !HAVE_WINSOCK2_H */
+    int tcp_notsent_lowat;
+    int zerocopy;
+    TCPZeroCopy zc;
+    int64_t bytes_sent;
+    int64_t bytes_received;
+    int64_t start_time;
 } TCPContext;
 
 #define OFFSET(x) offsetof(TCPContext, x)
@@ -57,9 +113,14 @@ static const AVOption options[] = {
     { "send_buffer_size", "Socket send buffer size (in bytes)",                OFFSET(send_buffer_size), AV_OPT_TYPE_INT, { .i64 = -1 },         -1, INT_MAX, .flags = D|E },
     { "recv_buffer_size", "Socket receive buffer size (in bytes)",             OFFSET(recv_buffer_size), AV_OPT_TYPE_INT, { .i64 = -1 },         -1, INT_MAX, .flags = D|E },
     { "tcp_nodelay", "Use TCP_NODELAY to disable nagle's algorithm",           OFFSET(tcp_nodelay), AV_OPT_TYPE_BOOL, { .i64 = 0 },             0, 1, .flags = D|E },
+    { "multiplex",   "Wait for data from all the clients in multi-client listen mode, and keep the connections of closed clients", OFFSET(multiplex), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, .flags = D|E },
 #if !HAVE_WINSOCK2_H
     { "tcp_mss",     "Maximum segment size for outgoing TCP packets",          OFFSET(tcp_mss),     AV_OPT_TYPE_INT, { .i64 = -1 },         -1, INT_MAX, .flags = D|E },
 #endif /* !HAVE_WINSOCK2_H */
+    { "tcp_notsent_lowat", "Limit of data waiting to be sent in the socket send buffer (in bytes)", OFFSET(tcp_notsent_lowat), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, INT_MAX, .flags = D|E },
+    { "zerocopy",    "Send data from the I/O buffers without copying it (MSG_ZEROCOPY)", OFFSET(zerocopy), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, .flags = E },
+    { "bytes_sent",     "Number of bytes sent",     OFFSET(bytes_sent),     AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, .flags = D|E|AV_OPT_FLAG_EXPORT|AV_OPT_FLAG_READONLY },
+    { "bytes_received", "Number of bytes received", OFFSET(bytes_received), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, .flags = D|E|AV_OPT_FLAG_EXPORT|AV_OPT_FLAG_READONLY },
     { NULL }
 };
 
@@ -97,7 +158,298 @@ static void customize_fd(void *ctx, int fd)
         }
     }
 #endif /* !HAVE_WINSOCK2_H */
+#ifdef TCP_NOTSENT_LOWAT
+    if (s->tcp_notsent_lowat >= 0) {
+        if (setsockopt (fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &s->tcp_notsent_lowat, sizeof (s->tcp_notsent_lowat))) {
+            ff_log_net_error(ctx, AV_LOG_WARNING, "setsockopt(TCP_NOTSENT_LOWAT)");
+        }
+    }
+#endif
+}
+
+#if USE_ZEROCOPY
+static int zerocopy_init(URLContext *h)
+{
+    TCPContext *s = h->priv_data;
+    int one = 1;
+
+    if (setsockopt(s->fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one))) {
+        ff_log_net_error(h, AV_LOG_WARNING, "setsockopt(SO_ZEROCOPY)");
+        return 0;
+    }
+    s->zc.start = av_malloc_array(64, sizeof(*s->zc.start));
+    s->zc.done  = av_malloc(64);
+    if (!s->zc.start || !s->zc.done) {
+        av_freep(&s->zc.start);
+        av_freep(&s->zc.done);
+        return AVERROR(ENOMEM);
+    }
+    s->zc.size = 64;
+    /* Everything the socket send buffer can hold may be in flight; without
+     * an explicit size, the kernel grows it up to 4 MiB by default. */
+    h->zerocopy_size = s->send_buffer_size > 0 ? s->send_buffer_size : 4 << 20;
+    return 0;
+}
+
+static int zerocopy_push(TCPZeroCopy *zc, int64_t start)
+{
+    unsigned i;
+
+    if (zc->count == zc->size) {
+        int64_t *new_start = av_malloc_array(2 * zc->size, sizeof(*zc->start));
+        uint8_t *new_done  = av_malloc(2 * zc->size);
+        if (!new_start || !new_done) {
+            av_free(new_start);
+            av_free(new_done);
+            return AVERROR(ENOMEM);
+        }
+        for (i = 0; i < zc->count; i++) {
+            new_start[i] = zc->start[(zc->head + i) & (zc->size - 1)];
+            new_done[i]  = zc->done[(zc->head + i) & (zc->size - 1)];
+        }
+        av_free(zc->start);
+        av_free(zc->done);
+        zc->start = new_start;
+        zc->done  = new_done;
+        zc->head  = 0;
+        zc->size *= 2;
+    }
+    i = (zc->head + zc->count++) & (zc->size - 1);
+    zc->start[i] = start;
+    zc->done[i]  = 0;
+    zc->nb_sends++;
+    return 0;
+}
+
+/* Mark the sends completed by the kernel. */
+static int zerocopy_reap(TCPContext *s)
+{
+    TCPZeroCopy *zc = &s->zc;
+
+    for (;;) {
+        char control[CMSG_SPACE(sizeof(struct sock_extended_err))];
+        struct msghdr msg = { .msg_control = control, .msg_controllen = sizeof(control) };
+        struct cmsghdr *cm;
+        struct sock_extended_err *serr;
+        uint32_t id;
+
+        if (recvmsg(s->fd, &msg, MSG_ERRQUEUE) < 0) {
+            int ret = ff_neterrno();
+            return ret == AVERROR(EAGAIN) ? 0 : ret;
+        }
+        cm = CMSG_FIRSTHDR(&msg);
+        if (!cm || !((cm->cmsg_level == SOL_IP   && cm->cmsg_type == IP_RECVERR) ||
+                     (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)))
+            continue;
+        serr = (struct sock_extended_err *)CMSG_DATA(cm);
+        if (serr->ee_errno || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+            continue;
+
+        if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+            zc->nb_copied += serr->ee_data - serr->ee_info + 1;
+        for (id = serr->ee_info; id - serr->ee_info <= serr->ee_data - serr->ee_info; id++) {
+            uint32_t n = id - zc->head_id;
+            if (n < zc->count)
+                zc->done[(zc->head + n) & (zc->size - 1)] = 1;
+        }
+        while (zc->count && zc->done[zc->head]) {
+            zc->head = (zc->head + 1) & (zc->size - 1);
+            zc->head_id++;
+            zc->count--;
+        }
+    }
+}
+
+static int64_t zerocopy_pending(TCPContext *s)
+{
+    return s->zc.count ? s->bytes_sent - s->zc.start[s->zc.head] : 0;
+}
+
+static int tcp_wait_writes(URLContext *h, int64_t pending)
+{
+    TCPContext *s = h->priv_data;
+    int64_t wait_start = 0;
+    int ret;
+
+    for (;;) {
+        struct pollfd p = { .fd = s->fd };
+
+        if ((ret = zerocopy_reap(s)) < 0)
+            return ret;
+        if (zerocopy_pending(s) <= pending)
+            return 0;
+
+        if (ff_check_interrupt(&h->interrupt_callback))
+            return AVERROR_EXIT;
+        /* completions are signaled as errors */
+        ret = poll(&p, 1, POLLING_TIME);
+        if (ret < 0) {
+            ret = ff_neterrno();
+            if (ret != AVERROR(EINTR))
+                return ret;
+        } else if (p.revents & POLLERR) {
+            int err = 0;
+            socklen_t err_len = sizeof(err);
+            if (!getsockopt(s->fd, SOL_SOCKET, SO_ERROR, &err, &err_len) && err)
+                return AVERROR(err);
+        } else if (p.revents & POLLHUP) {
+            return AVERROR(EPIPE);
+        }
+        if (h->rw_timeout > 0) {
+            if (!wait_start)
+                wait_start = av_gettime_relative();
+            else if (av_gettime_relative() - wait_start > h->rw_timeout)
+                return AVERROR(ETIMEDOUT);
+        }
+    }
+}
+#endif
+
+#if HAVE_EPOLL_CREATE1
+static int mux_init(TCPContext *s)
+{
+    struct epoll_event ev = { .events = EPOLLIN };
+    TCPMux *mux;
+    int ret;
+
+    /* ff_listen() uses a backlog of one */
+    if (listen(s->fd, SOMAXCONN) || ff_socket_nonblock(s->fd, 1) < 0)
+        return ff_neterrno();
+
+    mux = av_mallocz(sizeof(*mux));
+    if (!mux)
+        return AVERROR(ENOMEM);
+    mux->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (mux->epfd < 0) {
+        ret = AVERROR(errno);
+        av_free(mux);
+        return ret;
+    }
+    ev.data.fd = mux->listen_fd = s->fd;
+    if (epoll_ctl(mux->epfd, EPOLL_CTL_ADD, s->fd, &ev) < 0) {
+        ret = AVERROR(errno);
+        close(mux->epfd);
+        av_free(mux);
+        return ret;
+    }
+    ff_mutex_init(&mux->lock, NULL);
+    mux->refcount = 1;
+    s->mux = mux;
+    return 0;
+}
+
+/* Wait for the next data on fd, or close it if the server is gone. */
+static void mux_add_idle(TCPMux *mux, int fd)
+{
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLONESHOT, .data.fd = fd };
+
+    ff_mutex_lock(&mux->lock);
+    if (!mux->closed && fd >= mux->idle_size) {
+        int size = FFMAX(fd + 1, 2 * mux->idle_size);
+        uint8_t *idle = av_realloc(mux->idle, size);
+        if (idle) {
+            memset(idle + mux->idle_size, 0, size - mux->idle_size);
+            mux->idle      = idle;
+            mux->idle_size = size;
+        }
+    }
+    if (mux->closed || fd >= mux->idle_size ||
+        epoll_ctl(mux->epfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+        closesocket(fd);
+    else
+        mux->idle[fd] = 1;
+    ff_mutex_unlock(&mux->lock);
+}
+
+static void mux_unref(TCPMux **pmux)
+{
+    TCPMux *mux = *pmux;
+    int refcount;
+
+    ff_mutex_lock(&mux->lock);
+    refcount = --mux->refcount;
+    ff_mutex_unlock(&mux->lock);
+    if (!refcount) {
+        close(mux->epfd);
+        ff_mutex_destroy(&mux->lock);
+        av_free(mux->idle);
+        av_free(mux);
+    }
+    *pmux = NULL;
+}
+
+/* Close the idle connections, later closed clients close theirs. */
+static void mux_close(TCPMux *mux)
+{
+    int fd;
+
+    ff_mutex_lock(&mux->lock);
+    mux->closed = 1;
+    for (fd = 0; fd < mux->idle_size; fd++)
+        if (mux->idle[fd])
+            closesocket(fd);
+    ff_mutex_unlock(&mux->lock);
+}
+
+static int mux_accept(URLContext *h, TCPMux *mux, int timeout)
+{
+    int64_t wait_start = 0;
+
+    for (;;) {
+        struct epoll_event ev;
+        uint8_t byte;
+        int fd, ret;
+
+        if (ff_check_interrupt(&h->interrupt_callback))
+            return AVERROR_EXIT;
+        ret = epoll_wait(mux->epfd, &ev, 1, POLLING_TIME);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return AVERROR(errno);
+        }
+        if (!ret) {
+            if (timeout >= 0) {
+                if (!wait_start)
+                    wait_start = av_gettime_relative();
+                else if (av_gettime_relative() - wait_start > timeout * 1000LL)
+                    return AVERROR(ETIMEDOUT);
+            }
+            continue;
+        }
+
+        if (ev.data.fd == mux->listen_fd) {
+            fd = accept(mux->listen_fd, NULL, NULL);
+            if (fd < 0) {
+                ret = ff_neterrno();
+                if (ret == AVERROR(EAGAIN) || ret == AVERROR(EINTR) ||
+                    ret == AVERROR(ECONNABORTED))
+                    continue;
+                return ret;
+            }
+            if (ff_socket_nonblock(fd, 1) < 0)
+                av_log(h, AV_LOG_DEBUG, "ff_socket_nonblock failed\n");
+            mux_add_idle(mux, fd);
+            continue;
+        }
+
+        fd = ev.data.fd;
+        ff_mutex_lock(&mux->lock);
+        epoll_ctl(mux->epfd, EPOLL_CTL_DEL, fd, NULL);
+        mux->idle[fd] = 0;
+        ff_mutex_unlock(&mux->lock);
+
+        /* drop connections closed by the peer while idle */
+        ret = recv(fd, &byte, 1, MSG_PEEK);
+        if (ret > 0)
+            return fd;
+        if (ret < 0 && ff_neterrno() == AVERROR(EAGAIN))
+            mux_add_idle(mux, fd);
+        else
+            closesocket(fd);
+    }
 }
+#endif
 
 /* return non zero if error */
 static int tcp_open(URLContext *h, const char *uri, int flags)
@@ -187,6 +539,17 @@ static int tcp_open(URLContext *h, const char *uri, int flags)
         // multi-client
         if ((ret = ff_listen(fd, cur_ai->ai_addr, cur_ai->ai_addrlen)) < 0)
             goto fail1;
+        if (s->multiplex) {
+#if HAVE_EPOLL_CREATE1
+            s->fd = fd;
+            if ((ret = mux_init(s)) < 0)
+                goto fail1;
+#else
+            av_log(h, AV_LOG_ERROR, "Multiplexed listen mode requires epoll\n");
+            ret = AVERROR(ENOSYS);
+            goto fail1;
+#endif
+        }
     } else if (s->listen == 1) {
         // single client
         if ((ret = ff_listen_bind(fd, cur_ai->ai_addr, cur_ai->ai_addrlen,
@@ -202,6 +565,16 @@ static int tcp_open(URLContext *h, const char *uri, int flags)
 
     h->is_streamed = 1;
     s->fd = fd;
+    s->start_time = av_gettime_relative();
+
+    if (s->zerocopy && s->listen != 2) {
+#if USE_ZEROCOPY
+        if ((ret = zerocopy_init(h)) < 0)
+            goto fail1;
+#else
+        av_log(h, AV_LOG_WARNING, "Zero-copy send is not supported, data will be copied\n");
+#endif
+    }
 
     freeaddrinfo(ai);
     return 0;
@@ -222,12 +595,36 @@ static int tcp_accept(URLContext *s, URLContext **c)
     if ((ret = ffurl_alloc(c, s->filename, s->flags, &s->interrupt_callback)) < 0)
         return ret;
     cc = (*c)->priv_data;
+#if HAVE_EPOLL_CREATE1
+    if (sc->mux) {
+        ret = mux_accept(s, sc->mux, sc->listen_timeout);
+        if (ret < 0) {
+            ffurl_closep(c);
+            return ret;
+        }
+        cc->fd         = ret;
+        cc->mux        = sc->mux;
+        cc->reusable   = 1;
+        cc->start_time = av_gettime_relative();
+        ff_mutex_lock(&sc->mux->lock);
+        sc->mux->refcount++;
+        ff_mutex_unlock(&sc->mux->lock);
+        return 0;
+    }
+#endif
     ret = ff_accept(sc->fd, sc->listen_timeout, s);
     if (ret < 0) {
         ffurl_closep(c);
         return ret;
     }
-    cc->fd = ret;
+    cc->fd         = ret;
+    cc->start_time = av_gettime_relative();
+#if USE_ZEROCOPY
+    if (sc->zerocopy && (ret = zerocopy_init(*c)) < 0) {
+        ffurl_closep(c);
+        return ret;
+    }
+#endif
     return 0;
 }
 
@@ -242,9 +639,18 @@ static int tcp_read(URLContext *h, uint8_t *buf, int size)
             return ret;
     }
     ret = recv(s->fd, buf, size, 0);
-    if (ret == 0)
+    if (ret == 0) {
+        s->reusable = 0;
         return AVERROR_EOF;
-    return ret < 0 ? ff_neterrno() : ret;
+    }
+    if (ret < 0) {
+        ret = ff_neterrno();
+        if (ret != AVERROR(EAGAIN))
+            s->reusable = 0;
+    } else {
+        s->bytes_received += ret;
+    }
+    return ret;
 }
 
 static int tcp_write(URLContext *h, const uint8_t *buf, int size)
@@ -257,8 +663,39 @@ static int tcp_write(URLContext *h, const uint8_t *buf, int size)
         if (ret)
             return ret;
     }
+#if USE_ZEROCOPY
+    if (s->zc.size && h->zerocopy_write && size >= ZEROCOPY_MIN_SIZE) {
+        if ((ret = zerocopy_reap(s)) < 0) {
+            s->reusable = 0;
+            return ret;
+        }
+        ret = send(s->fd, buf, size, MSG_NOSIGNAL | MSG_ZEROCOPY);
+        if (ret > 0) {
+            int err = zerocopy_push(&s->zc, s->bytes_sent);
+            if (err < 0) {
+                s->reusable = 0;
+                return err;
+            }
+            s->bytes_sent += ret;
+            return ret;
+        }
+        /* ENOBUFS: too much memory pinned, copy this one */
+        if (ret < 0 && (ret = ff_neterrno()) != AVERROR(ENOBUFS)) {
+            if (ret != AVERROR(EAGAIN))
+                s->reusable = 0;
+            return ret;
+        }
+    }
+#endif
     ret = send(s->fd, buf, size, MSG_NOSIGNAL);
-    return ret < 0 ? ff_neterrno() : ret;
+    if (ret < 0) {
+        ret = ff_neterrno();
+        if (ret != AVERROR(EAGAIN))
+            s->reusable = 0;
+    } else {
+        s->bytes_sent += ret;
+    }
+    return ret;
 }
 
 static int tcp_shutdown(URLContext *h, int flags)
@@ -274,12 +711,46 @@ static int tcp_shutdown(URLContext *h, int flags)
         how = SHUT_RD;
     }
 
+    s->reusable = 0;
     return shutdown(s->fd, how);
 }
 
+static void log_statistics(URLContext *h)
+{
+    TCPContext *s = h->priv_data;
+    double duration = FFMAX(av_gettime_relative() - s->start_time, 1) / 1000000.0;
+
+    if (!s->bytes_sent && !s->bytes_received)
+        return;
+    av_log(h, AV_LOG_VERBOSE, "Statistics: %"PRId64" bytes sent, %"PRId64" bytes received "
+           "in %.3f s (%.3f / %.3f Mbit/s)\n", s->bytes_sent, s->bytes_received,
+           duration, s->bytes_sent * 8 / 1e6 / duration, s->bytes_received * 8 / 1e6 / duration);
+    if (s->zc.nb_sends)
+        av_log(h, AV_LOG_VERBOSE, "%"PRId64" zero-copy sends, %"PRId64" copied by the kernel\n",
+               s->zc.nb_sends, s->zc.nb_copied);
+}
+
 static int tcp_close(URLContext *h)
 {
     TCPContext *s = h->priv_data;
+
+    log_statistics(h);
+    av_freep(&s->zc.start);
+    av_freep(&s->zc.done);
+#if HAVE_EPOLL_CREATE1
+    if (s->mux) {
+        if (s->listen) {
+            mux_close(s->mux);
+            closesocket(s->fd);
+        } else if (s->reusable) {
+            mux_add_idle(s->mux, s->fd);
+        } else {
+            closesocket(s->fd);
+        }
+        mux_unref(&s->mux);
+        return 0;
+    }
+#endif
     closesocket(s->fd);
     return 0;
 }
@@ -320,6 +791,9 @@ const URLProtocol ff_tcp_protocol = {
     .url_get_file_handle = tcp_get_file_handle,
     .url_get_short_seek  = tcp_get_window_size,
     .url_shutdown        = tcp_shutdown,
+#if USE_ZEROCOPY
+    .url_wait_writes     = tcp_wait_writes,
+#endif
     .priv_data_size      = sizeof(TCPContext),
     .flags               = URL_PROTOCOL_FLAG_NETWORK,
     .priv_data_class     = &tcp_class,
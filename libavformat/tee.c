@@ -19,10 +19,13 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdatomic.h>
 
 #include "libavutil/avutil.h"
 #include "libavutil/avstring.h"
 #include "libavutil/opt.h"
+#include "libavutil/thread.h"
+#include "libavutil/threadmessage.h"
 #include "internal.h"
 #include "avformat.h"
 #include "avio_internal.h"
@@ -35,6 +38,19 @@ typedef enum {
 
 #define DEFAULT_SLAVE_FAILURE_POLICY ON_SLAVE_FAILURE_ABORT
 
+typedef enum {
+    ON_SLAVE_FULL_BLOCK = 1,
+    ON_SLAVE_FULL_DROP  = 2
+} SlaveFullPolicy;
+
+#define DEFAULT_SLAVE_FULL_POLICY ON_SLAVE_FULL_BLOCK
+
+typedef struct TeeMessage {
+    AVPacket pkt;     ///< packet mapped to the slave stream
+    int64_t ts;       ///< dts of the packet in AV_TIME_BASE, for lag statistics
+    int flush;
+} TeeMessage;
+
 typedef struct {
     AVFormatContext *avf;
     AVBSFContext **bsfs; ///< bitstream filters per stream
@@ -47,6 +63,21 @@ typedef struct {
      * disabled output streams are set to -1 */
     int *stream_map;
     int header_written;
+
+    int use_thread;
+    int thread_queue_size;
+    SlaveFullPolicy on_full;
+    AVThreadMessageQueue *queue; ///< packets for the slave thread, NULL when not threaded
+#if HAVE_THREADS
+    pthread_t thread;
+#endif
+    int thread_ret;
+    int *wait_keyframe;          ///< per output stream, set after dropping packets
+    atomic_int_least64_t last_written_ts;
+    int64_t last_queued_ts;
+    int64_t nb_dropped;
+    int max_queued;
+    int64_t max_lag;
 } TeeSlave;
 
 typedef struct TeeContext {
@@ -56,6 +87,8 @@ typedef struct TeeContext {
     TeeSlave *slaves;
     int use_fifo;
     AVDictionary *fifo_options;
+    int use_thread;
+    int thread_queue_size;
 } TeeContext;
 
 static const char *const slave_delim     = "|";
@@ -68,6 +101,10 @@ static const AVOption options[] = {
          OFFSET(use_fifo), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM},
         {"fifo_options", "fifo pseudo-muxer options", OFFSET(fifo_options),
          AV_OPT_TYPE_DICT, {.str = NULL}, 0, 0, AV_OPT_FLAG_ENCODING_PARAM},
+        {"use_thread", "Write each slave from its own thread",
+         OFFSET(use_thread), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM},
+        {"thread_queue_size", "Maximum number of packets queued for each slave thread",
+         OFFSET(thread_queue_size), AV_OPT_TYPE_INT, {.i64 = 64}, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM},
         {NULL}
 };
 
@@ -118,18 +155,173 @@ static int parse_slave_fifo_options(const char *use_fifo,
     return ret;
 }
 
+static int parse_slave_thread_options(const char *use_thread, const char *queue_size,
+                                      const char *on_full, TeeSlave *tee_slave)
+{
+    if (use_thread) {
+        if (av_match_name(use_thread, "true,y,yes,enable,enabled,on,1")) {
+            tee_slave->use_thread = 1;
+        } else if (av_match_name(use_thread, "false,n,no,disable,disabled,off,0")) {
+            tee_slave->use_thread = 0;
+        } else {
+            return AVERROR(EINVAL);
+        }
+    }
+
+    if (queue_size) {
+        char *end;
+        long size = strtol(queue_size, &end, 10);
+        if (*end || size < 1 || size > INT_MAX)
+            return AVERROR(EINVAL);
+        tee_slave->thread_queue_size = size;
+    }
+
+    if (!on_full) {
+        tee_slave->on_full = DEFAULT_SLAVE_FULL_POLICY;
+    } else if (!av_strcasecmp("block", on_full)) {
+        tee_slave->on_full = ON_SLAVE_FULL_BLOCK;
+    } else if (!av_strcasecmp("drop", on_full)) {
+        tee_slave->on_full = ON_SLAVE_FULL_DROP;
+    } else {
+        return AVERROR(EINVAL);
+    }
+
+    return 0;
+}
+
+/* Filters and writes a packet which has already been mapped to the slave
+ * stream. Takes ownership of pkt. */
+static int tee_write_slave_packet(TeeSlave *tee_slave, AVPacket *pkt)
+{
+    AVFormatContext *avf2 = tee_slave->avf;
+    int s2 = pkt->stream_index;
+    AVBSFContext *bsfs = tee_slave->bsfs[s2];
+    int ret;
+
+    ret = av_bsf_send_packet(bsfs, pkt);
+    if (ret < 0) {
+        av_log(avf2, AV_LOG_ERROR, "Error while sending packet to bitstream filter: %s\n",
+               av_err2str(ret));
+        av_packet_unref(pkt);
+        return ret;
+    }
+
+    while (1) {
+        ret = av_bsf_receive_packet(bsfs, pkt);
+        if (ret == AVERROR(EAGAIN))
+            return 0;
+        else if (ret < 0)
+            return ret;
+
+        av_packet_rescale_ts(pkt, bsfs->time_base_out,
+                             avf2->streams[s2]->time_base);
+        ret = av_interleaved_write_frame(avf2, pkt);
+        if (ret < 0)
+            return ret;
+    }
+}
+
+static void tee_free_message(void *msg)
+{
+    av_packet_unref(&((TeeMessage *)msg)->pkt);
+}
+
+#if HAVE_THREADS
+static void *tee_slave_thread(void *arg)
+{
+    TeeSlave *tee_slave = arg;
+    TeeMessage msg;
+    int ret;
+
+    while ((ret = av_thread_message_queue_recv(tee_slave->queue, &msg, 0)) >= 0) {
+        if (msg.flush)
+            ret = av_interleaved_write_frame(tee_slave->avf, NULL);
+        else
+            ret = tee_write_slave_packet(tee_slave, &msg.pkt);
+        if (ret < 0) {
+            /* fail the next packet sent to this slave */
+            tee_slave->thread_ret = ret;
+            av_thread_message_queue_set_err_send(tee_slave->queue, ret);
+            break;
+        }
+        if (msg.ts != AV_NOPTS_VALUE)
+            atomic_store_explicit(&tee_slave->last_written_ts, msg.ts,
+                                  memory_order_relaxed);
+    }
+
+    return NULL;
+}
+#endif
+
+static int start_slave_thread(AVFormatContext *avf, TeeSlave *tee_slave)
+{
+#if HAVE_THREADS
+    int ret;
+
+    tee_slave->wait_keyframe = av_calloc(tee_slave->avf->nb_streams,
+                                         sizeof(*tee_slave->wait_keyframe));
+    if (!tee_slave->wait_keyframe)
+        return AVERROR(ENOMEM);
+
+    ret = av_thread_message_queue_alloc(&tee_slave->queue, tee_slave->thread_queue_size,
+                                        sizeof(TeeMessage));
+    if (ret < 0)
+        return ret;
+    av_thread_message_queue_set_free_func(tee_slave->queue, tee_free_message);
+
+    atomic_init(&tee_slave->last_written_ts, AV_NOPTS_VALUE);
+    tee_slave->last_queued_ts = AV_NOPTS_VALUE;
+
+    ret = pthread_create(&tee_slave->thread, NULL, tee_slave_thread, tee_slave);
+    if (ret) {
+        av_log(avf, AV_LOG_ERROR, "Failed to start slave thread: %s\n",
+               av_err2str(AVERROR(ret)));
+        av_thread_message_queue_free(&tee_slave->queue);
+        return AVERROR(ret);
+    }
+    return 0;
+#else
+    av_log(avf, AV_LOG_ERROR, "use_thread requires threading support\n");
+    return AVERROR(ENOSYS);
+#endif
+}
+
+/* Waits until the slave thread has written all queued packets */
+static int stop_slave_thread(TeeSlave *tee_slave)
+{
+    if (!tee_slave->queue)
+        return 0;
+
+    av_thread_message_queue_set_err_recv(tee_slave->queue, AVERROR_EOF);
+#if HAVE_THREADS
+    pthread_join(tee_slave->thread, NULL);
+#endif
+    av_thread_message_queue_free(&tee_slave->queue);
+
+    av_log(tee_slave->avf, tee_slave->nb_dropped ? AV_LOG_WARNING : AV_LOG_VERBOSE,
+           "Slave '%s': %"PRId64" packets dropped, at most %d packets queued, "
+           "maximum lag %.3fs\n", tee_slave->avf->url, tee_slave->nb_dropped,
+           tee_slave->max_queued, tee_slave->max_lag / (double)AV_TIME_BASE);
+
+    return tee_slave->thread_ret;
+}
+
 static int close_slave(TeeSlave *tee_slave)
 {
     AVFormatContext *avf;
     unsigned i;
-    int ret = 0;
+    int ret = 0, thread_ret;
 
     avf = tee_slave->avf;
     if (!avf)
         return 0;
 
+    thread_ret = stop_slave_thread(tee_slave);
+
     if (tee_slave->header_written)
         ret = av_write_trailer(avf);
+    if (thread_ret < 0)
+        ret = thread_ret;
 
     if (tee_slave->bsfs) {
         for (i = 0; i < avf->nb_streams; ++i)
@@ -137,6 +329,7 @@ static int close_slave(TeeSlave *tee_slave)
     }
     av_freep(&tee_slave->stream_map);
     av_freep(&tee_slave->bsfs);
+    av_freep(&tee_slave->wait_keyframe);
 
     ff_format_io_close(avf, &avf->pb);
     avformat_free_context(avf);
@@ -163,6 +356,7 @@ static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
     char *filename;
     char *format = NULL, *select = NULL, *on_fail = NULL;
     char *use_fifo = NULL, *fifo_options_str = NULL;
+    char *use_thread = NULL, *thread_queue_size = NULL, *on_full = NULL;
     AVFormatContext *avf2 = NULL;
     AVStream *st, *st2;
     int stream_count;
@@ -185,6 +379,9 @@ static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
     STEAL_OPTION("onfail", on_fail);
     STEAL_OPTION("use_fifo", use_fifo);
     STEAL_OPTION("fifo_options", fifo_options_str);
+    STEAL_OPTION("use_thread", use_thread);
+    STEAL_OPTION("thread_queue_size", thread_queue_size);
+    STEAL_OPTION("onfull", on_full);
     entry = NULL;
     while ((entry = av_dict_get(options, "bsfs", entry, AV_DICT_IGNORE_SUFFIX))) {
         /* trim out strlen("bsfs") characters from key */
@@ -205,6 +402,13 @@ static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
         goto end;
     }
 
+    ret = parse_slave_thread_options(use_thread, thread_queue_size, on_full, tee_slave);
+    if (ret < 0) {
+        av_log(avf, AV_LOG_ERROR, "Invalid use_thread, thread_queue_size or onfull "
+               "option value, valid onfull options are 'block' and 'drop'\n");
+        goto end;
+    }
+
     if (tee_slave->use_fifo) {
 
         if (options) {
@@ -237,6 +441,8 @@ static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
     tee_slave->avf = avf2;
     av_dict_copy(&avf2->metadata, avf->metadata, 0);
     avf2->opaque   = avf->opaque;
+    /* with use_thread, these are called from the slave threads, which is
+     * documented as requiring thread-safe callbacks */
     avf2->io_open  = avf->io_open;
     avf2->io_close = avf->io_close;
     avf2->interrupt_callback = avf->interrupt_callback;
@@ -399,10 +605,16 @@ static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
         goto end;
     }
 
+    if (tee_slave->use_thread)
+        ret = start_slave_thread(avf, tee_slave);
+
 end:
     av_free(format);
     av_free(select);
     av_free(on_fail);
+    av_free(use_thread);
+    av_free(thread_queue_size);
+    av_free(on_full);
     av_dict_free(&options);
     av_dict_free(&bsf_options);
     av_freep(&tmp_select);
@@ -483,6 +695,8 @@ static int tee_write_header(AVFormatContext *avf)
     for (i = 0; i < nb_slaves; i++) {
 
         tee->slaves[i].use_fifo = tee->use_fifo;
+        tee->slaves[i].use_thread = tee->use_thread;
+        tee->slaves[i].thread_queue_size = tee->thread_queue_size;
         ret = av_dict_copy(&tee->slaves[i].fifo_options, tee->fifo_options, 0);
         if (ret < 0)
             goto fail;
@@ -534,23 +748,75 @@ static int tee_write_trailer(AVFormatContext *avf)
     return ret_all;
 }
 
+/* Hands a packet over to a threaded slave, dropping it when the queue is
+ * full and the slave is configured to do so. Takes ownership of pkt. */
+static int tee_queue_slave_packet(AVFormatContext *avf, TeeSlave *tee_slave,
+                                  AVPacket *pkt, int s)
+{
+    AVStream *st = avf->streams[s];
+    int s2 = pkt->stream_index;
+    int flags = tee_slave->on_full == ON_SLAVE_FULL_DROP ? AV_THREAD_MESSAGE_NONBLOCK : 0;
+    int64_t ts = pkt->dts != AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+    TeeMessage msg = { .ts = AV_NOPTS_VALUE };
+    int64_t written;
+    int ret;
+
+    /* after a drop, resume at a point the slave can decode from */
+    if (tee_slave->wait_keyframe[s2] && !(pkt->flags & AV_PKT_FLAG_KEY)) {
+        av_packet_unref(pkt);
+        tee_slave->nb_dropped++;
+        return 0;
+    }
+
+    if (ts != AV_NOPTS_VALUE)
+        msg.ts = av_rescale_q(ts, st->time_base, AV_TIME_BASE_Q);
+    av_packet_move_ref(&msg.pkt, pkt);
+
+    ret = av_thread_message_queue_send(tee_slave->queue, &msg, flags);
+    if (ret == AVERROR(EAGAIN)) {
+        av_packet_unref(&msg.pkt);
+        tee_slave->nb_dropped++;
+        tee_slave->wait_keyframe[s2] = 1;
+        return 0;
+    } else if (ret < 0) {
+        av_packet_unref(&msg.pkt);
+        return ret;
+    }
+    tee_slave->wait_keyframe[s2] = 0;
+
+    tee_slave->max_queued = FFMAX(tee_slave->max_queued,
+                                  av_thread_message_queue_nb_elems(tee_slave->queue));
+    if (msg.ts != AV_NOPTS_VALUE) {
+        tee_slave->last_queued_ts = msg.ts;
+        written = atomic_load_explicit(&tee_slave->last_written_ts, memory_order_relaxed);
+        if (written != AV_NOPTS_VALUE)
+            tee_slave->max_lag = FFMAX(tee_slave->max_lag, msg.ts - written);
+    }
+    return 0;
+}
+
 static int tee_write_packet(AVFormatContext *avf, AVPacket *pkt)
 {
     TeeContext *tee = avf->priv_data;
-    AVFormatContext *avf2;
-    AVBSFContext *bsfs;
+    TeeSlave *tee_slave;
     AVPacket pkt2;
     int ret_all = 0, ret;
     unsigned i, s;
     int s2;
 
     for (i = 0; i < tee->nb_slaves; i++) {
-        if (!(avf2 = tee->slaves[i].avf))
+        tee_slave = &tee->slaves[i];
+        if (!tee_slave->avf)
             continue;
 
         /* Flush slave if pkt is NULL*/
         if (!pkt) {
-            ret = av_interleaved_write_frame(avf2, NULL);
+            if (tee_slave->queue) {
+                TeeMessage msg = { .ts = AV_NOPTS_VALUE, .flush = 1 };
+                ret = av_thread_message_queue_send(tee_slave->queue, &msg, 0);
+            } else {
+                ret = av_interleaved_write_frame(tee_slave->avf, NULL);
+            }
             if (ret < 0) {
                 ret = tee_process_slave_failure(avf, i, ret);
                 if (!ret_all && ret < 0)
@@ -560,7 +826,7 @@ static int tee_write_packet(AVFormatContext *avf, AVPacket *pkt)
         }
 
         s = pkt->stream_index;
-        s2 = tee->slaves[i].stream_map[s];
+        s2 = tee_slave->stream_map[s];
         if (s2 < 0)
             continue;
 
@@ -569,33 +835,12 @@ static int tee_write_packet(AVFormatContext *avf, AVPacket *pkt)
                 ret_all = ret;
                 continue;
             }
-        bsfs = tee->slaves[i].bsfs[s2];
         pkt2.stream_index = s2;
 
-        ret = av_bsf_send_packet(bsfs, &pkt2);
-        if (ret < 0) {
-            av_log(avf, AV_LOG_ERROR, "Error while sending packet to bitstream filter: %s\n",
-                   av_err2str(ret));
-            ret = tee_process_slave_failure(avf, i, ret);
-            if (!ret_all && ret < 0)
-                ret_all = ret;
-        }
-
-        while(1) {
-            ret = av_bsf_receive_packet(bsfs, &pkt2);
-            if (ret == AVERROR(EAGAIN)) {
-                ret = 0;
-                break;
-            } else if (ret < 0) {
-                break;
-            }
-
-            av_packet_rescale_ts(&pkt2, bsfs->time_base_out,
-                                 avf2->streams[s2]->time_base);
-            ret = av_interleaved_write_frame(avf2, &pkt2);
-            if (ret < 0)
-                break;
-        };
+        if (tee_slave->queue)
+            ret = tee_queue_slave_packet(avf, tee_slave, &pkt2, s);
+        else
+            ret = tee_write_slave_packet(tee_slave, &pkt2);
 
         if (ret < 0) {
             ret = tee_process_slave_failure(avf, i, ret);
@@ -0,0 +1,334 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* Loopback tests of the multi-client HTTP server with multiplexed
+ * connections, which keeps the client connections for the next request,
+ * and of the client connection pool and pipelined requests. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/thread.h"
+#include "libavformat/avformat.h"
+#include "libavformat/http.h"
+#include "libavformat/url.h"
+
+typedef struct Server {
+    URLContext *uc;
+    int nb_requests;
+    pthread_t thread;
+} Server;
+
+/* Serve each request with its resource and the port of the client as the
+ * reply body. The body of a request is only read for "/read". */
+static void *server_thread(void *arg)
+{
+    Server *server = arg;
+
+    for (int i = 0; i < server->nb_requests; i++) {
+        URLContext *client = NULL;
+        uint8_t *resource = NULL;
+        struct sockaddr_in addr;
+        socklen_t addr_len = sizeof(addr);
+        char buf[256];
+        int ret;
+
+        if ((ret = ffurl_accept(server->uc, &client)) < 0) {
+            printf("accept failed: %s\n", av_err2str(ret));
+            break;
+        }
+        while ((ret = ffurl_handshake(client)) > 0);
+        if (!ret)
+            ret = av_opt_get(client->priv_data, "resource", 0, &resource);
+        if (!ret && getpeername(ffurl_get_file_handle(client),
+                                (struct sockaddr *)&addr, &addr_len))
+            ret = AVERROR(errno);
+        if (!ret) {
+            if (!strcmp(resource, "/read"))
+                while (ffurl_read(client, buf, sizeof(buf)) > 0);
+            snprintf(buf, sizeof(buf), "%s %d", resource, ntohs(addr.sin_port));
+            ffurl_write(client, buf, strlen(buf));
+        }
+        av_free(resource);
+        ffurl_closep(&client);
+    }
+    return NULL;
+}
+
+/* Clients of a server opened for writing only send GET requests, those of
+ * a server also opened for reading send POST requests. If *port is not
+ * set, the first free port found is used. */
+static int start_server(Server *server, int flags, int nb_requests, int *port)
+{
+    int base = *port ? *port : 20000 + getpid() % 20000;
+    int ret = AVERROR(EADDRINUSE);
+
+    for (int i = 0; i < (*port ? 1 : 100) && ret == AVERROR(EADDRINUSE); i++) {
+        AVDictionary *opts = NULL;
+        char url[64];
+
+        snprintf(url, sizeof(url), "http://127.0.0.1:%d", base + i);
+        av_dict_set(&opts, "listen", "2", 0);
+        av_dict_set(&opts, "multiplex", "1", 0);
+        av_dict_set(&opts, "listen_timeout", "10000", 0);
+        ret = ffurl_open_whitelist(&server->uc, url, flags,
+                                   NULL, &opts, NULL, NULL, NULL);
+        av_dict_free(&opts);
+        if (ret >= 0)
+            *port = base + i;
+    }
+    if (ret < 0)
+        return ret;
+
+    server->nb_requests = nb_requests;
+    if (pthread_create(&server->thread, NULL, server_thread, server)) {
+        ffurl_closep(&server->uc);
+        return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+
+/* Wait for the server to serve all its requests, and close it. */
+static void stop_server(Server *server)
+{
+    pthread_join(server->thread, NULL);
+    ffurl_closep(&server->uc);
+}
+
+static int connect_client(URLContext **c, int port)
+{
+    AVDictionary *opts = NULL;
+    char url[64];
+    int ret;
+
+    snprintf(url, sizeof(url), "tcp://127.0.0.1:%d", port);
+    av_dict_set(&opts, "timeout", "10000000", 0);
+    ret = ffurl_open_whitelist(c, url, AVIO_FLAG_READ_WRITE, NULL, &opts,
+                               NULL, NULL, NULL);
+    av_dict_free(&opts);
+    return ret;
+}
+
+/* Send a request and print the reply, a chunked one from the server. */
+static int request(URLContext *c, const char *req)
+{
+    static const char end[] = "\r\n0\r\n\r\n";
+    char reply[1024], *body;
+    int len = 0, ret;
+
+    if ((ret = ffurl_write(c, req, strlen(req))) < 0)
+        return ret;
+    while (len < strlen(end) || strcmp(reply + len - strlen(end), end)) {
+        if (len == sizeof(reply) - 1)
+            return AVERROR_INVALIDDATA;
+        ret = ffurl_read(c, reply + len, sizeof(reply) - 1 - len);
+        if (ret <= 0)
+            return ret ? ret : AVERROR_EOF;
+        len += ret;
+        reply[len] = '\0';
+    }
+    body = strstr(reply, "\r\n\r\n");
+    if (!body || !(body = strstr(body + 4, "\r\n")))
+        return AVERROR_INVALIDDATA;
+    body += 2;
+    printf("%.*s: %.12s, %s\n", (int)strcspn(body, " "), body, reply,
+           strstr(reply, "Connection: close\r\n") ? "Connection: close" : "keep-alive");
+    return 0;
+}
+
+/* The server closed the connection after its last reply. */
+static void check_closed(URLContext *c)
+{
+    char buf[16];
+    int ret = ffurl_read(c, buf, sizeof(buf));
+
+    if (ret == AVERROR_EOF || ret == 0 || ret == AVERROR(ECONNRESET))
+        printf("closed\n");
+    else
+        printf("not closed: %d\n", ret);
+}
+
+static int test_server(int port)
+{
+    URLContext *c = NULL;
+    int ret;
+
+    /* A connection is kept as long as its requests are read entirely. */
+    if ((ret = connect_client(&c, port)) < 0 ||
+        (ret = request(c, "POST /first HTTP/1.1\r\nContent-Length: 0\r\n\r\n")) < 0 ||
+        (ret = request(c, "POST /second HTTP/1.1\r\nContent-Length: 0\r\n\r\n")) < 0 ||
+        (ret = request(c, "POST /read HTTP/1.1\r\nContent-Length: 4\r\n\r\nbody")) < 0 ||
+        (ret = request(c, "POST /skip HTTP/1.1\r\nContent-Length: 4\r\n\r\nbody")) < 0)
+        goto fail;
+    check_closed(c);
+    ffurl_closep(&c);
+
+    /* The second request is in the buffer when the first one is replied. */
+    if ((ret = connect_client(&c, port)) < 0 ||
+        (ret = request(c, "POST /pipelined HTTP/1.1\r\nContent-Length: 0\r\n\r\n"
+                          "POST /lost HTTP/1.1\r\nContent-Length: 0\r\n\r\n")) < 0)
+        goto fail;
+    check_closed(c);
+    ffurl_closep(&c);
+
+    if ((ret = connect_client(&c, port)) < 0 ||
+        (ret = request(c, "POST /close HTTP/1.1\r\nContent-Length: 0\r\n"
+                          "Connection: close\r\n\r\n")) < 0)
+        goto fail;
+    check_closed(c);
+    ffurl_closep(&c);
+
+    if ((ret = connect_client(&c, port)) < 0 ||
+        (ret = request(c, "POST /http10 HTTP/1.0\r\nContent-Length: 0\r\n\r\n")) < 0)
+        goto fail;
+    check_closed(c);
+
+fail:
+    ffurl_closep(&c);
+    return ret;
+}
+
+static int open_get(URLContext **h, int port, const char *resource)
+{
+    AVDictionary *opts = NULL;
+    char url[64];
+    int ret;
+
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d%s", port, resource);
+    av_dict_set(&opts, "multiple_requests", "1", 0);
+    av_dict_set(&opts, "connection_pool", "1", 0);
+    av_dict_set(&opts, "timeout", "10000000", 0);
+    ret = ffurl_open_whitelist(h, url, AVIO_FLAG_READ, NULL, &opts,
+                               NULL, NULL, NULL);
+    av_dict_free(&opts);
+    return ret;
+}
+
+/* Read the reply to the current request and print which connection, in
+ * order of first use, served it. */
+static int read_reply(URLContext *h, int *ports, int nb_ports)
+{
+    char body[64], *sep;
+    int len = 0, port, i, ret;
+
+    while (len < sizeof(body) - 1 &&
+           (ret = ffurl_read(h, body + len, sizeof(body) - 1 - len)) > 0)
+        len += ret;
+    if (ret < 0 && ret != AVERROR_EOF)
+        return ret;
+    body[len] = '\0';
+    if (!(sep = strchr(body, ' ')))
+        return AVERROR_INVALIDDATA;
+    port = atoi(sep + 1);
+    for (i = 0; i < nb_ports - 1 && ports[i] && ports[i] != port; i++);
+    ports[i] = port;
+    printf("%.*s: connection %d\n", (int)(sep - body), body, i + 1);
+    return 0;
+}
+
+static int test_client(Server *server, int port)
+{
+    URLContext *h = NULL;
+    char url[64];
+    int ports[8] = { 0 };
+    int ret;
+
+    /* the pool is emptied when its last user releases it */
+    ff_http_pool_ref();
+
+    /* The connection of a complete reply is reused by the next context. */
+    if ((ret = open_get(&h, port, "/pooled1")) < 0 ||
+        (ret = read_reply(h, ports, FF_ARRAY_ELEMS(ports))) < 0)
+        goto fail;
+    ffurl_closep(&h);
+    if ((ret = open_get(&h, port, "/pooled2")) < 0 ||
+        (ret = read_reply(h, ports, FF_ARRAY_ELEMS(ports))) < 0)
+        goto fail;
+    ffurl_closep(&h);
+
+    /* The reply to the pipelined request is used by the next request. */
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/next", port);
+    if ((ret = open_get(&h, port, "/current")) < 0 ||
+        (ret = ff_http_pipeline_request(h, url, 0, 0)) < 0 ||
+        (ret = read_reply(h, ports, FF_ARRAY_ELEMS(ports))) < 0 ||
+        (ret = ff_http_do_new_request(h, url)) < 0 ||
+        (ret = read_reply(h, ports, FF_ARRAY_ELEMS(ports))) < 0)
+        goto fail;
+    ffurl_closep(&h);
+
+    /* Another request cannot skip the pending reply, and is sent on a new
+     * connection. */
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/skipped", port);
+    if ((ret = open_get(&h, port, "/current")) < 0 ||
+        (ret = ff_http_pipeline_request(h, url, 0, 0)) < 0 ||
+        (ret = read_reply(h, ports, FF_ARRAY_ELEMS(ports))) < 0)
+        goto fail;
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/other", port);
+    if ((ret = ff_http_do_new_request(h, url)) < 0 ||
+        (ret = read_reply(h, ports, FF_ARRAY_ELEMS(ports))) < 0)
+        goto fail;
+    ffurl_closep(&h);
+
+    /* Closing the server closes the pooled connection, which is not used
+     * by the next request to the new server. */
+    stop_server(server);
+    if ((ret = start_server(server, AVIO_FLAG_WRITE, 1, &port)) < 0)
+        goto fail;
+    if ((ret = open_get(&h, port, "/restarted")) < 0 ||
+        (ret = read_reply(h, ports, FF_ARRAY_ELEMS(ports))) < 0)
+        goto fail;
+
+fail:
+    ffurl_closep(&h);
+    ff_http_pool_unref();
+    return ret;
+}
+
+int main(void)
+{
+    Server server = { 0 };
+    int port = 0, ret;
+
+    av_log_set_level(AV_LOG_QUIET);
+    avformat_network_init();
+
+    if ((ret = start_server(&server, AVIO_FLAG_READ_WRITE, 7, &port)) < 0)
+        goto fail;
+    ret = test_server(port);
+    stop_server(&server);
+    if (ret < 0)
+        goto fail;
+
+    if ((ret = start_server(&server, AVIO_FLAG_WRITE, 7, &port)) < 0)
+        goto fail;
+    ret = test_client(&server, port);
+    if (server.uc)
+        stop_server(&server);
+
+fail:
+    if (ret < 0)
+        printf("failed: %s\n", av_err2str(ret));
+    avformat_network_deinit();
+    return ret < 0;
+}
@@ -0,0 +1,143 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/intreadwrite.h"
+#include "libavformat/prompegdec.h"
+
+#define L 5
+#define D 4
+#define NB_MEDIA (L * D + L)
+#define PAYLOAD_SIZE 188
+#define PACKET_SIZE (12 + PAYLOAD_SIZE)
+#define FEC_SIZE (28 + PAYLOAD_SIZE)
+#define FIRST_SEQ 65530
+
+static uint8_t media[NB_MEDIA][PACKET_SIZE];
+static uint8_t row_fec[D][FEC_SIZE];
+static uint8_t col_fec[L][FEC_SIZE];
+
+static void make_media(void)
+{
+    uint32_t seed = 1;
+    int i, j;
+
+    for (i = 0; i < NB_MEDIA; i++) {
+        uint8_t *p = media[i];
+        p[0] = 0x80;
+        p[1] = 33 | (i % 7 == 6 ? 0x80 : 0);
+        AV_WB16(p + 2, FIRST_SEQ + i);
+        AV_WB32(p + 4, 90000 + 3003 * (i / 3));
+        AV_WB32(p + 8, 0x12345678);
+        for (j = 12; j < PACKET_SIZE; j++) {
+            seed = seed * 1664525 + 1013904223;
+            p[j] = seed >> 24;
+        }
+    }
+}
+
+/* Same layout as the prompeg protocol */
+static void make_fec(uint8_t *fec, int first, int offset, int na)
+{
+    uint8_t b0 = 0, m_pt = 0;
+    uint32_t ts = 0;
+    int i, j;
+
+    memset(fec, 0, FEC_SIZE);
+    for (i = 0; i < na; i++) {
+        const uint8_t *p = media[first + i * offset];
+        b0   ^= p[0] & 0x3f;
+        m_pt ^= p[1];
+        ts   ^= AV_RB32(p + 4);
+        for (j = 0; j < PAYLOAD_SIZE; j++)
+            fec[28 + j] ^= p[12 + j];
+    }
+    fec[0] = 0x80 | b0;
+    fec[1] = (m_pt & 0x80) | 0x60;
+    AV_WB16(fec + 12, FIRST_SEQ + first);
+    AV_WB16(fec + 14, na & 1 ? PAYLOAD_SIZE : 0);
+    fec[16] = 0x80 | m_pt;
+    AV_WB32(fec + 20, ts);
+    fec[24] = offset == 1 ? 0x40 : 0;
+    fec[25] = offset;
+    fec[26] = na;
+}
+
+static int test(const char *name, const int *lost, int nb_lost,
+                int use_rows, int use_cols)
+{
+    PrompegDecoder *d = ff_prompeg_dec_alloc(NULL);
+    uint8_t buf[PACKET_SIZE + 16];
+    int i, j, len, nb_recovered = 0, errors = 0;
+
+    if (!d)
+        return 1;
+
+    for (i = 0; i < NB_MEDIA; i++) {
+        for (j = 0; j < nb_lost; j++)
+            if (lost[j] == i)
+                break;
+        if (j == nb_lost)
+            ff_prompeg_dec_add_media(d, media[i], PACKET_SIZE);
+    }
+    for (i = 0; i < D && use_rows; i++)
+        ff_prompeg_dec_add_fec(d, row_fec[i], FEC_SIZE);
+    for (i = 0; i < L && use_cols; i++)
+        ff_prompeg_dec_add_fec(d, col_fec[i], FEC_SIZE);
+
+    while ((len = ff_prompeg_dec_get_recovered(d, buf, sizeof(buf))) >= 0) {
+        int idx = (uint16_t)(AV_RB16(buf + 2) - FIRST_SEQ);
+        nb_recovered++;
+        if (idx >= NB_MEDIA || len != PACKET_SIZE ||
+            memcmp(buf, media[idx], PACKET_SIZE)) {
+            printf("%s: packet %d recovered incorrectly\n", name, idx);
+            errors++;
+        }
+    }
+    printf("%s: %d lost, %d recovered\n", name, nb_lost, nb_recovered);
+
+    ff_prompeg_dec_free(&d);
+    return errors;
+}
+
+int main(void)
+{
+    static const int one_per_row[] = { 2, 5, 14, 19 };
+    static const int burst[]       = { 6, 7, 8, 9, 10 };
+    static const int corner[]      = { 0, 1, 5 };
+    static const int square[]      = { 0, 1, 5, 6 };
+    int i, errors = 0;
+
+    make_media();
+    for (i = 0; i < D; i++)
+        make_fec(row_fec[i], i * L, 1, L);
+    for (i = 0; i < L; i++)
+        make_fec(col_fec[i], i, L, D);
+
+    errors += test("rows",       one_per_row, 4, 1, 0);
+    errors += test("burst",      burst,       5, 0, 1);
+    errors += test("burst-rows", burst,       5, 1, 0);
+    errors += test("corner",     corner,      3, 1, 1);
+    errors += test("square",     square,      4, 1, 1);
+    errors += test("nofec",      corner,      3, 0, 0);
+
+    return !!errors;
+}
@@ -0,0 +1,172 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/intreadwrite.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/pixdesc.h"
+#include "libavformat/avformat.h"
+#include "libavformat/rtpdec.h"
+
+#define WIDTH  64
+#define HEIGHT 8
+#define PGROUP 5
+#define LINE_SIZE (WIDTH / 2 * PGROUP)
+#define FRAME_SIZE (LINE_SIZE * HEIGHT)
+/* so that lines are split across packets */
+#define MAX_PAYLOAD 150
+
+static uint8_t frames[3][FRAME_SIZE];
+static char stats[256];
+static uint8_t *packets[64];
+static int packet_sizes[64];
+static int nb_packets;
+
+/* Synthetic sender: packetize a frame, with up to two line segments per
+ * packet, as RFC 4175 allows. */
+static void packetize(const uint8_t *frame, uint32_t ts, uint32_t *seq)
+{
+    int line = 0, offset = 0;
+
+    while (line < HEIGHT) {
+        uint8_t hdr[2][6], *p;
+        int lens[2], nb = 0, room = MAX_PAYLOAD, pos, i;
+        int seg_line[2], seg_off[2];
+
+        while (nb < 2 && line < HEIGHT && room >= 6 + PGROUP) {
+            int len = FFMIN(LINE_SIZE - offset * PGROUP / 2, room - 6);
+            len -= len % PGROUP;
+            seg_line[nb] = line;
+            seg_off[nb]  = offset;
+            lens[nb]     = len;
+            room -= 6 + len;
+            offset += len / PGROUP * 2;
+            if (offset == WIDTH) {
+                offset = 0;
+                line++;
+            }
+            nb++;
+        }
+        for (i = 0; i < nb; i++) {
+            AV_WB16(hdr[i], lens[i]);
+            AV_WB16(hdr[i] + 2, seg_line[i]);
+            AV_WB16(hdr[i] + 4, seg_off[i] | (i < nb - 1 ? 0x8000 : 0));
+        }
+
+        p = packets[nb_packets] = av_malloc(12 + 2 + 12 + MAX_PAYLOAD);
+        p[0] = 0x80;
+        p[1] = 96 | (line == HEIGHT ? 0x80 : 0);
+        AV_WB16(p + 2, *seq);
+        AV_WB32(p + 4, ts);
+        AV_WB32(p + 8, 0x12345678);
+        AV_WB16(p + 12, *seq >> 16);
+        pos = 14;
+        for (i = 0; i < nb; i++, pos += 6)
+            memcpy(p + pos, hdr[i], 6);
+        for (i = 0; i < nb; i++) {
+            memcpy(p + pos, frame + seg_line[i] * LINE_SIZE + seg_off[i] * PGROUP / 2,
+                   lens[i]);
+            pos += lens[i];
+        }
+        packet_sizes[nb_packets++] = pos;
+        (*seq)++;
+    }
+}
+
+/* Keep the statistics the depacketizer logs when closed. */
+static void log_callback(void *avcl, int level, const char *fmt, va_list vl)
+{
+    if (level == AV_LOG_VERBOSE && strstr(fmt, "packets lost"))
+        vsnprintf(stats, sizeof(stats), fmt, vl);
+}
+
+int main(void)
+{
+    AVFormatContext *s = avformat_alloc_context();
+    const RTPDynamicProtocolHandler *handler;
+    PayloadContext *priv = NULL;
+    RTPDemuxContext *rtp = NULL;
+    AVPacket *pkt = av_packet_alloc();
+    AVStream *st;
+    uint32_t seq = 0xfff0;
+    int i, j, ret, lost, nb_frames = 0, errors = 0;
+
+    av_log_set_callback(log_callback);
+
+    if (!s || !pkt || !(st = avformat_new_stream(s, NULL)))
+        return 1;
+    st->time_base = (AVRational){ 1, 90000 };
+
+    handler = ff_rtp_handler_find_by_name("raw", AVMEDIA_TYPE_VIDEO);
+    if (!handler || !(priv = av_mallocz(handler->priv_data_size)))
+        return 1;
+    ret = handler->parse_sdp_a_line(s, 0, priv, "fmtp:96 sampling=YCbCr-4:2:2; "
+                                    "width=64; height=8; depth=10");
+    if (ret < 0)
+        return 1;
+    printf("%s, %dx%d\n", av_get_pix_fmt_name(st->codecpar->format),
+           st->codecpar->width, st->codecpar->height);
+
+    rtp = ff_rtp_parse_open(s, st, 96, 0);
+    if (!rtp)
+        return 1;
+    ff_rtp_parse_set_dynamic_protocol(rtp, priv, handler);
+
+    for (i = 0; i < 3; i++) {
+        for (j = 0; j < FRAME_SIZE; j++)
+            frames[i][j] = i * 37 + j * 13;
+        packetize(frames[i], 3000 * (i + 1), &seq);
+    }
+    /* lose a packet in the middle of the second frame */
+    lost = nb_packets / 2;
+
+    for (i = 0; i < nb_packets; i++) {
+        if (i == lost) {
+            av_freep(&packets[i]);
+            continue;
+        }
+        ret = ff_rtp_parse_packet(rtp, pkt, &packets[i], packet_sizes[i]);
+        av_freep(&packets[i]);
+        if (ret < 0)
+            continue;
+        printf("frame %d: size %d, %s\n", nb_frames, pkt->size,
+               pkt->flags & AV_PKT_FLAG_CORRUPT ? "corrupt" : "complete");
+        if (pkt->size != FRAME_SIZE ||
+            (!(pkt->flags & AV_PKT_FLAG_CORRUPT) &&
+             memcmp(pkt->data, frames[nb_frames], FRAME_SIZE))) {
+            printf("frame %d: unexpected content\n", nb_frames);
+            errors++;
+        }
+        nb_frames++;
+        av_packet_unref(pkt);
+    }
+    printf("%d packets sent, %d frames received\n", nb_packets, nb_frames);
+
+    ff_rtp_parse_close(rtp);
+    handler->close(priv);
+    printf("depacketizer: %s", stats);
+    av_free(priv);
+    av_packet_free(&pkt);
+    avformat_free_context(s);
+    return errors;
+}
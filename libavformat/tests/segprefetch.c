@@ -0,0 +1,215 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "libavutil/avstring.h"
+#include "libavformat/avformat.h"
+#include "libavformat/segprefetch.h"
+
+static char base_url[64];
+static const char *data_dir;
+static int nb_prefetches;
+
+/* Take a segment as if it was the next one to read, and print it. */
+static void take(SegmentPrefetchQueue *q, int64_t id)
+{
+    SegmentPrefetch *p = ff_segment_prefetch_take(q, id);
+    char buf[64];
+    int len = 0, ret;
+
+    if (!p) {
+        printf("segment %"PRId64": not queued, %d queued\n", id, q->nb_segments);
+        return;
+    }
+    ret = ff_segment_prefetch_wait(p);
+    while (ret >= 0 && len < sizeof(buf) - 1 &&
+           (ret = ff_segment_prefetch_read(p, buf + len, sizeof(buf) - 1 - len)) > 0)
+        len += ret;
+    buf[len] = '\0';
+    if (ret < 0 && ret != AVERROR_EOF)
+        printf("segment %"PRId64": %s, %d queued\n", id, av_err2str(ret), q->nb_segments);
+    else
+        printf("segment %"PRId64": \"%s\", %d queued\n", id, buf, q->nb_segments);
+    ff_segment_prefetch_free(&p);
+}
+
+static void start(SegmentPrefetchQueue *q, AVFormatContext *s, int64_t id,
+                  const char *url)
+{
+    int ret = ff_segment_prefetch_start(q, s, id, url, NULL, -1, 1024);
+
+    if (ret < 0)
+        printf("segment %"PRId64": could not start: %s\n", id, av_err2str(ret));
+}
+
+/* A local port which accepts connections but never replies, or refuses
+ * them if listen is not set. */
+static int open_port(int listen_backlog, int *port)
+{
+    struct sockaddr_in addr = { .sin_family = AF_INET };
+    socklen_t addr_len = sizeof(addr);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 ||
+        bind(fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+        (listen_backlog && listen(fd, listen_backlog)) ||
+        getsockname(fd, (struct sockaddr *)&addr, &addr_len)) {
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    *port = ntohs(addr.sin_port);
+    return fd;
+}
+
+static int test_queue(void)
+{
+    AVFormatContext *s = avformat_alloc_context();
+    SegmentPrefetchQueue q = { 0 };
+    char url[64];
+    int fd, port;
+
+    if (!s)
+        return AVERROR(ENOMEM);
+
+    /* segments are read in order */
+    start(&q, s, 1, "data:,segment1");
+    start(&q, s, 2, "data:,segment2");
+    start(&q, s, 3, "data:,segment3");
+    take(&q, 1);
+    take(&q, 2);
+    take(&q, 3);
+
+    /* seeking cancels the segments before the new one, or all of them */
+    start(&q, s, 4, "data:,segment4");
+    start(&q, s, 5, "data:,segment5");
+    start(&q, s, 6, "data:,segment6");
+    take(&q, 6);
+    start(&q, s, 7, "data:,segment7");
+    start(&q, s, 8, "data:,segment8");
+    take(&q, 20);
+    start(&q, s, 9, "data:,segment9");
+    start(&q, s, 10, "data:,segment10");
+    take(&q, 3);
+
+    /* a download blocked on the server is interrupted when cancelled */
+    if ((fd = open_port(1, &port)) >= 0) {
+        snprintf(url, sizeof(url), "http://127.0.0.1:%d/segment11", port);
+        start(&q, s, 11, url);
+        take(&q, 12);
+        close(fd);
+    }
+
+    /* the error of a failed prefetch is returned by the segment */
+    start(&q, s, 13, "nonexistent:segment13");
+    take(&q, 13);
+
+    ff_segment_prefetch_flush(&q);
+    avformat_free_context(s);
+    return 0;
+}
+
+static int io_open(AVFormatContext *s, AVIOContext **pb, const char *url,
+                   int flags, AVDictionary **opts)
+{
+    char path[1024];
+    const char *name;
+
+    if (!av_strstart(url, base_url, &name))
+        return AVERROR(EINVAL);
+    printf("io_open: %s\n", name);
+    snprintf(path, sizeof(path), "%s/%s", data_dir, name);
+    return avio_open2(pb, path, flags, &s->interrupt_callback, opts);
+}
+
+static void log_callback(void *avcl, int level, const char *fmt, va_list vl)
+{
+    if (av_strstart(fmt, "Prefetching segment", NULL))
+        nb_prefetches++;
+}
+
+/* The server of the playlist refuses the connections, while the io_open
+ * callback of the application serves the files. Segments are read through
+ * it once their prefetching failed. */
+static int test_hls(void)
+{
+    AVFormatContext *s = avformat_alloc_context();
+    AVDictionary *opts = NULL;
+    AVPacket *pkt = av_packet_alloc();
+    char url[128];
+    int fd, port, nb_packets = 0, ret;
+
+    if (!s || !pkt) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    if ((fd = open_port(0, &port)) < 0) {
+        ret = AVERROR(errno);
+        goto fail;
+    }
+    snprintf(base_url, sizeof(base_url), "http://127.0.0.1:%d/", port);
+    snprintf(url, sizeof(url), "%shls_list_size.m3u8", base_url);
+    s->io_open = io_open;
+    av_dict_set(&opts, "prefetch_segments", "2", 0);
+    av_log_set_callback(log_callback);
+    av_log_set_level(AV_LOG_DEBUG);
+
+    ret = avformat_open_input(&s, url, av_find_input_format("hls"), &opts);
+    while (ret >= 0 && (ret = av_read_frame(s, pkt)) >= 0) {
+        nb_packets++;
+        av_packet_unref(pkt);
+    }
+    if (ret == AVERROR_EOF)
+        ret = 0;
+    printf("%d packets, %d segments prefetched\n", nb_packets, nb_prefetches);
+
+    avformat_close_input(&s);
+    close(fd);
+fail:
+    av_log_set_level(AV_LOG_QUIET);
+    av_dict_free(&opts);
+    av_packet_free(&pkt);
+    avformat_free_context(s);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    int ret;
+
+    av_log_set_level(AV_LOG_QUIET);
+    avformat_network_init();
+    ret = test_queue();
+    if (ret >= 0 && argc > 1) {
+        data_dir = argv[1];
+        ret = test_hls();
+    }
+    if (ret < 0)
+        printf("failed: %s\n", av_err2str(ret));
+    avformat_network_deinit();
+    return ret < 0;
+}
@@ -61,6 +61,7 @@ int ff_tls_open_underlying(TLSShared *c, URLContext *parent, const char *uri, AV
     struct addrinfo hints = { 0 }, *ai = NULL;
     const char *proxy_path;
     int use_proxy;
+    AVIOInterruptCB int_cb = { ff_url_interrupt_cb, parent };
 
     set_options(c, uri);
 
@@ -105,6 +106,6 @@ int ff_tls_open_underlying(TLSShared *c, URLContext *parent, const char *uri, AV
     }
 
     return ffurl_open_whitelist(&c->tcp, buf, AVIO_FLAG_READ_WRITE,
-                                &parent->interrupt_callback, options,
+                                &int_cb, options,
                                 parent->protocol_whitelist, parent->protocol_blacklist, parent);
 }
@@ -31,11 +31,11 @@
 #include "avio_internal.h"
 #include "libavutil/avassert.h"
 #include "libavutil/parseutils.h"
-#include "libavutil/fifo.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/avstring.h"
 #include "libavutil/opt.h"
 #include "libavutil/log.h"
+#include "libavutil/spscring.h"
 #include "libavutil/time.h"
 #include "internal.h"
 #include "network.h"
@@ -67,6 +67,7 @@
 #endif
 
 #if HAVE_PTHREAD_CANCEL
+#include <stdatomic.h>
 #include "libavutil/thread.h"
 #endif
 
@@ -79,6 +80,7 @@
 #define UDP_RX_BUF_SIZE 393216
 #define UDP_MAX_PKT_SIZE 65536
 #define UDP_HEADER_SIZE 8
+#define UDP_GSO_MAX_SIZE 65507
 
 typedef struct UDPContext {
     const AVClass *class;
@@ -98,19 +100,27 @@ typedef struct UDPContext {
 
     /* Circular Buffer variables for use in UDP receive code */
     int circular_buffer_size;
-    AVFifoBuffer *fifo;
-    int circular_buffer_error;
+    AVSPSCRing *fifo;
     int64_t bitrate; /* number of bits to send per second */
     int64_t burst_bits;
-    int close_req;
+    int64_t overrun_count;
 #if HAVE_PTHREAD_CANCEL
+    atomic_int circular_buffer_error;
+    atomic_int close_req;
+    atomic_int_least64_t overruns;
     pthread_t circular_buffer_thread;
-    pthread_mutex_t mutex;
-    pthread_cond_t cond;
     int thread_started;
 #endif
     uint8_t tmp[UDP_MAX_PKT_SIZE+4];
     int remaining_in_dg;
+
+    /* Batched receive and send */
+    int batch_size;
+    int gso;
+    int gro;
+    uint8_t *batch_buf;
+    FFDatagram batch[FF_DATAGRAM_BATCH_MAX];
+    int batch_pos, batch_count, batch_offset;
     char *localaddr;
     int timeout;
     struct sockaddr_storage local_addr_storage;
@@ -138,7 +148,11 @@ static const AVOption options[] = {
     { "connect",        "set if connect() should be called on socket",     OFFSET(is_connected),   AV_OPT_TYPE_BOOL,   { .i64 =  0 },     0, 1,       .flags = D|E },
     { "fifo_size",      "set the UDP receiving circular buffer size, expressed as a number of packets with size of 188 bytes", OFFSET(circular_buffer_size), AV_OPT_TYPE_INT, {.i64 = 7*4096}, 0, INT_MAX, D },
     { "overrun_nonfatal", "survive in case of UDP receiving circular buffer overrun", OFFSET(overrun_nonfatal), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1,    D },
+    { "overrun_count",  "export the number of datagrams lost to circular buffer overruns", OFFSET(overrun_count), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, D | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
     { "timeout",        "set raise error timeout, in microseconds (only in read mode)",OFFSET(timeout),         AV_OPT_TYPE_INT,  {.i64 = 0}, 0, INT_MAX, D },
+    { "batch_size",     "Maximum number of datagrams received or sent per system call", OFFSET(batch_size), AV_OPT_TYPE_INT, { .i64 = 1 }, 1, FF_DATAGRAM_BATCH_MAX, .flags = D|E },
+    { "gso",            "Send batches of equally sized packets using UDP segmentation offload", OFFSET(gso), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, E },
+    { "gro",            "Let the kernel coalesce received datagrams using UDP receive offload", OFFSET(gro), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, D },
     { "sources",        "Source list",                                     OFFSET(sources),        AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
     { "block",          "Block list",                                      OFFSET(block),          AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
     { NULL }
@@ -467,57 +481,67 @@ static void *circular_buffer_task_rx( void *_URLContext)
     int old_cancelstate;
 
     pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
-    pthread_mutex_lock(&s->mutex);
     if (ff_socket_nonblock(s->udp_fd, 0) < 0) {
         av_log(h, AV_LOG_ERROR, "Failed to set blocking mode");
-        s->circular_buffer_error = AVERROR(EIO);
+        atomic_store(&s->circular_buffer_error, AVERROR(EIO));
         goto end;
     }
     while(1) {
-        int len;
-        struct sockaddr_storage addr;
-        socklen_t addr_len = sizeof(addr);
+        int n, i;
 
-        pthread_mutex_unlock(&s->mutex);
         /* Blocking operations are always cancellation points;
            see "General Information" / "Thread Cancelation Overview"
            in Single Unix. */
         pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_cancelstate);
-        len = recvfrom(s->udp_fd, s->tmp+4, sizeof(s->tmp)-4, 0, (struct sockaddr *)&addr, &addr_len);
+        n = ff_recv_datagrams(s->udp_fd, s->batch, s->batch_size, 0);
         pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
-        pthread_mutex_lock(&s->mutex);
-        if (len < 0) {
-            if (ff_neterrno() != AVERROR(EAGAIN) && ff_neterrno() != AVERROR(EINTR)) {
-                s->circular_buffer_error = ff_neterrno();
+        if (n < 0) {
+            if (n != AVERROR(EAGAIN) && n != AVERROR(EINTR)) {
+                atomic_store(&s->circular_buffer_error, n);
                 goto end;
             }
             continue;
         }
-        if (ff_ip_check_source_lists(&addr, &s->filters))
-            continue;
-        AV_WL32(s->tmp, len);
+        for (i = 0; i < n; i++) {
+            FFDatagram *dg = &s->batch[i];
+            int seg_size = dg->seg_size ? dg->seg_size : dg->len;
+            int offset = 0;
 
-        if(av_fifo_space(s->fifo) < len + 4) {
-            /* No Space left */
-            if (s->overrun_nonfatal) {
-                av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
-                        "Surviving due to overrun_nonfatal option\n");
+            if (ff_ip_check_source_lists(&dg->addr, &s->filters))
                 continue;
-            } else {
-                av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
-                        "To avoid, increase fifo_size URL option. "
-                        "To survive in such case, use overrun_nonfatal option\n");
-                s->circular_buffer_error = AVERROR(EIO);
-                goto end;
-            }
+
+            /* Each datagram buffer is preceded by 4 spare bytes for the
+             * length prefix. For the later segments of a coalesced datagram
+             * the prefix overwrites the tail of the previous segment, which
+             * has already been queued. */
+            do {
+                uint8_t *p = dg->buf + offset;
+                int len = FFMIN(seg_size, dg->len - offset);
+
+                AV_WL32(p - 4, len);
+                offset += len;
+
+                if (av_spsc_ring_write(s->fifo, p - 4, len + 4) < 0) {
+                    /* No Space left */
+                    atomic_fetch_add(&s->overruns, 1);
+                    if (s->overrun_nonfatal) {
+                        av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
+                                "Surviving due to overrun_nonfatal option\n");
+                        continue;
+                    } else {
+                        av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
+                                "To avoid, increase fifo_size URL option. "
+                                "To survive in such case, use overrun_nonfatal option\n");
+                        atomic_store(&s->circular_buffer_error, AVERROR(EIO));
+                        goto end;
+                    }
+                }
+            } while (offset < dg->len);
         }
-        av_fifo_generic_write(s->fifo, s->tmp, len+4, NULL);
-        pthread_cond_signal(&s->cond);
     }
 
 end:
-    pthread_cond_signal(&s->cond);
-    pthread_mutex_unlock(&s->mutex);
+    av_spsc_ring_wake(s->fifo);
     return NULL;
 }
 
@@ -529,42 +553,52 @@ static void *circular_buffer_task_tx( void *_URLContext)
     int64_t start_timestamp = av_gettime_relative();
     int64_t sent_bits = 0;
     int64_t burst_interval = s->bitrate ? (s->burst_bits * 1000000 / s->bitrate) : 0;
-    int64_t max_delay = s->bitrate ?  ((int64_t)h->max_packet_size * 8 * 1000000 / s->bitrate + 1) : 0;
-
-    pthread_mutex_lock(&s->mutex);
+    int64_t max_delay = s->bitrate ?  ((int64_t)h->max_packet_size * s->batch_size * 8 * 1000000 / s->bitrate + 1) : 0;
 
     if (ff_socket_nonblock(s->udp_fd, 0) < 0) {
         av_log(h, AV_LOG_ERROR, "Failed to set blocking mode");
-        s->circular_buffer_error = AVERROR(EIO);
-        goto end;
+        atomic_store(&s->circular_buffer_error, AVERROR(EIO));
+        return NULL;
     }
 
     for(;;) {
-        int len;
-        const uint8_t *p;
+        int len, n, total;
         uint8_t tmp[4];
         int64_t timestamp;
-
-        len = av_fifo_size(s->fifo);
-
-        while (len<4) {
-            if (s->close_req)
-                goto end;
-            if (pthread_cond_wait(&s->cond, &s->mutex) < 0) {
-                goto end;
-            }
-            len = av_fifo_size(s->fifo);
+        FFDatagram dg[FF_DATAGRAM_BATCH_MAX];
+        const struct sockaddr *dest = s->is_connected ? NULL :
+                                      (struct sockaddr *)&s->dest_addr;
+
+        while (av_spsc_ring_size(s->fifo) < 4) {
+            if (atomic_load(&s->close_req))
+                return NULL;
+            av_spsc_ring_wait_size(s->fifo, 4, -1);
         }
 
-        av_fifo_generic_read(s->fifo, tmp, 4, NULL);
-        len = AV_RL32(tmp);
-
-        av_assert0(len >= 0);
-        av_assert0(len <= sizeof(s->tmp));
-
-        av_fifo_generic_read(s->fifo, s->tmp, len, NULL);
-
-        pthread_mutex_unlock(&s->mutex);
+        /* Gather up to batch_size queued packets back to back into tmp;
+         * with gso, only as long as they have the size of the first one
+         * (the last one may be shorter). */
+        n = total = 0;
+        do {
+            av_spsc_ring_peek(s->fifo, tmp, 0, 4);
+            len = AV_RL32(tmp);
+
+            av_assert0(len >= 0);
+            av_assert0(len <= sizeof(s->tmp));
+
+            if (n && (total + len > sizeof(s->tmp) ||
+                      (s->gso && (len > dg[0].len || dg[n - 1].len < dg[0].len ||
+                                  total + len > UDP_GSO_MAX_SIZE))))
+                break;
+
+            av_spsc_ring_peek(s->fifo, s->tmp + total, 4, len);
+            av_spsc_ring_drain(s->fifo, 4 + len);
+            dg[n].buf = s->tmp + total;
+            dg[n].len = len;
+            total += len;
+            n++;
+        } while (n < s->batch_size && av_spsc_ring_size(s->fifo) >= 4);
+        len = total;
 
         if (s->bitrate) {
             timestamp = av_gettime_relative();
@@ -586,41 +620,54 @@ static void *circular_buffer_task_tx( void *_URLContext)
             target_timestamp = start_timestamp + sent_bits * 1000000 / s->bitrate;
         }
 
-        p = s->tmp;
-        while (len) {
+        for (int i = 0; i < n;) {
             int ret;
-            av_assert0(len > 0);
-            if (!s->is_connected) {
-                ret = sendto (s->udp_fd, p, len, 0,
-                            (struct sockaddr *) &s->dest_addr,
-                            s->dest_addr_len);
-            } else
-                ret = send(s->udp_fd, p, len, 0);
+            if (s->gso && n > 1 && !i) {
+                ret = ff_send_segments(s->udp_fd, s->tmp, total, dg[0].len,
+                                       dest, s->dest_addr_len);
+                if (ret >= 0)
+                    break;
+                if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR)) {
+                    av_log(h, AV_LOG_WARNING, "UDP segmentation offload failed (%s), "
+                           "disabling it\n", av_err2str(ret));
+                    s->gso = 0;
+                }
+                continue;
+            }
+            ret = ff_send_datagrams(s->udp_fd, dg + i, n - i,
+                                    dest, s->dest_addr_len);
             if (ret >= 0) {
-                len -= ret;
-                p   += ret;
+                i += ret;
             } else {
-                ret = ff_neterrno();
                 if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR)) {
-                    pthread_mutex_lock(&s->mutex);
-                    s->circular_buffer_error = ret;
-                    pthread_mutex_unlock(&s->mutex);
+                    atomic_store(&s->circular_buffer_error, ret);
                     return NULL;
                 }
             }
         }
-
-        pthread_mutex_lock(&s->mutex);
     }
-
-end:
-    pthread_mutex_unlock(&s->mutex);
-    return NULL;
 }
 
 
 #endif
 
+static int udp_init_batch(UDPContext *s)
+{
+    if (s->batch_size > 1) {
+        s->batch_buf = av_malloc_array(s->batch_size, UDP_MAX_PKT_SIZE + 4);
+        if (!s->batch_buf)
+            return AVERROR(ENOMEM);
+    }
+    /* The 4 bytes in front of each buffer leave room for the length prefix
+     * used by the circular buffer. */
+    for (int i = 0; i < s->batch_size; i++) {
+        uint8_t *slot = s->batch_buf ? s->batch_buf + i * (UDP_MAX_PKT_SIZE + 4) : s->tmp;
+        s->batch[i].buf  = slot + 4;
+        s->batch[i].size = UDP_MAX_PKT_SIZE;
+    }
+    return 0;
+}
+
 /* put it in UDP context */
 /* return non zero if error */
 static int udp_open(URLContext *h, const char *uri, int flags)
@@ -709,6 +756,13 @@ static int udp_open(URLContext *h, const char *uri, int flags)
         if (av_find_info_tag(buf, sizeof(buf), "burst_bits", p)) {
             s->burst_bits = strtoll(buf, NULL, 10);
         }
+        if (av_find_info_tag(buf, sizeof(buf), "batch_size", p)) {
+            s->batch_size = av_clip(strtol(buf, NULL, 10), 1, FF_DATAGRAM_BATCH_MAX);
+        }
+        if (is_output && av_find_info_tag(buf, sizeof(buf), "gso", p))
+            s->gso = strtol(buf, NULL, 10);
+        if (!is_output && av_find_info_tag(buf, sizeof(buf), "gro", p))
+            s->gro = strtol(buf, NULL, 10);
         if (av_find_info_tag(buf, sizeof(buf), "localaddr", p)) {
             av_strlcpy(localaddr, buf, sizeof(localaddr));
         }
@@ -888,6 +942,16 @@ static int udp_open(URLContext *h, const char *uri, int flags)
 
     s->udp_fd = udp_fd;
 
+    if (!is_output) {
+        if (s->gro && (ret = ff_socket_enable_gro(udp_fd)) < 0) {
+            av_log(h, AV_LOG_WARNING, "UDP receive offload not available: %s\n",
+                   av_err2str(ret));
+            s->gro = 0;
+        }
+        if ((ret = udp_init_batch(s)) < 0)
+            goto fail;
+    }
+
 #if HAVE_PTHREAD_CANCEL
     /*
       Create thread in case of:
@@ -902,44 +966,30 @@ static int udp_open(URLContext *h, const char *uri, int flags)
 
     if ((!is_output && s->circular_buffer_size) || (is_output && s->bitrate && s->circular_buffer_size)) {
         /* start the task going */
-        s->fifo = av_fifo_alloc(s->circular_buffer_size);
+        s->fifo = av_spsc_ring_alloc(s->circular_buffer_size);
         if (!s->fifo) {
             ret = AVERROR(ENOMEM);
             goto fail;
         }
-        ret = pthread_mutex_init(&s->mutex, NULL);
-        if (ret != 0) {
-            av_log(h, AV_LOG_ERROR, "pthread_mutex_init failed : %s\n", strerror(ret));
-            ret = AVERROR(ret);
-            goto fail;
-        }
-        ret = pthread_cond_init(&s->cond, NULL);
-        if (ret != 0) {
-            av_log(h, AV_LOG_ERROR, "pthread_cond_init failed : %s\n", strerror(ret));
-            ret = AVERROR(ret);
-            goto cond_fail;
-        }
+        atomic_init(&s->circular_buffer_error, 0);
+        atomic_init(&s->close_req, 0);
+        atomic_init(&s->overruns, 0);
         ret = pthread_create(&s->circular_buffer_thread, NULL, is_output?circular_buffer_task_tx:circular_buffer_task_rx, h);
         if (ret != 0) {
             av_log(h, AV_LOG_ERROR, "pthread_create failed : %s\n", strerror(ret));
             ret = AVERROR(ret);
-            goto thread_fail;
+            goto fail;
         }
         s->thread_started = 1;
     }
 #endif
 
     return 0;
-#if HAVE_PTHREAD_CANCEL
- thread_fail:
-    pthread_cond_destroy(&s->cond);
- cond_fail:
-    pthread_mutex_destroy(&s->mutex);
-#endif
  fail:
     if (udp_fd >= 0)
         closesocket(udp_fd);
-    av_fifo_freep(&s->fifo);
+    av_spsc_ring_freep(&s->fifo);
+    av_freep(&s->batch_buf);
     ff_ip_reset_filters(&s->filters);
     return ret;
 }
@@ -954,6 +1004,48 @@ static int udplite_open(URLContext *h, const char *uri, int flags)
     return udp_open(h, uri, flags);
 }
 
+/* Return the next datagram (or coalesced segment) from the batch received
+ * last, receiving a new batch once it is exhausted. */
+static int udp_read_batch(URLContext *h, uint8_t *buf, int size)
+{
+    UDPContext *s = h->priv_data;
+    FFDatagram *dg;
+    int ret, len, filtered;
+
+    if (s->batch_pos >= s->batch_count) {
+        if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
+            ret = ff_network_wait_fd(s->udp_fd, 0);
+            if (ret < 0)
+                return ret;
+        }
+        ret = ff_recv_datagrams(s->udp_fd, s->batch, s->batch_size, 0);
+        if (ret < 0)
+            return ret;
+        s->batch_count  = ret;
+        s->batch_pos    = 0;
+        s->batch_offset = 0;
+    }
+
+    dg  = &s->batch[s->batch_pos];
+    len = dg->len - s->batch_offset;
+    if (dg->seg_size)
+        len = FFMIN(len, dg->seg_size);
+    filtered = ff_ip_check_source_lists(&dg->addr, &s->filters);
+    if (!filtered) {
+        if (len > size) {
+            av_log(h, AV_LOG_WARNING, "Part of datagram lost due to insufficient buffer size\n");
+            len = size;
+        }
+        memcpy(buf, dg->buf + s->batch_offset, len);
+    }
+
+    if (!dg->seg_size || (s->batch_offset += dg->seg_size) >= dg->len) {
+        s->batch_pos++;
+        s->batch_offset = 0;
+    }
+    return filtered ? AVERROR(EINTR) : len;
+}
+
 static int udp_read(URLContext *h, uint8_t *buf, int size)
 {
     UDPContext *s = h->priv_data;
@@ -964,47 +1056,39 @@ static int udp_read(URLContext *h, uint8_t *buf, int size)
     int avail, nonblock = h->flags & AVIO_FLAG_NONBLOCK;
 
     if (s->fifo) {
-        pthread_mutex_lock(&s->mutex);
+        s->overrun_count = atomic_load(&s->overruns);
         do {
-            avail = av_fifo_size(s->fifo);
-            if (avail) { // >=size) {
+            if (av_spsc_ring_size(s->fifo)) {
                 uint8_t tmp[4];
+                int len;
 
-                av_fifo_generic_read(s->fifo, tmp, 4, NULL);
-                avail = AV_RL32(tmp);
+                av_spsc_ring_peek(s->fifo, tmp, 0, 4);
+                avail = len = AV_RL32(tmp);
                 if(avail > size){
                     av_log(h, AV_LOG_WARNING, "Part of datagram lost due to insufficient buffer size\n");
                     avail = size;
                 }
 
-                av_fifo_generic_read(s->fifo, buf, avail, NULL);
-                av_fifo_drain(s->fifo, AV_RL32(tmp) - avail);
-                pthread_mutex_unlock(&s->mutex);
+                av_spsc_ring_peek(s->fifo, buf, 4, avail);
+                av_spsc_ring_drain(s->fifo, 4 + len);
                 return avail;
-            } else if(s->circular_buffer_error){
-                int err = s->circular_buffer_error;
-                pthread_mutex_unlock(&s->mutex);
-                return err;
+            } else if ((ret = atomic_load(&s->circular_buffer_error))) {
+                return ret;
             } else if(nonblock) {
-                pthread_mutex_unlock(&s->mutex);
                 return AVERROR(EAGAIN);
             } else {
-                /* FIXME: using the monotonic clock would be better,
-                   but it does not exist on all supported platforms. */
-                int64_t t = av_gettime() + 100000;
-                struct timespec tv = { .tv_sec  =  t / 1000000,
-                                       .tv_nsec = (t % 1000000) * 1000 };
-                int err = pthread_cond_timedwait(&s->cond, &s->mutex, &tv);
-                if (err) {
-                    pthread_mutex_unlock(&s->mutex);
-                    return AVERROR(err == ETIMEDOUT ? EAGAIN : err);
-                }
+                if (av_spsc_ring_wait_size(s->fifo, 4, 100000) < 0 &&
+                    !atomic_load(&s->circular_buffer_error))
+                    return AVERROR(EAGAIN);
                 nonblock = 1;
             }
         } while(1);
     }
 #endif
 
+    if (s->batch_size > 1 || s->gro)
+        return udp_read_batch(h, buf, size);
+
     if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
         ret = ff_network_wait_fd(s->udp_fd, 0);
         if (ret < 0)
@@ -1026,29 +1110,21 @@ static int udp_write(URLContext *h, const uint8_t *buf, int size)
 #if HAVE_PTHREAD_CANCEL
     if (s->fifo) {
         uint8_t tmp[4];
-
-        pthread_mutex_lock(&s->mutex);
+        const void *bufs[2] = { tmp, buf }; /* size of packet, the data */
+        size_t sizes[2]     = { 4, size };
 
         /*
           Return error if last tx failed.
           Here we can't know on which packet error was, but it needs to know that error exists.
         */
-        if (s->circular_buffer_error<0) {
-            int err = s->circular_buffer_error;
-            pthread_mutex_unlock(&s->mutex);
-            return err;
-        }
+        if ((ret = atomic_load(&s->circular_buffer_error)) < 0)
+            return ret;
 
-        if(av_fifo_space(s->fifo) < size + 4) {
+        AV_WL32(tmp, size);
+        if (av_spsc_ring_writev(s->fifo, bufs, sizes, 2) < 0) {
             /* What about a partial packet tx ? */
-            pthread_mutex_unlock(&s->mutex);
             return AVERROR(ENOMEM);
         }
-        AV_WL32(tmp, size);
-        av_fifo_generic_write(s->fifo, tmp, 4, NULL); /* size of packet */
-        av_fifo_generic_write(s->fifo, (uint8_t *)buf, size, NULL); /* the data */
-        pthread_cond_signal(&s->cond);
-        pthread_mutex_unlock(&s->mutex);
         return size;
     }
 #endif
@@ -1075,10 +1151,8 @@ static int udp_close(URLContext *h)
 #if HAVE_PTHREAD_CANCEL
     // Request close once writing is finished
     if (s->thread_started && !(h->flags & AVIO_FLAG_READ)) {
-        pthread_mutex_lock(&s->mutex);
-        s->close_req = 1;
-        pthread_cond_signal(&s->cond);
-        pthread_mutex_unlock(&s->mutex);
+        atomic_store(&s->close_req, 1);
+        av_spsc_ring_wake(s->fifo);
     }
 #endif
 
@@ -1102,12 +1176,15 @@ static int udp_close(URLContext *h)
         ret = pthread_join(s->circular_buffer_thread, NULL);
         if (ret != 0)
             av_log(h, AV_LOG_ERROR, "pthread_join(): %s\n", strerror(ret));
-        pthread_mutex_destroy(&s->mutex);
-        pthread_cond_destroy(&s->cond);
+        s->overrun_count = atomic_load(&s->overruns);
+        if (s->overrun_count)
+            av_log(h, AV_LOG_WARNING, "%"PRId64" datagrams lost to circular buffer overruns\n",
+                   s->overrun_count);
     }
 #endif
     closesocket(s->udp_fd);
-    av_fifo_freep(&s->fifo);
+    av_spsc_ring_freep(&s->fifo);
+    av_freep(&s->batch_buf);
     ff_ip_reset_filters(&s->filters);
     return 0;
 }
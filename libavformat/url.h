@@ -49,6 +49,8 @@ typedef struct URLContext {
     const char *protocol_whitelist;
     const char *protocol_blacklist;
     int min_packet_size;        /**< if non zero, the stream is packetized with this min packet size */
+    int zerocopy_size;          /**< if non zero, the protocol can send up to this many bytes without copying them, see url_wait_writes() */
+    int zerocopy_write;         /**< set by the caller if it keeps the data passed to url_write() unmodified until released by url_wait_writes() */
 } URLContext;
 
 typedef struct URLProtocol {
@@ -97,6 +99,12 @@ typedef struct URLProtocol {
     int (*url_delete)(URLContext *h);
     int (*url_move)(URLContext *h_src, URLContext *h_dst);
     const char *default_whitelist;
+    /**
+     * Wait until at most pending bytes of the data passed to url_write()
+     * are still referenced by the protocol. Only used when zerocopy_write
+     * is set: the data is otherwise released when url_write() returns.
+     */
+    int (*url_wait_writes)(URLContext *h, int64_t pending);
 } URLProtocol;
 
 /**
@@ -266,12 +274,28 @@ int ffurl_get_short_seek(URLContext *h);
  */
 int ffurl_shutdown(URLContext *h, int flags);
 
+/**
+ * Wait until at most pending bytes of the data written to the URLContext
+ * may still be referenced by the protocol, for zero-copy writes.
+ *
+ * @return 0 on success, a negative value if an error condition occurred,
+ * in which case the data may still be referenced
+ */
+int ffurl_wait_writes(URLContext *h, int64_t pending);
+
 /**
  * Check if the user has requested to interrupt a blocking function
  * associated with cb.
  */
 int ff_check_interrupt(AVIOInterruptCB *cb);
 
+/**
+ * Interrupt callback checking the interrupt callback of the URLContext
+ * passed as opaque. Protocols opening a nested URLContext can use it so
+ * that the nested context follows changes to the callback of their own.
+ */
+int ff_url_interrupt_cb(void *opaque);
+
 /* udp.c */
 int ff_udp_set_remote_url(URLContext *h, const char *uri);
 int ff_udp_get_local_port(URLContext *h);
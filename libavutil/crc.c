@@ -315,15 +315,23 @@ static const AVCRC av_crc_table[AV_CRC_MAX][257] = {
 #if CONFIG_SMALL
 #define CRC_TABLE_SIZE 257
 #else
-#define CRC_TABLE_SIZE 1024
+/* The standard tables are larger than what av_crc_init() accepts, so that
+ * av_crc() can process 8 bytes at a time when it is passed one of them. */
+#define CRC_TABLE_SIZE 2048
 #endif
 static AVCRC av_crc_table[AV_CRC_MAX][CRC_TABLE_SIZE];
 
+#define IS_STANDARD_TABLE(ctx)                                      \
+    ((uintptr_t) (ctx) >= (uintptr_t) av_crc_table &&              \
+     (uintptr_t) (ctx) <  (uintptr_t) (av_crc_table + AV_CRC_MAX))
+
+static int crc_init(AVCRC *ctx, int le, int bits, uint32_t poly, int ctx_size);
+
 #define DECLARE_CRC_INIT_TABLE_ONCE(id, le, bits, poly)                                       \
 static AVOnce id ## _once_control = AV_ONCE_INIT;                                             \
 static void id ## _init_table_once(void)                                                      \
 {                                                                                             \
-    av_assert0(av_crc_init(av_crc_table[id], le, bits, poly, sizeof(av_crc_table[id])) >= 0); \
+    av_assert0(crc_init(av_crc_table[id], le, bits, poly, sizeof(av_crc_table[id])) >= 0);    \
 }
 
 #define CRC_INIT_TABLE_ONCE(id) ff_thread_once(&id ## _once_control, id ## _init_table_once)
@@ -338,15 +346,13 @@ DECLARE_CRC_INIT_TABLE_ONCE(AV_CRC_32_IEEE_LE, 1, 32, 0xEDB88320)
 DECLARE_CRC_INIT_TABLE_ONCE(AV_CRC_16_ANSI_LE, 1, 16,     0xA001)
 #endif
 
-int av_crc_init(AVCRC *ctx, int le, int bits, uint32_t poly, int ctx_size)
+static int crc_init(AVCRC *ctx, int le, int bits, uint32_t poly, int ctx_size)
 {
     unsigned i, j;
     uint32_t c;
 
     if (bits < 8 || bits > 32 || poly >= (1LL << bits))
         return AVERROR(EINVAL);
-    if (ctx_size != sizeof(AVCRC) * 257 && ctx_size != sizeof(AVCRC) * 1024)
-        return AVERROR(EINVAL);
 
     for (i = 0; i < 256; i++) {
         if (le) {
@@ -363,7 +369,7 @@ int av_crc_init(AVCRC *ctx, int le, int bits, uint32_t poly, int ctx_size)
 #if !CONFIG_SMALL
     if (ctx_size >= sizeof(AVCRC) * 1024)
         for (i = 0; i < 256; i++)
-            for (j = 0; j < 3; j++)
+            for (j = 0; j < ctx_size / (sizeof(AVCRC) * 256) - 1; j++)
                 ctx[256 * (j + 1) + i] =
                     (ctx[256 * j + i] >> 8) ^ ctx[ctx[256 * j + i] & 0xFF];
 #endif
@@ -371,6 +377,13 @@ int av_crc_init(AVCRC *ctx, int le, int bits, uint32_t poly, int ctx_size)
     return 0;
 }
 
+int av_crc_init(AVCRC *ctx, int le, int bits, uint32_t poly, int ctx_size)
+{
+    if (ctx_size != sizeof(AVCRC) * 257 && ctx_size != sizeof(AVCRC) * 1024)
+        return AVERROR(EINVAL);
+    return crc_init(ctx, le, bits, poly, ctx_size);
+}
+
 const AVCRC *av_crc_get_table(AVCRCId crc_id)
 {
 #if !CONFIG_HARDCODED_TABLES
@@ -399,6 +412,25 @@ uint32_t av_crc(const AVCRC *ctx, uint32_t crc,
         while (((intptr_t) buffer & 3) && buffer < end)
             crc = ctx[((uint8_t) crc) ^ *buffer++] ^ (crc >> 8);
 
+#if !CONFIG_HARDCODED_TABLES
+        /* slice-by-8, only the standard tables are large enough */
+        if (IS_STANDARD_TABLE(ctx)) {
+            while (buffer < end - 7) {
+                uint32_t one = crc ^ av_le2ne32(*(const uint32_t *) buffer);
+                uint32_t two =       av_le2ne32(*(const uint32_t *) (buffer + 4));
+                buffer += 8;
+                crc = ctx[7 * 256 + ( one        & 0xFF)] ^
+                      ctx[6 * 256 + ((one >> 8 ) & 0xFF)] ^
+                      ctx[5 * 256 + ((one >> 16) & 0xFF)] ^
+                      ctx[4 * 256 + ((one >> 24)       )] ^
+                      ctx[3 * 256 + ( two        & 0xFF)] ^
+                      ctx[2 * 256 + ((two >> 8 ) & 0xFF)] ^
+                      ctx[1 * 256 + ((two >> 16) & 0xFF)] ^
+                      ctx[0 * 256 + ((two >> 24)       )];
+            }
+        }
+#endif
+
         while (buffer < end - 3) {
             crc ^= av_le2ne32(*(const uint32_t *) buffer); buffer += 4;
             crc = ctx[3 * 256 + ( crc        & 0xFF)] ^
@@ -0,0 +1,304 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdatomic.h>
+#include <string.h>
+
+#include "avassert.h"
+#include "common.h"
+#include "error.h"
+#include "mem.h"
+#include "spscring.h"
+#include "thread.h"
+#include "time.h"
+
+#define WAIT_CONSUMER 1
+#define WAIT_PRODUCER 2
+
+/* Keep the positions written by either side in separate cache lines */
+#define CACHE_LINE 64
+
+struct AVSPSCRing {
+    uint8_t *buf;
+    size_t   mask;
+
+    atomic_int waiting;
+#if HAVE_THREADS
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    int             wake_pending;
+#endif
+
+    /* Only written by the producer */
+    uint8_t        pad0[CACHE_LINE];
+    atomic_size_t  write_pos;
+
+    /* Only written by the consumer */
+    uint8_t        pad1[CACHE_LINE];
+    atomic_size_t  read_pos;
+    uint8_t        pad2[CACHE_LINE];
+};
+
+AVSPSCRing *av_spsc_ring_alloc(size_t size)
+{
+    AVSPSCRing *ring;
+    size_t capacity = 1;
+
+    if (!size || size > SIZE_MAX / 2)
+        return NULL;
+    while (capacity < size)
+        capacity <<= 1;
+
+    ring = av_mallocz(sizeof(*ring));
+    if (!ring)
+        return NULL;
+    ring->buf = av_malloc(capacity);
+    if (!ring->buf) {
+        av_free(ring);
+        return NULL;
+    }
+#if HAVE_THREADS
+    if (pthread_mutex_init(&ring->lock, NULL)) {
+        av_free(ring->buf);
+        av_free(ring);
+        return NULL;
+    }
+    if (pthread_cond_init(&ring->cond, NULL)) {
+        pthread_mutex_destroy(&ring->lock);
+        av_free(ring->buf);
+        av_free(ring);
+        return NULL;
+    }
+#endif
+    ring->mask = capacity - 1;
+    atomic_init(&ring->waiting,   0);
+    atomic_init(&ring->write_pos, 0);
+    atomic_init(&ring->read_pos,  0);
+    return ring;
+}
+
+void av_spsc_ring_freep(AVSPSCRing **pring)
+{
+    AVSPSCRing *ring = *pring;
+
+    if (!ring)
+        return;
+#if HAVE_THREADS
+    pthread_cond_destroy(&ring->cond);
+    pthread_mutex_destroy(&ring->lock);
+#endif
+    av_free(ring->buf);
+    av_freep(pring);
+}
+
+size_t av_spsc_ring_capacity(const AVSPSCRing *ring)
+{
+    return ring->mask + 1;
+}
+
+void av_spsc_ring_reset(AVSPSCRing *ring)
+{
+    atomic_store(&ring->write_pos, 0);
+    atomic_store(&ring->read_pos,  0);
+}
+
+static size_t ring_size(AVSPSCRing *ring)
+{
+    size_t wpos = atomic_load_explicit(&ring->write_pos, memory_order_acquire);
+    size_t rpos = atomic_load_explicit(&ring->read_pos,  memory_order_acquire);
+    return wpos - rpos;
+}
+
+/* Wake up the other side if it is waiting. The positions are updated with
+ * sequentially consistent stores, so that either the waiting flag set by a
+ * thread going to sleep is seen here, or that thread sees the new position
+ * when checking its condition before sleeping. */
+static void ring_notify(AVSPSCRing *ring, int flag)
+{
+#if HAVE_THREADS
+    if (atomic_load(&ring->waiting) & flag) {
+        pthread_mutex_lock(&ring->lock);
+        pthread_cond_broadcast(&ring->cond);
+        pthread_mutex_unlock(&ring->lock);
+    }
+#endif
+}
+
+static int ring_ready(AVSPSCRing *ring, int flag, size_t size)
+{
+    size_t used = ring_size(ring);
+    return flag == WAIT_CONSUMER ? used >= size : ring->mask + 1 - used >= size;
+}
+
+static int ring_wait(AVSPSCRing *ring, int flag, size_t size, int64_t timeout)
+{
+#if HAVE_THREADS
+    int64_t t = av_gettime() + timeout;
+    struct timespec tv = { .tv_sec  =  t / 1000000,
+                           .tv_nsec = (t % 1000000) * 1000 };
+    int ret = 0;
+
+    if (ring_ready(ring, flag, size))
+        return 0;
+
+    pthread_mutex_lock(&ring->lock);
+    atomic_fetch_or(&ring->waiting, flag);
+    /* Pairs with the position stores and the load in ring_notify(): the
+     * acquire loads in ring_ready() alone could see the positions from
+     * before the flag was set, and the wakeup would be lost. */
+    atomic_thread_fence(memory_order_seq_cst);
+    while (!ring_ready(ring, flag, size)) {
+        if (ring->wake_pending & flag) {
+            ret = AVERROR(EAGAIN);
+            break;
+        }
+        if (timeout < 0) {
+            pthread_cond_wait(&ring->cond, &ring->lock);
+        } else if (pthread_cond_timedwait(&ring->cond, &ring->lock, &tv) == ETIMEDOUT) {
+            ret = ring_ready(ring, flag, size) ? 0 : AVERROR(EAGAIN);
+            break;
+        }
+    }
+    atomic_fetch_and(&ring->waiting, ~flag);
+    ring->wake_pending &= ~flag;
+    pthread_mutex_unlock(&ring->lock);
+    return ret;
+#else
+    return ring_ready(ring, flag, size) ? 0 : AVERROR(EAGAIN);
+#endif
+}
+
+void av_spsc_ring_wake(AVSPSCRing *ring)
+{
+#if HAVE_THREADS
+    pthread_mutex_lock(&ring->lock);
+    ring->wake_pending = WAIT_CONSUMER | WAIT_PRODUCER;
+    pthread_cond_broadcast(&ring->cond);
+    pthread_mutex_unlock(&ring->lock);
+#endif
+}
+
+size_t av_spsc_ring_space(AVSPSCRing *ring)
+{
+    return ring->mask + 1 - ring_size(ring);
+}
+
+static void ring_copy_in(AVSPSCRing *ring, size_t pos, const uint8_t *src, size_t size)
+{
+    size_t offset = pos & ring->mask;
+    size_t len    = FFMIN(size, ring->mask + 1 - offset);
+
+    memcpy(ring->buf + offset, src, len);
+    memcpy(ring->buf, src + len, size - len);
+}
+
+static void ring_copy_out(AVSPSCRing *ring, size_t pos, uint8_t *dst, size_t size)
+{
+    size_t offset = pos & ring->mask;
+    size_t len    = FFMIN(size, ring->mask + 1 - offset);
+
+    memcpy(dst, ring->buf + offset, len);
+    memcpy(dst + len, ring->buf, size - len);
+}
+
+int av_spsc_ring_writev(AVSPSCRing *ring, const void *const *bufs,
+                        const size_t *sizes, int nb_bufs)
+{
+    size_t wpos = atomic_load_explicit(&ring->write_pos, memory_order_relaxed);
+    size_t total = 0;
+    int i;
+
+    for (i = 0; i < nb_bufs; i++)
+        total += sizes[i];
+    if (total > av_spsc_ring_space(ring))
+        return AVERROR(ENOSPC);
+
+    for (i = 0; i < nb_bufs; i++) {
+        ring_copy_in(ring, wpos, bufs[i], sizes[i]);
+        wpos += sizes[i];
+    }
+    atomic_store(&ring->write_pos, wpos);
+    ring_notify(ring, WAIT_CONSUMER);
+    return 0;
+}
+
+int av_spsc_ring_write(AVSPSCRing *ring, const void *buf, size_t size)
+{
+    return av_spsc_ring_writev(ring, &buf, &size, 1);
+}
+
+uint8_t *av_spsc_ring_write_buffer(AVSPSCRing *ring, size_t *size)
+{
+    size_t wpos   = atomic_load_explicit(&ring->write_pos, memory_order_relaxed);
+    size_t offset = wpos & ring->mask;
+
+    *size = FFMIN(av_spsc_ring_space(ring), ring->mask + 1 - offset);
+    return ring->buf + offset;
+}
+
+void av_spsc_ring_write_commit(AVSPSCRing *ring, size_t size)
+{
+    size_t wpos = atomic_load_explicit(&ring->write_pos, memory_order_relaxed);
+
+    av_assert2(size <= av_spsc_ring_space(ring));
+    atomic_store(&ring->write_pos, wpos + size);
+    ring_notify(ring, WAIT_CONSUMER);
+}
+
+size_t av_spsc_ring_size(AVSPSCRing *ring)
+{
+    return ring_size(ring);
+}
+
+int av_spsc_ring_peek(AVSPSCRing *ring, void *buf, size_t offset, size_t size)
+{
+    size_t rpos = atomic_load_explicit(&ring->read_pos, memory_order_relaxed);
+
+    if (offset + size > ring_size(ring) || offset + size < offset)
+        return AVERROR(EINVAL);
+    ring_copy_out(ring, rpos + offset, buf, size);
+    return 0;
+}
+
+void av_spsc_ring_drain(AVSPSCRing *ring, size_t size)
+{
+    size_t rpos = atomic_load_explicit(&ring->read_pos, memory_order_relaxed);
+
+    av_assert2(size <= ring_size(ring));
+    atomic_store(&ring->read_pos, rpos + size);
+    ring_notify(ring, WAIT_PRODUCER);
+}
+
+int av_spsc_ring_read(AVSPSCRing *ring, void *buf, size_t size)
+{
+    int ret = av_spsc_ring_peek(ring, buf, 0, size);
+    if (ret < 0)
+        return ret;
+    av_spsc_ring_drain(ring, size);
+    return 0;
+}
+
+int av_spsc_ring_wait_size(AVSPSCRing *ring, size_t size, int64_t timeout)
+{
+    return ring_wait(ring, WAIT_CONSUMER, size, timeout);
+}
+
+int av_spsc_ring_wait_space(AVSPSCRing *ring, size_t size, int64_t timeout)
+{
+    return ring_wait(ring, WAIT_PRODUCER, size, timeout);
+}
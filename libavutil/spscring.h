@@ -0,0 +1,176 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * @ingroup lavu_spsc_ring
+ * Lock-free single-producer/single-consumer ring buffer
+ */
+
+#ifndef AVUTIL_SPSCRING_H
+#define AVUTIL_SPSCRING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @defgroup lavu_spsc_ring AVSPSCRing
+ * @ingroup lavu_data
+ *
+ * @{
+ * A byte ring buffer for passing data from exactly one producer thread to
+ * exactly one consumer thread without locking.
+ *
+ * Functions documented as producer functions may only be called from the
+ * producer thread, and consumer functions only from the consumer thread.
+ * Data becomes visible to the consumer only once it has been committed as
+ * a whole, so a write of several buffers can be used to pass records.
+ *
+ * Either side can sleep until the other one has made progress. A lock is
+ * only taken on this slow path: writes and reads only wake up the other side
+ * when it is actually waiting.
+ */
+
+typedef struct AVSPSCRing AVSPSCRing;
+
+/**
+ * Allocate a ring buffer.
+ *
+ * @param size minimum capacity in bytes, rounded up to a power of two
+ * @return the ring buffer, or NULL on failure
+ */
+AVSPSCRing *av_spsc_ring_alloc(size_t size);
+
+/**
+ * Free a ring buffer and set the pointer to NULL.
+ * The ring buffer must no longer be in use by another thread.
+ */
+void av_spsc_ring_freep(AVSPSCRing **ring);
+
+/**
+ * @return the capacity of the ring buffer in bytes
+ */
+size_t av_spsc_ring_capacity(const AVSPSCRing *ring);
+
+/**
+ * Discard all the data in the ring buffer.
+ * Neither the producer nor the consumer may access the ring buffer
+ * concurrently.
+ */
+void av_spsc_ring_reset(AVSPSCRing *ring);
+
+/**
+ * Producer: get the number of bytes that can be written.
+ */
+size_t av_spsc_ring_space(AVSPSCRing *ring);
+
+/**
+ * Producer: write and commit data.
+ *
+ * @return 0 on success, AVERROR(ENOSPC) if there is not enough space for
+ *         all of the data, in which case nothing is written
+ */
+int av_spsc_ring_write(AVSPSCRing *ring, const void *buf, size_t size);
+
+/**
+ * Producer: write the concatenation of several buffers and commit them
+ * at once.
+ *
+ * @return 0 on success, AVERROR(ENOSPC) if there is not enough space for
+ *         all of the data, in which case nothing is written
+ */
+int av_spsc_ring_writev(AVSPSCRing *ring, const void *const *bufs,
+                        const size_t *sizes, int nb_bufs);
+
+/**
+ * Producer: get direct access to the contiguous writable area that follows
+ * the committed data, to fill it in place.
+ *
+ * @param size set to the size of the area, which may be smaller than
+ *             av_spsc_ring_space() when the area wraps around
+ * @return a pointer to the area
+ */
+uint8_t *av_spsc_ring_write_buffer(AVSPSCRing *ring, size_t *size);
+
+/**
+ * Producer: commit size bytes filled in the area returned by
+ * av_spsc_ring_write_buffer().
+ */
+void av_spsc_ring_write_commit(AVSPSCRing *ring, size_t size);
+
+/**
+ * Consumer: get the number of bytes that can be read.
+ */
+size_t av_spsc_ring_size(AVSPSCRing *ring);
+
+/**
+ * Consumer: copy data without consuming it.
+ *
+ * @param buf    destination buffer
+ * @param offset offset of the data to copy from the read position
+ * @param size   number of bytes to copy
+ * @return 0 on success, AVERROR(EINVAL) if fewer than offset + size bytes
+ *         can be read
+ */
+int av_spsc_ring_peek(AVSPSCRing *ring, void *buf, size_t offset, size_t size);
+
+/**
+ * Consumer: discard size bytes, which must be readable.
+ */
+void av_spsc_ring_drain(AVSPSCRing *ring, size_t size);
+
+/**
+ * Consumer: read and consume data.
+ *
+ * @return 0 on success, AVERROR(EINVAL) if fewer than size bytes can be read
+ */
+int av_spsc_ring_read(AVSPSCRing *ring, void *buf, size_t size);
+
+/**
+ * Consumer: wait until at least size bytes can be read.
+ *
+ * @param timeout maximum time to wait in microseconds, negative to wait
+ *                without limit
+ * @return 0 if the data is available, AVERROR(EAGAIN) on timeout or if
+ *         woken up by av_spsc_ring_wake()
+ */
+int av_spsc_ring_wait_size(AVSPSCRing *ring, size_t size, int64_t timeout);
+
+/**
+ * Producer: wait until at least size bytes can be written.
+ *
+ * @param timeout maximum time to wait in microseconds, negative to wait
+ *                without limit
+ * @return 0 if the space is available, AVERROR(EAGAIN) on timeout or if
+ *         woken up by av_spsc_ring_wake()
+ */
+int av_spsc_ring_wait_space(AVSPSCRing *ring, size_t size, int64_t timeout);
+
+/**
+ * Wake up any thread waiting on the ring buffer, e.g. to let it notice
+ * an error or an end of stream signaled by other means. A side that is not
+ * currently waiting returns from its next wait call immediately instead.
+ * Can be called from any thread.
+ */
+void av_spsc_ring_wake(AVSPSCRing *ring);
+
+/**
+ * @}
+ */
+
+#endif /* AVUTIL_SPSCRING_H */
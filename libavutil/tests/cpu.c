@@ -77,6 +77,7 @@ static const struct {
     { AV_CPU_FLAG_BMI2,      "bmi2"       },
     { AV_CPU_FLAG_AESNI,     "aesni"      },
     { AV_CPU_FLAG_AVX512,    "avx512"     },
+    { AV_CPU_FLAG_CLMUL,     "clmul"      },
 #endif
     { 0 }
 };
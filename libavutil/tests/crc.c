@@ -43,5 +43,27 @@ int main(void)
         ctx = av_crc_get_table(p[i][0]);
         printf("crc %08X = %X\n", p[i][1], av_crc(ctx, 0, buf, sizeof(buf)));
     }
+
+    /* the standard tables take a different code path than user tables,
+     * check that they agree for all alignments and tail lengths */
+    for (i = 0; i < 7; i++) {
+        AVCRC user_ctx[257];
+        int le = p[i][0] == AV_CRC_32_IEEE_LE || p[i][0] == AV_CRC_16_ANSI_LE;
+        int bits = p[i][1] > 0xFFFFFF ? 32 : p[i][1] > 0xFFFF ? 24 :
+                   p[i][1] > 0xFF ? 16 : 8;
+        int start, len;
+
+        ctx = av_crc_get_table(p[i][0]);
+        if (av_crc_init(user_ctx, le, bits, p[i][1], sizeof(user_ctx)) < 0)
+            return 1;
+        for (start = 0; start < 8; start++)
+            for (len = 0; len < 40; len++)
+                if (av_crc(ctx, 0x12345678, buf + start, len) !=
+                    av_crc(user_ctx, 0x12345678, buf + start, len)) {
+                    printf("crc %08X mismatch at offset %d, length %d\n",
+                           p[i][1], start, len);
+                    return 1;
+                }
+    }
     return 0;
 }
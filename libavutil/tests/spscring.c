@@ -0,0 +1,181 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+
+#include "libavutil/common.h"
+#include "libavutil/error.h"
+#include "libavutil/lfg.h"
+#include "libavutil/spscring.h"
+#include "libavutil/thread.h"
+
+#define STREAM_SIZE (4 * 1024 * 1024)
+
+typedef struct Producer {
+    AVSPSCRing *ring;
+    AVLFG lfg;
+    uint8_t counter;
+    size_t sent;
+} Producer;
+
+/* Write records of a 1-byte length followed by that many bytes of a
+ * counter, as long as there is space. */
+static void produce(Producer *p)
+{
+    uint8_t data[255];
+
+    while (p->sent < STREAM_SIZE) {
+        AVLFG lfg = p->lfg;
+        uint8_t len = av_lfg_get(&lfg);
+        const void *bufs[2] = { &len, data };
+        size_t sizes[2]     = { 1, len };
+
+        for (int i = 0; i < len; i++)
+            data[i] = p->counter + i;
+        if (av_spsc_ring_writev(p->ring, bufs, sizes, 2) < 0)
+            return;
+        p->lfg      = lfg;
+        p->counter += len;
+        p->sent    += len + 1;
+    }
+}
+
+#if HAVE_THREADS
+static void *producer_thread(void *arg)
+{
+    Producer *p = arg;
+
+    while (p->sent < STREAM_SIZE) {
+        produce(p);
+        av_spsc_ring_wait_space(p->ring, 256, -1);
+    }
+    return NULL;
+}
+#endif
+
+static int consume(AVSPSCRing *ring, size_t *received, uint8_t *counter)
+{
+    uint8_t len, data[255];
+    int ret = 1;
+
+    if (av_spsc_ring_peek(ring, &len, 0, 1) < 0 ||
+        av_spsc_ring_size(ring) < len + 1)
+        return 0;
+    av_spsc_ring_drain(ring, 1);
+    av_spsc_ring_read(ring, data, len);
+    for (int i = 0; i < len; i++) {
+        if (data[i] != (uint8_t)(*counter + i) && ret > 0) {
+            printf("mismatch at %zu\n", *received + 1 + i);
+            ret = AVERROR_BUG;
+        }
+    }
+    *counter  += len;
+    *received += len + 1;
+    return ret;
+}
+
+static int test_stream(void)
+{
+    Producer p = { av_spsc_ring_alloc(1000) };
+    size_t received = 0;
+    uint8_t counter = 0;
+    int ret, err = 0;
+
+    if (!p.ring)
+        return AVERROR(ENOMEM);
+    av_lfg_init(&p.lfg, 1);
+#if HAVE_THREADS
+    {
+        pthread_t thread;
+
+        if ((ret = pthread_create(&thread, NULL, producer_thread, &p))) {
+            av_spsc_ring_freep(&p.ring);
+            return AVERROR(ret);
+        }
+        while (received < STREAM_SIZE) {
+            ret = consume(p.ring, &received, &counter);
+            if (ret < 0)
+                err = ret;
+            else if (!ret)
+                av_spsc_ring_wait_size(p.ring, 256, 1000);
+        }
+        pthread_join(thread, NULL);
+    }
+#else
+    while (received < STREAM_SIZE) {
+        produce(&p);
+        while ((ret = consume(p.ring, &received, &counter)))
+            if (ret < 0)
+                err = ret;
+    }
+#endif
+    av_spsc_ring_freep(&p.ring);
+    return err;
+}
+
+int main(void)
+{
+    AVSPSCRing *ring = av_spsc_ring_alloc(13);
+    uint8_t buf[16], *p;
+    size_t size;
+    int i, ret;
+
+    if (!ring)
+        return 1;
+    printf("capacity: %zu\n", av_spsc_ring_capacity(ring));
+
+    for (i = 0; i < 10; i++)
+        buf[i] = i;
+    ret = av_spsc_ring_write(ring, buf, 10);
+    printf("write 10: %d, size %zu, space %zu\n", ret,
+           av_spsc_ring_size(ring), av_spsc_ring_space(ring));
+    ret = av_spsc_ring_write(ring, buf, 10);
+    printf("write 10: %s\n", ret == AVERROR(ENOSPC) ? "ENOSPC" : "unexpected");
+
+    ret = av_spsc_ring_peek(ring, buf, 4, 3);
+    printf("peek 4+3: %d: %d %d %d\n", ret, buf[0], buf[1], buf[2]);
+    ret = av_spsc_ring_peek(ring, buf, 8, 3);
+    printf("peek 8+3: %s\n", ret == AVERROR(EINVAL) ? "EINVAL" : "unexpected");
+
+    av_spsc_ring_drain(ring, 8);
+    p = av_spsc_ring_write_buffer(ring, &size);
+    printf("write buffer: %zu bytes\n", size);
+    for (i = 0; i < size; i++)
+        p[i] = 100 + i;
+    av_spsc_ring_write_commit(ring, size);
+
+    /* wraps around */
+    buf[0] = 200;
+    buf[1] = 201;
+    ret = av_spsc_ring_write(ring, buf, 2);
+    printf("write 2: %d, size %zu\n", ret, av_spsc_ring_size(ring));
+    size = av_spsc_ring_size(ring);
+    ret = av_spsc_ring_read(ring, buf, size);
+    printf("read %zu: %d:", size, ret);
+    for (i = 0; i < size; i++)
+        printf(" %d", buf[i]);
+    printf("\n");
+
+    ret = av_spsc_ring_wait_size(ring, 1, 0);
+    printf("wait empty: %s\n", ret == AVERROR(EAGAIN) ? "EAGAIN" : "unexpected");
+    av_spsc_ring_freep(&ring);
+
+    ret = test_stream();
+    printf("stream: %s\n", ret < 0 ? "failed" : "ok");
+    return 0;
+}
@@ -30,6 +30,17 @@ int ff_tx_type_is_mdct(enum AVTXType type)
     }
 }
 
+int ff_tx_type_is_dct(enum AVTXType type)
+{
+    switch (type) {
+    case AV_TX_FLOAT_DCT:
+    case AV_TX_DOUBLE_DCT:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
 /* Calculates the modular multiplicative inverse, not fast, replace */
 static av_always_inline int mulinv(int n, int m)
 {
@@ -153,6 +164,7 @@ av_cold void av_tx_uninit(AVTXContext **ctx)
     av_free((*ctx)->revtab);
     av_free((*ctx)->inplace_idx);
     av_free((*ctx)->tmp);
+    av_free((*ctx)->rdft_tmp);
 
     av_freep(ctx);
 }
@@ -176,6 +188,16 @@ av_cold int av_tx_init(AVTXContext **ctx, av_tx_fn *tx, enum AVTXType type,
         if ((err = ff_tx_init_mdct_fft_double(s, tx, type, inv, len, scale, flags)))
             goto fail;
         break;
+    case AV_TX_FLOAT_RDFT:
+    case AV_TX_FLOAT_DCT:
+        if ((err = ff_tx_init_rdft_dct_float(s, tx, type, inv, len, scale, flags)))
+            goto fail;
+        break;
+    case AV_TX_DOUBLE_RDFT:
+    case AV_TX_DOUBLE_DCT:
+        if ((err = ff_tx_init_rdft_dct_double(s, tx, type, inv, len, scale, flags)))
+            goto fail;
+        break;
     case AV_TX_INT32_FFT:
     case AV_TX_INT32_MDCT:
         if ((err = ff_tx_init_mdct_fft_int32(s, tx, type, inv, len, scale, flags)))
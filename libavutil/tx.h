@@ -79,6 +79,45 @@ enum AVTXType {
      * Stride must be a non-zero multiple of sizeof(int32_t).
      */
     AV_TX_INT32_MDCT = 5,
+
+    /**
+     * Real to complex and complex to real DFTs.
+     * For the forward transform (real to complex), the input is an array of
+     * len floats, and the output is an array of len/2 + 1 AVComplexFloat
+     * values, starting with the DC and ending with the Nyquist frequency,
+     * the imaginary parts of both being 0.
+     * For the inverse transform, the input is len/2 + 1 AVComplexFloat values
+     * and the output is len floats. The imaginary parts of the DC and Nyquist
+     * coefficients are ignored.
+     * The scale type is float, and the output is multiplied by it. Neither
+     * direction is normalized, so a forward followed by an inverse transform
+     * needs a total scale of 1.0/len for the input to be reconstructed.
+     * Only even lengths are supported. The stride parameter is ignored.
+     * NOTE: the inverse transform always overwrites the input.
+     */
+    AV_TX_FLOAT_RDFT = 6,
+
+    /**
+     * Same as AV_TX_FLOAT_RDFT with data and scale type of double.
+     */
+    AV_TX_DOUBLE_RDFT = 7,
+
+    /**
+     * Discrete Cosine Transform with sample data type and scale type of
+     * float. The forward transform is a DCT-II, defined as
+     * X[k] = sum(x[n]*cos(M_PI*k*(2*n + 1)/(2*len)), n = 0..len-1),
+     * while the inverse transform is a DCT-III, defined as
+     * x[n] = X[0]/2 + sum(X[k]*cos(M_PI*k*(2*n + 1)/(2*len)), k = 1..len-1),
+     * both multiplied by the scale. Using a scale of 2.0/len for one of the
+     * directions and 1.0 for the other makes them exact inverses.
+     * Only even lengths are supported. The stride parameter is ignored.
+     */
+    AV_TX_FLOAT_DCT = 8,
+
+    /**
+     * Same as AV_TX_FLOAT_DCT with data and scale type of double.
+     */
+    AV_TX_DOUBLE_DCT = 9,
 };
 
 /**
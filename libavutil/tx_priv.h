@@ -118,10 +118,14 @@ struct AVTXContext {
     int        *pfatab; /* Input/Output mapping for compound transforms */
     int        *revtab; /* Input mapping for power of two transforms */
     int   *inplace_idx; /* Required indices to revtab for in-place transforms */
+
+    av_tx_fn    top_tx; /* Half-length complex FFT used by real transforms */
+    FFTComplex *rdft_tmp; /* Temporary buffer needed for DCTs */
 };
 
 /* Shared functions */
 int ff_tx_type_is_mdct(enum AVTXType type);
+int ff_tx_type_is_dct(enum AVTXType type);
 int ff_tx_gen_compound_mapping(AVTXContext *s);
 int ff_tx_gen_ptwo_revtab(AVTXContext *s, int invert_lookup);
 int ff_tx_gen_ptwo_inplace_revtab_idx(AVTXContext *s);
@@ -153,6 +157,13 @@ int ff_tx_init_mdct_fft_int32(AVTXContext *s, av_tx_fn *tx,
                               enum AVTXType type, int inv, int len,
                               const void *scale, uint64_t flags);
 
+int ff_tx_init_rdft_dct_float(AVTXContext *s, av_tx_fn *tx,
+                              enum AVTXType type, int inv, int len,
+                              const void *scale, uint64_t flags);
+int ff_tx_init_rdft_dct_double(AVTXContext *s, av_tx_fn *tx,
+                               enum AVTXType type, int inv, int len,
+                               const void *scale, uint64_t flags);
+
 typedef struct CosTabsInitOnce {
     void (*func)(void);
     AVOnce control;
@@ -755,3 +755,188 @@ int TX_NAME(ff_tx_init_mdct_fft)(AVTXContext *s, av_tx_fn *tx,
 
     return 0;
 }
+
+#if defined(TX_FLOAT) || defined(TX_DOUBLE)
+/* Splits the half-length FFT of the even/odd interleaved input into the
+ * first len/2 + 1 bins of the real DFT, in-place. */
+static av_always_inline void rdft_postproc(AVTXContext *s, FFTComplex *z,
+                                           FFTSample scale)
+{
+    const FFTComplex *exp = s->exptab;
+    const int len2 = s->n*s->m;
+    const FFTSample hscale = scale*0.5;
+    FFTSample t0 = z[0].re, t1 = z[0].im;
+
+    z[0   ].re = (t0 + t1)*scale;
+    z[0   ].im = 0;
+    z[len2].re = (t0 - t1)*scale;
+    z[len2].im = 0;
+
+    for (int i = 1; i <= (len2 >> 1); i++) {
+        const FFTComplex a = z[i], b = z[len2 - i];
+        FFTSample er = (a.re + b.re)*hscale, ei = (a.im - b.im)*hscale;
+        FFTSample od = (a.im + b.im)*hscale, oe = (b.re - a.re)*hscale;
+        FFTSample tr, ti;
+
+        CMUL(tr, ti, od, oe, exp[i].re, exp[i].im);
+
+        z[i       ].re = er + tr;
+        z[i       ].im = ei + ti;
+        z[len2 - i].re = er - tr;
+        z[len2 - i].im = ti - ei;
+    }
+}
+
+/* Inverse of the above, packs len/2 + 1 bins into the input of a half-length
+ * inverse FFT, in-place. */
+static av_always_inline void rdft_preproc(AVTXContext *s, FFTComplex *z,
+                                          FFTSample scale)
+{
+    const FFTComplex *exp = s->exptab;
+    const int len2 = s->n*s->m;
+    FFTSample t0 = z[0].re, t1 = z[len2].re;
+
+    z[0].re = (t0 + t1)*scale;
+    z[0].im = (t0 - t1)*scale;
+
+    for (int i = 1; i <= (len2 >> 1); i++) {
+        const FFTComplex a = z[i], b = z[len2 - i];
+        FFTSample er = (a.re + b.re)*scale, ei = (a.im - b.im)*scale;
+        FFTSample dr = (a.re - b.re)*scale, di = (a.im + b.im)*scale;
+        FFTSample tr, ti;
+
+        CMUL(tr, ti, dr, di, exp[i].re, -exp[i].im);
+
+        z[i       ].re = er - ti;
+        z[i       ].im = ei + tr;
+        z[len2 - i].re = er + ti;
+        z[len2 - i].im = tr - ei;
+    }
+}
+
+static void rdft_r2c(AVTXContext *s, void *_dst, void *_src,
+                     ptrdiff_t stride)
+{
+    FFTComplex *dst = _dst;
+
+    s->top_tx(s, dst, _src, sizeof(FFTComplex));
+    rdft_postproc(s, dst, s->scale);
+}
+
+static void rdft_c2r(AVTXContext *s, void *_dst, void *_src,
+                     ptrdiff_t stride)
+{
+    FFTComplex *src = _src;
+
+    rdft_preproc(s, src, s->scale);
+    s->top_tx(s, _dst, src, sizeof(FFTComplex));
+}
+
+static void dct2(AVTXContext *s, void *_dst, void *_src, ptrdiff_t stride)
+{
+    FFTSample *src = _src;
+    FFTSample *dst = _dst;
+    const int len2 = s->n*s->m;
+    const int len = len2*2;
+    const FFTComplex *exp = s->exptab + (len2 >> 1) + 1;
+    FFTSample *tmp = (FFTSample *)s->rdft_tmp;
+    FFTComplex *z = s->rdft_tmp + len2;
+
+    /* Makhoul's reordering: evens ascending, odds descending */
+    for (int i = 0; i < len2; i++) {
+        tmp[i          ] = src[2*i + 0];
+        tmp[len - i - 1] = src[2*i + 1];
+    }
+
+    s->top_tx(s, z, tmp, sizeof(FFTComplex));
+    rdft_postproc(s, z, 1.0);
+
+    dst[0] = z[0].re*exp[0].re;
+    for (int i = 1; i < len2; i++) {
+        FFTSample re, im;
+        CMUL(re, im, z[i].re, z[i].im, exp[i].re, exp[i].im);
+        dst[i      ] =  re;
+        dst[len - i] = -im;
+    }
+    dst[len2] = z[len2].re*exp[len2].re;
+}
+
+static void dct3(AVTXContext *s, void *_dst, void *_src, ptrdiff_t stride)
+{
+    FFTSample *src = _src;
+    FFTSample *dst = _dst;
+    const int len2 = s->n*s->m;
+    const int len = len2*2;
+    const FFTComplex *exp = s->exptab + (len2 >> 1) + 1;
+    FFTSample *tmp = (FFTSample *)s->rdft_tmp;
+    FFTComplex *z = s->rdft_tmp + len2;
+
+    z[0].re = src[0]*exp[0].re;
+    z[0].im = 0;
+    for (int i = 1; i <= len2; i++)
+        CMUL(z[i].re, z[i].im, src[i], -src[len - i], exp[i].re, exp[i].im);
+
+    rdft_preproc(s, z, 1.0);
+    s->top_tx(s, tmp, z, sizeof(FFTComplex));
+
+    for (int i = 0; i < len2; i++) {
+        dst[2*i + 0] = tmp[i          ];
+        dst[2*i + 1] = tmp[len - i - 1];
+    }
+}
+
+int TX_NAME(ff_tx_init_rdft_dct)(AVTXContext *s, av_tx_fn *tx,
+                                 enum AVTXType type, int inv, int len,
+                                 const void *scale, uint64_t flags)
+{
+    const int is_dct = ff_tx_type_is_dct(type);
+    const int len2 = len >> 1;
+    double sc = scale ? *((SCALE_TYPE *)scale) : 1.0;
+    int err;
+
+    if ((len & 1) || len < 2) /* Odd real transforms are not supported yet */
+        return AVERROR(ENOSYS);
+    if (flags & AV_TX_INPLACE) /* Neither are in-place ones */
+        return AVERROR(ENOSYS);
+
+    /* The real transforms are built on top of a half-length complex FFT */
+    if ((err = TX_NAME(ff_tx_init_mdct_fft)(s, &s->top_tx, type, inv, len2,
+                                            NULL, flags)))
+        return err;
+
+    s->scale = sc;
+
+    if (!(s->exptab = av_malloc_array((len2 >> 1) + 1 + is_dct*(len2 + 1),
+                                      sizeof(*s->exptab))))
+        return AVERROR(ENOMEM);
+
+    for (int i = 0; i <= (len2 >> 1); i++) {
+        const double alpha = 2.0*M_PI*i/len;
+        s->exptab[i].re = RESCALE( cos(alpha));
+        s->exptab[i].im = RESCALE(-sin(alpha));
+    }
+
+    if (is_dct) {
+        FFTComplex *exp = s->exptab + (len2 >> 1) + 1;
+
+        if (!(s->rdft_tmp = av_malloc_array(2*len2 + 1, sizeof(*s->rdft_tmp))))
+            return AVERROR(ENOMEM);
+
+        /* The DCT-III is a factor of 2 larger than the inverse of the DCT-II */
+        if (inv)
+            sc *= 0.5;
+
+        for (int i = 0; i <= len2; i++) {
+            const double alpha = M_PI*i/(2.0*len);
+            exp[i].re = RESCALE(cos(alpha)*sc);
+            exp[i].im = RESCALE(sin(alpha)*sc*(inv ? 1 : -1));
+        }
+
+        *tx = inv ? dct3 : dct2;
+    } else {
+        *tx = inv ? rdft_c2r : rdft_r2c;
+    }
+
+    return 0;
+}
+#endif /* TX_FLOAT || TX_DOUBLE */
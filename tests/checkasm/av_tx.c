@@ -0,0 +1,144 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "libavutil/common.h"
+#include "libavutil/cpu.h"
+#include "libavutil/error.h"
+#include "libavutil/internal.h"
+#include "libavutil/mem.h"
+#include "libavutil/tx.h"
+
+#include "checkasm.h"
+
+#define MAX_LEN (1 << 15)
+
+typedef struct TXTest {
+    const char *name;
+    enum AVTXType type;
+    int inv;
+    float scale;
+    /* Number of floats read and written per transform length sample */
+    int in_mult, out_mult;
+    /* Extra floats read and written, for the real transforms' Nyquist bin */
+    int in_pad, out_pad;
+} TXTest;
+
+static const TXTest tests[] = {
+    { "fft",   AV_TX_FLOAT_FFT,  0, 1.0f, 2, 2, 0, 0 },
+    { "ifft",  AV_TX_FLOAT_FFT,  1, 1.0f, 2, 2, 0, 0 },
+    { "mdct",  AV_TX_FLOAT_MDCT, 0, 1.0f, 2, 1, 0, 0 },
+    { "imdct", AV_TX_FLOAT_MDCT, 1, 1.0f, 1, 1, 0, 0 },
+    { "rdft",  AV_TX_FLOAT_RDFT, 0, 1.0f, 1, 1, 0, 2 },
+    { "irdft", AV_TX_FLOAT_RDFT, 1, 0.5f, 1, 1, 2, 0 },
+    { "dct",   AV_TX_FLOAT_DCT,  0, 1.0f, 1, 1, 0, 0 },
+    { "idct",  AV_TX_FLOAT_DCT,  1, 1.0f, 1, 1, 0, 0 },
+};
+
+/* Power of two lengths, plus the 15*2^n lengths used by the Opus and AAC
+ * (960/1920 frame) MDCTs and the 3*2^n and 5*2^n compound transforms */
+static const int lengths[] = {
+    4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192, 16384, 32768,
+    60, 120, 240, 480, 960, 1920, 96, 384, 160, 640,
+};
+
+#define randomize_buffer(buf, len)                          \
+    do {                                                    \
+        for (int i = 0; i < len; i++)                       \
+            buf[i] = (float)rnd() / (UINT_MAX >> 1) - 1.0f; \
+    } while (0)
+
+static void check_tx(int t, int l, float *in, float *in_ref, float *in_new,
+                     float *out_ref, float *out_new)
+{
+    const TXTest *test = &tests[t];
+    const int len      = lengths[l];
+    const int in_len   = len * test->in_mult  + test->in_pad;
+    const int out_len  = len * test->out_mult + test->out_pad;
+    const ptrdiff_t stride = test->type == AV_TX_FLOAT_FFT ? sizeof(AVComplexFloat)
+                                                           : sizeof(float);
+    const int cpu_flags = av_get_cpu_flags();
+    AVTXContext *ctx, *ref_ctx = NULL;
+    av_tx_fn fn, ref_fn;
+    int ret;
+
+    declare_func(void, AVTXContext *s, void *out, void *in, ptrdiff_t stride);
+
+    ret = av_tx_init(&ctx, &fn, test->type, test->inv, len, &test->scale, 0);
+    if (ret < 0) {
+        fprintf(stderr, "av_tx: init of %s_%d failed: %s\n",
+                test->name, len, av_err2str(ret));
+        fail();
+        return;
+    }
+
+    if (check_func(fn, "%s_%d", test->name, len)) {
+        /* The function returned by av_tx_init() is only valid along with its
+         * own context, so the reference needs one set up without SIMD. */
+        av_force_cpu_flags(0);
+        ret = av_tx_init(&ref_ctx, &ref_fn, test->type, test->inv, len,
+                         &test->scale, 0);
+        av_force_cpu_flags(cpu_flags);
+        if (ret < 0) {
+            fail();
+            goto end;
+        }
+
+        memcpy(in_ref, in, in_len * sizeof(*in));
+        memcpy(in_new, in, in_len * sizeof(*in));
+        memset(out_ref, 0, out_len * sizeof(*out_ref));
+        memset(out_new, 0, out_len * sizeof(*out_new));
+
+        call_ref(ref_ctx, out_ref, in_ref, stride);
+        call_new(ctx, out_new, in_new, stride);
+        if (!float_near_abs_eps_array(out_ref, out_new, len * 2e-6f, out_len))
+            fail();
+
+        bench_new(ctx, out_new, in_new, stride);
+    }
+
+end:
+    av_tx_uninit(&ref_ctx);
+    av_tx_uninit(&ctx);
+}
+
+void checkasm_check_av_tx(void)
+{
+    float *in      = av_malloc(2 * MAX_LEN * sizeof(float) + 2 * sizeof(float));
+    float *in_ref  = av_malloc(2 * MAX_LEN * sizeof(float) + 2 * sizeof(float));
+    float *in_new  = av_malloc(2 * MAX_LEN * sizeof(float) + 2 * sizeof(float));
+    float *out_ref = av_malloc(2 * MAX_LEN * sizeof(float) + 2 * sizeof(float));
+    float *out_new = av_malloc(2 * MAX_LEN * sizeof(float) + 2 * sizeof(float));
+
+    if (!in || !in_ref || !in_new || !out_ref || !out_new)
+        goto end;
+
+    randomize_buffer(in, 2 * MAX_LEN + 2);
+
+    for (int t = 0; t < FF_ARRAY_ELEMS(tests); t++) {
+        for (int l = 0; l < FF_ARRAY_ELEMS(lengths); l++)
+            check_tx(t, l, in, in_ref, in_new, out_ref, out_new);
+        report("%s", tests[t].name);
+    }
+
+end:
+    av_free(in);
+    av_free(in_ref);
+    av_free(in_new);
+    av_free(out_ref);
+    av_free(out_new);
+}
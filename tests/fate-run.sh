@@ -491,6 +491,44 @@ concat(){
     fi
 }
 
+tee_framecrc(){
+    slave_opts=$1
+    shift 1
+    out1="${outdir}/${test}.1.framecrc"
+    out2="${outdir}/${test}.2.framecrc"
+    cleanfiles="$cleanfiles $out1 $out2"
+    ffmpeg "$@" -bitexact -f tee \
+        "[f=framecrc${slave_opts}]$(target_path $out1)|[f=framecrc${slave_opts}]$(target_path $out2)" || return
+    cmp $out1 $out2 || return
+    cat $out1
+}
+
+hls_parts(){
+    seg="${outdir}/${test}"
+    # the playlist goes to stdout on every update, the files to the cwd
+    (cd $outdir && ffmpeg "$@" -hls_segment_type fmp4 -hls_fmp4_init_filename ${test}.init.mp4 \
+        -hls_list_size 0 -hls_segment_filename ${test}_%d.m4s -f hls pipe:1) || return
+    cleanfiles="$cleanfiles $seg.init.mp4 $seg.parts.mp4 $seg.seg.mp4 $seg.parts.crc $seg.seg.crc"
+    i=0
+    while test -e ${seg}_$i.m4s; do
+        cat $seg.init.mp4 > $seg.parts.mp4
+        j=0
+        while test -e ${seg}_$i.part$j.m4s; do
+            cat ${seg}_$i.part$j.m4s >> $seg.parts.mp4
+            cleanfiles="$cleanfiles ${seg}_$i.part$j.m4s"
+            j=$(($j + 1))
+        done
+        cat $seg.init.mp4 ${seg}_$i.m4s > $seg.seg.mp4
+        cleanfiles="$cleanfiles ${seg}_$i.m4s"
+        # the parts of a segment hold the same packets as the segment
+        ffmpeg -i $(target_path $seg.parts.mp4) -c copy -f framecrc -y $(target_path $seg.parts.crc) || return
+        ffmpeg -i $(target_path $seg.seg.mp4) -c copy -f framecrc -y $(target_path $seg.seg.crc) || return
+        cmp $seg.parts.crc $seg.seg.crc || return
+        echo "${test}_$i.m4s: $j parts"
+        i=$(($i + 1))
+    done
+}
+
 venc_data(){
     file=$1
     stream=$2
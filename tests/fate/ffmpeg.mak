@@ -41,6 +41,15 @@ fate-ffmpeg-filter_colorkey: CMD = framecrc -auto_conversion_filters -idct simpl
 FATE_FFMPEG-$(CONFIG_COLOR_FILTER) += fate-ffmpeg-lavfi
 fate-ffmpeg-lavfi: CMD = framecrc -lavfi color=d=1:r=5 -fflags +bitexact
 
+# Both slaves must write all the packets. With onfull=drop, the queue is
+# larger than the input so that nothing is dropped.
+FATE_TEE-$(call ALLYES, TESTSRC_FILTER SINE_FILTER RAWVIDEO_ENCODER PCM_S16LE_ENCODER TEE_MUXER FRAMECRC_MUXER) += fate-tee-thread fate-tee-thread-onfull-drop
+fate-tee-thread: CMD = tee_framecrc ":thread_queue_size=4" -lavfi "testsrc=s=64x64:r=25:d=2;sine=d=2" -c:v rawvideo -c:a pcm_s16le -use_thread 1
+fate-tee-thread-onfull-drop: CMD = tee_framecrc ":use_thread=1:onfull=drop:thread_queue_size=256" -lavfi "testsrc=s=64x64:r=25:d=2;sine=d=2" -c:v rawvideo -c:a pcm_s16le
+
+FATE_FFMPEG += $(FATE_TEE-yes)
+fate-tee: $(FATE_TEE-yes)
+
 FATE_SAMPLES_FFMPEG-$(CONFIG_RAWVIDEO_DEMUXER) += fate-force_key_frames
 fate-force_key_frames: tests/data/vsynth_lena.yuv
 fate-force_key_frames: CMD = enc_dec \
@@ -41,6 +41,21 @@ fate-hls-live-endlist: CMD = md5 -i $(SRC) -af hdcd=process_stereo=false -t 20 -
 fate-hls-live-endlist: CMP = oneline
 fate-hls-live-endlist: REF = e189ce781d9c87882f58e3929455167b
 
+tests/data/hls_async_io.m3u8: TAG = GEN
+tests/data/hls_async_io.m3u8: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< \
+        -f lavfi -i "aevalsrc=cos(2*PI*t)*sin(2*PI*(440+4*t)*t):d=20" -f hls -hls_time 3 -map 0 \
+        -hls_list_size 0 -async_io 1 -async_io_queue_size 2 -codec:a mp2fixed \
+        -hls_segment_filename $(TARGET_PATH)/tests/data/hls_async_io_%d.ts \
+        $(TARGET_PATH)/tests/data/hls_async_io.m3u8 2>/dev/null
+
+FATE_HLSENC-$(call ALLYES, HLS_DEMUXER MPEGTS_MUXER MPEGTS_DEMUXER AEVALSRC_FILTER LAVFI_INDEV MP2FIXED_ENCODER) += fate-hls-async-io
+fate-hls-async-io: tests/data/hls_async_io.m3u8
+fate-hls-async-io: SRC = $(TARGET_PATH)/tests/data/hls_async_io.m3u8
+fate-hls-async-io: CMD = md5 -i $(SRC) -af hdcd=process_stereo=false -t 20 -f s24le
+fate-hls-async-io: CMP = oneline
+fate-hls-async-io: REF = e189ce781d9c87882f58e3929455167b
+
 tests/data/hls_segment_size.m3u8: TAG = GEN
 tests/data/hls_segment_size.m3u8: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
 	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< \
@@ -97,6 +112,28 @@ FATE_HLSENC-$(call ALLYES, HLS_DEMUXER MPEGTS_MUXER MPEGTS_DEMUXER AEVALSRC_FILT
 fate-hls-fmp4: tests/data/hls_fmp4.m3u8
 fate-hls-fmp4: CMD = framecrc -auto_conversion_filters -flags +bitexact -i $(TARGET_PATH)/tests/data/hls_fmp4.m3u8 -vf setpts=N*23
 
+tests/data/hls_fmp4_init.m3u8: TAG = GEN
+tests/data/hls_fmp4_init.m3u8: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< \
+	-f lavfi -i "testsrc=s=64x64:r=25:d=4" -map 0 -sws_flags +accurate_rnd+bitexact -codec:v mpeg4 -g 10 \
+	-flags +bitexact -fflags +bitexact \
+	-hls_segment_type fmp4 -hls_fmp4_init_filename hls_fmp4_init.mp4 -hls_list_size 0 \
+	-hls_time 1 -hls_segment_filename "$(TARGET_PATH)/tests/data/hls_fmp4_init_%d.m4s" \
+	$(TARGET_PATH)/tests/data/hls_fmp4_init.m3u8 2>/dev/null
+
+# the init segment ends with the moov, the first fragment is in the first segment
+FATE_HLSENC_PROBE-$(call ALLYES, HLS_DEMUXER MOV_MUXER MOV_DEMUXER TESTSRC_FILTER LAVFI_INDEV MPEG4_ENCODER) += fate-hls-fmp4-init
+fate-hls-fmp4-init: tests/data/hls_fmp4_init.m3u8
+fate-hls-fmp4-init: CMD = run ffprobe$(PROGSSUF)$(EXESUF) -count_packets -show_entries format=size:stream=codec_name,nb_read_packets $(TARGET_PATH)/tests/data/hls_fmp4_init.mp4
+
+FATE_HLSENC-$(call ALLYES, HLS_DEMUXER MOV_MUXER MOV_DEMUXER TESTSRC_FILTER LAVFI_INDEV MPEG4_ENCODER) += fate-hls-fmp4-segments
+fate-hls-fmp4-segments: tests/data/hls_fmp4_init.m3u8
+fate-hls-fmp4-segments: CMD = framecrc -flags +bitexact -i $(TARGET_PATH)/tests/data/hls_fmp4_init.m3u8 -c copy
+
+# the live playlists list the parts of the last segments and a preload hint
+FATE_HLSENC-$(call ALLYES, HLS_MUXER MOV_MUXER MOV_DEMUXER TESTSRC_FILTER LAVFI_INDEV MPEG4_ENCODER FRAMECRC_MUXER) += fate-hls-part-time
+fate-hls-part-time: CMD = hls_parts -auto_conversion_filters -f lavfi -i "testsrc=s=64x64:r=25:d=2" -map 0 -sws_flags +accurate_rnd+bitexact -codec:v mpeg4 -g 10 -flags +bitexact -fflags +bitexact -hls_time 1 -hls_part_time 0.2
+
 tests/data/hls_fmp4_ac3.m3u8: TAG = GEN
 tests/data/hls_fmp4_ac3.m3u8: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
 	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< \
@@ -2,14 +2,32 @@
 #fate-async: libavformat/tests/async$(EXESUF)
 #fate-async: CMD = run libavformat/tests/async
 
+FATE_LIBAVFORMAT_HTTP-$(HAVE_EPOLL_CREATE1) += fate-http
+FATE_LIBAVFORMAT-$(call ALLYES, HTTP_PROTOCOL TCP_PROTOCOL) += $(FATE_LIBAVFORMAT_HTTP-$(HAVE_PTHREADS))
+fate-http: libavformat/tests/http$(EXESUF)
+fate-http: CMD = run libavformat/tests/http$(EXESUF)
+
 FATE_LIBAVFORMAT-$(CONFIG_NETWORK) += fate-noproxy
 fate-noproxy: libavformat/tests/noproxy$(EXESUF)
 fate-noproxy: CMD = run libavformat/tests/noproxy$(EXESUF)
 
+FATE_LIBAVFORMAT-$(CONFIG_RTP_PROTOCOL) += fate-prompegdec
+fate-prompegdec: libavformat/tests/prompegdec$(EXESUF)
+fate-prompegdec: CMD = run libavformat/tests/prompegdec$(EXESUF)
+
+FATE_LIBAVFORMAT-$(CONFIG_RTPDEC) += fate-rfc4175
+fate-rfc4175: libavformat/tests/rfc4175$(EXESUF)
+fate-rfc4175: CMD = run libavformat/tests/rfc4175$(EXESUF)
+
 FATE_LIBAVFORMAT-$(CONFIG_FFRTMPCRYPT_PROTOCOL) += fate-rtmpdh
 fate-rtmpdh: libavformat/tests/rtmpdh$(EXESUF)
 fate-rtmpdh: CMD = run libavformat/tests/rtmpdh$(EXESUF)
 
+FATE_LIBAVFORMAT_SEGPREFETCH-$(call ALLYES, HLS_DEMUXER MPEGTS_DEMUXER HTTP_PROTOCOL DATA_PROTOCOL FILE_PROTOCOL HLS_MUXER MPEGTS_MUXER AEVALSRC_FILTER LAVFI_INDEV MP2FIXED_ENCODER) += fate-segprefetch
+FATE_LIBAVFORMAT-$(HAVE_THREADS) += $(FATE_LIBAVFORMAT_SEGPREFETCH-yes)
+fate-segprefetch: libavformat/tests/segprefetch$(EXESUF) tests/data/hls_list_size.m3u8
+fate-segprefetch: CMD = run libavformat/tests/segprefetch$(EXESUF) $(TARGET_PATH)/tests/data
+
 FATE_LIBAVFORMAT-$(CONFIG_SRTP) += fate-srtp
 fate-srtp: libavformat/tests/srtp$(EXESUF)
 fate-srtp: CMD = run libavformat/tests/srtp$(EXESUF)
@@ -50,6 +50,24 @@ $(foreach N,$(FATE_SEGMENT_ALLPARTS),$(eval $(N:%=fate-segment-adts-to-mkv-heade
 fate-segment-adts-to-mkv-header-%: CMD = framecrc -flags +bitexact -i $(TARGET_PATH)/tests/data/$(@:fate-segment-adts-to-mkv-header-%=adts-to-mkv-cated-%).mkv -c copy
 FATE_SEGMENT-$(call ALLYES, AAC_DEMUXER AAC_ADTSTOASC_BSF MATROSKA_MUXER MATROSKA_DEMUXER SEGMENT_MUXER HLS_DEMUXER) += $(FATE_SEGMENT_SPLIT)
 
+tests/data/segment-mp4-%.ffconcat: TAG = GEN
+tests/data/segment-mp4-%.ffconcat: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< \
+        -f lavfi -i "testsrc=s=64x64:r=25:d=4" -map 0 -sws_flags +accurate_rnd+bitexact -codec:v mpeg4 -g 10 \
+        -flags +bitexact -fflags +bitexact \
+        -f segment -segment_time 1 -segment_format mp4 -segment_format_options movflags=+faststart \
+        -async_finalize $(if $(filter async,$*),1,0) -segment_list_type ffconcat \
+        -segment_list $(TARGET_PATH)/$@ -y $(TARGET_PATH)/tests/data/segment-mp4-$*-%03d.mp4 2>/dev/null
+
+# finalizing the segments in a thread must not change the output
+FATE_SEGMENT_FFMPEG-$(call ALLYES, LAVFI_INDEV TESTSRC_FILTER MPEG4_ENCODER MOV_MUXER SEGMENT_MUXER CONCAT_DEMUXER MOV_DEMUXER) += fate-segment-mp4-sync fate-segment-mp4-async
+fate-segment-mp4-sync: tests/data/segment-mp4-sync.ffconcat
+fate-segment-mp4-sync: CMD = framecrc -flags +bitexact -i $(TARGET_PATH)/tests/data/segment-mp4-sync.ffconcat -c copy
+fate-segment-mp4-async: tests/data/segment-mp4-async.ffconcat
+fate-segment-mp4-async: CMD = framecrc -flags +bitexact -i $(TARGET_PATH)/tests/data/segment-mp4-async.ffconcat -c copy
+fate-segment-mp4-async: REF = $(SRC_PATH)/tests/ref/fate/segment-mp4-sync
+
 FATE_SAMPLES_FFMPEG += $(FATE_SEGMENT-yes)
+FATE_FFMPEG += $(FATE_SEGMENT_FFMPEG-yes)
 
-fate-segment: $(FATE_SEGMENT-yes)
+fate-segment: $(FATE_SEGMENT-yes) $(FATE_SEGMENT_FFMPEG-yes)
@@ -71,6 +71,7 @@ struct hash_impl {
  * lavu: libavutil
  ***************************************************************************/
 
+#include "libavutil/adler32.h"
 #include "libavutil/md5.h"
 #include "libavutil/sha.h"
 #include "libavutil/sha512.h"
@@ -104,6 +105,24 @@ static void run_lavu_ ## suffix(uint8_t *output,                             \
     av_ ## namespace ## _final(h, output);                                   \
 }
 
+static void run_lavu_crc32(uint8_t *output,
+                           const uint8_t *input, unsigned size)
+{
+    AV_WB32(output, av_crc(av_crc_get_table(AV_CRC_32_IEEE_LE), 0, input, size));
+}
+
+static void run_lavu_crc32be(uint8_t *output,
+                             const uint8_t *input, unsigned size)
+{
+    AV_WB32(output, av_crc(av_crc_get_table(AV_CRC_32_IEEE), 0, input, size));
+}
+
+static void run_lavu_adler32(uint8_t *output,
+                             const uint8_t *input, unsigned size)
+{
+    AV_WB32(output, av_adler32_update(1, input, size));
+}
+
 DEFINE_LAVU_MD(sha1,      AVSHA,    sha, 160);
 DEFINE_LAVU_MD(sha256,    AVSHA,    sha, 256);
 DEFINE_LAVU_MD(sha512,    AVSHA512, sha512, 512);
@@ -646,6 +665,9 @@ struct hash_impl implementations[] = {
     IMPL(lavu,     "RIPEMD-128", ripemd128, "9ab8bfba2ddccc5d99c9d4cdfb844a5f")
     IMPL(tomcrypt, "RIPEMD-128", ripemd128, "9ab8bfba2ddccc5d99c9d4cdfb844a5f")
     IMPL_ALL("RIPEMD-160", ripemd160, "62a5321e4fc8784903bb43ab7752c75f8b25af00")
+    IMPL(lavu,     "CRC-32",     crc32,     "b56da6ba")
+    IMPL(lavu,     "CRC-32-BE",  crc32be,   "ffe7b880")
+    IMPL(lavu,     "ADLER-32",   adler32,   "02be3d2d")
     IMPL_ALL("AES-128",    aes128,    "crc:ff6bc888")
     IMPL_ALL("CAMELLIA",   camellia,  "crc:7abb59a7")
     IMPL(lavu,     "CAST-128", cast128, "crc:456aa584")
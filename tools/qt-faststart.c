@@ -22,14 +22,32 @@
  * the top-level atoms by shifting the moov atom from the back of the file
  * to the front, and patch the chunk offsets along the way. This utility
  * presently only operates on uncompressed moov atoms.
+ *
+ * On Linux, the data following the moov atom is copied with
+ * copy_file_range(), which lets the kernel (or the filesystem, through
+ * reflinks or server-side copies) move it without passing every byte
+ * through userspace. Other systems use large buffered copies.
  */
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <inttypes.h>
 #include <string.h>
 #include <limits.h>
 
+#if defined(__linux__) && defined(__GLIBC__) && \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+#include <errno.h>
+#include <unistd.h>
+#define USE_COPY_FILE_RANGE 1
+#else
+#define USE_COPY_FILE_RANGE 0
+#endif
+
 #ifdef __MINGW32__
 #undef fseeko
 #define fseeko(x, y, z) fseeko64(x, y, z)
@@ -427,6 +445,49 @@ static int update_moov_atom(
     return 0;
 }
 
+#if USE_COPY_FILE_RANGE
+/**
+ * Copy size bytes from the current position of infile to the current
+ * position of outfile without going through a userspace buffer.
+ * @return the number of bytes copied, which is less than size if
+ *         copy_file_range() is not supported for these files (e.g. pipes),
+ *         -1 on error with errno set, or -2 if infile ends before size bytes
+ */
+static int64_t copy_file_range_all(FILE *infile, FILE *outfile, int64_t size)
+{
+    int64_t copied = 0;
+    loff_t in_pos, out_pos;
+
+    if (fflush(outfile))
+        return -1;
+    in_pos  = ftello(infile);
+    out_pos = ftello(outfile);
+    if (in_pos < 0 || out_pos < 0)
+        return 0;
+
+    while (copied < size) {
+        ssize_t ret = copy_file_range(fileno(infile), &in_pos,
+                                      fileno(outfile), &out_pos,
+                                      MIN(size - copied, 1 << 30), 0);
+        if (ret < 0) {
+            /* not supported by the kernel or across these filesystems,
+             * the caller falls back to a buffered copy */
+            if (!copied && (errno == ENOSYS || errno == EXDEV ||
+                            errno == EINVAL || errno == EOPNOTSUPP))
+                break;
+            return -1;
+        }
+        if (!ret)
+            return -2;
+        copied += ret;
+    }
+
+    if (fseeko(infile, in_pos, SEEK_SET) || fseeko(outfile, out_pos, SEEK_SET))
+        return -1;
+    return copied;
+}
+#endif
+
 int main(int argc, char *argv[])
 {
     FILE *infile  = NULL;
@@ -636,6 +697,24 @@ int main(int argc, char *argv[])
     }
 
     /* copy the remainder of the infile, from offset 0 -> last_offset - 1 */
+#if USE_COPY_FILE_RANGE
+    if (last_offset) {
+        int64_t copied = copy_file_range_all(infile, outfile, last_offset);
+        if (copied == -2) {
+            fprintf(stderr, "%s: file is truncated\n", argv[1]);
+            goto error_out;
+        }
+        if (copied < 0) {
+            perror(argv[2]);
+            goto error_out;
+        }
+        if (copied > 0)
+            printf(" copied rest of file with copy_file_range...\n");
+        last_offset -= copied;
+    }
+    if (!last_offset)
+        goto done;
+#endif
     bytes_to_copy = MIN(COPY_BUFFER_SIZE, last_offset);
     copy_buffer = malloc(bytes_to_copy);
     if (!copy_buffer) {
@@ -657,6 +736,9 @@ int main(int argc, char *argv[])
         last_offset -= bytes_to_copy;
     }
 
+#if USE_COPY_FILE_RANGE
+done:
+#endif
     fclose(infile);
     fclose(outfile);
     free(moov_atom);